@@ -0,0 +1,902 @@
+#include <rtd/feed_adapter.h> // Winsock 2 has to precede <windows.h>
+#include <windows.h>
+#include <psapi.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <span>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <rtd/rtd.h>
+#include <rtd/xloper_hash.h>
+#include <rtd/shm_feed.h>
+
+// --- Allocation accounting ---
+// Counts C++ heap allocations (operator new / new[], which TopicValue and the standard
+// containers use) and tracks live bytes for a per-case peak. BSTRs come from the OLE
+// allocator and are not included; the suite reports them separately where they are known.
+namespace {
+    std::atomic<unsigned long long> g_allocCount{0};
+    std::atomic<long long> g_liveBytes{0};
+    std::atomic<long long> g_peakBytes{0};
+    constexpr size_t kAllocHeader = 16; // Keeps the returned block 16-byte aligned
+}
+
+void* operator new(size_t size) {
+    void* raw = std::malloc(size + kAllocHeader);
+    if (!raw) throw std::bad_alloc();
+    std::memcpy(raw, &size, sizeof(size));
+    g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    long long live = g_liveBytes.fetch_add(static_cast<long long>(size), std::memory_order_relaxed) + static_cast<long long>(size);
+    long long peak = g_peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !g_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    return static_cast<char*>(raw) + kAllocHeader;
+}
+
+void operator delete(void* block) noexcept {
+    if (!block) return;
+    void* raw = static_cast<char*>(block) - kAllocHeader;
+    size_t size = 0;
+    std::memcpy(&size, raw, sizeof(size));
+    g_liveBytes.fetch_sub(static_cast<long long>(size), std::memory_order_relaxed);
+    std::free(raw);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    operator delete(block);
+}
+
+// Minimal server: topics are fed by the benchmark, never by ConnectData
+class BenchServer : public rtd::RtdServerBase {
+public:
+    HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+        if (!pvarOut) return E_POINTER;
+        pvarOut->vt = VT_ERROR;
+        pvarOut->scode = 2043;
+        return S_OK;
+    }
+
+    // The pre-in-place RefreshData: VariantCopy into a temporary vector under the lock,
+    // then SafeArrayPutElement (a second copy) per cell. Kept as the comparison baseline.
+    HRESULT RefreshDataCopyTwice(long* TopicCount, SAFEARRAY** parrayOut) {
+        std::vector<long> dirtyTopics;
+        std::vector<VARIANT> topicValues;
+        {
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            for (size_t s = 0; s < m_shards.Count(); ++s) {
+                rtd::TopicStore& store = m_shards[s].store;
+                std::lock_guard<std::mutex> shardLock(m_shards[s].mutex);
+                for (long localId = store.PopDirty(); localId != rtd::TopicStore::kNil; localId = store.PopDirty()) {
+                    VARIANT value;
+                    VariantInit(&value);
+                    store.At(localId).value.CopyTo(&value);
+                    dirtyTopics.push_back(m_shards.GlobalId(s, localId));
+                    topicValues.push_back(value);
+                }
+            }
+        }
+        long count = static_cast<long>(dirtyTopics.size());
+        SAFEARRAY* psa = nullptr;
+        HRESULT hr = CreateRefreshDataArray(count, &psa);
+        if (FAILED(hr)) return hr;
+        for (long i = 0; i < count; ++i) {
+            long indices[2] = { i, 0 };
+            VARIANT vTopicId;
+            vTopicId.vt = VT_I4;
+            vTopicId.lVal = dirtyTopics[i];
+            SafeArrayPutElement(psa, indices, &vTopicId);
+            indices[1] = 1;
+            SafeArrayPutElement(psa, indices, &topicValues[i]);
+        }
+        for (auto& v : topicValues) VariantClear(&v);
+        *TopicCount = count;
+        *parrayOut = psa;
+        return S_OK;
+    }
+};
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Drains the server the way Excel would, until told to stop
+static void RefreshLoop(rtd::RtdServerBase* server, std::atomic<bool>& stop, long& refreshes) {
+    long topicCount = 0;
+    SAFEARRAY* sa = nullptr;
+    while (!stop.load(std::memory_order_acquire)) {
+        server->RefreshData(&topicCount, &sa);
+        if (sa) {
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+        ++refreshes;
+        std::this_thread::yield();
+    }
+    server->RefreshData(&topicCount, &sa);
+    if (sa) SafeArrayDestroy(sa);
+}
+
+// --- Ingestion: producer thread scaling, mutex path vs lock-free rings ---
+static void BenchIngest() {
+    const int updatesPerThread = 200000;
+    const int topicsPerThread = 1000;
+    const int threadCounts[] = { 1, 2, 4, 8, 16 };
+    const rtd::IngestMode modes[] = { rtd::IngestMode::Locked, rtd::IngestMode::LockFree };
+
+    std::cout << "ingest: " << updatesPerThread << " double updates per producer, "
+              << topicsPerThread << " topics per producer, one RefreshData loop" << std::endl;
+    std::cout << std::left << std::setw(10) << "mode" << std::setw(10) << "threads"
+              << std::setw(16) << "Mupdates/s" << std::setw(12) << "refreshes" << std::endl;
+
+    for (rtd::IngestMode mode : modes) {
+        for (int threads : threadCounts) {
+            BenchServer* server = new BenchServer();
+            server->SetIngestMode(mode);
+
+            std::atomic<bool> stop{false};
+            long refreshes = 0;
+            std::thread consumer(RefreshLoop, server, std::ref(stop), std::ref(refreshes));
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> producers;
+            for (int p = 0; p < threads; ++p) {
+                producers.emplace_back([server, p, updatesPerThread, topicsPerThread]() {
+                    VARIANT v;
+                    VariantInit(&v);
+                    v.vt = VT_R8;
+                    long base = p * topicsPerThread;
+                    for (int i = 0; i < updatesPerThread; ++i) {
+                        v.dblVal = i;
+                        server->UpdateTopic(base + (i % topicsPerThread), v);
+                    }
+                });
+            }
+            for (auto& t : producers) t.join();
+            double elapsed = SecondsSince(start);
+
+            stop.store(true, std::memory_order_release);
+            consumer.join();
+            server->Release();
+
+            double rate = (static_cast<double>(updatesPerThread) * threads) / elapsed / 1e6;
+            std::cout << std::left << std::setw(10) << (mode == rtd::IngestMode::Locked ? "locked" : "lockfree")
+                      << std::setw(10) << threads << std::setw(16) << std::fixed << std::setprecision(2) << rate
+                      << std::setw(12) << refreshes << std::endl;
+        }
+    }
+}
+
+// --- Sharded store: locked-path producer throughput vs shard count ---
+static void BenchShards() {
+    const int updatesPerThread = 200000;
+    const int topicsPerThread = 1000;
+    const int threadCounts[] = { 1, 2, 4, 8 };
+    const size_t shardCounts[] = { 1, 2, 4, 8, 16 };
+
+    std::cout << "shards: " << updatesPerThread << " double updates per producer (locked mode), "
+              << topicsPerThread << " topics per producer, one RefreshData loop" << std::endl;
+    std::cout << std::left << std::setw(10) << "shards" << std::setw(10) << "threads"
+              << std::setw(16) << "Mupdates/s" << std::setw(12) << "refreshes" << std::endl;
+
+    for (size_t shards : shardCounts) {
+        for (int threads : threadCounts) {
+            BenchServer* server = new BenchServer();
+            server->SetShardCount(shards);
+
+            std::atomic<bool> stop{false};
+            long refreshes = 0;
+            std::thread consumer(RefreshLoop, server, std::ref(stop), std::ref(refreshes));
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> producers;
+            for (int p = 0; p < threads; ++p) {
+                producers.emplace_back([server, p, updatesPerThread, topicsPerThread]() {
+                    long base = p * topicsPerThread;
+                    for (int i = 0; i < updatesPerThread; ++i) {
+                        server->UpdateTopic(base + (i % topicsPerThread), static_cast<double>(i));
+                    }
+                });
+            }
+            for (auto& t : producers) t.join();
+            double elapsed = SecondsSince(start);
+
+            stop.store(true, std::memory_order_release);
+            consumer.join();
+            server->Release();
+
+            double rate = (static_cast<double>(updatesPerThread) * threads) / elapsed / 1e6;
+            std::cout << std::left << std::setw(10) << shards << std::setw(10) << threads
+                      << std::setw(16) << std::fixed << std::setprecision(2) << rate
+                      << std::setw(12) << refreshes << std::endl;
+        }
+    }
+}
+
+// --- Batch publish: UpdateTopics over spans vs a per-topic UpdateTopic loop ---
+static void BenchBatch() {
+    const long batchSizes[] = { 1000, 10000, 100000 };
+    const int rounds = 50;
+    const char* pathNames[] = { "per-topic", "batch" };
+
+    std::cout << "batch: ns per topic update (one snapshot per round, drained between rounds)" << std::endl;
+    std::cout << std::left << std::setw(10) << "topics" << std::setw(10) << "type"
+              << std::setw(16) << "path" << std::setw(12) << "ns/topic" << std::endl;
+
+    for (long topics : batchSizes) {
+        std::vector<long> ids(topics);
+        std::vector<double> doubles(topics);
+        std::vector<VARIANT> variants(topics);
+        for (long i = 0; i < topics; ++i) {
+            ids[i] = i;
+            doubles[i] = 100.0 + i * 0.01;
+            VariantInit(&variants[i]);
+            variants[i].vt = VT_R8;
+            variants[i].dblVal = doubles[i];
+        }
+
+        for (int isVariant = 0; isVariant < 2; ++isVariant) {
+            for (int batch = 0; batch < 2; ++batch) {
+                BenchServer* server = new BenchServer();
+                double total = 0;
+                for (int r = 0; r < rounds; ++r) {
+                    auto start = std::chrono::steady_clock::now();
+                    if (batch) {
+                        if (isVariant) server->UpdateTopics(std::span<const long>(ids), std::span<const VARIANT>(variants));
+                        else server->UpdateTopics(std::span<const long>(ids), std::span<const double>(doubles));
+                    } else {
+                        for (long i = 0; i < topics; ++i) {
+                            if (isVariant) server->UpdateTopic(ids[i], variants[i]);
+                            else server->UpdateTopic(ids[i], doubles[i]);
+                        }
+                        server->NotifyUpdate();
+                    }
+                    total += SecondsSince(start);
+
+                    long topicCount = 0;
+                    SAFEARRAY* sa = nullptr;
+                    server->RefreshData(&topicCount, &sa);
+                    if (sa) SafeArrayDestroy(sa);
+                }
+                server->Release();
+
+                std::cout << std::left << std::setw(10) << topics << std::setw(10) << (isVariant ? "variant" : "double")
+                          << std::setw(16) << pathNames[batch] << std::setw(12) << std::fixed << std::setprecision(1)
+                          << (total * 1e9 / (static_cast<double>(topics) * rounds)) << std::endl;
+            }
+        }
+    }
+}
+
+// --- RefreshData: two-copy baseline vs in-place fill (copy when retained, move otherwise) ---
+static void BenchRefresh() {
+    const long topicCounts[] = { 10000, 100000 };
+    const int rounds = 20;
+    enum Path { CopyTwice, InPlaceRetain, InPlaceMove };
+    const char* pathNames[] = { "copy-twice", "inplace-copy", "inplace-move" };
+
+    std::cout << "refresh: ns per delivered topic (RefreshData only; Excel's SafeArrayDestroy excluded)" << std::endl;
+    std::cout << std::left << std::setw(10) << "topics" << std::setw(10) << "type"
+              << std::setw(16) << "path" << std::setw(12) << "ns/topic" << std::endl;
+
+    for (long topics : topicCounts) {
+        for (int isString = 0; isString < 2; ++isString) {
+            for (int path = CopyTwice; path <= InPlaceMove; ++path) {
+                BenchServer* server = new BenchServer();
+                server->SetRetainValues(path != InPlaceMove);
+
+                VARIANT v;
+                VariantInit(&v);
+                if (isString) {
+                    v.vt = VT_BSTR;
+                    v.bstrVal = SysAllocString(L"EXCHANGE-OPEN");
+                } else {
+                    v.vt = VT_R8;
+                    v.dblVal = 101.25;
+                }
+
+                double total = 0;
+                for (int r = 0; r < rounds; ++r) {
+                    for (long id = 0; id < topics; ++id) server->UpdateTopic(id, v);
+
+                    long topicCount = 0;
+                    SAFEARRAY* sa = nullptr;
+                    auto start = std::chrono::steady_clock::now();
+                    if (path == CopyTwice) server->RefreshDataCopyTwice(&topicCount, &sa);
+                    else server->RefreshData(&topicCount, &sa);
+                    total += SecondsSince(start);
+                    if (sa) SafeArrayDestroy(sa);
+                }
+                VariantClear(&v);
+                server->Release();
+
+                std::cout << std::left << std::setw(10) << topics << std::setw(10) << (isString ? "string" : "double")
+                          << std::setw(16) << pathNames[path] << std::setw(12) << std::fixed << std::setprecision(1)
+                          << (total * 1e9 / (static_cast<double>(topics) * rounds)) << std::endl;
+            }
+        }
+    }
+}
+
+// --- Content hashing of a 1000x1000 xltypeMulti input: scalar vs vector stripe loop ---
+static void BenchHash() {
+    const long rows = 1000, columns = 1000;
+    const int rounds = 10;
+    std::vector<XLOPER12> cells(static_cast<size_t>(rows * columns));
+    static XCHAR label[] = L"\x0006Ticker";
+
+    std::cout << "hash: " << rows << "x" << columns << " xltypeMulti, GB/s of cell data"
+              << (rtd::ContentHasher::kVectorized ? "" : " (no SIMD in this build)") << std::endl;
+    std::cout << std::left << std::setw(10) << "cells" << std::setw(10) << "isa"
+              << std::setw(12) << "ms/hash" << std::setw(12) << "GB/s" << std::endl;
+
+    for (int mixed = 0; mixed < 2; ++mixed) {
+        for (size_t i = 0; i < cells.size(); ++i) {
+            if (mixed && i % 10 == 0) {
+                cells[i].xltype = xltypeStr;
+                cells[i].val.str = label;
+            } else {
+                cells[i].xltype = xltypeNum;
+                cells[i].val.num = static_cast<double>(i) * 0.25;
+            }
+        }
+        XLOPER12 matrix;
+        matrix.xltype = xltypeMulti;
+        matrix.val.array.lparray = cells.data();
+        matrix.val.array.rows = rows;
+        matrix.val.array.columns = columns;
+
+        for (rtd::HashIsa isa : { rtd::HashIsa::Scalar, rtd::HashIsa::Native }) {
+            rtd::XloperHasher hasher(isa);
+            volatile uint64_t sink = hasher.Hash(matrix);
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < rounds; ++r) sink = sink + hasher.Hash(matrix);
+            double seconds = SecondsSince(start) / rounds;
+            std::cout << std::left << std::setw(10) << (mixed ? "mixed" : "numbers")
+                      << std::setw(10) << (isa == rtd::HashIsa::Scalar ? "scalar" : "native")
+                      << std::setw(12) << std::fixed << std::setprecision(2) << seconds * 1e3
+                      << std::setw(12) << (cells.size() * sizeof(XLOPER12) / seconds / 1e9) << std::endl;
+        }
+    }
+
+    rtd::ContentHashCache cache;
+    const int lookups = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < lookups; ++i) cache.MarkSent(static_cast<uint64_t>(i % 1000), 8000000);
+    std::cout << "dedupe: " << std::fixed << std::setprecision(1) << SecondsSince(start) * 1e9 / lookups
+              << " ns per MarkSent (1000 distinct inputs)" << std::endl;
+}
+
+// --- Shared-memory feed: producer threads -> ring -> reader thread -> UpdateTopics ---
+static void BenchShmFeed() {
+    const std::wstring name = L"Local\\RtdBenchFeed";
+    const long topics = 1000;
+    const long long perProducer = 1000000;
+
+    std::cout << "shmfeed: " << perProducer << " double updates per producer over " << topics
+              << " topics; latency is producer stamp to UpdateTopics applied (log2 bucket bounds)" << std::endl;
+    std::cout << std::left << std::setw(10) << "threads" << std::setw(12) << "rate" << std::setw(14) << "Mmsg/s"
+              << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "p999 us"
+              << std::setw(10) << "retries" << std::endl;
+
+    // rate 0 = flat out (throughput); otherwise paced per producer (tail latency without queueing)
+    const long long rates[] = { 0, 100000 };
+    for (long long rate : rates) {
+        for (int threads : { 1, 2, 4 }) {
+            if (rate != 0 && threads != 1) continue;
+            BenchServer* server = new BenchServer();
+            rtd::ShmFeedReader reader(*server);
+            if (FAILED(reader.Start(name, 65536))) {
+                std::cout << "cannot create the feed" << std::endl;
+                server->Release();
+                return;
+            }
+            long long messages = rate != 0 ? rate : perProducer; // One second when paced
+            std::atomic<unsigned long long> retries{0};
+            std::atomic<bool> stop{false};
+            long refreshes = 0;
+            std::thread refresher(RefreshLoop, server, std::ref(stop), std::ref(refreshes));
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> producers;
+            for (int t = 0; t < threads; ++t) {
+                producers.emplace_back([&, t]() {
+                    rtd::ShmFeedWriter writer;
+                    if (FAILED(writer.Open(name))) return;
+                    unsigned long long localRetries = 0;
+                    auto begin = std::chrono::steady_clock::now();
+                    for (long long i = 0; i < messages; ++i) {
+                        if (rate != 0) {
+                            auto due = begin + std::chrono::nanoseconds(i * 1000000000LL / rate);
+                            while (std::chrono::steady_clock::now() < due) std::this_thread::yield();
+                        }
+                        uint64_t key = static_cast<uint64_t>((i * threads + t) % topics);
+                        while (!writer.Push(key, static_cast<double>(i))) {
+                            ++localRetries;
+                            std::this_thread::yield();
+                        }
+                    }
+                    retries.fetch_add(localRetries);
+                });
+            }
+            for (auto& producer : producers) producer.join();
+            unsigned long long total = static_cast<unsigned long long>(messages) * threads;
+            while (reader.GetStats().records < total) std::this_thread::yield();
+            double seconds = SecondsSince(start);
+            rtd::ShmFeedReader::Stats stats = reader.GetStats();
+            reader.Stop();
+            stop = true;
+            refresher.join();
+            server->Release();
+
+            std::cout << std::left << std::setw(10) << threads << std::setw(12) << (rate ? std::to_string(rate) : "max")
+                      << std::setw(14) << std::fixed << std::setprecision(2) << (total / seconds / 1e6)
+                      << std::setw(10) << std::setprecision(1) << stats.LatencyPercentileNs(0.5) / 1e3
+                      << std::setw(10) << stats.LatencyPercentileNs(0.99) / 1e3
+                      << std::setw(10) << stats.LatencyPercentileNs(0.999) / 1e3
+                      << std::setw(10) << retries.load() << std::endl;
+        }
+    }
+}
+
+// --- Stream feed: publisher -> named pipe / loopback TCP -> FeedAdapter -> UpdateSubscriptions ---
+static void BenchFeed() {
+    class FeedServer : public rtd::RtdServerBase {
+    public:
+        rtd::FeedAdapter feed{ *this };
+    protected:
+        HRESULT OnSubscribe(const rtd::SubscriptionHandle& subscription, const rtd::TopicArgs& args) override {
+            feed.Subscribe(subscription, args);
+            return S_OK;
+        }
+        void OnUnsubscribe(const rtd::SubscriptionHandle& subscription) override { feed.Unsubscribe(subscription); }
+    };
+
+    const std::wstring pipeName = L"\\\\.\\pipe\\RtdBenchFeed";
+    const unsigned short port = 47392;
+    const long topics = 1000;
+
+    std::cout << "feed: double updates over " << topics << " subscriptions; latency is publisher stamp to "
+              << "UpdateSubscriptions applied (log2 bucket bounds)" << std::endl;
+    std::cout << std::left << std::setw(8) << "link" << std::setw(8) << "batch" << std::setw(12) << "frames/s"
+              << std::setw(14) << "Mupdates/s" << std::setw(10) << "MB/s" << std::setw(10) << "p50 us"
+              << std::setw(10) << "p99 us" << std::setw(10) << "p999 us" << std::endl;
+
+    struct Case { int batch; long long frameRate; };
+    // frameRate 0 = flat out (throughput); otherwise paced (latency without queueing)
+    const Case cases[] = { { 1, 0 }, { 64, 0 }, { 1024, 0 }, { 1, 10000 }, { 64, 1000 } };
+    for (int tcp = 0; tcp < 2; ++tcp) {
+        for (const Case& c : cases) {
+            FeedServer* server = new FeedServer();
+            std::vector<SAFEARRAY*> strings(topics);
+            for (long id = 0; id < topics; ++id) {
+                strings[id] = SafeArrayCreateVector(VT_VARIANT, 0, 1);
+                std::wstring symbol = L"SYM" + std::to_wstring(id);
+                VARIANT v;
+                VariantInit(&v);
+                v.vt = VT_BSTR;
+                v.bstrVal = SysAllocString(symbol.c_str());
+                long index = 0;
+                SafeArrayPutElement(strings[id], &index, &v);
+                VariantClear(&v);
+                VARIANT_BOOL getNewValues = VARIANT_FALSE;
+                VARIANT out;
+                VariantInit(&out);
+                server->ConnectData(id, &strings[id], &getNewValues, &out);
+            }
+
+            rtd::FeedPublisher publisher;
+            HRESULT hr = tcp ? publisher.ListenTcp(port) : publisher.ListenPipe(pipeName);
+            if (SUCCEEDED(hr)) hr = tcp ? server->feed.ConnectTcp(port) : server->feed.ConnectPipe(pipeName);
+            if (SUCCEEDED(hr)) hr = publisher.Accept();
+            if (FAILED(hr)) {
+                std::cout << "cannot connect the feed (hr=0x" << std::hex << hr << std::dec << ")" << std::endl;
+                server->Release();
+                return;
+            }
+
+            // The adapter sends one Subscribe frame per subscription after connecting
+            std::vector<uint64_t> keys;
+            std::vector<uint8_t> payload;
+            rtd::FeedFrameKind kind{};
+            while (keys.size() < static_cast<size_t>(topics) && SUCCEEDED(publisher.Receive(kind, payload))) {
+                uint64_t key = 0;
+                rtd::FeedPayloadReader reader(payload.data(), payload.size());
+                if (kind == rtd::FeedFrameKind::Subscribe && reader.Read(key)) keys.push_back(key);
+            }
+
+            std::atomic<bool> stop{false};
+            long refreshes = 0;
+            std::thread refresher(RefreshLoop, server, std::ref(stop), std::ref(refreshes));
+
+            long long frames = c.frameRate != 0 ? c.frameRate : (c.batch == 1 ? 200000 : 2000000 / c.batch);
+            rtd::FeedFrameWriter writer;
+            auto start = std::chrono::steady_clock::now();
+            size_t next = 0;
+            for (long long f = 0; f < frames; ++f) {
+                if (c.frameRate != 0) {
+                    auto due = start + std::chrono::nanoseconds(f * 1000000000LL / c.frameRate);
+                    while (std::chrono::steady_clock::now() < due) std::this_thread::yield();
+                }
+                writer.BeginUpdates();
+                for (int i = 0; i < c.batch; ++i) {
+                    writer.Add(keys[next], static_cast<double>(f));
+                    next = next + 1 == keys.size() ? 0 : next + 1;
+                }
+                writer.EndUpdates();
+                // Batch small frames into one write when running flat out, as a publisher would
+                if (c.frameRate != 0 || writer.Size() >= rtd::FeedAdapter::kReadBuffer / 2) publisher.Send(writer);
+            }
+            if (!writer.Empty()) publisher.Send(writer);
+            while (server->feed.GetStats().frames < static_cast<unsigned long long>(frames)) std::this_thread::yield();
+            double seconds = SecondsSince(start);
+            rtd::FeedAdapter::Stats stats = server->feed.GetStats();
+
+            server->feed.Stop();
+            publisher.Close();
+            stop = true;
+            refresher.join();
+            for (SAFEARRAY* sa : strings) SafeArrayDestroy(sa);
+            server->Release();
+
+            std::cout << std::left << std::setw(8) << (tcp ? "tcp" : "pipe") << std::setw(8) << c.batch
+                      << std::setw(12) << (c.frameRate ? std::to_string(c.frameRate) : std::to_string(static_cast<long long>(frames / seconds)))
+                      << std::setw(14) << std::fixed << std::setprecision(2) << (stats.updates / seconds / 1e6)
+                      << std::setw(10) << std::setprecision(1) << (stats.bytes / seconds / 1e6)
+                      << std::setw(10) << stats.LatencyPercentileNs(0.5) / 1e3
+                      << std::setw(10) << stats.LatencyPercentileNs(0.99) / 1e3
+                      << std::setw(10) << stats.LatencyPercentileNs(0.999) / 1e3 << std::endl;
+        }
+    }
+}
+
+// --- Suite: parameter sweep with machine-readable output ---
+// One JSON object per line:
+//   {"bench":"update","mode":"locked","topics":1000,"type":"double","threads":1,"ratio":0,
+//    "ops":1000000,"ns_per_op":21.3,"allocs_per_op":0.000,"peak_heap_bytes":81920,"peak_rss_bytes":12345678}
+// ns_per_op and allocs_per_op cover the timed operation only; peak_heap_bytes is the highest
+// C++ heap usage during the case (relative to its start); peak_rss_bytes is the process-wide
+// peak working set so far.
+struct SuiteCase {
+    const char* bench = "";
+    const char* mode = "locked";
+    long topics = 0;
+    const char* type = "double";
+    int threads = 1;
+    int ratio = 0;
+};
+
+class SuiteMeter {
+public:
+    void Start() {
+        m_allocs = g_allocCount.load(std::memory_order_relaxed);
+        m_baseBytes = g_liveBytes.load(std::memory_order_relaxed);
+        g_peakBytes.store(m_baseBytes, std::memory_order_relaxed);
+        m_elapsed = 0.0;
+        m_timedAllocs = 0;
+    }
+
+    // Brackets a timed region; untimed setup in between is excluded from ns and allocs
+    void Resume() {
+        m_resumeAllocs = g_allocCount.load(std::memory_order_relaxed);
+        m_resumedAt = std::chrono::steady_clock::now();
+    }
+    void Pause() {
+        m_elapsed += SecondsSince(m_resumedAt);
+        m_timedAllocs += g_allocCount.load(std::memory_order_relaxed) - m_resumeAllocs;
+    }
+
+    void Emit(const SuiteCase& c, unsigned long long ops) const {
+        PROCESS_MEMORY_COUNTERS pmc;
+        pmc.cb = sizeof(pmc);
+        unsigned long long peakRss = GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)) ? pmc.PeakWorkingSetSize : 0;
+        long long peakHeap = g_peakBytes.load(std::memory_order_relaxed) - m_baseBytes;
+        double n = ops ? static_cast<double>(ops) : 1.0;
+
+        std::cout << std::fixed
+                  << "{\"bench\":\"" << c.bench << "\",\"mode\":\"" << c.mode << "\",\"topics\":" << c.topics
+                  << ",\"type\":\"" << c.type << "\",\"threads\":" << c.threads << ",\"ratio\":" << c.ratio
+                  << ",\"ops\":" << ops
+                  << ",\"ns_per_op\":" << std::setprecision(1) << (m_elapsed * 1e9 / n)
+                  << ",\"allocs_per_op\":" << std::setprecision(3) << (static_cast<double>(m_timedAllocs) / n)
+                  << ",\"peak_heap_bytes\":" << (peakHeap > 0 ? peakHeap : 0)
+                  << ",\"peak_rss_bytes\":" << peakRss << "}" << std::endl;
+    }
+
+private:
+    unsigned long long m_allocs = 0;
+    unsigned long long m_resumeAllocs = 0;
+    unsigned long long m_timedAllocs = 0;
+    long long m_baseBytes = 0;
+    double m_elapsed = 0.0;
+    std::chrono::steady_clock::time_point m_resumedAt;
+};
+
+// Excel-shaped values: a double, a BSTR that fits TopicValue's inline buffer, and one that does not
+static const char* const kSuiteTypes[] = { "double", "short_bstr", "long_bstr" };
+
+static void MakeSuiteValue(const char* type, long seed, VARIANT& v) {
+    VariantInit(&v);
+    if (std::strcmp(type, "double") == 0) {
+        v.vt = VT_R8;
+        v.dblVal = 100.0 + seed * 0.01;
+    } else if (std::strcmp(type, "short_bstr") == 0) {
+        v.vt = VT_BSTR;
+        v.bstrVal = SysAllocString(seed % 2 ? L"OPEN" : L"HALT");
+    } else {
+        std::wstring text(64, L'a' + static_cast<wchar_t>(seed % 26));
+        v.vt = VT_BSTR;
+        v.bstrVal = SysAllocStringLen(text.c_str(), static_cast<UINT>(text.size()));
+    }
+}
+
+static void DrainServer(BenchServer* server) {
+    long topicCount = 0;
+    SAFEARRAY* sa = nullptr;
+    server->RefreshData(&topicCount, &sa);
+    if (sa) SafeArrayDestroy(sa);
+}
+
+// UpdateTopic(VARIANT) from N producer threads, each cycling over its share of the topics
+static void SuiteUpdate(const std::vector<long>& topicCounts) {
+    const unsigned long long opsPerCase = 1000000;
+    const int threadCounts[] = { 1, 2, 4, 8 };
+    const rtd::IngestMode modes[] = { rtd::IngestMode::Locked, rtd::IngestMode::LockFree };
+
+    for (rtd::IngestMode mode : modes) {
+        for (long topics : topicCounts) {
+            for (const char* type : kSuiteTypes) {
+                for (int threads : threadCounts) {
+                    SuiteCase c;
+                    c.bench = "update";
+                    c.mode = mode == rtd::IngestMode::Locked ? "locked" : "lockfree";
+                    c.topics = topics;
+                    c.type = type;
+                    c.threads = threads;
+
+                    BenchServer* server = new BenchServer();
+                    server->SetIngestMode(mode);
+                    unsigned long long perThread = opsPerCase / threads;
+                    long share = topics / threads > 0 ? topics / threads : 1;
+
+                    SuiteMeter meter;
+                    meter.Start();
+                    std::atomic<int> ready{0};
+                    std::atomic<bool> go{false};
+                    std::vector<std::thread> producers;
+                    for (int t = 0; t < threads; ++t) {
+                        producers.emplace_back([&, t]() {
+                            VARIANT values[2];
+                            MakeSuiteValue(type, t, values[0]);
+                            MakeSuiteValue(type, t + 1, values[1]);
+                            long base = t * share;
+                            ready.fetch_add(1);
+                            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                            for (unsigned long long i = 0; i < perThread; ++i) {
+                                server->UpdateTopic(base + static_cast<long>(i % share), values[i & 1]);
+                            }
+                            VariantClear(&values[0]);
+                            VariantClear(&values[1]);
+                        });
+                    }
+                    while (ready.load() < threads) std::this_thread::yield();
+                    meter.Resume();
+                    go.store(true, std::memory_order_release);
+                    for (auto& producer : producers) producer.join();
+                    meter.Pause();
+                    meter.Emit(c, perThread * threads);
+
+                    DrainServer(server);
+                    server->Release();
+                }
+            }
+        }
+    }
+}
+
+// RefreshData cost per delivered topic, all topics dirty
+static void SuiteRefresh(const std::vector<long>& topicCounts) {
+    for (long topics : topicCounts) {
+        for (const char* type : kSuiteTypes) {
+            SuiteCase c;
+            c.bench = "refresh";
+            c.topics = topics;
+            c.type = type;
+
+            BenchServer* server = new BenchServer();
+            VARIANT value;
+            MakeSuiteValue(type, 0, value);
+            int rounds = topics >= 100000 ? 3 : 20;
+
+            SuiteMeter meter;
+            meter.Start();
+            for (int r = 0; r < rounds; ++r) {
+                for (long id = 0; id < topics; ++id) server->UpdateTopic(id, value);
+                long topicCount = 0;
+                SAFEARRAY* sa = nullptr;
+                meter.Resume();
+                server->RefreshData(&topicCount, &sa);
+                meter.Pause();
+                if (sa) SafeArrayDestroy(sa);
+            }
+            meter.Emit(c, static_cast<unsigned long long>(topics) * rounds);
+
+            VariantClear(&value);
+            server->Release();
+        }
+    }
+}
+
+// Update/refresh mix: 'ratio' updates per topic between two RefreshData calls (conflation);
+// ns per update, with the refresh cost amortized over the updates it drains
+static void SuiteMixed(const std::vector<long>& topicCounts) {
+    const int ratios[] = { 1, 4, 16 };
+    for (long topics : topicCounts) {
+        for (const char* type : kSuiteTypes) {
+            for (int ratio : ratios) {
+                SuiteCase c;
+                c.bench = "mixed";
+                c.topics = topics;
+                c.type = type;
+                c.ratio = ratio;
+
+                BenchServer* server = new BenchServer();
+                VARIANT values[2];
+                MakeSuiteValue(type, 0, values[0]);
+                MakeSuiteValue(type, 1, values[1]);
+                unsigned long long updatesPerCycle = static_cast<unsigned long long>(topics) * ratio;
+                int cycles = static_cast<int>(2000000 / updatesPerCycle);
+                if (cycles < 1) cycles = 1;
+
+                SuiteMeter meter;
+                meter.Start();
+                meter.Resume();
+                for (int cycle = 0; cycle < cycles; ++cycle) {
+                    for (unsigned long long i = 0; i < updatesPerCycle; ++i) {
+                        server->UpdateTopic(static_cast<long>(i % topics), values[i & 1]);
+                    }
+                    DrainServer(server);
+                }
+                meter.Pause();
+                meter.Emit(c, updatesPerCycle * cycles);
+
+                VariantClear(&values[0]);
+                VariantClear(&values[1]);
+                server->Release();
+            }
+        }
+    }
+}
+
+// ConnectData + DisconnectData through the default subscription path (distinct keys)
+static void SuiteConnect(const std::vector<long>& topicCounts) {
+    class ConnectServer : public rtd::RtdServerBase {};
+
+    for (long topics : topicCounts) {
+        std::vector<SAFEARRAY*> strings(topics);
+        for (long id = 0; id < topics; ++id) {
+            strings[id] = SafeArrayCreateVector(VT_VARIANT, 0, 2);
+            std::wstring symbol = L"SYM" + std::to_wstring(id);
+            VARIANT v;
+            VariantInit(&v);
+            v.vt = VT_BSTR;
+            long index = 0;
+            v.bstrVal = SysAllocString(symbol.c_str());
+            SafeArrayPutElement(strings[id], &index, &v);
+            VariantClear(&v);
+            index = 1;
+            v.vt = VT_BSTR;
+            v.bstrVal = SysAllocString(L"Last");
+            SafeArrayPutElement(strings[id], &index, &v);
+            VariantClear(&v);
+        }
+
+        ConnectServer* server = new ConnectServer();
+        SuiteCase c;
+        c.topics = topics;
+        c.type = "strings";
+
+        SuiteMeter meter;
+        c.bench = "connect";
+        meter.Start();
+        meter.Resume();
+        for (long id = 0; id < topics; ++id) {
+            VARIANT_BOOL getNewValues = VARIANT_FALSE;
+            VARIANT out;
+            VariantInit(&out);
+            server->ConnectData(id, &strings[id], &getNewValues, &out);
+        }
+        meter.Pause();
+        meter.Emit(c, topics);
+
+        c.bench = "disconnect";
+        meter.Start();
+        meter.Resume();
+        for (long id = 0; id < topics; ++id) server->DisconnectData(id);
+        meter.Pause();
+        meter.Emit(c, topics);
+
+        server->Release();
+        for (SAFEARRAY* sa : strings) SafeArrayDestroy(sa);
+    }
+}
+
+// NotifyUpdate with a no-op callback, from N threads
+static void SuiteNotify() {
+    struct NullUpdateEvent : public rtd::IRTDUpdateEvent {
+        HRESULT __stdcall UpdateNotify() override { return S_OK; }
+        HRESULT __stdcall get_HeartbeatInterval(long* value) override { *value = 1000; return S_OK; }
+        HRESULT __stdcall put_HeartbeatInterval(long) override { return S_OK; }
+        HRESULT __stdcall Disconnect() override { return S_OK; }
+        HRESULT __stdcall GetTypeInfoCount(UINT*) override { return E_NOTIMPL; }
+        HRESULT __stdcall GetTypeInfo(UINT, LCID, ITypeInfo**) override { return E_NOTIMPL; }
+        HRESULT __stdcall GetIDsOfNames(REFIID, LPOLESTR*, UINT, LCID, DISPID*) override { return E_NOTIMPL; }
+        HRESULT __stdcall Invoke(DISPID, REFIID, LCID, WORD, DISPPARAMS*, VARIANT*, EXCEPINFO*, UINT*) override { return E_NOTIMPL; }
+        HRESULT __stdcall QueryInterface(REFIID, void** ppv) override { *ppv = nullptr; return E_NOINTERFACE; }
+        ULONG __stdcall AddRef() override { return 2; }
+        ULONG __stdcall Release() override { return 1; }
+    };
+
+    const int threadCounts[] = { 1, 2, 4, 8 };
+    const unsigned long long opsPerCase = 1000000;
+    for (int threads : threadCounts) {
+        BenchServer* server = new BenchServer();
+        NullUpdateEvent callback;
+        long res = 0;
+        server->ServerStart(&callback, &res);
+
+        SuiteCase c;
+        c.bench = "notify";
+        c.type = "none";
+        c.threads = threads;
+        unsigned long long perThread = opsPerCase / threads;
+
+        SuiteMeter meter;
+        meter.Start();
+        meter.Resume();
+        std::vector<std::thread> callers;
+        for (int t = 0; t < threads; ++t) {
+            callers.emplace_back([server, perThread]() {
+                for (unsigned long long i = 0; i < perThread; ++i) server->NotifyUpdate();
+            });
+        }
+        for (auto& caller : callers) caller.join();
+        meter.Pause();
+        meter.Emit(c, perThread * threads);
+
+        server->ServerTerminate();
+        server->Release();
+    }
+}
+
+static void BenchSuite(bool quick) {
+    std::vector<long> topicCounts = { 1000, 10000, 100000 };
+    if (!quick) topicCounts.push_back(1000000);
+
+    SuiteUpdate(topicCounts);
+    SuiteRefresh(topicCounts);
+    SuiteMixed(topicCounts);
+    SuiteConnect(topicCounts);
+    SuiteNotify();
+}
+
+int main(int argc, char** argv) {
+    std::string scenario = argc > 1 ? argv[1] : "all";
+    bool quick = argc > 2 && std::string(argv[2]) == "--quick";
+
+    if (scenario == "all" || scenario == "ingest") BenchIngest();
+    if (scenario == "all" || scenario == "shards") BenchShards();
+    if (scenario == "all" || scenario == "batch") BenchBatch();
+    if (scenario == "all" || scenario == "refresh") BenchRefresh();
+    if (scenario == "all" || scenario == "hash") BenchHash();
+    if (scenario == "all" || scenario == "shmfeed") BenchShmFeed();
+    if (scenario == "all" || scenario == "feed") BenchFeed();
+    if (scenario == "suite") BenchSuite(quick);
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+// Stand-in for an external feed process: pushes double updates into a shared-memory feed
+// ring created by an rtd::ShmFeedReader inside the RTD server.
+//
+//   rtd_feed_producer <name> [topics] [messages] [rate]
+//
+// Topics 0..topics-1 are updated round robin, messages in total, at most rate per second
+// (0 = as fast as the ring accepts them). A full ring is retried, so nothing is lost.
+#include <rtd/shm_feed.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: rtd_feed_producer <name> [topics] [messages] [rate]" << std::endl;
+        return 2;
+    }
+    std::string narrow = argv[1];
+    std::wstring name(narrow.begin(), narrow.end());
+    long topics = argc > 2 ? std::stol(argv[2]) : 100;
+    long long messages = argc > 3 ? std::stoll(argv[3]) : 1000000;
+    long long rate = argc > 4 ? std::stoll(argv[4]) : 0;
+    if (topics <= 0) topics = 1;
+
+    rtd::ShmFeedWriter writer;
+    HRESULT hr = writer.Open(name);
+    for (int attempt = 0; FAILED(hr) && attempt < 50; ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        hr = writer.Open(name);
+    }
+    if (FAILED(hr)) {
+        std::cerr << "cannot open feed '" << narrow << "' (hr=0x" << std::hex << hr << ")" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned long long retries = 0;
+    for (long long i = 0; i < messages; ++i) {
+        if (rate > 0) {
+            auto due = start + std::chrono::nanoseconds(i * 1000000000LL / rate);
+            while (std::chrono::steady_clock::now() < due) std::this_thread::yield();
+        }
+        while (!writer.Push(static_cast<uint64_t>(i % topics), static_cast<double>(i))) {
+            if (writer.IsClosed()) {
+                std::cerr << "the reader closed the feed after " << i << " messages" << std::endl;
+                return 1;
+            }
+            ++retries;
+            std::this_thread::yield();
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << messages << " messages in " << seconds << " s (" << static_cast<long long>(messages / seconds)
+              << " msg/s), " << retries << " pushes retried on a full ring" << std::endl;
+    return 0;
+}
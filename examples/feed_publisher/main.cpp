@@ -0,0 +1,96 @@
+// Stand-in for an external publisher: serves the stream feed protocol (rtd/feed_protocol.h)
+// to an rtd::FeedAdapter inside the RTD server, over a named pipe or a loopback TCP port.
+//
+//   rtd_feed_publisher pipe <name> [rate]     e.g. rtd_feed_publisher pipe \\.\pipe\MyFeed
+//   rtd_feed_publisher tcp <port> [rate]
+//
+// Every subscription the adapter sends gets a random-walk price, all of them in one Updates
+// frame, rate frames per second (default 10). Unsubscribed keys stop updating. When the
+// adapter goes away the publisher waits for it to reconnect.
+#include <rtd/feed_adapter.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: rtd_feed_publisher pipe <name> [rate] | tcp <port> [rate]" << std::endl;
+        return 2;
+    }
+    std::string transport = argv[1];
+    std::string target = argv[2];
+    long long rate = argc > 3 ? std::stoll(argv[3]) : 10;
+    if (rate <= 0) rate = 1;
+
+    rtd::FeedPublisher publisher;
+    HRESULT hr = transport == "tcp" ? publisher.ListenTcp(static_cast<unsigned short>(std::stoi(target)))
+                                    : publisher.ListenPipe(std::wstring(target.begin(), target.end()));
+    if (FAILED(hr)) {
+        std::cerr << "cannot listen on " << transport << " " << target << " (hr=0x" << std::hex << hr << ")" << std::endl;
+        return 1;
+    }
+
+    std::mt19937_64 random(42);
+    std::normal_distribution<double> step(0.0, 0.05);
+    std::unordered_map<uint64_t, double> prices;
+    rtd::FeedFrameWriter frames;
+    std::vector<uint8_t> payload;
+    std::wstring arg;
+
+    while (true) {
+        std::cout << "waiting for the adapter..." << std::endl;
+        if (FAILED(publisher.Accept())) return 1;
+        std::cout << "adapter connected" << std::endl;
+        prices.clear();
+
+        auto next = std::chrono::steady_clock::now();
+        unsigned long long sent = 0;
+        while (true) {
+            // Back-channel: the adapter resends every live subscription after connecting
+            bool failed = false;
+            while (publisher.Pending() != 0) {
+                rtd::FeedFrameKind kind{};
+                if (FAILED(publisher.Receive(kind, payload))) {
+                    failed = true;
+                    break;
+                }
+                rtd::FeedPayloadReader reader(payload.data(), payload.size());
+                uint64_t key = 0;
+                if (!reader.Read(key)) continue;
+                if (kind == rtd::FeedFrameKind::Subscribe) {
+                    uint16_t count = 0;
+                    std::wstring topic;
+                    if (reader.Read(count)) {
+                        for (uint16_t i = 0; i < count && reader.ReadText(arg); ++i) topic += (i ? L"/" : L"") + arg;
+                    }
+                    prices.emplace(key, 100.0);
+                    std::wcout << L"subscribe " << topic << L" (" << prices.size() << L" live)" << std::endl;
+                } else if (kind == rtd::FeedFrameKind::Unsubscribe) {
+                    prices.erase(key);
+                    std::wcout << L"unsubscribe (" << prices.size() << L" live)" << std::endl;
+                }
+            }
+
+            if (!failed && !prices.empty()) {
+                frames.BeginUpdates();
+                for (auto& entry : prices) {
+                    entry.second += step(random);
+                    frames.Add(entry.first, entry.second);
+                }
+                frames.EndUpdates();
+                failed = FAILED(publisher.Send(frames));
+                sent += prices.size();
+            }
+            if (failed) break;
+
+            next += std::chrono::nanoseconds(1000000000LL / rate);
+            std::this_thread::sleep_until(next);
+        }
+        std::cout << "adapter disconnected after " << sent << " updates" << std::endl;
+        publisher.Disconnect();
+    }
+}
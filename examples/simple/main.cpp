@@ -1,8 +1,6 @@
 #include "server_impl.h"
 #include "xll_definitions.h"
-#include <vector>
-#include <cstdarg>
-#include <cwchar>
+#include <rtd/xll.h>
 
 // 3. Define Entry Points
 RTD_DEFINE_DLL_ENTRY(MyRtdServer, CLSID_MyRtdServer, g_szProgID, g_szFriendlyName)
@@ -12,54 +10,38 @@ extern "C" HRESULT __stdcall DllRegisterServer();
 
 // --- XLL Implementation ---
 
-// Helper to call Excel12
-static int Excel12v(int xlfn, LPXLOPER12 pxResult, int count, LPXLOPER12 opers[]) {
-    static PEXCEL12 pExcel12 = nullptr;
-    if (!pExcel12) {
-        HMODULE hMod = GetModuleHandleA("xlcall32.dll");
-        if (!hMod) hMod = LoadLibraryA("xlcall32.dll");
-        if (hMod) pExcel12 = (PEXCEL12)GetProcAddress(hMod, "Excel12");
-    }
-    if (!pExcel12) return -1; // xlretFailed
-    return pExcel12(xlfn, count, pxResult, opers);
+// Simple test function. The string is built in the thread's rtd::XlArena and released by
+// xlAutoFree12 once Excel has copied it.
+extern "C" __declspec(dllexport) LPXLOPER12 WINAPI MyHello() {
+    rtd::XlFrame frame;
+    return frame.Return(frame.String(L"Hello from XLL"));
 }
 
-// Variadic wrapper
-static int Excel12(int xlfn, LPXLOPER12 pxResult, int count, ...) {
-    std::vector<LPXLOPER12> opers(count);
-    va_list args;
-    va_start(args, count);
-    for (int i = 0; i < count; ++i) {
-        opers[i] = va_arg(args, LPXLOPER12);
-    }
-    va_end(args);
-    return Excel12v(xlfn, pxResult, count, opers.data());
+// Returns the matrix behind a handle delivered by a "matrix" topic:
+// =MyMatrix(RTD("My.Hybrid.Server",, "matrix", "10", "5")). The cells are handed to Excel straight
+// from rtd::ResultCache; xlAutoFree12 releases them once Excel has copied the array.
+extern "C" __declspec(dllexport) LPXLOPER12 WINAPI MyMatrix(LPXLOPER12 handle) {
+    return rtd::XlResultSlot::Resolve(*handle);
 }
 
-// Helper to create XLOPER12 string
-static void SetXlString(XLOPER12& xOp, const wchar_t* str) {
-    xOp.xltype = xltypeStr;
-    size_t len = wcslen(str);
-    if (len > 32767) len = 32767;
+// =MyTopic("AAPL") is =RTD("My.Hybrid.Server",, "AAPL"), callable from every recalculation thread
+static const rtd::XlRtdFunction g_topic(g_szProgID);
 
-    // Allocate buffer with length prefix
-    XCHAR* buf = new XCHAR[len + 1];
-    buf[0] = (XCHAR)len;
-    if (len > 0) wmemcpy(buf + 1, str, len);
-
-    xOp.val.str = buf;
+extern "C" __declspec(dllexport) LPXLOPER12 WINAPI MyTopic(LPXLOPER12 topic) {
+    return g_topic(*topic);
 }
 
-// Simple test function
-extern "C" __declspec(dllexport) LPXLOPER12 WINAPI MyHello() {
-    static XLOPER12 xResult;
-    // "Hello from XLL" (Length 14)
-    static XCHAR buf[] = L"\x000EHello from XLL";
-    xResult.xltype = xltypeStr;
-    xResult.val.str = buf;
-    return &xResult;
+extern "C" __declspec(dllexport) void WINAPI xlAutoFree12(LPXLOPER12 result) {
+    rtd::XlAutoFree12(result);
 }
 
+// Worksheet functions, registered in one pass by xlAutoOpen
+static constexpr rtd::XlFunction kFunctions[] = {
+    { L"MyHello", L"Q$", L"", L"MyHybridServer", L"Returns a greeting from the XLL" },
+    { L"MyMatrix", L"QQ$", L"handle", L"MyHybridServer", L"Returns the array behind a \"matrix\" topic handle" },
+    { L"MyTopic", L"QQ$", L"topic", L"MyHybridServer", L"Subscribes to a topic of the RTD server" },
+};
+
 // 4. XLL Entry Point
 extern "C" __declspec(dllexport) void WINAPI xlAutoOpen() {
     // 1. Self-Register the COM Server (Hybrid feature)
@@ -72,32 +54,7 @@ extern "C" __declspec(dllexport) void WINAPI xlAutoOpen() {
     }
 
     // 2. Register XLL functions
-    static XLOPER12 xDLL, xFunc, xType, xName;
-
-    // Get DLL name
-    Excel12(xlfGetName, &xDLL, 0);
-
-    // Prepare Registration Arguments for MyHello
-    SetXlString(xFunc, L"MyHello"); // Export name
-    SetXlString(xType, L"Q");       // Signature (Returns LPXLOPER12, no args)
-    SetXlString(xName, L"MyHello"); // Excel Function Name
-
-    // Register
-    XLOPER12 xRes;
-    Excel12(xlfRegister, &xRes, 4,
-        &xDLL,
-        &xFunc,
-        &xType,
-        &xName
-    );
-
-    // Cleanup memory allocated by SetXlString
-    delete[] xFunc.val.str;
-    delete[] xType.val.str;
-    delete[] xName.val.str;
-
-    // Free the DLL name returned by xlfGetName
-    Excel12(xlFree, 0, 1, &xDLL);
+    rtd::RegisterFunctions(kFunctions);
 }
 
 extern "C" __declspec(dllexport) void WINAPI xlAutoClose() {
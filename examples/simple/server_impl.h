@@ -2,12 +2,12 @@
 #define MY_HYBRID_SERVER_IMPL_H
 
 #include <rtd/rtd.h>
-#include <map>
-#include <vector>
-#include <thread>
-#include <mutex>
+#include <rtd/result_cache.h>
 #include <atomic>
 #include <chrono>
+#include <cwchar>
+#include <random>
+#include <string>
 
 // 1. Define Identity
 // GUID: {AAAAAAAA-BBBB-CCCC-DDDD-EEEEEEEEEEEE}
@@ -18,72 +18,49 @@ const wchar_t* g_szProgID = L"My.Hybrid.Server";
 const wchar_t* g_szFriendlyName = L"MinGW Hybrid RTD Server";
 
 // 2. Implement Server Logic
-class MyRtdServer : public rtd::RtdServerBase {
-private:
-    std::map<long, std::chrono::steady_clock::time_point> m_pendingTopics;
-    std::vector<long> m_readyTopics;
-    std::mutex m_mutex;
-    std::thread m_workerThread;
-    std::atomic<bool> m_running;
-
-    void Worker() {
-        while (m_running) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
-
-            bool notify = false;
-            {
-                std::lock_guard<std::mutex> lock(m_mutex);
-                auto now = std::chrono::steady_clock::now();
-
-                for (auto it = m_pendingTopics.begin(); it != m_pendingTopics.end(); ) {
-                    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - it->second).count();
-                    if (elapsed >= 2) {
-                        m_readyTopics.push_back(it->first);
-                        it = m_pendingTopics.erase(it); // Remove from pending, now ready
-                        notify = true;
-                    } else {
-                        ++it;
-                    }
-                }
-            }
-
-            if (notify) {
-                NotifyUpdate();
-            }
+// Each topic shows "Hello World!" two seconds after it connects. The coroutine runs on the
+// server's executor; DisconnectData destroys it if it is still waiting.
+inline rtd::TopicStream HelloAfterDelay() {
+    co_await rtd::Delay(std::chrono::seconds(2));
+    co_yield L"Hello World!";
+}
+
+// =MyMatrix(RTD("My.Hybrid.Server",, "matrix", rows, columns)): the topic delivers a handle
+// to a matrix of random numbers in rtd::ResultCache, republished every second, and MyMatrix
+// (main.cpp) returns the cached cells as an array. The name is erased when the frame is
+// destroyed, i.e. after the stream's last Publish, so DisconnectData cannot race a step.
+inline rtd::TopicStream RandomMatrix(std::wstring name, RW rows, COL columns) {
+    struct EraseOnExit {
+        const std::wstring& name;
+        ~EraseOnExit() { rtd::ResultCache::Shared().Erase(name); }
+    } erase{ name };
+    std::mt19937_64 random(std::hash<std::wstring>()(name));
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    while (true) {
+        rtd::ResultMatrix matrix;
+        matrix.Resize(rows, columns);
+        for (RW row = 0; row < rows; ++row) {
+            for (COL column = 0; column < columns; ++column) matrix.SetNumber(row, column, uniform(random));
         }
+        co_yield rtd::ResultCache::Shared().Publish(name, std::move(matrix));
+        co_await rtd::Delay(std::chrono::seconds(1));
     }
+}
 
+class MyRtdServer : public rtd::RtdServerBase {
 public:
-    MyRtdServer() : m_running(false) {}
-
-    virtual ~MyRtdServer() {
-        ServerTerminate();
-    }
-
-    HRESULT __stdcall ServerStart(rtd::IRTDUpdateEvent* Callback, long* pfRes) override {
-        HRESULT hr = RtdServerBase::ServerStart(Callback, pfRes);
-        if (FAILED(hr)) return hr;
-
-        m_running = true;
-        m_workerThread = std::thread(&MyRtdServer::Worker, this);
-
-        *pfRes = 1;
-        return S_OK;
-    }
-
-    HRESULT __stdcall ServerTerminate() override {
-        m_running = false;
-        if (m_workerThread.joinable()) {
-            m_workerThread.join();
-        }
-        return RtdServerBase::ServerTerminate();
-    }
+    MyRtdServer() {}
 
     HRESULT __stdcall ConnectData(long TopicID, SAFEARRAY** Strings, VARIANT_BOOL* GetNewValues, VARIANT* pvarOut) override {
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            m_pendingTopics[TopicID] = std::chrono::steady_clock::now();
+        if (!pvarOut) return E_POINTER;
+        rtd::TopicArgs args;
+        HRESULT hr;
+        if (Strings && SUCCEEDED(args.Parse(*Strings)) && args.Count() == 3 && args[0] == L"matrix") {
+            hr = StartTopicStream(TopicID, RandomMatrix(NextMatrixName(TopicID), ParseExtent(args[1], 1000), ParseExtent(args[2], 100)));
+        } else {
+            hr = StartTopicStream(TopicID, HelloAfterDelay());
         }
+        if (FAILED(hr)) return hr;
 
         VariantInit(pvarOut);
         pvarOut->vt = VT_ERROR;
@@ -91,50 +68,16 @@ public:
         return S_OK;
     }
 
-    HRESULT __stdcall RefreshData(long* TopicCount, SAFEARRAY** parrayOut) override {
-        std::lock_guard<std::mutex> lock(m_mutex);
-
-        *TopicCount = static_cast<long>(m_readyTopics.size());
-
-        HRESULT hr = CreateRefreshDataArray(*TopicCount, parrayOut);
-        if (FAILED(hr)) return hr;
-
-        if (*TopicCount == 0) return S_OK;
-
-        long indices[2];
-
-        for (long i = 0; i < *TopicCount; ++i) {
-            long topicID = m_readyTopics[i];
-
-            // Column i, Row 0: TopicID
-            indices[0] = i; indices[1] = 0;
-            VARIANT vID; VariantInit(&vID);
-            vID.vt = VT_I4; vID.lVal = topicID;
-            SafeArrayPutElement(*parrayOut, indices, &vID);
-
-            // Column i, Row 1: Value
-            indices[0] = i; indices[1] = 1;
-            VARIANT vVal; VariantInit(&vVal);
-            vVal.vt = VT_BSTR;
-            vVal.bstrVal = SysAllocString(L"Hello World!");
-            SafeArrayPutElement(*parrayOut, indices, &vVal);
-            SysFreeString(vVal.bstrVal);
-        }
-
-        m_readyTopics.clear();
-        return S_OK;
+private:
+    // Unique per stream: a cancelled stream may still be unwinding when its TopicID is reused
+    static std::wstring NextMatrixName(long topicId) {
+        static std::atomic<unsigned long> streams{0};
+        return L"matrix." + std::to_wstring(topicId) + L"." + std::to_wstring(++streams);
     }
 
-    HRESULT __stdcall DisconnectData(long TopicID) override {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_pendingTopics.erase(TopicID);
-        for (auto it = m_readyTopics.begin(); it != m_readyTopics.end(); ++it) {
-            if (*it == TopicID) {
-                m_readyTopics.erase(it);
-                break;
-            }
-        }
-        return S_OK;
+    static int ParseExtent(std::wstring_view text, int limit) {
+        int value = static_cast<int>(std::wcstol(std::wstring(text).c_str(), nullptr, 10));
+        return value < 1 ? 1 : (value > limit ? limit : value);
     }
 };
 
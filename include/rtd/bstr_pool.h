@@ -0,0 +1,243 @@
+#ifndef RTD_BSTR_POOL_H
+#define RTD_BSTR_POOL_H
+
+#include <windows.h>
+#include <ole2.h>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rtd {
+
+    /**
+     * @brief Bounded interning pool for string topic values.
+     *
+     * Every BSTR placed in RefreshData's SAFEARRAY is owned (and freed) by Excel, so one
+     * BSTR can never be handed out twice. Instead the pool deduplicates values by content
+     * and keeps, per value, a master BSTR that is never handed out plus a small stack of
+     * spare copies. Producers call Prepare when they publish a string, which builds spares
+     * on the producer thread; RefreshData then calls Take and usually gets a ready-made BSTR
+     * without allocating on the Excel thread or under the topic lock. Each spare leaves the
+     * pool exactly once, so ownership is always unambiguous.
+     *
+     * The number of spares kept for a value follows how many copies the previous refresh
+     * needed, capped by maxSparesPerEntry. Entries beyond maxEntries are evicted least
+     * recently used first, together with their spares; values taken by the refresh in
+     * progress are kept until it ends, so a refresh delivering more distinct values than
+     * maxEntries overshoots the bound until then. Strings longer than maxLength are not
+     * interned; Take simply allocates them.
+     */
+    class BstrPool {
+    public:
+        static constexpr size_t kDefaultMaxEntries = 1024;
+        static constexpr size_t kDefaultMaxSpares = 64;
+        static constexpr size_t kDefaultMaxLength = 256;
+
+        struct Stats {
+            unsigned long long hits = 0;        // Take found the value in the pool
+            unsigned long long misses = 0;      // Take interned a new value
+            unsigned long long spareHits = 0;   // Take handed out a pre-built BSTR
+            unsigned long long allocations = 0; // Take had to allocate on the delivery path
+            unsigned long long evictions = 0;
+            size_t entries = 0;
+            size_t spares = 0;
+        };
+
+        explicit BstrPool(size_t maxEntries = kDefaultMaxEntries, size_t maxSparesPerEntry = kDefaultMaxSpares,
+                          size_t maxLength = kDefaultMaxLength)
+            : m_maxEntries(maxEntries ? maxEntries : 1), m_maxSpares(maxSparesPerEntry), m_maxLength(maxLength) {}
+
+        BstrPool(const BstrPool&) = delete;
+        BstrPool& operator=(const BstrPool&) = delete;
+
+        ~BstrPool() {
+            for (auto& entry : m_lru) FreeEntry(entry);
+        }
+
+        /**
+         * @brief Producer side: interns the value and pre-builds spare BSTRs for its next deliveries.
+         * The allocations happen with the pool unlocked.
+         */
+        void Prepare(std::wstring_view text) {
+            if (text.size() > m_maxLength) return;
+            size_t needed = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                Entry* entry = FindOrInsert(text, nullptr);
+                if (!entry) return;
+                if (entry->spares.size() + entry->inFlight < entry->target) {
+                    needed = entry->target - entry->spares.size() - entry->inFlight;
+                    entry->inFlight += needed;
+                }
+            }
+            if (needed == 0) return;
+
+            std::vector<BSTR> built;
+            built.reserve(needed);
+            for (size_t i = 0; i < needed; ++i) {
+                BSTR copy = SysAllocStringLen(text.data(), static_cast<UINT>(text.size()));
+                if (copy) built.push_back(copy);
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_index.find(text);
+            if (it == m_index.end()) {
+                // Evicted meanwhile
+                for (BSTR copy : built) SysFreeString(copy);
+                return;
+            }
+            Entry& entry = *it->second;
+            entry.inFlight -= needed < entry.inFlight ? needed : entry.inFlight;
+            for (BSTR copy : built) entry.spares.push_back(copy);
+            m_spareCount += built.size();
+        }
+
+        /**
+         * @brief Delivery-side access for one RefreshData. The pool is locked per Take, so
+         * producers keep preparing values while Excel's refresh runs.
+         */
+        class Batch {
+        public:
+            explicit Batch(BstrPool& pool) : m_pool(pool) {}
+            ~Batch() { m_pool.EndCycle(); }
+
+            Batch(const Batch&) = delete;
+            Batch& operator=(const Batch&) = delete;
+
+            /**
+             * @brief Returns a BSTR with the given content, owned by the caller.
+             * @return nullptr on allocation failure.
+             */
+            BSTR Take(std::wstring_view text) {
+                BSTR spare = m_pool.TakeSpare(text);
+                return spare ? spare : SysAllocStringLen(text.data(), static_cast<UINT>(text.size()));
+            }
+
+        private:
+            BstrPool& m_pool;
+        };
+
+        Stats GetStats() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Stats stats = m_stats;
+            stats.entries = m_lru.size();
+            stats.spares = m_spareCount;
+            return stats;
+        }
+
+    private:
+        struct Entry {
+            BSTR master = nullptr;     // Never handed out; the index key points into it
+            std::vector<BSTR> spares;  // Pre-built copies, each handed out at most once
+            size_t target = 1;         // Spares to keep ready
+            size_t takenThisCycle = 0;
+            size_t inFlight = 0;       // Spares being built by Prepare
+            bool touched = false;      // Taken during the current cycle
+        };
+
+        using LruList = std::list<Entry>;
+
+        // Caller holds m_mutex. Most recently used entries are at the front.
+        Entry* FindOrInsert(std::wstring_view text, bool* inserted) {
+            auto it = m_index.find(text);
+            if (it != m_index.end()) {
+                m_lru.splice(m_lru.begin(), m_lru, it->second);
+                return &*it->second;
+            }
+            if (inserted) *inserted = true;
+
+            BSTR master = SysAllocStringLen(text.data(), static_cast<UINT>(text.size()));
+            if (!master) return nullptr;
+            m_lru.emplace_front();
+            m_lru.front().master = master;
+            m_index.emplace(std::wstring_view(master, text.size()), m_lru.begin());
+
+            Trim();
+            return &m_lru.front();
+        }
+
+        // Caller holds m_mutex. Evicts from the back down to m_maxEntries, stopping at an entry
+        // taken during the current cycle: m_touched points to those until EndCycle.
+        void Trim() {
+            while (m_lru.size() > m_maxEntries && !m_lru.back().touched) {
+                Entry& victim = m_lru.back();
+                m_index.erase(std::wstring_view(victim.master, SysStringLen(victim.master)));
+                FreeEntry(victim);
+                m_lru.pop_back();
+                ++m_stats.evictions;
+            }
+        }
+
+        // Returns a pre-built BSTR, or nullptr (counted as an allocation) if the caller has to
+        // allocate one, which it does with the pool unlocked.
+        BSTR TakeSpare(std::wstring_view text) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (text.size() > m_maxLength) {
+                ++m_stats.allocations;
+                return nullptr;
+            }
+            bool inserted = false;
+            Entry* entry = FindOrInsert(text, &inserted);
+            if (inserted) ++m_stats.misses;
+            else ++m_stats.hits;
+            if (!entry) {
+                ++m_stats.allocations;
+                return nullptr;
+            }
+
+            ++entry->takenThisCycle;
+            if (!entry->touched) {
+                entry->touched = true;
+                m_touched.push_back(entry);
+            }
+            if (!entry->spares.empty()) {
+                BSTR spare = entry->spares.back();
+                entry->spares.pop_back();
+                --m_spareCount;
+                ++m_stats.spareHits;
+                return spare;
+            }
+            ++m_stats.allocations;
+            return nullptr;
+        }
+
+        // Sizes each used entry's spare stock to this refresh's demand, then evicts any
+        // entries the refresh kept beyond the bound.
+        void EndCycle() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (Entry* entry : m_touched) {
+                size_t target = entry->takenThisCycle;
+                if (target < 1) target = 1;
+                if (target > m_maxSpares) target = m_maxSpares;
+                entry->target = target;
+                entry->takenThisCycle = 0;
+                entry->touched = false;
+            }
+            m_touched.clear();
+            Trim();
+        }
+
+        void FreeEntry(Entry& entry) {
+            for (BSTR spare : entry.spares) SysFreeString(spare);
+            m_spareCount -= entry.spares.size();
+            entry.spares.clear();
+            SysFreeString(entry.master);
+            entry.master = nullptr;
+        }
+
+        std::mutex m_mutex;
+        LruList m_lru;
+        std::unordered_map<std::wstring_view, LruList::iterator> m_index;
+        std::vector<Entry*> m_touched; // Entries taken during the current cycle
+        size_t m_maxEntries;
+        size_t m_maxSpares;
+        size_t m_maxLength;
+        size_t m_spareCount = 0;
+        Stats m_stats;
+    };
+
+} // namespace rtd
+
+#endif // RTD_BSTR_POOL_H
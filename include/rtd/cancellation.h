@@ -0,0 +1,80 @@
+#ifndef RTD_CANCELLATION_H
+#define RTD_CANCELLATION_H
+
+#include <atomic>
+#include <memory>
+
+namespace rtd {
+
+    /**
+     * @brief Read side of a cooperative cancellation flag.
+     * Long-running tasks poll IsCancelled and return early. A token may be chained to a
+     * parent scope (e.g. a topic's tasks under the server's), and is cancelled when either
+     * is. A default-constructed token is never cancelled.
+     */
+    class CancellationToken {
+    public:
+        CancellationToken() = default;
+
+        bool IsCancelled() const {
+            for (const State* state = m_state.get(); state; state = state->parent.get()) {
+                if (state->cancelled.load(std::memory_order_acquire)) return true;
+            }
+            return false;
+        }
+
+    private:
+        friend class CancellationSource;
+
+        struct State {
+            std::atomic<bool> cancelled{false};
+            std::shared_ptr<const State> parent;
+        };
+
+        explicit CancellationToken(std::shared_ptr<const State> state) : m_state(std::move(state)) {}
+
+        std::shared_ptr<const State> m_state;
+    };
+
+    /**
+     * @brief Hands out tokens for one cancellation scope.
+     * The scope is allocated by the first Token call, so an idle source costs one pointer.
+     * Cancel flags every token handed out so far and closes the scope; tokens taken
+     * afterwards belong to a fresh one. Not thread-safe: the owner serializes Token and
+     * Cancel (tokens themselves may be read from any thread).
+     */
+    class CancellationSource {
+    public:
+        CancellationSource() = default;
+
+        /**
+         * @brief Returns a token for the current scope, creating it under 'parent' if needed.
+         * A scope opened under a different parent (e.g. a previous server session's) is
+         * closed first, so its cancellation does not leak into tokens taken now.
+         */
+        CancellationToken Token(const CancellationToken& parent = CancellationToken()) {
+            if (m_state && m_state->parent != parent.m_state) Cancel();
+            if (!m_state) {
+                m_state = std::make_shared<State>();
+                m_state->parent = parent.m_state;
+            }
+            return CancellationToken(m_state);
+        }
+
+        void Cancel() {
+            if (!m_state) return;
+            m_state->cancelled.store(true, std::memory_order_release);
+            m_state.reset();
+        }
+
+        bool HasTokens() const { return m_state != nullptr; }
+
+    private:
+        using State = CancellationToken::State;
+
+        std::shared_ptr<State> m_state;
+    };
+
+} // namespace rtd
+
+#endif // RTD_CANCELLATION_H
@@ -0,0 +1,234 @@
+#ifndef RTD_CONTENT_HASH_H
+#define RTD_CONTENT_HASH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RTD_HASH_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RTD_HASH_SSE2 1
+#endif
+
+namespace rtd {
+
+    /**
+     * @brief Stripe loop used by ContentHasher. Native is AVX2 when the build enables it
+     * (-mavx2, /arch:AVX2), else SSE2 (always on for x64), else Scalar. All give the same hash.
+     */
+    enum class HashIsa { Scalar, Native };
+
+    namespace detail {
+
+        inline constexpr size_t kHashSecretSize = 192;
+
+        // Fixed key material, expanded from a constant with splitmix64
+        constexpr std::array<unsigned char, kHashSecretSize> MakeHashSecret() {
+            std::array<unsigned char, kHashSecretSize> secret{};
+            uint64_t state = 0x9E3779B97F4A7C15ULL;
+            for (size_t i = 0; i < kHashSecretSize; i += 8) {
+                state += 0x9E3779B97F4A7C15ULL;
+                uint64_t z = state;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                z ^= z >> 31;
+                for (size_t b = 0; b < 8; ++b) secret[i + b] = static_cast<unsigned char>(z >> (8 * b));
+            }
+            return secret;
+        }
+
+        inline constexpr std::array<unsigned char, kHashSecretSize> kHashSecret = MakeHashSecret();
+
+    } // namespace detail
+
+    /**
+     * @brief Streaming 64-bit content hash built like XXH3's long-input path.
+     * Input runs through eight 64-bit accumulators in 64-byte stripes: each lane adds its
+     * neighbour's word and the 32x32->64 product of its word mixed with a secret. Every
+     * 1 KB block ends with a scramble, and Digest folds the lanes and the length into
+     * one avalanched word. Feeding the same bytes in any chunking gives the same hash.
+     *
+     * Not cryptographic: it recognises content, it does not resist crafted collisions.
+     */
+    class ContentHasher {
+    public:
+        static constexpr size_t kStripe = 64;
+        static constexpr size_t kStripesPerBlock = 16;
+        static constexpr size_t kBlock = kStripe * kStripesPerBlock;
+
+        /**
+         * @brief True if HashIsa::Native uses SIMD in this build.
+         */
+        static constexpr bool kVectorized =
+#if defined(RTD_HASH_AVX2) || defined(RTD_HASH_SSE2)
+            true;
+#else
+            false;
+#endif
+
+        explicit ContentHasher(HashIsa isa = HashIsa::Native) : m_vector(isa == HashIsa::Native && kVectorized) {
+            Reset();
+        }
+
+        void Reset() {
+            static constexpr uint64_t kInit[8] = {
+                kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3, kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1
+            };
+            std::memcpy(m_acc, kInit, sizeof(m_acc));
+            m_buffered = 0;
+            m_length = 0;
+        }
+
+        void Update(const void* data, size_t size) {
+            const unsigned char* in = static_cast<const unsigned char*>(data);
+            m_length += size;
+            if (m_buffered != 0) {
+                size_t take = size < kBlock - m_buffered ? size : kBlock - m_buffered;
+                std::memcpy(m_buffer + m_buffered, in, take);
+                m_buffered += take;
+                in += take;
+                size -= take;
+                if (m_buffered < kBlock) return;
+                ConsumeBlock(m_acc, m_buffer);
+                m_buffered = 0;
+            }
+            for (; size >= kBlock; in += kBlock, size -= kBlock) ConsumeBlock(m_acc, in);
+            if (size != 0) {
+                std::memcpy(m_buffer, in, size);
+                m_buffered = size;
+            }
+        }
+
+        /**
+         * @brief Hash of everything fed so far. The hasher can keep taking input afterwards.
+         */
+        uint64_t Digest() const {
+            alignas(32) uint64_t acc[8];
+            std::memcpy(acc, m_acc, sizeof(acc));
+            const unsigned char* secret = detail::kHashSecret.data();
+            size_t stripes = m_buffered / kStripe;
+            for (size_t n = 0; n < stripes; ++n) Accumulate(acc, m_buffer + n * kStripe, secret + n * 8);
+            size_t tail = m_buffered % kStripe;
+            if (tail != 0) {
+                unsigned char last[kStripe] = {};
+                std::memcpy(last, m_buffer + stripes * kStripe, tail);
+                Accumulate(acc, last, secret + detail::kHashSecretSize - kStripe - 7);
+            }
+
+            uint64_t result = static_cast<uint64_t>(m_length) * kPrime64_1;
+            for (size_t i = 0; i < 4; ++i) {
+                result += Mul128Fold64(acc[2 * i] ^ Read64(secret + 11 + 16 * i),
+                                       acc[2 * i + 1] ^ Read64(secret + 19 + 16 * i));
+            }
+            return Avalanche(result);
+        }
+
+        static uint64_t Hash(const void* data, size_t size, HashIsa isa = HashIsa::Native) {
+            ContentHasher hasher(isa);
+            hasher.Update(data, size);
+            return hasher.Digest();
+        }
+
+    private:
+        static constexpr uint64_t kPrime32_1 = 0x9E3779B1U;
+        static constexpr uint64_t kPrime32_2 = 0x85EBCA77U;
+        static constexpr uint64_t kPrime32_3 = 0xC2B2AE3DU;
+        static constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+        static constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+        static constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+        static constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+        static constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+
+        static uint64_t Read64(const unsigned char* p) {
+            uint64_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        static uint64_t Mul128Fold64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+            unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+            return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+            uint64_t aLo = a & 0xFFFFFFFFU, aHi = a >> 32, bLo = b & 0xFFFFFFFFU, bHi = b >> 32;
+            uint64_t loLo = aLo * bLo, hiLo = aHi * bLo, loHi = aLo * bHi, hiHi = aHi * bHi;
+            uint64_t cross = (loLo >> 32) + (hiLo & 0xFFFFFFFFU) + loHi;
+            uint64_t upper = (hiLo >> 32) + (cross >> 32) + hiHi;
+            uint64_t lower = (cross << 32) | (loLo & 0xFFFFFFFFU);
+            return lower ^ upper;
+#endif
+        }
+
+        static uint64_t Avalanche(uint64_t h) {
+            h ^= h >> 37;
+            h *= 0x165667919E3779F9ULL;
+            h ^= h >> 32;
+            return h;
+        }
+
+        static void AccumulateScalar(uint64_t* acc, const unsigned char* in, const unsigned char* key) {
+            for (size_t i = 0; i < 8; ++i) {
+                uint64_t data = Read64(in + 8 * i);
+                uint64_t mixed = data ^ Read64(key + 8 * i);
+                acc[i ^ 1] += data;
+                acc[i] += (mixed & 0xFFFFFFFFU) * (mixed >> 32);
+            }
+        }
+
+        // Same arithmetic as AccumulateScalar, two (AVX2) or four (SSE2) vectors per stripe.
+        // The shuffle swaps the 64-bit halves, so each lane gets its neighbour's word.
+        static void AccumulateVector(uint64_t* acc, const unsigned char* in, const unsigned char* key) {
+#if defined(RTD_HASH_AVX2)
+            __m256i* lanes = reinterpret_cast<__m256i*>(acc);
+            for (size_t i = 0; i < 2; ++i) {
+                __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in) + i);
+                __m256i mixed = _mm256_xor_si256(data, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key) + i));
+                __m256i product = _mm256_mul_epu32(mixed, _mm256_srli_epi64(mixed, 32));
+                __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                lanes[i] = _mm256_add_epi64(_mm256_add_epi64(lanes[i], swapped), product);
+            }
+#elif defined(RTD_HASH_SSE2)
+            __m128i* lanes = reinterpret_cast<__m128i*>(acc);
+            for (size_t i = 0; i < 4; ++i) {
+                __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in) + i);
+                __m128i mixed = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key) + i));
+                __m128i product = _mm_mul_epu32(mixed, _mm_srli_epi64(mixed, 32));
+                __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                lanes[i] = _mm_add_epi64(_mm_add_epi64(lanes[i], swapped), product);
+            }
+#else
+            AccumulateScalar(acc, in, key);
+#endif
+        }
+
+        void Accumulate(uint64_t* acc, const unsigned char* in, const unsigned char* key) const {
+            if (m_vector) AccumulateVector(acc, in, key);
+            else AccumulateScalar(acc, in, key);
+        }
+
+        void ConsumeBlock(uint64_t* acc, const unsigned char* block) const {
+            const unsigned char* secret = detail::kHashSecret.data();
+            for (size_t n = 0; n < kStripesPerBlock; ++n) Accumulate(acc, block + n * kStripe, secret + n * 8);
+            const unsigned char* key = secret + detail::kHashSecretSize - kStripe;
+            for (size_t i = 0; i < 8; ++i) {
+                uint64_t lane = acc[i];
+                lane ^= lane >> 47;
+                lane ^= Read64(key + 8 * i);
+                acc[i] = lane * kPrime32_1;
+            }
+        }
+
+        alignas(32) uint64_t m_acc[8];
+        unsigned char m_buffer[kBlock];
+        size_t m_buffered = 0;
+        unsigned long long m_length = 0;
+        bool m_vector;
+    };
+
+} // namespace rtd
+
+#endif // RTD_CONTENT_HASH_H
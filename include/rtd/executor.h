@@ -0,0 +1,261 @@
+#ifndef RTD_EXECUTOR_H
+#define RTD_EXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "spsc_ring.h"
+
+namespace rtd {
+
+    /**
+     * @brief Fixed-size thread pool with per-worker work-stealing deques.
+     * A task submitted from one of the pool's own threads goes to the back of that
+     * worker's deque and is popped from the back (LIFO, cache-warm); tasks from other
+     * threads are spread round-robin. An idle worker steals from the front of the others'
+     * deques before going to sleep. Each deque has its own small lock, so workers only
+     * meet on a lock when stealing.
+     *
+     * Workers start on the first Submit. Tasks must not throw; an escaping exception is
+     * caught and counted as failed.
+     */
+    class Executor {
+    public:
+        using Task = std::function<void()>;
+
+        static constexpr size_t kMaxThreads = 64;
+
+        struct Stats {
+            unsigned long long executed = 0;
+            unsigned long long stolen = 0;
+            unsigned long long failed = 0;
+        };
+
+        /**
+         * @param threads Worker count; 0 uses one per hardware thread.
+         */
+        explicit Executor(size_t threads = 0) {
+            SetThreadCount(threads);
+        }
+
+        Executor(const Executor&) = delete;
+        Executor& operator=(const Executor&) = delete;
+
+        ~Executor() {
+            Stop();
+        }
+
+        /**
+         * @brief Sets the worker count used when the workers next start.
+         * @return false if the workers are running (call Stop first).
+         */
+        bool SetThreadCount(size_t threads) {
+            std::lock_guard<std::mutex> lock(m_stateMutex);
+            if (!m_threads.empty()) return false;
+            if (threads == 0) threads = std::thread::hardware_concurrency();
+            if (threads == 0) threads = 1;
+            if (threads > kMaxThreads) threads = kMaxThreads;
+            m_threadCount = threads;
+            return true;
+        }
+
+        size_t ThreadCount() {
+            std::lock_guard<std::mutex> lock(m_stateMutex);
+            return m_threadCount;
+        }
+
+        /**
+         * @brief Queues a task.
+         * @return false if the executor is stopping (the task is dropped).
+         */
+        bool Submit(Task task) {
+            if (!task) return false;
+            // Stop waits for m_submitters to drain before it tears the deques down
+            m_submitters.fetch_add(1, std::memory_order_seq_cst);
+            if (m_stopping.load(std::memory_order_seq_cst) || (!m_running.load(std::memory_order_acquire) && !Start())) {
+                m_submitters.fetch_sub(1, std::memory_order_release);
+                return false;
+            }
+
+            size_t target;
+            const LocalWorker& local = Local();
+            if (local.owner == this) {
+                target = local.index;
+            } else {
+                target = m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workerCount;
+            }
+            m_pending.fetch_add(1, std::memory_order_relaxed);
+            {
+                Worker& worker = m_workers[target];
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                worker.tasks.push_back(std::move(task));
+            }
+            m_queued.fetch_add(1, std::memory_order_seq_cst);
+            if (m_sleeping.load(std::memory_order_seq_cst) > 0) {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_wake.notify_one();
+            }
+            m_submitters.fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Blocks until every submitted task has finished. Must not be called from a task.
+         */
+        void WaitIdle() {
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_idle.wait(lock, [this]() { return m_pending.load(std::memory_order_acquire) == 0; });
+        }
+
+        /**
+         * @brief Runs the tasks still queued, then joins the workers. Submit fails meanwhile.
+         * Must not be called from a task. The executor can be used again afterwards.
+         */
+        void Stop() {
+            m_stopping.store(true, std::memory_order_seq_cst);
+            while (m_submitters.load(std::memory_order_acquire) != 0) std::this_thread::yield();
+
+            std::lock_guard<std::mutex> state(m_stateMutex);
+            if (m_threads.empty()) {
+                m_stopping.store(false, std::memory_order_release);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_wake.notify_all();
+            }
+            for (auto& thread : m_threads) thread.join();
+            m_threads.clear();
+            m_workers.reset();
+            m_workerCount = 0;
+            m_running.store(false, std::memory_order_release);
+            m_stopping.store(false, std::memory_order_release);
+        }
+
+        Stats GetStats() const {
+            Stats stats;
+            stats.executed = m_executed.load(std::memory_order_relaxed);
+            stats.stolen = m_stolen.load(std::memory_order_relaxed);
+            stats.failed = m_failed.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+    private:
+        struct alignas(kCacheLineSize) Worker {
+            std::mutex mutex;
+            std::deque<Task> tasks; // Owner pops the back, thieves take the front
+        };
+
+        struct LocalWorker {
+            const Executor* owner;
+            size_t index;
+        };
+
+        static LocalWorker& Local() {
+            static thread_local LocalWorker local = { nullptr, 0 };
+            return local;
+        }
+
+        bool Start() {
+            std::lock_guard<std::mutex> state(m_stateMutex);
+            if (m_running.load(std::memory_order_relaxed)) return true;
+            if (m_stopping.load(std::memory_order_relaxed)) return false;
+            m_workers = std::make_unique<Worker[]>(m_threadCount);
+            m_workerCount = m_threadCount;
+            for (size_t i = 0; i < m_workerCount; ++i) m_threads.emplace_back(&Executor::Run, this, i);
+            m_running.store(true, std::memory_order_release);
+            return true;
+        }
+
+        bool PopLocal(size_t index, Task& task) {
+            Worker& worker = m_workers[index];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (worker.tasks.empty()) return false;
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            return true;
+        }
+
+        bool Steal(size_t thief, Task& task) {
+            for (size_t i = 1; i < m_workerCount; ++i) {
+                Worker& victim = m_workers[(thief + i) % m_workerCount];
+                std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+                if (!lock.owns_lock() || victim.tasks.empty()) continue;
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                m_stolen.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        void Run(size_t index) {
+            Local() = { this, index };
+            Task task;
+            while (true) {
+                if (PopLocal(index, task) || Steal(index, task)) {
+                    m_queued.fetch_sub(1, std::memory_order_relaxed);
+                    Execute(task);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(m_sleepMutex);
+                m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+                // A steal may have missed a deque that was locked; queued work keeps us awake
+                while (m_queued.load(std::memory_order_seq_cst) == 0 && !m_stopping.load(std::memory_order_acquire)) {
+                    m_wake.wait(lock);
+                }
+                m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+                // A Submit that got in before Stop may still be pushing; stay for its task
+                if (m_stopping.load(std::memory_order_seq_cst) && m_submitters.load(std::memory_order_seq_cst) == 0 &&
+                    m_queued.load(std::memory_order_seq_cst) == 0) {
+                    break;
+                }
+            }
+            Local() = { nullptr, 0 };
+        }
+
+        void Execute(Task& task) {
+            try {
+                task();
+            } catch (...) {
+                m_failed.fetch_add(1, std::memory_order_relaxed);
+            }
+            task = nullptr;
+            m_executed.fetch_add(1, std::memory_order_relaxed);
+            if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_idle.notify_all();
+            }
+        }
+
+        std::mutex m_stateMutex; // Serializes Start, Stop and SetThreadCount
+        std::vector<std::thread> m_threads;
+        std::unique_ptr<Worker[]> m_workers;
+        size_t m_workerCount = 0;
+        size_t m_threadCount = 1;
+        std::atomic<bool> m_running{false};
+        std::atomic<bool> m_stopping{false};
+        std::atomic<size_t> m_nextWorker{0};
+        std::atomic<size_t> m_submitters{0}; // Submit calls in progress
+
+        std::mutex m_sleepMutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_idle;
+        std::atomic<size_t> m_queued{0};   // In some deque
+        std::atomic<size_t> m_pending{0};  // Submitted and not yet finished
+        std::atomic<size_t> m_sleeping{0};
+
+        std::atomic<unsigned long long> m_executed{0};
+        std::atomic<unsigned long long> m_stolen{0};
+        std::atomic<unsigned long long> m_failed{0};
+    };
+
+} // namespace rtd
+
+#endif // RTD_EXECUTOR_H
@@ -0,0 +1,647 @@
+#ifndef RTD_FEED_ADAPTER_H
+#define RTD_FEED_ADAPTER_H
+
+// Winsock 2 must come before <windows.h> (or define WIN32_LEAN_AND_MEAN), so include
+// this header ahead of the others.
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "feed_protocol.h"
+#include "server.h"
+#include "subscription.h"
+#include "value.h"
+
+namespace rtd {
+
+    /**
+     * @brief Streams updates from an external publisher into a server over a named pipe or
+     * a loopback TCP connection, using the frames of FeedProtocol.
+     *
+     * One I/O thread owns the connection and a completion port with at most one read and
+     * one write outstanding. Reads land in a reused buffer (kReadBuffer, grown for larger
+     * frames); each Updates frame is decoded into reused TopicValues and applied with one
+     * UpdateSubscriptions call, which notifies Excel once. Keys are subscription handles
+     * (KeyOf), so publishers echo back what Subscribe frames told them.
+     *
+     * Subscribe and Unsubscribe, called from the server's OnSubscribe / OnUnsubscribe,
+     * queue the back-channel frames. The adapter remembers the live subscriptions and
+     * sends them all again after every (re)connect; a lost connection is retried every
+     * kReconnectMs until Stop. The adapter holds a reference on the server between
+     * Connect and Stop, so call Stop from ServerTerminate.
+     *
+     *   HRESULT OnSubscribe(const SubscriptionHandle& s, const TopicArgs& args) override {
+     *       m_feed.Subscribe(s, args);
+     *       return S_OK;
+     *   }
+     *   void OnUnsubscribe(const SubscriptionHandle& s) override { m_feed.Unsubscribe(s); }
+     */
+    class FeedAdapter {
+    public:
+        static constexpr size_t kReadBuffer = 64 * 1024;
+        static constexpr DWORD kReconnectMs = 250;
+
+        struct Stats {
+            unsigned long long frames = 0;   // Updates frames applied
+            unsigned long long updates = 0;
+            unsigned long long bytes = 0;    // Received
+            unsigned long long connects = 0;
+            unsigned long long disconnects = 0;
+            unsigned long long protocolErrors = 0; // Malformed frames; each drops the connection
+            // Publisher timestamp to applied, per update (see LatencyHistogram)
+            unsigned long long latency[LatencyHistogram::kBuckets] = {};
+
+            double LatencyPercentileNs(double q) const { return LatencyHistogram::PercentileNs(latency, q); }
+        };
+
+        explicit FeedAdapter(RtdServerBase& server) : m_server(server) {}
+        FeedAdapter(const FeedAdapter&) = delete;
+        FeedAdapter& operator=(const FeedAdapter&) = delete;
+        ~FeedAdapter() { Stop(); }
+
+        static uint64_t KeyOf(const SubscriptionHandle& subscription) {
+            return (static_cast<uint64_t>(subscription.generation) << 32) | static_cast<uint32_t>(subscription.id);
+        }
+        static SubscriptionHandle HandleOf(uint64_t key) {
+            SubscriptionHandle subscription;
+            subscription.id = static_cast<long>(key & 0x7FFFFFFFU);
+            subscription.generation = static_cast<unsigned long>(key >> 32);
+            return subscription;
+        }
+
+        /**
+         * @brief Starts the I/O thread on a named pipe, e.g. L"\\\\.\\pipe\\MyFeed".
+         * @return HRESULT S_OK on success (connecting continues in the background),
+         * E_UNEXPECTED if already started.
+         */
+        HRESULT ConnectPipe(const std::wstring& pipeName) {
+            return Start(Transport::Pipe, pipeName, 0);
+        }
+
+        /**
+         * @brief Starts the I/O thread on a TCP port of 127.0.0.1.
+         * @return HRESULT S_OK on success, E_UNEXPECTED if already started, or the Winsock error.
+         */
+        HRESULT ConnectTcp(unsigned short port) {
+            return Start(Transport::Tcp, std::wstring(), port);
+        }
+
+        /**
+         * @brief Closes the connection and stops the I/O thread. Remembered subscriptions
+         * are kept for the next Connect.
+         */
+        void Stop() {
+            if (!m_thread.joinable()) return;
+            m_stopping.store(true, std::memory_order_release);
+            PostQueuedCompletionStatus(m_port, 0, kStopKey, nullptr);
+            m_thread.join();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                CloseHandle(m_port);
+                m_port = nullptr;
+            }
+            if (m_transport == Transport::Tcp) WSACleanup();
+            m_server.Release();
+        }
+
+        bool IsConnected() const { return m_connected.load(std::memory_order_acquire); }
+
+        /**
+         * @brief Remembers the subscription and asks the publisher for it.
+         */
+        void Subscribe(const SubscriptionHandle& subscription, const TopicArgs& args) {
+            std::vector<std::wstring> copy(args.Args().begin(), args.Args().end());
+            std::lock_guard<std::mutex> lock(m_mutex);
+            uint64_t key = KeyOf(subscription);
+            if (m_linkUp) {
+                m_outgoing.Subscribe(key, copy);
+                Wake();
+            }
+            m_subscribed[key] = std::move(copy);
+        }
+
+        /**
+         * @brief Forgets the subscription and tells the publisher to stop sending it.
+         */
+        void Unsubscribe(const SubscriptionHandle& subscription) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            uint64_t key = KeyOf(subscription);
+            if (m_subscribed.erase(key) == 0) return;
+            if (m_linkUp) {
+                m_outgoing.Unsubscribe(key);
+                Wake();
+            }
+        }
+
+        Stats GetStats() const {
+            Stats stats;
+            stats.frames = m_frames.load(std::memory_order_relaxed);
+            stats.updates = m_updates.load(std::memory_order_relaxed);
+            stats.bytes = m_bytes.load(std::memory_order_relaxed);
+            stats.connects = m_connects.load(std::memory_order_relaxed);
+            stats.disconnects = m_disconnects.load(std::memory_order_relaxed);
+            stats.protocolErrors = m_protocolErrors.load(std::memory_order_relaxed);
+            m_latency.CopyTo(stats.latency);
+            return stats;
+        }
+
+    private:
+        enum class Transport { Pipe, Tcp };
+
+        // Completion keys
+        static constexpr ULONG_PTR kIoKey = 1;
+        static constexpr ULONG_PTR kWakeKey = 2;
+        static constexpr ULONG_PTR kStopKey = 3;
+
+        HRESULT Start(Transport transport, const std::wstring& pipeName, unsigned short port) {
+            if (m_thread.joinable()) return E_UNEXPECTED;
+            if (transport == Transport::Tcp) {
+                WSADATA data;
+                int error = WSAStartup(MAKEWORD(2, 2), &data);
+                if (error != 0) return HRESULT_FROM_WIN32(error);
+            }
+            HANDLE completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+            if (!completionPort) {
+                if (transport == Transport::Tcp) WSACleanup();
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_port = completionPort;
+            }
+            m_transport = transport;
+            m_pipeName = pipeName;
+            m_tcpPort = port;
+            m_read.resize(kReadBuffer);
+            m_stopping.store(false, std::memory_order_relaxed);
+            m_server.AddRef();
+            m_thread = std::thread(&FeedAdapter::Run, this);
+            return S_OK;
+        }
+
+        // Caller holds m_mutex
+        void Wake() {
+            if (m_port) PostQueuedCompletionStatus(m_port, 0, kWakeKey, nullptr);
+        }
+
+        void Run() {
+            while (!m_stopping.load(std::memory_order_acquire)) {
+                if (!Open()) {
+                    WaitForStop(kReconnectMs);
+                    continue;
+                }
+                m_connects.fetch_add(1, std::memory_order_relaxed);
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_outgoing.Clear();
+                    for (const auto& entry : m_subscribed) m_outgoing.Subscribe(entry.first, entry.second);
+                    m_linkUp = true;
+                }
+                m_connected.store(true, std::memory_order_release);
+                if (StartRead()) {
+                    StartWrite();
+                    Pump();
+                }
+                Close();
+            }
+        }
+
+        // Handles completions until the connection fails or Stop is called.
+        void Pump() {
+            while (m_readPending || m_writePending) {
+                DWORD bytes = 0;
+                ULONG_PTR key = 0;
+                OVERLAPPED* overlapped = nullptr;
+                BOOL ok = GetQueuedCompletionStatus(m_port, &bytes, &key, &overlapped, INFINITE);
+                if (key == kStopKey) return;
+                if (key == kWakeKey) {
+                    StartWrite();
+                    continue;
+                }
+                if (overlapped == &m_readOverlapped) {
+                    m_readPending = false;
+                    if (!ok || bytes == 0 || !OnRead(bytes) || !StartRead()) return;
+                } else if (overlapped == &m_writeOverlapped) {
+                    m_writePending = false;
+                    if (!ok) return;
+                    m_written += bytes;
+                    if (!StartWrite()) return;
+                }
+            }
+        }
+
+        void WaitForStop(DWORD timeoutMs) {
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* overlapped = nullptr;
+            // Wake packets are for a connection that is not up; drop them
+            GetQueuedCompletionStatus(m_port, &bytes, &key, &overlapped, timeoutMs);
+        }
+
+        bool Open() {
+            if (m_transport == Transport::Pipe) {
+                HANDLE pipe = CreateFileW(m_pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                                          OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+                if (pipe == INVALID_HANDLE_VALUE) return false;
+                m_handle = pipe;
+            } else {
+                SOCKET tcp = WSASocketW(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+                if (tcp == INVALID_SOCKET) return false;
+                // Frames are written whole; don't hold small ones back
+                BOOL noDelay = TRUE;
+                setsockopt(tcp, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+                sockaddr_in address = {};
+                address.sin_family = AF_INET;
+                address.sin_port = htons(m_tcpPort);
+                address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                if (connect(tcp, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+                    closesocket(tcp);
+                    return false;
+                }
+                m_socket = tcp;
+                m_handle = reinterpret_cast<HANDLE>(tcp);
+            }
+            if (!CreateIoCompletionPort(m_handle, m_port, kIoKey, 0)) {
+                CloseTransport();
+                return false;
+            }
+            m_filled = 0;
+            m_written = 0;
+            m_sending.Clear();
+            return true;
+        }
+
+        void Close() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_linkUp = false;
+            }
+            m_connected.store(false, std::memory_order_release);
+            // Cancel what is outstanding and wait for the completions, which still refer
+            // to the buffers and OVERLAPPEDs.
+            if (m_readPending || m_writePending) CancelIoEx(m_handle, nullptr);
+            while (m_readPending || m_writePending) {
+                DWORD bytes = 0;
+                ULONG_PTR key = 0;
+                OVERLAPPED* overlapped = nullptr;
+                GetQueuedCompletionStatus(m_port, &bytes, &key, &overlapped, INFINITE);
+                if (key == kStopKey) m_stopping.store(true, std::memory_order_release);
+                if (overlapped == &m_readOverlapped) m_readPending = false;
+                if (overlapped == &m_writeOverlapped) m_writePending = false;
+            }
+            CloseTransport();
+            m_disconnects.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void CloseTransport() {
+            if (m_transport == Transport::Tcp) {
+                if (m_socket != INVALID_SOCKET) closesocket(m_socket);
+                m_socket = INVALID_SOCKET;
+            } else if (m_handle) {
+                CloseHandle(m_handle);
+            }
+            m_handle = nullptr;
+        }
+
+        bool StartRead() {
+            if (m_filled == m_read.size()) m_read.resize(m_read.size() * 2);
+            std::memset(&m_readOverlapped, 0, sizeof(m_readOverlapped));
+            char* target = reinterpret_cast<char*>(m_read.data() + m_filled);
+            DWORD space = static_cast<DWORD>(m_read.size() - m_filled);
+            bool issued;
+            if (m_transport == Transport::Tcp) {
+                WSABUF buffer = { space, target };
+                DWORD flags = 0;
+                issued = WSARecv(m_socket, &buffer, 1, nullptr, &flags, &m_readOverlapped, nullptr) == 0 ||
+                         WSAGetLastError() == WSA_IO_PENDING;
+            } else {
+                issued = ReadFile(m_handle, target, space, nullptr, &m_readOverlapped) ||
+                         GetLastError() == ERROR_IO_PENDING;
+            }
+            // Completions are queued to the port even when the call finishes at once
+            m_readPending = issued;
+            return issued;
+        }
+
+        // Sends the rest of m_sending, or the next queued frames once it is done.
+        bool StartWrite() {
+            if (m_writePending) return true;
+            if (m_written == m_sending.Size()) {
+                m_sending.Clear();
+                m_written = 0;
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_outgoing.Empty()) return true;
+                m_sending.Swap(m_outgoing);
+            }
+            std::memset(&m_writeOverlapped, 0, sizeof(m_writeOverlapped));
+            char* source = reinterpret_cast<char*>(const_cast<uint8_t*>(m_sending.Data() + m_written));
+            DWORD size = static_cast<DWORD>(m_sending.Size() - m_written);
+            bool issued;
+            if (m_transport == Transport::Tcp) {
+                WSABUF buffer = { size, source };
+                issued = WSASend(m_socket, &buffer, 1, nullptr, 0, &m_writeOverlapped, nullptr) == 0 ||
+                         WSAGetLastError() == WSA_IO_PENDING;
+            } else {
+                issued = WriteFile(m_handle, source, size, nullptr, &m_writeOverlapped) ||
+                         GetLastError() == ERROR_IO_PENDING;
+            }
+            m_writePending = issued;
+            return issued;
+        }
+
+        // Applies every whole frame in the buffer and keeps the partial tail.
+        // Returns false on a protocol error.
+        bool OnRead(DWORD bytes) {
+            m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+            m_filled += bytes;
+            size_t offset = 0;
+            while (true) {
+                FeedFrameKind kind{};
+                const uint8_t* payload = nullptr;
+                size_t payloadSize = 0, frameSize = 0;
+                FeedFrameParse result = ParseFeedFrame(m_read.data() + offset, m_filled - offset, kind,
+                                                       payload, payloadSize, frameSize);
+                if (result == FeedFrameParse::Invalid) {
+                    m_protocolErrors.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                if (result == FeedFrameParse::Incomplete) {
+                    if (frameSize > m_read.size()) m_read.resize(frameSize);
+                    break;
+                }
+                if (kind == FeedFrameKind::Updates && !ApplyUpdates(payload, payloadSize)) {
+                    m_protocolErrors.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                offset += frameSize;
+            }
+            if (offset != 0) {
+                std::memmove(m_read.data(), m_read.data() + offset, m_filled - offset);
+                m_filled -= offset;
+            }
+            return true;
+        }
+
+        bool ApplyUpdates(const uint8_t* payload, size_t size) {
+            FeedPayloadReader reader(payload, size);
+            int64_t timestamp = 0;
+            uint32_t count = 0;
+            if (!reader.Read(timestamp) || !reader.Read(count)) return false;
+            // Bound the count by the payload before sizing the buffers for it
+            if (count > reader.Remaining() / FeedProtocol::kMinUpdateBytes) return false;
+            if (m_values.size() < count) {
+                m_values.resize(count);
+                m_handles.resize(count);
+            }
+            for (uint32_t i = 0; i < count; ++i) {
+                uint64_t key = 0;
+                if (!reader.ReadUpdate(key, m_values[i], m_text)) return false;
+                m_handles[i] = HandleOf(key);
+            }
+            if (count != 0) {
+                // E_HANDLE for subscriptions closed while their updates were in flight is expected
+                m_server.UpdateSubscriptions(std::span<const SubscriptionHandle>(m_handles.data(), count),
+                                             std::span<const TopicValue>(m_values.data(), count));
+                m_latency.Record(timestamp, FeedClockNs(), count);
+            }
+            m_frames.fetch_add(1, std::memory_order_relaxed);
+            m_updates.fetch_add(count, std::memory_order_relaxed);
+            return true;
+        }
+
+        RtdServerBase& m_server;
+        std::thread m_thread;
+        std::atomic<bool> m_stopping{false};
+        std::atomic<bool> m_connected{false};
+        Transport m_transport = Transport::Pipe;
+        std::wstring m_pipeName;
+        unsigned short m_tcpPort = 0;
+
+        // Shared with Subscribe / Unsubscribe
+        std::mutex m_mutex;
+        HANDLE m_port = nullptr;
+        bool m_linkUp = false;
+        std::unordered_map<uint64_t, std::vector<std::wstring>> m_subscribed;
+        FeedFrameWriter m_outgoing;
+
+        // Owned by the I/O thread
+        HANDLE m_handle = nullptr;
+        SOCKET m_socket = INVALID_SOCKET;
+        OVERLAPPED m_readOverlapped = {};
+        OVERLAPPED m_writeOverlapped = {};
+        bool m_readPending = false;
+        bool m_writePending = false;
+        std::vector<uint8_t> m_read;
+        size_t m_filled = 0;
+        FeedFrameWriter m_sending;
+        size_t m_written = 0;
+        std::vector<SubscriptionHandle> m_handles;
+        std::vector<TopicValue> m_values;
+        std::wstring m_text;
+
+        std::atomic<unsigned long long> m_frames{0};
+        std::atomic<unsigned long long> m_updates{0};
+        std::atomic<unsigned long long> m_bytes{0};
+        std::atomic<unsigned long long> m_connects{0};
+        std::atomic<unsigned long long> m_disconnects{0};
+        std::atomic<unsigned long long> m_protocolErrors{0};
+        LatencyHistogram m_latency;
+    };
+
+    /**
+     * @brief Blocking publisher end of the feed protocol: serves one FeedAdapter at a time
+     * over a named pipe or a loopback TCP port. A stand-in for real publishers in tests,
+     * benchmarks and examples/feed_publisher; one thread both sends and, after checking
+     * Pending, receives.
+     */
+    class FeedPublisher {
+    public:
+        FeedPublisher() = default;
+        FeedPublisher(const FeedPublisher&) = delete;
+        FeedPublisher& operator=(const FeedPublisher&) = delete;
+        ~FeedPublisher() { Close(); }
+
+        /**
+         * @brief Creates the pipe. Call Accept to wait for the adapter.
+         */
+        HRESULT ListenPipe(const std::wstring& pipeName) {
+            Close();
+            m_pipe = CreateNamedPipeW(pipeName.c_str(), PIPE_ACCESS_DUPLEX, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+                                      1, static_cast<DWORD>(FeedAdapter::kReadBuffer),
+                                      static_cast<DWORD>(FeedAdapter::kReadBuffer), 0, nullptr);
+            if (m_pipe == INVALID_HANDLE_VALUE) {
+                m_pipe = nullptr;
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+            return S_OK;
+        }
+
+        /**
+         * @brief Listens on 127.0.0.1:port. Call Accept to wait for the adapter.
+         */
+        HRESULT ListenTcp(unsigned short port) {
+            Close();
+            WSADATA data;
+            int error = WSAStartup(MAKEWORD(2, 2), &data);
+            if (error != 0) return HRESULT_FROM_WIN32(error);
+            m_winsock = true;
+            m_listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (m_listener == INVALID_SOCKET) return SocketError();
+            BOOL reuse = TRUE;
+            setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (bind(m_listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+                listen(m_listener, 1) != 0) {
+                HRESULT hr = SocketError();
+                closesocket(m_listener);
+                m_listener = INVALID_SOCKET;
+                return hr;
+            }
+            return S_OK;
+        }
+
+        /**
+         * @brief Blocks until an adapter connects.
+         */
+        HRESULT Accept() {
+            if (m_pipe) {
+                if (!ConnectNamedPipe(m_pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED) {
+                    return HRESULT_FROM_WIN32(GetLastError());
+                }
+                m_pipeConnected = true;
+                return S_OK;
+            }
+            if (m_listener == INVALID_SOCKET) return E_UNEXPECTED;
+            m_client = accept(m_listener, nullptr, nullptr);
+            if (m_client == INVALID_SOCKET) return SocketError();
+            BOOL noDelay = TRUE;
+            setsockopt(m_client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+            return S_OK;
+        }
+
+        /**
+         * @brief Drops the current adapter; Accept waits for the next one.
+         */
+        void Disconnect() {
+            if (m_pipeConnected) {
+                DisconnectNamedPipe(m_pipe);
+                m_pipeConnected = false;
+            }
+            if (m_client != INVALID_SOCKET) {
+                closesocket(m_client);
+                m_client = INVALID_SOCKET;
+            }
+        }
+
+        void Close() {
+            Disconnect();
+            if (m_pipe) CloseHandle(m_pipe);
+            m_pipe = nullptr;
+            if (m_listener != INVALID_SOCKET) closesocket(m_listener);
+            m_listener = INVALID_SOCKET;
+            if (m_winsock) WSACleanup();
+            m_winsock = false;
+        }
+
+        /**
+         * @brief Sends the queued frames and clears the writer.
+         */
+        HRESULT Send(FeedFrameWriter& frames) {
+            HRESULT hr = Send(frames.Data(), frames.Size());
+            frames.Clear();
+            return hr;
+        }
+
+        /**
+         * @brief Sends raw bytes, e.g. frames encoded elsewhere.
+         */
+        HRESULT Send(const uint8_t* data, size_t size) {
+            while (size != 0) {
+                DWORD chunk = static_cast<DWORD>(size < 0x10000000 ? size : 0x10000000);
+                DWORD sent = 0;
+                if (m_pipeConnected) {
+                    if (!WriteFile(m_pipe, data, chunk, &sent, nullptr)) return HRESULT_FROM_WIN32(GetLastError());
+                } else {
+                    int result = send(m_client, reinterpret_cast<const char*>(data), static_cast<int>(chunk), 0);
+                    if (result == SOCKET_ERROR) return SocketError();
+                    sent = static_cast<DWORD>(result);
+                }
+                data += sent;
+                size -= sent;
+            }
+            return S_OK;
+        }
+
+        /**
+         * @brief Bytes waiting to be received; Receive does not block while this is non-zero
+         * (unless a frame is still arriving).
+         */
+        size_t Pending() {
+            if (m_pipeConnected) {
+                DWORD available = 0;
+                return PeekNamedPipe(m_pipe, nullptr, 0, nullptr, &available, nullptr) ? available : 0;
+            }
+            if (m_client == INVALID_SOCKET) return 0;
+            u_long available = 0;
+            return ioctlsocket(m_client, FIONREAD, &available) == 0 ? available : 0;
+        }
+
+        /**
+         * @brief Blocks for the next frame and returns its kind and payload.
+         * @return HRESULT S_OK, E_FAIL for a malformed frame, or the error that ended the connection.
+         */
+        HRESULT Receive(FeedFrameKind& kind, std::vector<uint8_t>& payload) {
+            uint8_t header[FeedProtocol::kHeader];
+            HRESULT hr = ReceiveBytes(header, sizeof(header));
+            if (FAILED(hr)) return hr;
+            uint32_t length;
+            std::memcpy(&length, header, sizeof(length));
+            if (length == 0 || length > FeedProtocol::kMaxFrame) return E_FAIL;
+            kind = static_cast<FeedFrameKind>(header[sizeof(uint32_t)]);
+            payload.resize(length - 1);
+            return payload.empty() ? S_OK : ReceiveBytes(payload.data(), payload.size());
+        }
+
+    private:
+        static HRESULT SocketError() { return HRESULT_FROM_WIN32(WSAGetLastError()); }
+
+        HRESULT ReceiveBytes(uint8_t* data, size_t size) {
+            while (size != 0) {
+                DWORD received = 0;
+                if (m_pipeConnected) {
+                    if (!ReadFile(m_pipe, data, static_cast<DWORD>(size), &received, nullptr)) {
+                        return HRESULT_FROM_WIN32(GetLastError());
+                    }
+                } else {
+                    int result = recv(m_client, reinterpret_cast<char*>(data), static_cast<int>(size), 0);
+                    if (result == SOCKET_ERROR) return SocketError();
+                    received = static_cast<DWORD>(result);
+                }
+                if (received == 0) return HRESULT_FROM_WIN32(ERROR_BROKEN_PIPE);
+                data += received;
+                size -= received;
+            }
+            return S_OK;
+        }
+
+        HANDLE m_pipe = nullptr;
+        bool m_pipeConnected = false;
+        SOCKET m_listener = INVALID_SOCKET;
+        SOCKET m_client = INVALID_SOCKET;
+        bool m_winsock = false;
+    };
+
+} // namespace rtd
+
+#endif // RTD_FEED_ADAPTER_H
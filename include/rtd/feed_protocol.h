@@ -0,0 +1,322 @@
+#ifndef RTD_FEED_PROTOCOL_H
+#define RTD_FEED_PROTOCOL_H
+
+#include <windows.h>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "value.h"
+
+namespace rtd {
+
+    static_assert(std::endian::native == std::endian::little, "Feed wire formats are little-endian");
+
+    /**
+     * @brief Value types of a feed update, shared by the shared-memory ring (FeedRecord)
+     * and the stream protocol (FeedFrameWriter).
+     */
+    enum class FeedValueType : uint32_t { Empty = 0, Double = 1, Int64 = 2, Bool = 3, Error = 4, String = 5 };
+
+    /**
+     * @brief Feed timestamp: steady clock in ns (QueryPerformanceCounter on Windows).
+     * Producers on the same machine stamp updates with it; 0 means no timestamp.
+     */
+    inline int64_t FeedClockNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @brief Lock-free histogram of feed latencies in log2 buckets: bucket b counts
+     * latencies below 2^b ns.
+     */
+    class LatencyHistogram {
+    public:
+        static constexpr size_t kBuckets = 64;
+
+        static size_t Bucket(uint64_t elapsedNs) {
+            size_t bucket = static_cast<size_t>(std::bit_width(elapsedNs));
+            return bucket < kBuckets ? bucket : kBuckets - 1;
+        }
+
+        void Add(size_t bucket, unsigned long long count = 1) {
+            m_buckets[bucket].fetch_add(count, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Records count updates stamped at stampNs and applied at nowNs.
+         */
+        void Record(int64_t stampNs, int64_t nowNs, unsigned long long count = 1) {
+            if (stampNs == 0 || count == 0) return;
+            Add(Bucket(nowNs > stampNs ? static_cast<uint64_t>(nowNs - stampNs) : 0), count);
+        }
+
+        void CopyTo(unsigned long long (&out)[kBuckets]) const {
+            for (size_t b = 0; b < kBuckets; ++b) out[b] = m_buckets[b].load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Upper bound of the q-quantile (0..1) of a bucket snapshot, in ns.
+         */
+        static double PercentileNs(const unsigned long long (&latency)[kBuckets], double q) {
+            unsigned long long total = 0;
+            for (unsigned long long count : latency) total += count;
+            if (total == 0) return 0.0;
+            unsigned long long rank = static_cast<unsigned long long>(q * static_cast<double>(total - 1)) + 1;
+            for (size_t b = 0; b < kBuckets; ++b) {
+                if (latency[b] >= rank) return static_cast<double>(1ULL << b);
+                rank -= latency[b];
+            }
+            return static_cast<double>(1ULL << (kBuckets - 1));
+        }
+
+    private:
+        std::atomic<unsigned long long> m_buckets[kBuckets] = {};
+    };
+
+    /**
+     * @brief Frame kinds of the stream feed protocol.
+     */
+    enum class FeedFrameKind : uint8_t { Updates = 1, Subscribe = 2, Unsubscribe = 3 };
+
+    /**
+     * @brief Length-prefixed binary frames exchanged by a FeedAdapter and its publisher over
+     * a byte stream (named pipe or loopback TCP). Little-endian, unaligned, no padding:
+     *
+     *   frame        uint32 length (bytes after this field), uint8 kind, payload
+     *   Updates      int64 timestamp (FeedClockNs; 0 = none), uint32 count, count x update
+     *     update     uint64 key, uint8 FeedValueType, value:
+     *                Double float64 | Int64 int64 | Bool uint8 | Error int32 (2042 = #N/A)
+     *                | String uint16 n + n UTF-16 units | Empty nothing
+     *   Subscribe    uint64 key, uint16 argc, argc x (uint16 n + n UTF-16 units)
+     *   Unsubscribe  uint64 key
+     *
+     * Updates flow from the publisher; Subscribe and Unsubscribe flow back. Receivers skip
+     * frames of unknown kind. Frames are at most kMaxFrame bytes.
+     */
+    struct FeedProtocol {
+        static constexpr uint32_t kMaxFrame = 16u << 20;
+        static constexpr size_t kHeader = sizeof(uint32_t) + sizeof(uint8_t);
+        static constexpr size_t kMaxText = 0xFFFF;
+        static constexpr size_t kMinUpdateBytes = sizeof(uint64_t) + sizeof(uint8_t); // Key and an Empty value
+    };
+
+    /**
+     * @brief Encodes frames into one reused byte buffer; several frames may be queued
+     * before the buffer is sent, and Clear keeps the capacity.
+     *
+     *   writer.BeginUpdates();
+     *   writer.Add(key, 101.5);
+     *   writer.Add(key2, L"Halted");
+     *   writer.EndUpdates();
+     */
+    class FeedFrameWriter {
+    public:
+        void Clear() { m_bytes.clear(); }
+        bool Empty() const { return m_bytes.empty(); }
+        const uint8_t* Data() const { return m_bytes.data(); }
+        size_t Size() const { return m_bytes.size(); }
+        void Swap(FeedFrameWriter& other) { m_bytes.swap(other.m_bytes); }
+
+        /**
+         * @brief Opens an Updates frame; Add appends to it until EndUpdates.
+         */
+        void BeginUpdates(int64_t timestamp = FeedClockNs()) {
+            m_frame = BeginFrame(FeedFrameKind::Updates);
+            Put(timestamp);
+            m_count = 0;
+            Put(m_count);
+        }
+
+        void Add(uint64_t key, double value) { PutUpdate(key, FeedValueType::Double, value); }
+        void Add(uint64_t key, int value) { Add(key, static_cast<long long>(value)); }
+        void Add(uint64_t key, long value) { Add(key, static_cast<long long>(value)); }
+        void Add(uint64_t key, long long value) { PutUpdate(key, FeedValueType::Int64, static_cast<int64_t>(value)); }
+        void Add(uint64_t key, bool value) { PutUpdate(key, FeedValueType::Bool, static_cast<uint8_t>(value ? 1 : 0)); }
+        void AddError(uint64_t key, SCODE code) { PutUpdate(key, FeedValueType::Error, static_cast<int32_t>(code)); }
+        void AddEmpty(uint64_t key) { PutKey(key, FeedValueType::Empty); }
+        /**
+         * @return false (and nothing is added) if the string exceeds FeedProtocol::kMaxText units.
+         */
+        bool Add(uint64_t key, std::wstring_view value) {
+            if (value.size() > FeedProtocol::kMaxText) return false;
+            PutKey(key, FeedValueType::String);
+            PutText(value);
+            return true;
+        }
+        bool Add(uint64_t key, const wchar_t* value) { return Add(key, std::wstring_view(value ? value : L"")); }
+
+        /**
+         * @brief Closes the Updates frame: fills in its count and length.
+         */
+        void EndUpdates() {
+            std::memcpy(m_bytes.data() + m_frame + FeedProtocol::kHeader + sizeof(int64_t), &m_count, sizeof(m_count));
+            EndFrame(m_frame);
+        }
+
+        /**
+         * @brief Appends a Subscribe frame. Arguments longer than FeedProtocol::kMaxText
+         * units are truncated.
+         */
+        template <typename Args>
+        void Subscribe(uint64_t key, const Args& args) {
+            size_t frame = BeginFrame(FeedFrameKind::Subscribe);
+            Put(key);
+            Put(static_cast<uint16_t>(std::size(args)));
+            for (const auto& arg : args) {
+                std::wstring_view text(arg);
+                PutText(text.substr(0, FeedProtocol::kMaxText));
+            }
+            EndFrame(frame);
+        }
+
+        void Unsubscribe(uint64_t key) {
+            size_t frame = BeginFrame(FeedFrameKind::Unsubscribe);
+            Put(key);
+            EndFrame(frame);
+        }
+
+    private:
+        template <typename T>
+        void Put(const T& value) {
+            size_t at = m_bytes.size();
+            m_bytes.resize(at + sizeof(T));
+            std::memcpy(m_bytes.data() + at, &value, sizeof(T));
+        }
+
+        void PutText(std::wstring_view text) {
+            Put(static_cast<uint16_t>(text.size()));
+            size_t at = m_bytes.size();
+            m_bytes.resize(at + text.size() * sizeof(uint16_t));
+            uint8_t* out = m_bytes.data() + at;
+            for (wchar_t c : text) {
+                uint16_t unit = static_cast<uint16_t>(c);
+                std::memcpy(out, &unit, sizeof(unit));
+                out += sizeof(unit);
+            }
+        }
+
+        void PutKey(uint64_t key, FeedValueType type) {
+            Put(key);
+            Put(static_cast<uint8_t>(type));
+            ++m_count;
+        }
+
+        template <typename T>
+        void PutUpdate(uint64_t key, FeedValueType type, T value) {
+            PutKey(key, type);
+            Put(value);
+        }
+
+        size_t BeginFrame(FeedFrameKind kind) {
+            size_t frame = m_bytes.size();
+            Put(uint32_t(0));
+            Put(static_cast<uint8_t>(kind));
+            return frame;
+        }
+
+        void EndFrame(size_t frame) {
+            uint32_t length = static_cast<uint32_t>(m_bytes.size() - frame - sizeof(uint32_t));
+            std::memcpy(m_bytes.data() + frame, &length, sizeof(length));
+        }
+
+        std::vector<uint8_t> m_bytes;
+        size_t m_frame = 0;
+        uint32_t m_count = 0;
+    };
+
+    /**
+     * @brief Bounds-checked decoder over one frame payload. Every Read returns false
+     * instead of running past the end, so a malformed frame can be rejected as a whole.
+     */
+    class FeedPayloadReader {
+    public:
+        FeedPayloadReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+        size_t Remaining() const { return m_size - m_offset; }
+
+        template <typename T>
+        bool Read(T& value) {
+            if (Remaining() < sizeof(T)) return false;
+            std::memcpy(&value, m_data + m_offset, sizeof(T));
+            m_offset += sizeof(T);
+            return true;
+        }
+
+        /**
+         * @brief Reads a uint16-counted UTF-16 string into text, reusing its capacity.
+         */
+        bool ReadText(std::wstring& text) {
+            uint16_t length = 0;
+            if (!Read(length) || Remaining() < length * sizeof(uint16_t)) return false;
+            text.resize(length);
+            for (uint16_t i = 0; i < length; ++i) {
+                uint16_t unit;
+                std::memcpy(&unit, m_data + m_offset + i * sizeof(uint16_t), sizeof(unit));
+                text[i] = static_cast<wchar_t>(unit);
+            }
+            m_offset += length * sizeof(uint16_t);
+            return true;
+        }
+
+        /**
+         * @brief Reads one update of an Updates frame. String values are staged in scratch,
+         * then assigned, so value's buffer is reused as well.
+         */
+        bool ReadUpdate(uint64_t& key, TopicValue& value, std::wstring& scratch) {
+            uint8_t type = 0;
+            if (!Read(key) || !Read(type)) return false;
+            switch (static_cast<FeedValueType>(type)) {
+            case FeedValueType::Empty: value.Clear(); return true;
+            case FeedValueType::Double: { double v; if (!Read(v)) return false; value.Assign(v); return true; }
+            case FeedValueType::Int64: { int64_t v; if (!Read(v)) return false; value.Assign(static_cast<long long>(v)); return true; }
+            case FeedValueType::Bool: { uint8_t v; if (!Read(v)) return false; value.Assign(v != 0); return true; }
+            case FeedValueType::Error: { int32_t v; if (!Read(v)) return false; value.SetError(static_cast<SCODE>(v)); return true; }
+            case FeedValueType::String:
+                if (!ReadText(scratch)) return false;
+                return SUCCEEDED(value.Assign(std::wstring_view(scratch)));
+            }
+            return false;
+        }
+
+    private:
+        const uint8_t* m_data;
+        size_t m_size;
+        size_t m_offset = 0;
+    };
+
+    /**
+     * @brief Splits a byte stream into frames.
+     */
+    enum class FeedFrameParse { Complete, Incomplete, Invalid };
+
+    /**
+     * @brief Looks for a whole frame at the start of data.
+     * @return Complete with the frame's kind, payload and total size (header included);
+     * Incomplete if more bytes are needed (frameSize is then the size to wait for, once
+     * the length is known); Invalid if the length field is 0 or above kMaxFrame.
+     */
+    inline FeedFrameParse ParseFeedFrame(const uint8_t* data, size_t size, FeedFrameKind& kind,
+                                         const uint8_t*& payload, size_t& payloadSize, size_t& frameSize) {
+        frameSize = FeedProtocol::kHeader;
+        if (size < sizeof(uint32_t)) return FeedFrameParse::Incomplete;
+        uint32_t length;
+        std::memcpy(&length, data, sizeof(length));
+        if (length == 0 || length > FeedProtocol::kMaxFrame) return FeedFrameParse::Invalid;
+        frameSize = sizeof(uint32_t) + static_cast<size_t>(length);
+        if (size < frameSize) return FeedFrameParse::Incomplete;
+        kind = static_cast<FeedFrameKind>(data[sizeof(uint32_t)]);
+        payload = data + FeedProtocol::kHeader;
+        payloadSize = length - 1;
+        return FeedFrameParse::Complete;
+    }
+
+} // namespace rtd
+
+#endif // RTD_FEED_PROTOCOL_H
@@ -0,0 +1,122 @@
+#ifndef RTD_INGEST_H
+#define RTD_INGEST_H
+
+#include <windows.h>
+#include <ole2.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "spsc_ring.h"
+#include "thread_slots.h"
+#include "value.h"
+
+namespace rtd {
+
+    /**
+     * @brief How RtdServerBase::UpdateTopic hands values to the topic store.
+     */
+    enum class IngestMode {
+        Locked,   // Default: every update takes m_topicMutex and writes the slot directly
+        LockFree  // Updates go through a per-producer-thread ring, drained by RefreshData
+    };
+
+    /**
+     * @brief A topic update in flight between a producer thread and the topic store.
+     */
+    struct PendingUpdate {
+        long topicId = -1;
+        unsigned long generation = 0; // Checked only when byHandle is set
+        bool byHandle = false;
+        TopicValue value;
+    };
+
+    /**
+     * @brief Per-producer-thread update rings for IngestMode::LockFree.
+     * Each producer thread leases its own SPSC ring on first use, so producers never
+     * contend with each other. When the thread exits the ring goes back to the pool,
+     * pending updates included, and the next new producer takes it over. The consumer
+     * side is whoever holds the server's topic lock (RefreshData, DisconnectData, or a
+     * producer flushing a full ring).
+     */
+    class UpdateIngestor {
+    public:
+        static constexpr size_t kMaxRings = 64;
+        static constexpr size_t kDefaultRingCapacity = 4096;
+
+        using Ring = SpscRing<PendingUpdate>;
+
+        UpdateIngestor() : m_producers(kMaxRings), m_ringCapacity(kDefaultRingCapacity) {
+            for (auto& ring : m_rings) ring.store(nullptr, std::memory_order_relaxed);
+        }
+
+        UpdateIngestor(const UpdateIngestor&) = delete;
+        UpdateIngestor& operator=(const UpdateIngestor&) = delete;
+
+        ~UpdateIngestor() {
+            // Values that were never drained are released with the rings
+            for (auto& ring : m_rings) delete ring.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Sets the capacity of rings created from now on.
+         */
+        void SetRingCapacity(size_t capacity) {
+            std::lock_guard<std::mutex> lock(m_registryMutex);
+            m_ringCapacity = capacity ? capacity : kDefaultRingCapacity;
+        }
+
+        /**
+         * @brief Returns the calling thread's ring, creating it on first use.
+         * @return nullptr while kMaxRings producer threads hold a ring (caller falls back to
+         * the locked path).
+         */
+        Ring* LocalRing() {
+            size_t index = m_producers.Acquire();
+            if (index == ThreadSlots::kNone) return nullptr;
+            // Only the index's current holder stores its ring
+            Ring* ring = m_rings[index].load(std::memory_order_acquire);
+            return ring ? ring : CreateRing(index);
+        }
+
+        /**
+         * @brief Consumes every pending update from every ring, oldest first per producer.
+         * Caller must be the only consumer (i.e. hold the server's topic lock).
+         */
+        template <typename Fn>
+        size_t Drain(Fn&& fn) {
+            size_t total = 0;
+            size_t count = m_ringCount.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; ++i) {
+                Ring* ring = m_rings[i].load(std::memory_order_acquire);
+                if (ring) total += ring->Drain(fn);
+            }
+            return total;
+        }
+
+        /**
+         * @brief Number of producer rings created so far (at most the number of producer
+         * threads alive at once); zero until a producer enqueues.
+         */
+        size_t RingCount() const { return m_ringCount.load(std::memory_order_acquire); }
+
+    private:
+        Ring* CreateRing(size_t index) {
+            std::lock_guard<std::mutex> lock(m_registryMutex);
+            Ring* ring = new (std::nothrow) Ring(m_ringCapacity);
+            if (!ring) return nullptr;
+            m_rings[index].store(ring, std::memory_order_release);
+            if (index >= m_ringCount.load(std::memory_order_relaxed)) m_ringCount.store(index + 1, std::memory_order_release);
+            return ring;
+        }
+
+        ThreadSlots m_producers; // Ring index leased by each producer thread
+        std::atomic<Ring*> m_rings[kMaxRings];
+        std::atomic<size_t> m_ringCount{0}; // Rings are only created below this index
+
+        std::mutex m_registryMutex; // Protects m_ringCapacity; ring creation only
+        size_t m_ringCapacity;
+    };
+
+} // namespace rtd
+
+#endif // RTD_INGEST_H
@@ -0,0 +1,273 @@
+#ifndef RTD_NOTIFIER_H
+#define RTD_NOTIFIER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace rtd {
+
+    /**
+     * @brief Fires a callback at the earliest scheduled deadline.
+     * Used by RtdServerBase to re-notify Excel when a delivery policy held updates back.
+     * The worker thread is started on first use; repeated Schedule calls coalesce into
+     * the earliest pending deadline, so at most one callback is outstanding.
+     */
+    class DeferredNotifier {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit DeferredNotifier(std::function<void()> fire)
+            : m_fire(std::move(fire)), m_pending(false), m_stopping(false) {}
+
+        DeferredNotifier(const DeferredNotifier&) = delete;
+        DeferredNotifier& operator=(const DeferredNotifier&) = delete;
+
+        ~DeferredNotifier() {
+            Stop();
+        }
+
+        /**
+         * @brief Requests a callback at 'due' (or earlier if one is already scheduled sooner).
+         */
+        void ScheduleAt(Clock::time_point due) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping) return;
+            if (m_pending && m_due <= due) return;
+            m_due = due;
+            m_pending = true;
+            if (!m_thread.joinable()) {
+                m_thread = std::thread(&DeferredNotifier::Run, this);
+            } else {
+                m_cv.notify_one();
+            }
+        }
+
+        /**
+         * @brief Cancels any pending callback and joins the worker thread.
+         * Must not be called from inside the callback. Scheduling is allowed again afterwards.
+         */
+        void Stop() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+                m_pending = false;
+            }
+            m_cv.notify_one();
+            if (m_thread.joinable()) m_thread.join();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = false;
+        }
+
+    private:
+        void Run() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_stopping) {
+                if (!m_pending) {
+                    m_cv.wait(lock);
+                    continue;
+                }
+                if (Clock::now() < m_due) {
+                    m_cv.wait_until(lock, m_due);
+                    continue;
+                }
+                m_pending = false;
+                lock.unlock();
+                m_fire();
+                lock.lock();
+            }
+        }
+
+        std::function<void()> m_fire;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::thread m_thread;
+        Clock::time_point m_due;
+        bool m_pending;
+        bool m_stopping;
+    };
+
+    /**
+     * @brief When NotifyUpdate calls UpdateNotify once Excel has consumed the previous one.
+     */
+    enum class NotifyPacing {
+        Immediate, // As soon as something changes
+        Adaptive   // Just before Excel's measured throttle interval runs out
+    };
+
+    /**
+     * @brief Edge-triggered UpdateNotify gate that learns Excel's RefreshData cadence.
+     * At most one notify is outstanding: once one is sent, further requests are absorbed
+     * until Excel calls RefreshData. Each notify/refresh pair is timed. A refresh that
+     * arrives long after an early notify means Excel sat on it until its throttle interval
+     * (Application.RTD.ThrottleInterval) expired, which gives the throttle estimate; any
+     * refresh bounds it from above. Refreshes that were not held give the dispatch latency.
+     *
+     * With adaptive pacing a request made while Excel is still throttling is deferred to
+     * the throttle's end minus the latency, so the notify lands when Excel can act on it.
+     * Every kProbeEvery-th notify is sent at once to notice a shorter throttle interval.
+     */
+    class RefreshCadence {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        enum class Decision { Notify, Absorbed, Defer };
+
+        static constexpr unsigned kProbeEvery = 16;
+        static constexpr size_t kLatencyWindow = 32;
+
+        struct Snapshot {
+            double intervalMs = 0.0; // Average time between RefreshData calls
+            double latencyMs = 0.0;  // Average time from UpdateNotify to RefreshData
+            double throttleMs = 0.0; // Estimated throttle interval; 0 until one is observed
+        };
+
+        RefreshCadence() = default;
+        RefreshCadence(const RefreshCadence&) = delete;
+        RefreshCadence& operator=(const RefreshCadence&) = delete;
+
+        /**
+         * @brief Lock-free pre-check: true if a notify is outstanding or already deferred.
+         */
+        bool Busy() const { return m_state.load(std::memory_order_acquire) != State::Idle; }
+
+        /**
+         * @brief Decides what to do with a notify request. On Notify the caller must call
+         * UpdateNotify (and Failed if that fails); on Defer it must retry at 'due' after
+         * calling ClearDeferred.
+         */
+        Decision Request(Clock::time_point now, NotifyPacing pacing, Clock::time_point& due) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_state.load(std::memory_order_relaxed) != State::Idle) return Decision::Absorbed;
+            if (pacing == NotifyPacing::Adaptive && m_hasThrottle && ++m_paced % kProbeEvery != 0) {
+                Clock::duration lead = m_throttle - MinLatency();
+                if (lead > Clock::duration::zero() && now < m_lastRefresh + lead) {
+                    due = m_lastRefresh + lead;
+                    m_state.store(State::Deferred, std::memory_order_release);
+                    return Decision::Defer;
+                }
+            }
+            m_notifiedAt = now;
+            m_state.store(State::Outstanding, std::memory_order_release);
+            return Decision::Notify;
+        }
+
+        // UpdateNotify failed: let the next request through.
+        void Failed() { SetIdleFrom(State::Outstanding); }
+
+        // The deferred notify is due.
+        void ClearDeferred() { SetIdleFrom(State::Deferred); }
+
+        /**
+         * @brief Records a RefreshData call and re-opens the gate.
+         */
+        void Refreshed(Clock::time_point now) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_refreshed) {
+                Clock::duration since = now - m_lastRefresh;
+                m_intervalMs = Average(m_intervalMs, Milliseconds(since));
+                if (m_state.load(std::memory_order_relaxed) == State::Outstanding) {
+                    Clock::duration latency = now - m_notifiedAt;
+                    Clock::duration sentAfter = m_notifiedAt - m_lastRefresh;
+                    m_latencyMs = Average(m_latencyMs, Milliseconds(latency));
+                    if (sentAfter * 2 < since) {
+                        // Excel held an early notify: it was throttling for 'since'
+                        m_throttle = since;
+                        m_hasThrottle = true;
+                    } else {
+                        m_latencies[m_latencyCount++ % kLatencyWindow] = latency;
+                    }
+                }
+                if (m_hasThrottle && since < m_throttle) m_throttle = since;
+            }
+            m_lastRefresh = now;
+            m_refreshed = true;
+            if (m_state.load(std::memory_order_relaxed) == State::Outstanding) {
+                m_state.store(State::Idle, std::memory_order_release);
+            }
+        }
+
+        /**
+         * @brief Re-opens the gate if a notify has been outstanding for 'after' or longer,
+         * i.e. Excel apparently lost it.
+         * @return true if the gate was re-opened.
+         */
+        bool Expire(Clock::time_point now, Clock::duration after) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_state.load(std::memory_order_relaxed) != State::Outstanding || now - m_notifiedAt < after) return false;
+            m_state.store(State::Idle, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Forgets the measurements and any outstanding notify (new Excel session).
+         */
+        void Reset() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_state.store(State::Idle, std::memory_order_release);
+            m_refreshed = false;
+            m_hasThrottle = false;
+            m_throttle = Clock::duration::zero();
+            m_intervalMs = 0.0;
+            m_latencyMs = 0.0;
+            m_latencyCount = 0;
+            m_paced = 0;
+        }
+
+        Snapshot Read() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Snapshot snapshot;
+            snapshot.intervalMs = m_intervalMs;
+            snapshot.latencyMs = m_latencyMs;
+            snapshot.throttleMs = m_hasThrottle ? Milliseconds(m_throttle) : 0.0;
+            return snapshot;
+        }
+
+    private:
+        enum class State : unsigned char { Idle, Outstanding, Deferred };
+
+        static double Milliseconds(Clock::duration d) {
+            return std::chrono::duration<double, std::milli>(d).count();
+        }
+
+        // Moving average giving the newest sample a weight of 1/8
+        static double Average(double average, double sample) {
+            return average == 0.0 ? sample : average + (sample - average) / 8.0;
+        }
+
+        void SetIdleFrom(State from) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_state.load(std::memory_order_relaxed) == from) m_state.store(State::Idle, std::memory_order_release);
+        }
+
+        // Caller holds m_mutex. Smallest recent unthrottled latency.
+        Clock::duration MinLatency() const {
+            size_t count = m_latencyCount < kLatencyWindow ? m_latencyCount : kLatencyWindow;
+            if (count == 0) return Clock::duration::zero();
+            Clock::duration least = m_latencies[0];
+            for (size_t i = 1; i < count; ++i) {
+                if (m_latencies[i] < least) least = m_latencies[i];
+            }
+            return least;
+        }
+
+        std::atomic<State> m_state{State::Idle};
+        std::mutex m_mutex; // Guards everything below and m_state transitions
+        bool m_refreshed = false;
+        bool m_hasThrottle = false;
+        Clock::time_point m_lastRefresh;
+        Clock::time_point m_notifiedAt;
+        Clock::duration m_throttle{};
+        Clock::duration m_latencies[kLatencyWindow] = {};
+        size_t m_latencyCount = 0;
+        unsigned m_paced = 0;
+        double m_intervalMs = 0.0;
+        double m_latencyMs = 0.0;
+    };
+
+} // namespace rtd
+
+#endif // RTD_NOTIFIER_H
@@ -0,0 +1,341 @@
+#ifndef RTD_POLICY_H
+#define RTD_POLICY_H
+
+#include <windows.h>
+#include <ole2.h>
+#include <chrono>
+#include <cmath>
+#include <string_view>
+#include <cwchar>
+#include "value.h"
+
+namespace rtd {
+
+    /**
+     * @brief Outcome of DeliveryPolicy::Filter for an incoming update.
+     */
+    enum class UpdateFilter {
+        Accept,    // Store the value and mark the topic dirty
+        Unchanged, // Equal to the current value
+        Deadband   // Numeric change below the deadband / display precision
+    };
+
+    /**
+     * @brief Updates dropped by DeliveryPolicy filters, per reason.
+     */
+    struct SuppressionStats {
+        unsigned long long unchanged = 0; // @onchange
+        unsigned long long deadband = 0;  // @deadband and @decimals
+    };
+
+    /**
+     * @brief Per-topic delivery policy applied by RtdServerBase.
+     * Pending updates are always conflated last-value-wins; the policy decides how
+     * often a topic may be delivered. An update held back by the policy stays dirty and
+     * goes out on a later RefreshData, for which a follow-up notify is scheduled.
+     * Optional filters drop updates on ingestion, before they mark the topic dirty: values
+     * equal to the current one, and numeric changes inside a deadband. Filtered topics keep
+     * their delivered value in the store, as the reference for later comparisons.
+     *
+     * From topic strings, trailing options starting with '@' select the policy:
+     *   =RTD("My.Hybrid.Server",, "AAPL", "Last", "@interval=250", "@rate=2")
+     *   @lvw            Last value wins, no throttling, no filters (the default)
+     *   @interval=<ms>  Minimum gap between two deliveries of the topic
+     *   @rate=<n>       At most n deliveries per second (token bucket, burst of n)
+     *   @onchange       Ignore updates equal to the current value
+     *   @deadband=<x>   Ignore numeric moves smaller than x (absolute)
+     *   @deadband=<x>%  Ignore numeric moves smaller than x percent of the current value
+     *   @decimals=<n>   Ignore numeric moves that do not show when rounded to n decimals (n <= 15)
+     *   @priority=<n>   Delivery order when RefreshData is capped (higher first; default 0)
+     */
+    struct DeliveryPolicy {
+        long minIntervalMs = 0;   // 0 = no minimum gap
+        long maxPerSecond = 0;    // 0 = unlimited
+        bool onChange = false;    // Drop updates equal to the current value
+        double deadband = 0.0;    // Absolute numeric deadband; 0 = off
+        double deadbandPct = 0.0; // Relative numeric deadband in percent; 0 = off
+        long decimals = -1;       // Display precision for rounding; -1 = off
+        long priority = 0;        // Higher is delivered first when a RefreshData batch is capped
+
+        static constexpr long kMaxDecimals = 15; // A double carries no more decimal digits
+
+        bool IsThrottled() const { return minIntervalMs > 0 || maxPerSecond > 0; }
+        bool HasFilter() const { return onChange || deadband > 0.0 || deadbandPct > 0.0 || decimals >= 0; }
+
+        static DeliveryPolicy LastValueWins() { return DeliveryPolicy(); }
+
+        static DeliveryPolicy MinInterval(long ms) {
+            DeliveryPolicy policy;
+            policy.minIntervalMs = ms;
+            return policy;
+        }
+
+        static DeliveryPolicy MaxPerSecond(long count) {
+            DeliveryPolicy policy;
+            policy.maxPerSecond = count;
+            return policy;
+        }
+
+        static DeliveryPolicy OnChange() {
+            DeliveryPolicy policy;
+            policy.onChange = true;
+            return policy;
+        }
+
+        static DeliveryPolicy Deadband(double absolute) {
+            DeliveryPolicy policy;
+            policy.deadband = absolute;
+            return policy;
+        }
+
+        static DeliveryPolicy RelativeDeadband(double percent) {
+            DeliveryPolicy policy;
+            policy.deadbandPct = percent;
+            return policy;
+        }
+
+        static DeliveryPolicy Decimals(long digits) {
+            DeliveryPolicy policy;
+            policy.decimals = digits > kMaxDecimals ? kMaxDecimals : digits;
+            return policy;
+        }
+
+        /**
+         * @brief Decides whether an incoming update reaches the topic.
+         * @param current The topic's stored value (pending or last delivered).
+         */
+        template <typename T>
+        UpdateFilter Filter(const TopicValue& current, const T& incoming) const {
+            if (!HasFilter() || current.IsEmpty()) return UpdateFilter::Accept;
+            if (onChange && current.Equals(incoming)) return UpdateFilter::Unchanged;
+
+            double before = 0.0, after = 0.0;
+            if (!current.AsNumber(before) || !NumberOf(incoming, after)) return UpdateFilter::Accept;
+            double move = std::fabs(after - before);
+            if (deadband > 0.0 && move < deadband) return UpdateFilter::Deadband;
+            if (deadbandPct > 0.0 && move < std::fabs(before) * deadbandPct / 100.0) return UpdateFilter::Deadband;
+            if (decimals >= 0) {
+                double scale = std::pow(10.0, static_cast<double>(decimals));
+                if (std::round(before * scale) == std::round(after * scale)) return UpdateFilter::Deadband;
+            }
+            return UpdateFilter::Accept;
+        }
+
+        /**
+         * @brief Returns true if the string is a policy option (starts with '@').
+         */
+        static bool IsOption(std::wstring_view text) {
+            return !text.empty() && text[0] == L'@';
+        }
+
+        /**
+         * @brief Applies one '@' option to the policy.
+         * @return false if the option is not a recognized policy option.
+         */
+        bool ApplyOption(std::wstring_view option) {
+            if (!IsOption(option)) return false;
+            option.remove_prefix(1);
+
+            if (option == L"lvw") {
+                *this = LastValueWins();
+                return true;
+            }
+            if (option == L"onchange") {
+                onChange = true;
+                return true;
+            }
+
+            size_t eq = option.find(L'=');
+            if (eq == std::wstring_view::npos) return false;
+            std::wstring_view name = option.substr(0, eq);
+            std::wstring_view text = option.substr(eq + 1);
+
+            if (name == L"deadband") {
+                bool percent = !text.empty() && text.back() == L'%';
+                if (percent) text.remove_suffix(1);
+                double band = 0.0;
+                if (!ParseDecimal(text, band)) return false;
+                if (percent) deadbandPct = band;
+                else deadband = band;
+                return true;
+            }
+
+            long value = 0;
+            if (!ParseNonNegative(text, value)) return false;
+
+            if (name == L"interval") {
+                minIntervalMs = value;
+                return true;
+            }
+            if (name == L"rate") {
+                maxPerSecond = value;
+                return true;
+            }
+            if (name == L"decimals") {
+                // Clamped: 10^n overflows past 308, and rounding would then hide every move
+                decimals = value > kMaxDecimals ? kMaxDecimals : value;
+                return true;
+            }
+            if (name == L"priority") {
+                priority = value;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Builds a policy from the '@' options in ConnectData's topic strings.
+         * Starts from the fallback (usually the server default); non-option strings are ignored.
+         */
+        static DeliveryPolicy FromTopicStrings(SAFEARRAY* strings, const DeliveryPolicy& fallback) {
+            DeliveryPolicy policy = fallback;
+            if (!strings || SafeArrayGetDim(strings) != 1) return policy;
+
+            VARTYPE vt = VT_EMPTY;
+            if (FAILED(SafeArrayGetVartype(strings, &vt))) return policy;
+
+            long lower = 0, upper = -1;
+            SafeArrayGetLBound(strings, 1, &lower);
+            SafeArrayGetUBound(strings, 1, &upper);
+
+            void* data = nullptr;
+            if (FAILED(SafeArrayAccessData(strings, &data))) return policy;
+            for (long i = 0; i <= upper - lower; ++i) {
+                BSTR text = nullptr;
+                if (vt == VT_VARIANT) {
+                    VARIANT& item = static_cast<VARIANT*>(data)[i];
+                    if (item.vt == VT_BSTR) text = item.bstrVal;
+                } else if (vt == VT_BSTR) {
+                    text = static_cast<BSTR*>(data)[i];
+                }
+                if (text) policy.ApplyOption(std::wstring_view(text, SysStringLen(text)));
+            }
+            SafeArrayUnaccessData(strings);
+            return policy;
+        }
+
+    private:
+        static bool NumberOf(const TopicValue& value, double& number) { return value.AsNumber(number); }
+        static bool NumberOf(double value, double& number) { number = value; return true; }
+        static bool NumberOf(long long value, double& number) { number = static_cast<double>(value); return true; }
+        static bool NumberOf(bool, double&) { return false; }
+        static bool NumberOf(std::wstring_view, double&) { return false; }
+        static bool NumberOf(const VARIANT& value, double& number) {
+            switch (value.vt) {
+            case VT_R8: number = value.dblVal; return true;
+            case VT_R4: number = value.fltVal; return true;
+            case VT_I4: number = value.lVal; return true;
+            case VT_I2: number = value.iVal; return true;
+            case VT_I8: number = static_cast<double>(value.llVal); return true;
+            case VT_INT: number = value.intVal; return true;
+            default: return false;
+            }
+        }
+
+        // Plain decimal: digits with an optional fractional part, no sign or exponent
+        static bool ParseDecimal(std::wstring_view text, double& value) {
+            if (text.empty() || text.size() > 24) return false;
+            double result = 0.0, scale = 1.0;
+            bool fraction = false, digits = false;
+            for (wchar_t c : text) {
+                if (c == L'.' && !fraction) {
+                    fraction = true;
+                    continue;
+                }
+                if (c < L'0' || c > L'9') return false;
+                digits = true;
+                if (fraction) {
+                    scale /= 10.0;
+                    result += (c - L'0') * scale;
+                } else {
+                    result = result * 10.0 + (c - L'0');
+                }
+            }
+            if (!digits) return false;
+            value = result;
+            return true;
+        }
+
+        static bool ParseNonNegative(std::wstring_view digits, long& value) {
+            if (digits.empty() || digits.size() > 9) return false;
+            long result = 0;
+            for (wchar_t c : digits) {
+                if (c < L'0' || c > L'9') return false;
+                result = result * 10 + (c - L'0');
+            }
+            value = result;
+            return true;
+        }
+    };
+
+    /**
+     * @brief Delivery bookkeeping for one topic under a DeliveryPolicy.
+     * Trivially copyable so it can live inside TopicStore slots.
+     */
+    struct PolicyState {
+        using Clock = std::chrono::steady_clock;
+
+        DeliveryPolicy policy;
+        Clock::time_point lastDelivery; // Epoch = never delivered
+        Clock::time_point lastRefill;
+        double tokens = 0.0;
+        unsigned long passedOver = 0;   // Capped RefreshData batches that left the topic out; ages its priority
+
+        void Reset(const DeliveryPolicy& newPolicy) {
+            policy = newPolicy;
+            lastDelivery = Clock::time_point();
+            lastRefill = Clock::time_point();
+            tokens = static_cast<double>(newPolicy.maxPerSecond);
+            passedOver = 0;
+        }
+
+        /**
+         * @brief Priority for a capped RefreshData: the topic's priority plus one level for
+         * every batch that has left it out, so low-priority topics cannot starve.
+         */
+        long long EffectivePriority() const {
+            return static_cast<long long>(policy.priority) + static_cast<long long>(passedOver);
+        }
+
+        /**
+         * @brief Checks whether the topic may be delivered at 'now'.
+         * @param due Set to the earliest time the topic becomes deliverable when it is held back.
+         */
+        bool IsDue(Clock::time_point now, Clock::time_point& due) const {
+            due = now;
+            if (policy.minIntervalMs > 0 && lastDelivery != Clock::time_point()) {
+                Clock::time_point next = lastDelivery + std::chrono::milliseconds(policy.minIntervalMs);
+                if (next > due) due = next;
+            }
+            if (policy.maxPerSecond > 0) {
+                double available = TokensAt(now);
+                if (available < 1.0) {
+                    auto wait = std::chrono::duration<double>((1.0 - available) / policy.maxPerSecond);
+                    Clock::time_point next = now + std::chrono::duration_cast<Clock::duration>(wait);
+                    if (next > due) due = next;
+                }
+            }
+            return due <= now;
+        }
+
+        void OnDelivered(Clock::time_point now) {
+            if (policy.maxPerSecond > 0) {
+                tokens = TokensAt(now) - 1.0;
+                lastRefill = now;
+            }
+            lastDelivery = now;
+        }
+
+    private:
+        double TokensAt(Clock::time_point now) const {
+            if (lastRefill == Clock::time_point()) return tokens;
+            double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+            double refilled = tokens + elapsed * policy.maxPerSecond;
+            double burst = static_cast<double>(policy.maxPerSecond);
+            return refilled > burst ? burst : refilled;
+        }
+    };
+
+} // namespace rtd
+
+#endif // RTD_POLICY_H
@@ -0,0 +1,380 @@
+#ifndef RTD_RESULT_CACHE_H
+#define RTD_RESULT_CACHE_H
+
+#include <windows.h>
+#include <cstdint>
+#include <cwchar>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "xlcall.h"
+
+namespace rtd {
+
+    /**
+     * @brief An array result laid out as Excel reads it: row-major XLOPER12 cells, with
+     * string cells pointing into one length-prefixed text buffer owned by the matrix.
+     * Built by the calculation side, then published to a ResultCache, after which it is
+     * immutable and handed to Excel as an xltypeMulti without any conversion.
+     * Cells start out empty (xltypeNil).
+     */
+    class ResultMatrix {
+    public:
+        static constexpr RW kMaxRows = 1048576;
+        static constexpr COL kMaxColumns = 16384;
+        static constexpr size_t kMaxText = 32767;
+
+        ResultMatrix() = default;
+
+        /**
+         * @return HRESULT S_OK on success, E_INVALIDARG if the shape exceeds a worksheet.
+         */
+        HRESULT Resize(RW rows, COL columns) {
+            if (rows <= 0 || columns <= 0 || rows > kMaxRows || columns > kMaxColumns) return E_INVALIDARG;
+            XLOPER12 nil = {};
+            nil.xltype = xltypeNil;
+            m_cells.assign(static_cast<size_t>(rows) * static_cast<size_t>(columns), nil);
+            m_text.clear();
+            m_strings.clear();
+            m_rows = rows;
+            m_columns = columns;
+            return S_OK;
+        }
+
+        RW Rows() const { return m_rows; }
+        COL Columns() const { return m_columns; }
+
+        void SetNumber(RW row, COL column, double value) {
+            XLOPER12& cell = At(row, column);
+            cell.xltype = xltypeNum;
+            cell.val.num = value;
+        }
+
+        /**
+         * @brief Sets a whole row-major block of numbers, e.g. straight from a solver's output.
+         */
+        void SetNumbers(const double* values) {
+            for (size_t i = 0; i < m_cells.size(); ++i) {
+                m_cells[i].xltype = xltypeNum;
+                m_cells[i].val.num = values[i];
+            }
+        }
+
+        void SetBool(RW row, COL column, bool value) {
+            XLOPER12& cell = At(row, column);
+            cell.xltype = xltypeBool;
+            cell.val.xbool = value ? TRUE : FALSE;
+        }
+
+        void SetError(RW row, COL column, int error) {
+            XLOPER12& cell = At(row, column);
+            cell.xltype = xltypeErr;
+            cell.val.err = error;
+        }
+
+        /**
+         * @brief Sets a string cell; text beyond Excel's 32767 characters is cut off.
+         */
+        void SetString(RW row, COL column, std::wstring_view text) {
+            if (text.size() > kMaxText) text = text.substr(0, kMaxText);
+            XLOPER12& cell = At(row, column);
+            cell.xltype = xltypeStr;
+            cell.val.str = nullptr; // Pointed into m_text by Seal, once the buffer stops growing
+            m_strings.push_back({ static_cast<size_t>(&cell - m_cells.data()), m_text.size() });
+            m_text.push_back(static_cast<XCHAR>(text.size()));
+            m_text.insert(m_text.end(), text.begin(), text.end());
+        }
+
+        const XLOPER12& Cell(RW row, COL column) const {
+            return m_cells[static_cast<size_t>(row) * static_cast<size_t>(m_columns) + static_cast<size_t>(column)];
+        }
+
+        const XLOPER12* Cells() const { return m_cells.data(); }
+
+        /**
+         * @brief Memory held by the matrix, as counted against a ResultCache's bound.
+         */
+        size_t Bytes() const {
+            return sizeof(*this) + m_cells.size() * sizeof(XLOPER12) + m_text.size() * sizeof(XCHAR);
+        }
+
+    private:
+        friend class ResultCache;
+
+        struct StringCell {
+            size_t cell;
+            size_t offset;
+        };
+
+        XLOPER12& At(RW row, COL column) {
+            return m_cells[static_cast<size_t>(row) * static_cast<size_t>(m_columns) + static_cast<size_t>(column)];
+        }
+
+        // Points the string cells at their text; a later SetString on the same cell wins
+        void Seal() {
+            for (const StringCell& string : m_strings) {
+                XLOPER12& cell = m_cells[string.cell];
+                if (cell.xltype == xltypeStr) cell.val.str = m_text.data() + string.offset;
+            }
+            m_strings.clear();
+            m_strings.shrink_to_fit();
+        }
+
+        std::vector<XLOPER12> m_cells;
+        std::vector<XCHAR> m_text;
+        std::vector<StringCell> m_strings;
+        RW m_rows = 0;
+        COL m_columns = 0;
+    };
+
+    /**
+     * @brief In-process store of array results, shared by the RTD server and the XLL's
+     * worksheet functions (both live in the same DLL; see Shared).
+     *
+     * RTD can only deliver scalars, so the server publishes a matrix here under a name and
+     * delivers the returned handle, "<name>@<version>", as the topic value. Each publish
+     * bumps the version, so the handle changes and Excel recalculates the cells that read
+     * it; a function such as =MyMatrix(RTD(...)) then resolves the handle with Find and
+     * returns the cached cells as an xltypeMulti (see XlResultSlot), with no SAFEARRAY in
+     * between. Only the latest version of each name is kept, and Find returns it for any
+     * version of the handle.
+     *
+     * Matrices are reference counted: a reader keeps its matrix alive after it has been
+     * replaced or evicted. The cache itself is bounded by the summed Bytes of the matrices
+     * it holds, evicting the least recently published or read names first; the newest
+     * matrix stays even if it alone exceeds the bound. Thread-safe.
+     */
+    class ResultCache {
+    public:
+        static constexpr unsigned long long kDefaultMaxBytes = 256ULL * 1024 * 1024;
+        static constexpr wchar_t kVersionSeparator = L'@';
+
+        struct Stats {
+            unsigned long long publishes = 0;
+            unsigned long long hits = 0;
+            unsigned long long misses = 0;
+            unsigned long long evictions = 0;
+            size_t entries = 0;
+            unsigned long long bytes = 0;
+        };
+
+        explicit ResultCache(unsigned long long maxBytes = kDefaultMaxBytes) : m_maxBytes(maxBytes) {}
+
+        ResultCache(const ResultCache&) = delete;
+        ResultCache& operator=(const ResultCache&) = delete;
+
+        /**
+         * @brief The process-wide cache, for servers and functions that do not share one of their own.
+         */
+        static ResultCache& Shared() {
+            static ResultCache cache;
+            return cache;
+        }
+
+        /**
+         * @brief Publishes a matrix under name, replacing the previous version.
+         * @return The handle to deliver through RTD, or an empty string for an empty matrix or name.
+         */
+        std::wstring Publish(std::wstring_view name, ResultMatrix&& matrix) {
+            if (name.empty() || matrix.Rows() == 0) return std::wstring();
+            matrix.Seal();
+            std::shared_ptr<const ResultMatrix> shared = std::make_shared<ResultMatrix>(std::move(matrix));
+            size_t bytes = shared->Bytes();
+
+            unsigned long long version;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                version = ++m_version;
+                ++m_stats.publishes;
+                auto it = m_byName.find(name);
+                if (it != m_byName.end()) {
+                    Entry& entry = *it->second;
+                    m_bytes -= entry.bytes;
+                    entry.matrix.swap(shared); // The old version is released outside the lock
+                    entry.bytes = bytes;
+                    entry.version = version;
+                    m_lru.splice(m_lru.begin(), m_lru, it->second);
+                } else {
+                    m_lru.push_front({ std::wstring(name), std::move(shared), bytes, version });
+                    m_byName.emplace(std::wstring_view(m_lru.front().name), m_lru.begin());
+                }
+                m_bytes += bytes;
+                EvictLocked();
+            }
+            return FormatHandle(name, version);
+        }
+
+        /**
+         * @brief Returns the latest matrix for a handle of any version, or nullptr.
+         */
+        std::shared_ptr<const ResultMatrix> Find(std::wstring_view handle) {
+            std::wstring_view name = NameOf(handle);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_byName.find(name);
+            if (it == m_byName.end()) {
+                ++m_stats.misses;
+                return nullptr;
+            }
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            ++m_stats.hits;
+            return it->second->matrix;
+        }
+
+        /**
+         * @brief Drops a name, e.g. when its last subscription closes.
+         */
+        void Erase(std::wstring_view name) {
+            std::shared_ptr<const ResultMatrix> released;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_byName.find(name);
+            if (it == m_byName.end()) return;
+            std::list<Entry>::iterator entry = it->second;
+            m_bytes -= entry->bytes;
+            released.swap(entry->matrix);
+            m_byName.erase(it);
+            m_lru.erase(entry);
+        }
+
+        void Clear() {
+            std::list<Entry> released;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_byName.clear();
+            released.swap(m_lru);
+            m_bytes = 0;
+        }
+
+        Stats GetStats() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Stats stats = m_stats;
+            stats.entries = m_lru.size();
+            stats.bytes = m_bytes;
+            return stats;
+        }
+
+        static std::wstring FormatHandle(std::wstring_view name, unsigned long long version) {
+            std::wstring handle(name);
+            handle.push_back(kVersionSeparator);
+            handle.append(std::to_wstring(version));
+            return handle;
+        }
+
+        /**
+         * @brief The name part of a handle: everything before the last '@'.
+         */
+        static std::wstring_view NameOf(std::wstring_view handle) {
+            size_t at = handle.rfind(kVersionSeparator);
+            return at == std::wstring_view::npos ? handle : handle.substr(0, at);
+        }
+
+    private:
+        struct Entry {
+            std::wstring name;
+            std::shared_ptr<const ResultMatrix> matrix;
+            size_t bytes;
+            unsigned long long version;
+        };
+
+        void EvictLocked() {
+            while (m_lru.size() > 1 && m_maxBytes != 0 && m_bytes > m_maxBytes) {
+                Entry& oldest = m_lru.back();
+                m_bytes -= oldest.bytes;
+                m_byName.erase(std::wstring_view(oldest.name));
+                m_lru.pop_back();
+                ++m_stats.evictions;
+            }
+        }
+
+        mutable std::mutex m_mutex;
+        std::list<Entry> m_lru; // Front is most recently used
+        // Keyed by views of Entry::name, so lookups from a handle do not allocate
+        std::unordered_map<std::wstring_view, std::list<Entry>::iterator> m_byName;
+        unsigned long long m_maxBytes;
+        unsigned long long m_bytes = 0;
+        unsigned long long m_version = 0;
+        Stats m_stats;
+    };
+
+    /**
+     * @brief Per-thread return slot for a worksheet function that hands Excel a cached
+     * matrix. Excel copies a returned XLOPER12 flagged xlbitDLLFree and then calls the
+     * XLL's xlAutoFree12 on the same thread, so one slot per calculation thread is enough:
+     * Return points the result at the matrix's own cells and pins the matrix, and Release
+     * (from xlAutoFree12) unpins it. Safe for thread-safe ('$') registration.
+     *
+     *   extern "C" LPXLOPER12 WINAPI MyMatrix(LPXLOPER12 handle) { return rtd::XlResultSlot::Resolve(*handle); }
+     *   extern "C" void WINAPI xlAutoFree12(LPXLOPER12 p) { rtd::XlResultSlot::Release(p); }
+     */
+    class XlResultSlot {
+    public:
+        /**
+         * @brief Returns the matrix for a string handle as an xltypeMulti. An error handle
+         * (the topic has no value yet) gives #GETTING_DATA, any other non-string #VALUE!,
+         * and an unknown or evicted handle #N/A.
+         */
+        static LPXLOPER12 Resolve(const XLOPER12& handle, ResultCache& cache = ResultCache::Shared()) {
+            XlResultSlot& slot = Current();
+            slot.m_pinned.reset();
+            DWORD type = handle.xltype & ~static_cast<DWORD>(xlbitXLFree | xlbitDLLFree);
+            if (type == xltypeErr) return slot.Error(xlerrGettingData);
+            if (type != xltypeStr || !handle.val.str) return slot.Error(xlerrValue);
+
+            std::wstring_view text(handle.val.str + 1, static_cast<size_t>(handle.val.str[0]));
+            slot.m_pinned = cache.Find(text);
+            if (!slot.m_pinned) return slot.Error(xlerrNA);
+            return slot.Return(*slot.m_pinned);
+        }
+
+        /**
+         * @brief Points the slot at a matrix the caller keeps alive until xlAutoFree12.
+         */
+        static LPXLOPER12 Return(std::shared_ptr<const ResultMatrix> matrix) {
+            XlResultSlot& slot = Current();
+            slot.m_pinned = std::move(matrix);
+            return slot.Return(*slot.m_pinned);
+        }
+
+        /**
+         * @brief Unpins the matrix behind a result returned from this thread's slot.
+         * @return false if result did not come from the slot (the caller frees it itself).
+         */
+        static bool Release(LPXLOPER12 result) {
+            XlResultSlot& slot = Current();
+            if (result != &slot.m_result) return false;
+            slot.m_pinned.reset();
+            slot.m_result.xltype = xltypeNil;
+            return true;
+        }
+
+    private:
+        static XlResultSlot& Current() {
+            thread_local XlResultSlot slot;
+            return slot;
+        }
+
+        LPXLOPER12 Return(const ResultMatrix& matrix) {
+            m_result.xltype = xltypeMulti | xlbitDLLFree;
+            m_result.val.array.lparray = const_cast<LPXLOPER12>(matrix.Cells()); // Excel only reads it
+            m_result.val.array.rows = matrix.Rows();
+            m_result.val.array.columns = matrix.Columns();
+            return &m_result;
+        }
+
+        // Errors need no xlAutoFree12 call
+        LPXLOPER12 Error(int error) {
+            m_result.xltype = xltypeErr;
+            m_result.val.err = error;
+            return &m_result;
+        }
+
+        XLOPER12 m_result = {};
+        std::shared_ptr<const ResultMatrix> m_pinned;
+    };
+
+} // namespace rtd
+
+#endif // RTD_RESULT_CACHE_H
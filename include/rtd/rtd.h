@@ -4,6 +4,7 @@
 #include "defs.h"
 #include "registry.h"
 #include "server.h"
+#include "timer_wheel.h"
 #include "factory.h"
 #include "entry.h"
 
@@ -1,46 +1,168 @@
 #ifndef RTD_SERVER_H
 #define RTD_SERVER_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <vector>
-#include <map>
-#include <algorithm>
+#include <string_view>
+#include <utility>
 #include "defs.h"
 #include "module.h"
+#include "topic_store.h"
+#include "topic_shards.h"
+#include "value.h"
+#include "ingest.h"
+#include "policy.h"
+#include "notifier.h"
+#include "bstr_pool.h"
+#include "subscription.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "executor.h"
+#include "cancellation.h"
+#include "timer_wheel.h"
+#include "topic_stream.h"
 
 namespace rtd {
 
+    namespace detail {
+
+        /**
+         * @brief A server member built on first use, so a server that never uses the feature
+         * behind it pays neither its memory nor its construction. Concurrent first uses
+         * build it once.
+         */
+        template <typename T>
+        class OnDemand {
+        public:
+            OnDemand() = default;
+            OnDemand(const OnDemand&) = delete;
+            OnDemand& operator=(const OnDemand&) = delete;
+
+            ~OnDemand() { delete m_object.load(std::memory_order_acquire); }
+
+            /**
+             * @brief Returns the object, building it with make() (a std::unique_ptr<T>) on first use.
+             */
+            template <typename Make>
+            T& Get(Make&& make) {
+                T* object = m_object.load(std::memory_order_acquire);
+                if (object) return *object;
+                std::lock_guard<std::mutex> lock(m_mutex);
+                object = m_object.load(std::memory_order_relaxed);
+                if (!object) {
+                    object = make().release();
+                    m_object.store(object, std::memory_order_release);
+                }
+                return *object;
+            }
+
+            /**
+             * @brief Returns the object, or nullptr if it was never needed.
+             */
+            T* Find() const { return m_object.load(std::memory_order_acquire); }
+
+        private:
+            std::atomic<T*> m_object{nullptr};
+            std::mutex m_mutex; // Serializes building only
+        };
+
+    } // namespace detail
+
     /**
      * @brief Base class for implementing an RTD Server.
      * Handles IUnknown, IDispatch (Stub), topic management, and batch update logic.
      */
-    class RtdServerBase : public IRtdServer {
+    class RtdServerBase : public IRtdServer, private StreamHost {
     private:
         long m_refCount;
 
     protected:
         IRTDUpdateEvent* m_callback;
-        std::mutex m_callbackMutex; // Protects m_callback
+        std::mutex m_callbackMutex; // Protects m_callback and m_heartbeatInterval
+
+        // Edge-triggered UpdateNotify, paced by Excel's observed RefreshData cadence
+        RefreshCadence m_cadence;
+        std::atomic<NotifyPacing> m_notifyPacing{NotifyPacing::Immediate};
+        std::chrono::milliseconds m_heartbeatInterval{15000}; // Excel's, read in ServerStart
 
         // Topic Management
-        std::map<long, VARIANT> m_topicData;
-        std::vector<long> m_dirtyTopics;
-        std::mutex m_topicMutex; // Protects m_topicData and m_dirtyTopics
+        TopicShards m_shards;    // Dense slots partitioned by TopicID; each shard has its own lock and dirty list
+        std::mutex m_topicMutex; // Protects m_subscriptions and server-wide state; held by whoever drains m_ingestor.
+                                 // Taken before any shard lock
+
+        // TopicIDs with the same topic strings share one logical subscription
+        SubscriptionTable m_subscriptions;
+
+        // Lock-free ingestion (opt-in via SetIngestMode)
+        UpdateIngestor m_ingestor;
+        std::atomic<IngestMode> m_ingestMode{IngestMode::Locked};
+
+        // Re-notifies Excel when delivery policies, adaptive pacing or streams held updates back
+        detail::OnDemand<DeferredNotifier> m_notifier;
+
+        // Keep delivered values in the store (copy into RefreshData) instead of moving them out
+        bool m_retainValues = false; // Guarded by m_topicMutex
+
+        // Cap on topics per RefreshData (0 = none); the rest wait by priority and age
+        size_t m_maxRefreshBatch = 0; // Guarded by m_topicMutex
+        struct DueCandidate {
+            long long priority;
+            size_t order;  // Position in its shard's dirty list: older first among equals
+            size_t shard;
+            long localId;
+        };
+        std::vector<DueCandidate> m_dueCandidates; // Scratch for capped batches; guarded by m_topicMutex
+
+        // TopicIDs at or above this only take updates once ConnectData has acquired them
+        std::atomic<long> m_updateIdLimit{TopicStore::kDefaultUpdateLimit};
 
+        // Interned string values with pre-built BSTRs (opt-in via EnableStringInterning)
+        std::unique_ptr<BstrPool> m_stringPool;
 
+        // Last delivered values, kept across sessions (opt-in via EnableSnapshot); guarded by m_topicMutex
+        std::unique_ptr<TopicSnapshot> m_snapshot;
+        std::chrono::milliseconds m_prewarmGrace{30000};   // Guarded by m_topicMutex
+        bool m_prewarmDone = false;                         // Guarded by m_topicMutex
+        std::vector<SubscriptionHandle> m_prewarmed;        // Guarded by m_topicMutex
+        detail::OnDemand<DeferredNotifier> m_prewarmSweeper; // Closes prewarmed keys no TopicID claimed
+
+        // Work-stealing pool for computing topic values; tasks are cancelled per topic and on ServerTerminate
+        detail::OnDemand<Executor> m_executor;
+        CancellationSource m_taskScope; // Guarded by m_topicMutex
+
+        // Coroutine topics (see StartTopicStream), indexed by TopicID; guarded by m_topicMutex
+        std::vector<std::shared_ptr<TopicStream::Control>> m_streams;
+        detail::OnDemand<TimerWheel> m_timers; // Wakes streams suspended on rtd::Delay
+
+        // Self-monitoring: hot-path counters and the "__stats" topics serving them
+        ThreadCounters m_counters;
+        detail::OnDemand<DeferredNotifier> m_statsTicker;
+        std::vector<std::pair<long, StatsMetric>> m_statsTopics; // Guarded by m_topicMutex
+        std::chrono::milliseconds m_statsInterval{1000};         // Guarded by m_topicMutex
+        long m_lastBatch = 0;                                     // Guarded by m_topicMutex
+        long m_maxBatch = 0;                                      // Guarded by m_topicMutex
+        double m_updatesPerSec = 0.0;                             // Guarded by m_topicMutex
+        unsigned long long m_rateBaseline = 0;                    // Guarded by m_topicMutex
+        std::chrono::steady_clock::time_point m_rateSampledAt;   // Guarded by m_topicMutex
     public:
         RtdServerBase() : m_refCount(1), m_callback(nullptr) {
             GlobalModule::Lock();
         }
         virtual ~RtdServerBase() {
+            // Join the executor and notifier threads first; they read m_callback
+            m_taskScope.Cancel();
+            CancelStreams();
+            StopWorkers();
             // No need to lock mutexes; object is being destroyed (RefCount=0)
             if (m_callback) m_callback->Release();
-
-            // Clean up stored VARIANTs
-            for (auto const& [topicId, value] : m_topicData) {
-                VariantClear((VARIANT*)&value);
-            }
-            m_topicData.clear();
+            // Stored values are released by m_shards
             GlobalModule::Unlock();
         }
 
@@ -82,15 +204,38 @@ namespace rtd {
         // --- IRtdServer Default Implementations ---
         HRESULT __stdcall ServerStart(IRTDUpdateEvent* Callback, long* pfRes) override {
             if (!pfRes) return E_POINTER;
-            std::lock_guard<std::mutex> lock(m_callbackMutex);
-            if (m_callback) m_callback->Release();
-            m_callback = Callback;
-            if (m_callback) m_callback->AddRef();
+            m_cadence.Reset();
+            {
+                std::lock_guard<std::mutex> lock(m_callbackMutex);
+                if (m_callback) m_callback->Release();
+                m_callback = Callback;
+                if (m_callback) {
+                    m_callback->AddRef();
+                    long heartbeat = 0;
+                    if (SUCCEEDED(m_callback->get_HeartbeatInterval(&heartbeat)) && heartbeat > 0) {
+                        m_heartbeatInterval = std::chrono::milliseconds(heartbeat);
+                    }
+                }
+            }
+            PrewarmFromSnapshot();
             *pfRes = 1;
             return S_OK;
         }
 
         HRESULT __stdcall ServerTerminate() override {
+            // Stop before taking m_callbackMutex: a pending notify may be waiting on it.
+            // Running tasks see their tokens cancelled; queued ones are skipped.
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                m_taskScope.Cancel();
+            }
+            CancelStreams();
+            StopWorkers();
+            ClosePrewarmed(false);
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                if (m_snapshot) m_snapshot->Flush();
+            }
             std::lock_guard<std::mutex> lock(m_callbackMutex);
             if (m_callback) {
                 m_callback->Release();
@@ -101,8 +246,16 @@ namespace rtd {
 
         /**
          * @brief Thread-safe helper to notify Excel of updates.
+         * Edge-triggered: once UpdateNotify has been called, further calls are absorbed
+         * until Excel calls RefreshData, which collects everything published meanwhile.
+         * With NotifyPacing::Adaptive the notify may also be deferred until Excel's
+         * throttle interval is nearly over (see RefreshCadence).
          */
         void NotifyUpdate() {
+            if (m_cadence.Busy()) {
+                m_counters.Add(Counter::NotifyAbsorbed);
+                return;
+            }
             IRTDUpdateEvent* tempCallback = nullptr;
             {
                 std::lock_guard<std::mutex> lock(m_callbackMutex);
@@ -111,12 +264,37 @@ namespace rtd {
                     tempCallback->AddRef();
                 }
             }
-            if (tempCallback) {
-                tempCallback->UpdateNotify();
-                tempCallback->Release();
+            if (!tempCallback) return;
+
+            DeferredNotifier::Clock::time_point due;
+            switch (m_cadence.Request(DeferredNotifier::Clock::now(), m_notifyPacing.load(std::memory_order_relaxed), due)) {
+            case RefreshCadence::Decision::Notify:
+                m_counters.Add(Counter::NotifyCalls);
+                if (FAILED(tempCallback->UpdateNotify())) m_cadence.Failed();
+                break;
+            case RefreshCadence::Decision::Defer:
+                Notifier().ScheduleAt(due);
+                break;
+            case RefreshCadence::Decision::Absorbed:
+                m_counters.Add(Counter::NotifyAbsorbed);
+                break;
             }
+            tempCallback->Release();
         }
 
+        /**
+         * @brief Sets how NotifyUpdate times the next notify once Excel has refreshed.
+         * NotifyPacing::Adaptive holds it until Excel's measured throttle interval is about
+         * to run out, so Excel is ready to call RefreshData when it arrives.
+         */
+        void SetNotifyPacing(NotifyPacing pacing) { m_notifyPacing.store(pacing, std::memory_order_relaxed); }
+        NotifyPacing GetNotifyPacing() const { return m_notifyPacing.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Excel's measured RefreshData cadence (also served as "__stats" metrics).
+         */
+        RefreshCadence::Snapshot GetRefreshCadence() { return m_cadence.Read(); }
+
         /**
          * @brief Helper to create the standard 2D SafeArray for RefreshData.
          * The array is [2][topicCount].
@@ -158,69 +336,178 @@ namespace rtd {
             return S_OK;
         }
 
-        HRESULT __stdcall DisconnectData(long TopicID) override {
+        /**
+         * @brief Default ConnectData built on logical subscriptions.
+         * Parses the topic strings into TopicArgs, applies their '@' delivery options and
+         * attaches the TopicID to the subscription for their canonical key. The key's first
+         * TopicID triggers OnSubscribe; a TopicID joining an existing key gets the current
+         * value right away through pvarOut (with *GetNewValues set). Until a value has been
+         * published, #GETTING_DATA is returned, unless a snapshot (see EnableSnapshot) holds
+         * the key's value from a previous session. Topics in the reserved "__stats" namespace
+         * are answered by the server itself (see ConnectStatsTopic).
+         * Servers that manage topics themselves override ConnectData instead.
+         */
+        HRESULT __stdcall ConnectData(long TopicID, SAFEARRAY** Strings, VARIANT_BOOL* GetNewValues, VARIANT* pvarOut) override {
+            if (!pvarOut) return E_POINTER;
+            if (!TopicStore::IsValidId(TopicID)) return E_INVALIDARG;
+
+            TopicArgs args;
+            HRESULT hr = args.Parse(Strings ? *Strings : nullptr);
+            if (FAILED(hr)) return hr;
+            if (IsStatsTopic(args)) return ConnectStatsTopic(TopicID, args, GetNewValues, pvarOut);
+
+            bool created = false;
+            SubscriptionHandle handle;
+            SubscriptionHandle replaced;
+            std::shared_ptr<TopicStream::Control> stream;
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                // Excel reusing a TopicID it never disconnected: end the old connection first
+                if (IsSubscribed(TopicID)) {
+                    DrainPendingUpdates();
+                    replaced = DetachTopic(TopicID, stream);
+                }
+                TopicShards::Shard& shard = m_shards.ShardOf(TopicID);
+                std::lock_guard<std::mutex> shardLock(shard.mutex);
+                TopicStore::Slot* slot = shard.store.Acquire(m_shards.LocalId(TopicID));
+                slot->policy.Reset(args.Policy(shard.store.DefaultPolicy()));
+                slot->subscription = m_subscriptions.Attach(args, TopicID, created);
+                handle = m_subscriptions.HandleOf(slot->subscription);
+                if (created && m_snapshot) SeedFromSnapshot(slot->subscription);
+            }
+            if (stream) stream->Cancel();
+            if (replaced.IsValid()) OnUnsubscribe(replaced);
+
+            // Outside the lock: the handler may publish a first value synchronously
+            if (created) {
+                hr = OnSubscribe(handle, args);
+                if (FAILED(hr)) {
+                    size_t failed = 0;
+                    {
+                        std::lock_guard<std::mutex> lock(m_topicMutex);
+                        failed = FailSubscription(handle, TopicID);
+                        std::lock_guard<std::mutex> shardLock(m_shards.ShardOf(TopicID).mutex);
+                        ReleaseSlot(TopicID);
+                    }
+                    if (failed) NotifyUpdate();
+                    return hr;
+                }
+            }
+
+            VariantInit(pvarOut);
             std::lock_guard<std::mutex> lock(m_topicMutex);
-            auto it = m_topicData.find(TopicID);
-            if (it != m_topicData.end()) {
-                VariantClear(&(it->second));
-                m_topicData.erase(it);
+            SubscriptionTable::Subscription* sub = m_subscriptions.Find(handle);
+            if (sub && sub->hasValue && SUCCEEDED(sub->value.CopyTo(pvarOut))) {
+                if (GetNewValues) *GetNewValues = VARIANT_TRUE;
+            } else {
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043; // xlErrGettingData
+            }
+            return S_OK;
+        }
+
+        HRESULT __stdcall DisconnectData(long TopicID) override {
+            SubscriptionHandle closed;
+            std::shared_ptr<TopicStream::Control> stream;
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                // Apply in-flight updates first so none of them resurrects the slot afterwards
+                DrainPendingUpdates();
+                closed = DetachTopic(TopicID, stream);
             }
+            // Outside the locks: destroying the frame runs the coroutine's destructors
+            if (stream) stream->Cancel();
+            if (closed.IsValid()) OnUnsubscribe(closed);
             return S_OK;
         }
 
         HRESULT __stdcall RefreshData(long* TopicCount, SAFEARRAY** parrayOut) override {
             if (!TopicCount || !parrayOut) return E_POINTER;
+            *TopicCount = 0;
+            *parrayOut = nullptr;
+            // Re-open the notify gate first: anything published from here on notifies again
+            m_cadence.Refreshed(RefreshCadence::Clock::now());
 
-            std::vector<long> dirtyTopics;
-            std::vector<VARIANT> topicValues;
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            DrainPendingUpdates();
 
-            {
-                std::lock_guard<std::mutex> lock(m_topicMutex);
-                if (m_dirtyTopics.empty()) {
-                    *TopicCount = 0;
-                    *parrayOut = nullptr;
-                    return S_OK;
-                }
-                dirtyTopics.swap(m_dirtyTopics);
-
-                topicValues.reserve(dirtyTopics.size());
-                for (long topicId : dirtyTopics) {
-                    VARIANT value;
-                    VariantInit(&value);
-                    auto it = m_topicData.find(topicId);
-                    if (it != m_topicData.end()) {
-                        VariantCopy(&value, &it->second);
-                    } else {
-                        value.vt = VT_ERROR;
-                        value.scode = 2043; // xlErrGettingData
-                    }
-                    topicValues.push_back(value);
-                }
-            }
+            // Pass 1 pops each shard's due topics, pass 2 fills their values. Between the
+            // passes only producers can run (Connect/DisconnectData need m_topicMutex), so
+            // every collected topic stays live; one updated in between delivers its newest
+            // value now and is delivered again by the next refresh.
+            size_t due = CollectDueTopics();
+            if (due == 0) return S_OK;
 
-            long count = static_cast<long>(dirtyTopics.size());
+            long count = static_cast<long>(due);
+            m_counters.Add(Counter::RefreshCalls);
+            m_counters.Add(Counter::TopicsDelivered, static_cast<unsigned long long>(count));
+            m_lastBatch = count;
+            if (count > m_maxBatch) m_maxBatch = count;
             SAFEARRAY* psa = nullptr;
+            VARIANT* cells = nullptr;
             HRESULT hr = CreateRefreshDataArray(count, &psa);
+            if (SUCCEEDED(hr)) {
+                hr = SafeArrayAccessData(psa, reinterpret_cast<void**>(&cells));
+                if (FAILED(hr)) SafeArrayDestroy(psa);
+            }
             if (FAILED(hr)) {
-                for(auto& v : topicValues) VariantClear(&v);
+                // Nothing was delivered; keep the topics pending
+                for (size_t s = 0; s < m_shards.Count(); ++s) {
+                    TopicShards::Shard& shard = m_shards[s];
+                    std::lock_guard<std::mutex> shardLock(shard.mutex);
+                    for (long localId : shard.dueIds) shard.store.MarkDirty(localId);
+                }
                 return hr;
             }
 
-            for (long i = 0; i < count; ++i) {
-                long indices[2];
-                indices[0] = i;
-
-                indices[1] = 0;
-                VARIANT vTopicId;
-                vTopicId.vt = VT_I4;
-                vTopicId.lVal = dirtyTopics[i];
-                SafeArrayPutElement(psa, indices, &vTopicId);
+            // Fill both rows in place. Element (column i, row r) lives at cells[r * count + i]
+            // (indices[0] of CreateRefreshDataArray varies fastest).
+            std::optional<BstrPool::Batch> strings;
+            if (m_stringPool) strings.emplace(*m_stringPool);
+            VARIANT* idRow = cells;
+            VARIANT* valueRow = cells + count;
+            long i = 0;
+            for (size_t s = 0; s < m_shards.Count(); ++s) {
+                TopicShards::Shard& shard = m_shards[s];
+                if (shard.dueIds.empty()) continue;
+                std::lock_guard<std::mutex> shardLock(shard.mutex);
+                for (long localId : shard.dueIds) {
+                    idRow[i].vt = VT_I4;
+                    idRow[i].lVal = m_shards.GlobalId(s, localId);
 
-                indices[1] = 1;
-                SafeArrayPutElement(psa, indices, &topicValues[i]);
+                    // The VARIANT (and any BSTR) is only materialized here, for delivered values.
+                    // When the store no longer needs the value, a held VARIANT is moved, not copied.
+                    // Filtered topics keep it as the reference for change detection, and a topic
+                    // updated again since pass 1 keeps it for the next refresh.
+                    TopicStore::Slot& slot = shard.store.At(localId);
+                    TopicValue& stored = slot.value;
+                    if (m_snapshot && slot.subscription != TopicStore::kNil) {
+                        SubscriptionTable::Subscription* sub = m_subscriptions.Find(slot.subscription);
+                        if (sub && sub->snapshotRecord != TopicSnapshot::kNil) m_snapshot->Write(sub->snapshotRecord, stored);
+                    }
+                    bool retain = m_retainValues || slot.dirty || slot.policy.policy.HasFilter();
+                    HRESULT hrValue = S_OK;
+                    if (strings && stored.GetType() == TopicValue::Type::String) {
+                        // Usually a BSTR pre-built by the producer; ownership passes to Excel
+                        BSTR bstr = strings->Take(stored.AsString());
+                        if (bstr) {
+                            valueRow[i].vt = VT_BSTR;
+                            valueRow[i].bstrVal = bstr;
+                        } else {
+                            hrValue = E_OUTOFMEMORY;
+                        }
+                        if (!retain) stored.Clear();
+                    } else {
+                        hrValue = retain ? stored.CopyTo(&valueRow[i]) : stored.MoveTo(&valueRow[i]);
+                    }
+                    if (FAILED(hrValue)) {
+                        valueRow[i].vt = VT_ERROR;
+                        valueRow[i].scode = 2043; // xlErrGettingData
+                    }
+                    ++i;
+                }
             }
-
-            for(auto& v : topicValues) VariantClear(&v);
+            SafeArrayUnaccessData(psa);
 
             *TopicCount = count;
             *parrayOut = psa;
@@ -230,41 +517,1110 @@ namespace rtd {
         HRESULT __stdcall Heartbeat(long* pfRes) override {
             if (!pfRes) return E_POINTER;
             *pfRes = 1;
+            // A notify outstanding for a whole heartbeat interval was lost; send another
+            std::chrono::milliseconds interval;
+            {
+                std::lock_guard<std::mutex> lock(m_callbackMutex);
+                interval = m_heartbeatInterval;
+            }
+            if (m_cadence.Expire(RefreshCadence::Clock::now(), interval)) NotifyUpdate();
             return S_OK;
         }
 
     public: // --- Topic Management ---
 
+        /**
+         * @brief Selects how UpdateTopic hands values to the topic store.
+         * In IngestMode::LockFree each producer thread writes into its own bounded ring
+         * and RefreshData drains and conflates them, so producers never take m_topicMutex
+         * unless their ring is full. Call before producers start publishing.
+         * @param ringCapacity Per-producer ring size (rounded up to a power of two).
+         */
+        void SetIngestMode(IngestMode mode, size_t ringCapacity = UpdateIngestor::kDefaultRingCapacity) {
+            m_ingestor.SetRingCapacity(ringCapacity);
+            m_ingestMode.store(mode, std::memory_order_release);
+        }
+
+        IngestMode GetIngestMode() const {
+            return m_ingestMode.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Sets the delivery policy given to topics when they are first connected or updated.
+         */
+        void SetDefaultDeliveryPolicy(const DeliveryPolicy& policy) {
+            TopicShards::AllLock lock(m_shards);
+            for (size_t s = 0; s < m_shards.Count(); ++s) m_shards[s].store.SetDefaultPolicy(policy);
+        }
+
+        /**
+         * @brief Partitions the topic table into independently locked shards.
+         * TopicIDs are spread round-robin over 'count' shards (rounded up to a power of two,
+         * at most TopicShards::kMaxShards; the default is 1). Producers on the locked
+         * ingestion path then only contend when they update topics on the same shard, and
+         * RefreshData visits the shards in turn, merging their dirty lists into one array.
+         * Call before any topic is connected or updated, and before producers start.
+         * @return HRESULT S_OK on success, E_UNEXPECTED if topics already exist.
+         */
+        HRESULT SetShardCount(size_t count) {
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            DeliveryPolicy policy;
+            {
+                TopicShards::AllLock shards(m_shards);
+                for (size_t s = 0; s < m_shards.Count(); ++s) {
+                    if (m_shards[s].store.LiveCount() != 0) return E_UNEXPECTED;
+                }
+                policy = m_shards[0].store.DefaultPolicy();
+            }
+            m_shards.Reset(count);
+            for (size_t s = 0; s < m_shards.Count(); ++s) m_shards[s].store.SetDefaultPolicy(policy);
+            return S_OK;
+        }
+
+        size_t GetShardCount() const { return m_shards.Count(); }
+
+        /**
+         * @brief Bounds the TopicIDs that updates may create ahead of ConnectData (default
+         * TopicStore::kDefaultUpdateLimit). An update for a higher TopicID that ConnectData has
+         * not acquired is rejected with E_INVALIDARG (dropped when drained, in
+         * IngestMode::LockFree) instead of growing the topic table, so a bogus id from a feed
+         * cannot allocate slots up to TopicStore::kMaxTopicId. ConnectData is not bounded.
+         */
+        void SetUpdateTopicLimit(long limit) {
+            m_updateIdLimit.store(std::clamp(limit, 0L, TopicStore::kMaxTopicId), std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Sets the delivery policy of one topic, resetting its throttling state.
+         * @return HRESULT S_OK on success, E_INVALIDARG if the TopicID is out of range.
+         */
+        HRESULT SetTopicPolicy(long topicId, const DeliveryPolicy& policy) {
+            std::lock_guard<std::mutex> lock(m_shards.ShardOf(topicId).mutex);
+            TopicStore::Slot* slot = AcquireSlot(topicId);
+            if (!slot) return E_INVALIDARG;
+            slot->policy.Reset(policy);
+            return S_OK;
+        }
+
+        /**
+         * @brief Sets a topic's policy from the '@' options in its topic strings,
+         * falling back to the server default. Intended to be called from ConnectData.
+         */
+        HRESULT ApplyTopicPolicy(long topicId, SAFEARRAY** Strings) {
+            DeliveryPolicy fallback;
+            {
+                std::lock_guard<std::mutex> lock(m_shards[0].mutex);
+                fallback = m_shards[0].store.DefaultPolicy();
+            }
+            return SetTopicPolicy(topicId, DeliveryPolicy::FromTopicStrings(Strings ? *Strings : nullptr, fallback));
+        }
+
         /**
          * @brief Updates the value for a given topic and marks it for refresh.
+         * Common scalar types (VT_R8, VT_I4, VT_BOOL, VT_ERROR, VT_BSTR, ...) are unpacked
+         * into the compact TopicValue form; others are stored as a VARIANT copy.
          * @param topicId The ID of the topic to update.
          * @param value The new value for the topic.
-         * @return HRESULT S_OK on success.
+         * @return HRESULT S_OK on success, S_FALSE if the topic's policy filtered the update
+         * out (unchanged or inside its deadband), E_INVALIDARG if the TopicID is out of range
+         * or, not yet connected, at or above the update limit (see SetUpdateTopicLimit).
+         * In IngestMode::LockFree filters run when the update is drained, and S_OK is returned.
+         */
+        HRESULT UpdateTopic(long topicId, const VARIANT& value) { return Publish(topicId, value); }
+
+        /**
+         * @brief Typed updates. These store the value without building a VARIANT; strings
+         * up to TopicValue::kInlineChars need no allocation at all. The VARIANT/BSTR is
+         * only created by RefreshData, and only for values that are actually delivered.
+         */
+        HRESULT UpdateTopic(long topicId, double value) { return Publish(topicId, value); }
+        HRESULT UpdateTopic(long topicId, int value) { return Publish(topicId, static_cast<long long>(value)); }
+        HRESULT UpdateTopic(long topicId, long value) { return Publish(topicId, static_cast<long long>(value)); }
+        HRESULT UpdateTopic(long topicId, long long value) { return Publish(topicId, value); }
+        HRESULT UpdateTopic(long topicId, bool value) { return Publish(topicId, value); }
+        HRESULT UpdateTopic(long topicId, std::wstring_view value) { return Publish(topicId, value); }
+        HRESULT UpdateTopic(long topicId, const wchar_t* value) { return Publish(topicId, std::wstring_view(value ? value : L"")); }
+        HRESULT UpdateTopic(long topicId, TopicValue&& value) { return Publish(topicId, std::move(value)); }
+
+        /**
+         * @brief Updates a topic through a handle, without a TopicID lookup.
+         * @return HRESULT S_OK on success, E_HANDLE if the topic was disconnected since the handle was taken.
+         * In IngestMode::LockFree the generation is checked when the update is drained, and
+         * updates through stale handles are dropped there.
+         */
+        HRESULT UpdateTopic(const TopicHandle& handle, const VARIANT& value) { return Publish(handle, value); }
+        HRESULT UpdateTopic(const TopicHandle& handle, double value) { return Publish(handle, value); }
+        HRESULT UpdateTopic(const TopicHandle& handle, int value) { return Publish(handle, static_cast<long long>(value)); }
+        HRESULT UpdateTopic(const TopicHandle& handle, long value) { return Publish(handle, static_cast<long long>(value)); }
+        HRESULT UpdateTopic(const TopicHandle& handle, long long value) { return Publish(handle, value); }
+        HRESULT UpdateTopic(const TopicHandle& handle, bool value) { return Publish(handle, value); }
+        HRESULT UpdateTopic(const TopicHandle& handle, std::wstring_view value) { return Publish(handle, value); }
+        HRESULT UpdateTopic(const TopicHandle& handle, const wchar_t* value) { return Publish(handle, std::wstring_view(value ? value : L"")); }
+        HRESULT UpdateTopic(const TopicHandle& handle, TopicValue&& value) { return Publish(handle, std::move(value)); }
+
+        /**
+         * @brief Columnar batch update: values[i] becomes the value of ids[i].
+         * Buckets the entries by shard in one pass, then takes each shard lock once and
+         * applies that shard's entries front to back (once producer rings exist, they are drained first so no older
+         * queued value can win). Calls NotifyUpdate once if any topic was updated.
+         * @return HRESULT S_OK on success, E_INVALIDARG if the spans differ in length or any
+         * TopicID was out of range (the valid entries are still applied).
+         */
+        HRESULT UpdateTopics(std::span<const long> ids, std::span<const double> values) { return PublishBatch(ids, values); }
+        HRESULT UpdateTopics(std::span<const long> ids, std::span<const VARIANT> values) { return PublishBatch(ids, values); }
+        HRESULT UpdateTopics(std::span<const long> ids, std::span<const TopicValue> values) { return PublishBatch(ids, values); }
+
+        /**
+         * @brief Publishes an upstream value to a logical subscription.
+         * The value is kept as the subscription's current value and copied to every attached
+         * TopicID, each of which is marked for refresh. Always takes the topic lock.
+         * @return HRESULT S_OK on success, E_HANDLE if the subscription has been closed.
+         */
+        HRESULT UpdateSubscription(const SubscriptionHandle& subscription, const VARIANT& value) { return FanOut(subscription, value); }
+        HRESULT UpdateSubscription(const SubscriptionHandle& subscription, double value) { return FanOut(subscription, value); }
+        HRESULT UpdateSubscription(const SubscriptionHandle& subscription, int value) { return FanOut(subscription, static_cast<long long>(value)); }
+        HRESULT UpdateSubscription(const SubscriptionHandle& subscription, long value) { return FanOut(subscription, static_cast<long long>(value)); }
+        HRESULT UpdateSubscription(const SubscriptionHandle& subscription, long long value) { return FanOut(subscription, value); }
+        HRESULT UpdateSubscription(const SubscriptionHandle& subscription, bool value) { return FanOut(subscription, value); }
+        HRESULT UpdateSubscription(const SubscriptionHandle& subscription, std::wstring_view value) { return FanOut(subscription, value); }
+        HRESULT UpdateSubscription(const SubscriptionHandle& subscription, const wchar_t* value) { return FanOut(subscription, std::wstring_view(value ? value : L"")); }
+        HRESULT UpdateSubscription(const SubscriptionHandle& subscription, TopicValue&& value) { return FanOut(subscription, std::move(value)); }
+
+        /**
+         * @brief Batch form of UpdateSubscription: values[i] goes to subscriptions[i].
+         * Takes the topic lock once for the whole batch, and calls NotifyUpdate once if any
+         * topic was updated.
+         * @return HRESULT S_OK on success, E_INVALIDARG if the spans differ in length,
+         * E_HANDLE if any subscription had been closed (the others are still applied).
+         */
+        HRESULT UpdateSubscriptions(std::span<const SubscriptionHandle> subscriptions, std::span<const TopicValue> values) {
+            if (subscriptions.size() != values.size()) return E_INVALIDARG;
+            if (subscriptions.empty()) return S_OK;
+            m_counters.Add(Counter::UpdatesIngested, subscriptions.size());
+            if (m_stringPool) {
+                for (const TopicValue& value : values) PrepareString(value);
+            }
+
+            HRESULT result = S_OK;
+            size_t applied = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                for (size_t i = 0; i < subscriptions.size(); ++i) {
+                    HRESULT hr = FanOutLocked(subscriptions[i], values[i], applied);
+                    if (FAILED(hr) && SUCCEEDED(result)) result = hr;
+                }
+            }
+            if (applied) NotifyUpdate();
+            return result;
+        }
+
+        /**
+         * @brief Number of open logical subscriptions.
+         */
+        size_t GetSubscriptionCount() {
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            return m_subscriptions.LiveCount();
+        }
+
+        /**
+         * @brief Returns a publish handle for a topic, creating its slot if needed.
+         * The handle stays valid until the next DisconnectData for the TopicID.
+         * @return An invalid handle (IsValid() == false) if the TopicID is out of range.
+         */
+        TopicHandle GetTopicHandle(long topicId) {
+            std::lock_guard<std::mutex> lock(m_shards.ShardOf(topicId).mutex);
+            TopicHandle handle;
+            TopicStore::Slot* slot = AcquireSlot(topicId);
+            if (slot) {
+                handle.topicId = topicId;
+                handle.generation = slot->generation;
+            }
+            return handle;
+        }
+
+        /**
+         * @brief Checks whether a handle still refers to the topic it was taken for.
+         */
+        bool IsTopicHandleValid(const TopicHandle& handle) {
+            std::lock_guard<std::mutex> lock(m_shards.ShardOf(handle.topicId).mutex);
+            TopicStore::Slot* slot = FindSlot(handle.topicId);
+            return slot && slot->generation == handle.generation;
+        }
+
+        /**
+         * @brief Keeps delivered values in the topic store.
+         * By default RefreshData moves each delivered VARIANT into the output array, since
+         * nothing reads it again. Enable this if the server reads stored values after delivery.
+         */
+        void SetRetainValues(bool retain) {
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            m_retainValues = retain;
+        }
+
+        /**
+         * @brief Caps the number of topics one RefreshData hands to Excel (0, the default,
+         * means no cap), so a burst of updates is applied over several smaller batches instead
+         * of freezing Excel on one huge array. When more topics are due, the highest
+         * priority go first (DeliveryPolicy::priority, from "@priority=<n>" or
+         * SetTopicPriority); each batch that leaves a topic out raises its priority by one,
+         * so low-priority topics still get through. Topics left out stay pending and a
+         * follow-up notify is scheduled.
+         */
+        void SetMaxRefreshBatch(size_t maxTopics) {
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            m_maxRefreshBatch = maxTopics;
+        }
+
+        /**
+         * @brief Sets a topic's delivery priority without resetting its throttling state.
+         * @return HRESULT S_OK on success, E_INVALIDARG if the TopicID is out of range.
+         */
+        HRESULT SetTopicPriority(long topicId, long priority) {
+            std::lock_guard<std::mutex> lock(m_shards.ShardOf(topicId).mutex);
+            TopicStore::Slot* slot = AcquireSlot(topicId);
+            if (!slot) return E_INVALIDARG;
+            slot->policy.policy.priority = priority;
+            return S_OK;
+        }
+
+        /**
+         * @brief Returns how many updates the topics' policy filters (@onchange, @deadband,
+         * @decimals) have dropped since the server started.
+         */
+        SuppressionStats GetSuppressionStats() const {
+            SuppressionStats stats;
+            stats.unchanged = m_counters.Sum(Counter::DroppedUnchanged);
+            stats.deadband = m_counters.Sum(Counter::DroppedDeadband);
+            return stats;
+        }
+
+        /**
+         * @brief Sets how often "__stats" topics are recomputed and pushed to Excel (default 1 s).
+         */
+        void SetStatsInterval(std::chrono::milliseconds interval) {
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            m_statsInterval = interval.count() > 0 ? interval : std::chrono::milliseconds(1);
+        }
+
+        /**
+         * @brief Reads one self-monitoring metric, as served by the "__stats" topics.
+         */
+        double GetStatsValue(StatsMetric metric) {
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            return StatsValue(metric);
+        }
+
+        using TopicTask = std::function<void(const TopicHandle& topic, const CancellationToken& cancel)>;
+        using ServerTask = std::function<void(const CancellationToken& cancel)>;
+
+        /**
+         * @brief Computes a topic's value on the server's executor, which keeps one worker
+         * per core busy through work stealing. Typically called from ConnectData or a feed
+         * callback. The task gets a handle to the topic and a token that is cancelled by
+         * DisconnectData for the topic or by ServerTerminate; long computations should poll
+         * it. Publish through the handle: once the topic is disconnected the update is
+         * rejected (E_HANDLE) rather than recreating the topic.
+         * @return HRESULT S_OK if queued, E_INVALIDARG if the TopicID is out of range,
+         * E_ABORT if the executor is shutting down.
+         */
+        HRESULT SubmitTopicTask(long topicId, TopicTask task) {
+            if (!task) return E_INVALIDARG;
+            TopicHandle handle;
+            CancellationToken token;
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                std::lock_guard<std::mutex> shardLock(m_shards.ShardOf(topicId).mutex);
+                TopicStore::Slot* slot = AcquireSlot(topicId);
+                if (!slot) return E_INVALIDARG;
+                handle.topicId = topicId;
+                handle.generation = slot->generation;
+                token = slot->tasks.Token(m_taskScope.Token());
+            }
+            bool queued = Tasks().Submit([task = std::move(task), handle, token]() {
+                if (!token.IsCancelled()) task(handle, token);
+            });
+            return queued ? S_OK : E_ABORT;
+        }
+
+        /**
+         * @brief Runs server-wide work (feed decoding, bulk recalculation) on the executor.
+         * The token is cancelled by ServerTerminate.
+         * @return HRESULT S_OK if queued, E_ABORT if the executor is shutting down.
+         */
+        HRESULT SubmitTask(ServerTask task) {
+            if (!task) return E_INVALIDARG;
+            CancellationToken token;
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                token = m_taskScope.Token();
+            }
+            bool queued = Tasks().Submit([task = std::move(task), token]() {
+                if (!token.IsCancelled()) task(token);
+            });
+            return queued ? S_OK : E_ABORT;
+        }
+
+        /**
+         * @brief Sets the executor's worker count (0, the default, means one per hardware
+         * thread). Takes effect when the workers start, so call before submitting tasks.
+         * @return false if the workers are already running.
+         */
+        bool SetExecutorThreads(size_t threads) { return Tasks().SetThreadCount(threads); }
+
+        /**
+         * @brief Blocks until every submitted task has finished. Must not be called from a task.
+         */
+        void WaitForTasks() {
+            if (Executor* executor = m_executor.Find()) executor->WaitIdle();
+        }
+
+        Executor::Stats GetExecutorStats() const {
+            const Executor* executor = m_executor.Find();
+            return executor ? executor->GetStats() : Executor::Stats();
+        }
+
+        /**
+         * @brief Drives a topic from a coroutine (see TopicStream), typically started in
+         * ConnectData: StartTopicStream(TopicID, MyFeed(symbol)). The coroutine runs on the
+         * executor; each co_yield publishes to the topic and schedules one coalesced
+         * NotifyUpdate. DisconnectData or ServerTerminate destroys the frame, and starting
+         * another stream for the TopicID replaces this one.
+         * @return HRESULT S_OK if started, E_INVALIDARG if the TopicID is out of range,
+         * E_OUTOFMEMORY if the frame could not be allocated, E_ABORT if the executor is
+         * shutting down.
+         */
+        HRESULT StartTopicStream(long topicId, TopicStream stream) {
+            if (!stream) return E_OUTOFMEMORY;
+            std::shared_ptr<TopicStream::Control> control;
+            std::shared_ptr<TopicStream::Control> previous;
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                TopicHandle handle;
+                {
+                    std::lock_guard<std::mutex> shardLock(m_shards.ShardOf(topicId).mutex);
+                    TopicStore::Slot* slot = AcquireSlot(topicId);
+                    if (!slot) return E_INVALIDARG;
+                    handle.topicId = topicId;
+                    handle.generation = slot->generation;
+                }
+                control = stream.Attach(*this, handle);
+                if (!control) return E_OUTOFMEMORY;
+                if (static_cast<size_t>(topicId) >= m_streams.size()) m_streams.resize(static_cast<size_t>(topicId) + 1);
+                previous = std::exchange(m_streams[topicId], control);
+            }
+            if (previous) previous->Cancel();
+            return control->Start() ? S_OK : E_ABORT;
+        }
+
+        /**
+         * @brief Interns string values so RefreshData can hand out pre-built BSTRs.
+         * Suited to string topics that cycle through a small set of values (status codes,
+         * exchange names, "Open"/"Halted"). Producers build the BSTR copies when they publish,
+         * so RefreshData rarely allocates. Every delivered BSTR is still a separate allocation
+         * owned by Excel; the pool never hands out the same BSTR twice.
+         * Call before producers start publishing.
+         * @param maxEntries Distinct values kept; least recently used values are evicted.
+         * @param maxSparesPerEntry Upper bound on pre-built BSTRs kept per value.
+         * @param maxLength Longer strings are not interned.
+         */
+        void EnableStringInterning(size_t maxEntries = BstrPool::kDefaultMaxEntries,
+                                   size_t maxSparesPerEntry = BstrPool::kDefaultMaxSpares,
+                                   size_t maxLength = BstrPool::kDefaultMaxLength) {
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            m_stringPool = std::make_unique<BstrPool>(maxEntries, maxSparesPerEntry, maxLength);
+        }
+
+        /**
+         * @brief Returns the interning pool's counters (all zero when interning is disabled).
+         */
+        BstrPool::Stats GetStringPoolStats() {
+            return m_stringPool ? m_stringPool->GetStats() : BstrPool::Stats();
+        }
+
+        /**
+         * @brief Keeps each subscription's last delivered value in a memory-mapped file, so
+         * the next session starts from it instead of #GETTING_DATA. RefreshData updates one
+         * record per delivered topic; the file is keyed by canonical subscription key, since
+         * Excel hands out new TopicIDs every session. ConnectData answers a new key from its
+         * record (the value is shown until the feed publishes), and ServerStart re-subscribes
+         * upstream to every key of the previous session (see SetSnapshotPrewarm).
+         * Only applies to the default ConnectData. Call before ServerStart, typically from the
+         * derived server's constructor.
+         * @param capacity Records in a new file; an existing file keeps its own.
+         * @return HRESULT S_OK on success, or the file error (the server then runs without one).
+         */
+        HRESULT EnableSnapshot(const std::wstring& path, uint32_t capacity = TopicSnapshot::kDefaultCapacity) {
+            auto snapshot = std::make_unique<TopicSnapshot>();
+            HRESULT hr = snapshot->Open(path, capacity);
+            if (FAILED(hr)) return hr;
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            m_snapshot = std::move(snapshot);
+            m_prewarmDone = false;
+            return S_OK;
+        }
+
+        /**
+         * @brief Sets how long keys subscribed upstream from the snapshot at ServerStart stay
+         * open without a TopicID; keys the reopened workbooks never connect are then
+         * unsubscribed and dropped from the file. 0 disables pre-warming: the snapshot only
+         * answers ConnectData. Default 30 seconds.
+         */
+        void SetSnapshotPrewarm(std::chrono::milliseconds grace) {
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            m_prewarmGrace = grace;
+        }
+
+        /**
+         * @brief Returns the snapshot's counters (all zero when no snapshot is enabled).
+         */
+        TopicSnapshot::Stats GetSnapshotStats() {
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            return m_snapshot ? m_snapshot->GetStats() : TopicSnapshot::Stats();
+        }
+
+    protected:
+        static bool IsStatsTopic(const TopicArgs& args) {
+            return !args.Empty() && args[0] == kStatsNamespace;
+        }
+
+        /**
+         * @brief Serves =RTD(progId,, "__stats", "<metric>") from the server's own counters.
+         * The default ConnectData routes the reserved namespace here; servers overriding
+         * ConnectData can forward to it when IsStatsTopic(args) holds. Values are recomputed
+         * every stats interval while any stats topic is connected. Unknown metrics get #N/A.
+         */
+        HRESULT ConnectStatsTopic(long TopicID, const TopicArgs& args, VARIANT_BOOL* GetNewValues, VARIANT* pvarOut) {
+            if (!pvarOut) return E_POINTER;
+            VariantInit(pvarOut);
+            StatsMetric metric;
+            if (args.Count() != 2 || !ParseStatsMetric(args[1], metric)) {
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2042; // xlErrNA
+                return S_OK;
+            }
+
+            std::chrono::milliseconds interval;
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                {
+                    std::lock_guard<std::mutex> shardLock(m_shards.ShardOf(TopicID).mutex);
+                    if (!AcquireSlot(TopicID)) return E_INVALIDARG;
+                }
+                DropStatsTopic(TopicID);
+                m_statsTopics.emplace_back(TopicID, metric);
+                if (m_rateSampledAt == std::chrono::steady_clock::time_point()) {
+                    m_rateBaseline = m_counters.Sum(Counter::UpdatesIngested);
+                    m_rateSampledAt = std::chrono::steady_clock::now();
+                }
+                pvarOut->vt = VT_R8;
+                pvarOut->dblVal = StatsValue(metric);
+                interval = m_statsInterval;
+            }
+            if (GetNewValues) *GetNewValues = VARIANT_TRUE;
+            StatsTicker().ScheduleAt(std::chrono::steady_clock::now() + interval);
+            return S_OK;
+        }
+
+        /**
+         * @brief Called by the default ConnectData when the first TopicID for a key connects.
+         * Start the upstream feed here and publish with UpdateSubscription. The args views
+         * are only valid during the call. Runs without the topic lock held.
+         * @return A failure HRESULT rejects the connection.
+         */
+        virtual HRESULT OnSubscribe(const SubscriptionHandle& subscription, const TopicArgs& args) {
+            (void)subscription;
+            (void)args;
+            return S_OK;
+        }
+
+        /**
+         * @brief Called when the last TopicID of a subscription disconnects; the handle is
+         * already stale. Runs without the topic lock held.
          */
-        HRESULT UpdateTopic(long topicId, const VARIANT& value) {
+        virtual void OnUnsubscribe(const SubscriptionHandle& subscription) {
+            (void)subscription;
+        }
+
+        // Caller holds m_topicMutex. Gives a new subscription its key's snapshot record and
+        // the value stored there.
+        void SeedFromSnapshot(long subscriptionId) {
+            SubscriptionTable::Subscription* sub = m_subscriptions.Find(subscriptionId);
+            sub->snapshotRecord = m_snapshot->Claim(sub->key);
+            if (sub->snapshotRecord != TopicSnapshot::kNil && !sub->hasValue) {
+                sub->hasValue = m_snapshot->Read(sub->snapshotRecord, sub->value);
+            }
+        }
+
+        // Caller holds m_topicMutex.
+        bool IsSubscribed(long topicId) {
+            std::lock_guard<std::mutex> shardLock(m_shards.ShardOf(topicId).mutex);
+            TopicStore::Slot* slot = FindSlot(topicId);
+            return slot && slot->subscription != TopicStore::kNil;
+        }
+
+        // Caller holds m_topicMutex and has drained pending updates. Ends a TopicID's
+        // connection: detaches it from its subscription, releases its slot and takes its
+        // stream, which the caller cancels outside the lock. Returns the subscription this
+        // closed, for the caller to pass to OnUnsubscribe (also outside the lock).
+        SubscriptionHandle DetachTopic(long topicId, std::shared_ptr<TopicStream::Control>& stream) {
+            SubscriptionHandle closed;
+            if (!m_statsTopics.empty()) DropStatsTopic(topicId);
+            {
+                std::lock_guard<std::mutex> shardLock(m_shards.ShardOf(topicId).mutex);
+                TopicStore::Slot* slot = FindSlot(topicId);
+                if (slot && slot->subscription != TopicStore::kNil) {
+                    SubscriptionHandle handle = m_subscriptions.HandleOf(slot->subscription);
+                    SubscriptionTable::Subscription* sub = m_subscriptions.Find(handle);
+                    long record = sub ? sub->snapshotRecord : TopicSnapshot::kNil;
+                    if (m_subscriptions.Detach(slot->subscription, topicId)) {
+                        closed = handle;
+                        // The record keeps its value: Excel disconnects every topic before it exits
+                        if (m_snapshot) m_snapshot->Release(record);
+                    }
+                }
+                ReleaseSlot(topicId);
+            }
+            stream = TakeStream(topicId);
+            return closed;
+        }
+
+        // Caller holds m_topicMutex. OnSubscribe failed: closes the subscription and gives
+        // #N/A to every TopicID that joined it while OnSubscribe ran, since their ConnectData
+        // has already returned. exceptTopicId (the failing ConnectData's own) is left to the
+        // caller. Returns the number of TopicIDs marked for refresh.
+        size_t FailSubscription(const SubscriptionHandle& handle, long exceptTopicId) {
+            SubscriptionTable::Subscription* sub = m_subscriptions.Find(handle);
+            if (!sub) return 0;
+            if (m_snapshot) m_snapshot->Release(sub->snapshotRecord);
+            std::vector<long> joined = sub->topicIds;
+            size_t failed = 0;
+            for (long topicId : joined) {
+                m_subscriptions.Detach(handle.id, topicId);
+                if (topicId == exceptTopicId) continue;
+                std::lock_guard<std::mutex> shardLock(m_shards.ShardOf(topicId).mutex);
+                TopicStore::Slot* slot = FindSlot(topicId);
+                if (!slot) continue;
+                slot->subscription = TopicStore::kNil;
+                slot->value.SetError(2042); // xlErrNA
+                MarkDirty(topicId);
+                ++failed;
+            }
+            m_subscriptions.CloseIfUnused(handle);
+            return failed;
+        }
+
+        // Subscribes upstream to the previous session's keys (once per snapshot), so fresh
+        // values are flowing by the time the workbooks reconnect their topics.
+        void PrewarmFromSnapshot() {
+            std::vector<SubscriptionHandle> handles;
+            std::vector<std::wstring> keys;
+            std::chrono::milliseconds grace;
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                if (!m_snapshot || m_prewarmDone || m_prewarmGrace.count() <= 0) return;
+                m_prewarmDone = true;
+                grace = m_prewarmGrace;
+                for (long record : m_snapshot->Restored()) {
+                    std::wstring key = m_snapshot->Key(record);
+                    bool created = false;
+                    long id = m_subscriptions.Open(TopicArgs::FromKey(key), created);
+                    if (!created) continue;
+                    SeedFromSnapshot(id);
+                    handles.push_back(m_subscriptions.HandleOf(id));
+                    keys.push_back(std::move(key));
+                }
+            }
+            if (handles.empty()) return;
+
+            // Outside the lock, as in ConnectData
+            std::vector<SubscriptionHandle> subscribed;
+            size_t failed = 0;
+            for (size_t i = 0; i < handles.size(); ++i) {
+                if (SUCCEEDED(OnSubscribe(handles[i], TopicArgs::FromKey(keys[i])))) {
+                    subscribed.push_back(handles[i]);
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                failed += FailSubscription(handles[i], TopicStore::kNil);
+            }
+            if (failed) NotifyUpdate();
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                m_prewarmed.insert(m_prewarmed.end(), subscribed.begin(), subscribed.end());
+            }
+            m_prewarmSweeper.Get([this]() {
+                return std::make_unique<DeferredNotifier>([this]() { ClosePrewarmed(true); });
+            }).ScheduleAt(DeferredNotifier::Clock::now() + grace);
+        }
+
+        // Unsubscribes prewarmed keys that no TopicID attached to. With forget set (the grace
+        // period ran out) their records are dropped as well; at ServerTerminate they are kept,
+        // since the session may simply have been too short to reach those workbooks.
+        void ClosePrewarmed(bool forget) {
+            std::vector<SubscriptionHandle> closed;
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                for (const SubscriptionHandle& handle : m_prewarmed) {
+                    SubscriptionTable::Subscription* sub = m_subscriptions.Find(handle);
+                    if (!sub || !sub->topicIds.empty()) continue;
+                    if (forget) m_snapshot->Erase(sub->snapshotRecord);
+                    else m_snapshot->Release(sub->snapshotRecord);
+                    m_subscriptions.CloseIfUnused(handle);
+                    closed.push_back(handle);
+                }
+                m_prewarmed.clear();
+            }
+            for (const SubscriptionHandle& handle : closed) OnUnsubscribe(handle);
+        }
+
+        // Slot access by TopicID. Caller holds the topic's shard lock (m_shards.ShardOf(topicId).mutex).
+        TopicStore::Slot* FindSlot(long topicId) {
+            return m_shards.ShardOf(topicId).store.Find(m_shards.LocalId(topicId));
+        }
+        TopicStore::Slot* AcquireSlot(long topicId) {
+            if (!TopicStore::IsValidId(topicId)) return nullptr;
+            return m_shards.ShardOf(topicId).store.Acquire(m_shards.LocalId(topicId));
+        }
+        void ReleaseSlot(long topicId) {
+            m_shards.ShardOf(topicId).store.Release(m_shards.LocalId(topicId));
+        }
+        // Slot for an update by TopicID: beyond the update limit only a connected topic has one.
+        TopicStore::Slot* AcquireUpdateSlot(long topicId) {
+            if (topicId >= m_updateIdLimit.load(std::memory_order_relaxed)) return FindSlot(topicId);
+            return AcquireSlot(topicId);
+        }
+
+    private:
+        // --- StreamHost ---
+        HRESULT PublishStreamValue(const TopicHandle& topic, TopicValue&& value) override {
+            HRESULT hr = Publish(topic, std::move(value));
+            if (SUCCEEDED(hr)) Notifier().ScheduleAt(DeferredNotifier::Clock::now());
+            return hr;
+        }
+        Executor& StreamExecutor() override { return Tasks(); }
+        TimerWheel& StreamTimers() override {
+            return m_timers.Get([]() { return std::make_unique<TimerWheel>(); });
+        }
+
+        // --- Workers built on first use (see detail::OnDemand) ---
+        Executor& Tasks() {
+            return m_executor.Get([]() { return std::make_unique<Executor>(); });
+        }
+        DeferredNotifier& Notifier() {
+            return m_notifier.Get([this]() {
+                return std::make_unique<DeferredNotifier>([this]() {
+                    m_cadence.ClearDeferred();
+                    NotifyUpdate();
+                });
+            });
+        }
+        DeferredNotifier& StatsTicker() {
+            return m_statsTicker.Get([this]() { return std::make_unique<DeferredNotifier>([this]() { PublishStats(); }); });
+        }
+
+        // Joins every worker thread that was ever started. Must not run on one of them.
+        void StopWorkers() {
+            if (Executor* executor = m_executor.Find()) executor->Stop();
+            if (TimerWheel* timers = m_timers.Find()) timers->Stop();
+            if (DeferredNotifier* notifier = m_notifier.Find()) notifier->Stop();
+            if (DeferredNotifier* ticker = m_statsTicker.Find()) ticker->Stop();
+            if (DeferredNotifier* sweeper = m_prewarmSweeper.Find()) sweeper->Stop();
+        }
+
+        // Caller holds m_topicMutex.
+        std::shared_ptr<TopicStream::Control> TakeStream(long topicId) {
+            if (topicId < 0 || static_cast<size_t>(topicId) >= m_streams.size()) return nullptr;
+            return std::move(m_streams[topicId]);
+        }
+
+        void CancelStreams() {
+            std::vector<std::shared_ptr<TopicStream::Control>> streams;
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                streams.swap(m_streams);
+            }
+            for (auto& stream : streams) {
+                if (stream) stream->Cancel();
+            }
+        }
+
+        // Caller holds m_topicMutex.
+        double StatsValue(StatsMetric metric) {
+            switch (metric) {
+            case StatsMetric::UpdatesIngested: return static_cast<double>(m_counters.Sum(Counter::UpdatesIngested));
+            case StatsMetric::UpdatesPerSec: return m_updatesPerSec;
+            case StatsMetric::UpdatesConflated: return static_cast<double>(m_counters.Sum(Counter::UpdatesConflated));
+            case StatsMetric::UpdatesSuppressed:
+                return static_cast<double>(m_counters.Sum(Counter::DroppedUnchanged) + m_counters.Sum(Counter::DroppedDeadband));
+            case StatsMetric::RefreshCalls: return static_cast<double>(m_counters.Sum(Counter::RefreshCalls));
+            case StatsMetric::LastBatch: return static_cast<double>(m_lastBatch);
+            case StatsMetric::MaxBatch: return static_cast<double>(m_maxBatch);
+            case StatsMetric::AvgBatch: {
+                unsigned long long calls = m_counters.Sum(Counter::RefreshCalls);
+                return calls ? static_cast<double>(m_counters.Sum(Counter::TopicsDelivered)) / calls : 0.0;
+            }
+            case StatsMetric::NotifyCalls: return static_cast<double>(m_counters.Sum(Counter::NotifyCalls));
+            case StatsMetric::LiveTopics:
+            case StatsMetric::StoreBytes: {
+                size_t total = 0;
+                for (size_t s = 0; s < m_shards.Count(); ++s) {
+                    std::lock_guard<std::mutex> shardLock(m_shards[s].mutex);
+                    const TopicStore& store = m_shards[s].store;
+                    total += metric == StatsMetric::LiveTopics ? store.LiveCount() : store.MemoryBytes();
+                }
+                return static_cast<double>(total);
+            }
+            case StatsMetric::RefreshDeferred: return static_cast<double>(m_counters.Sum(Counter::TopicsDeferred));
+            case StatsMetric::NotifyAbsorbed: return static_cast<double>(m_counters.Sum(Counter::NotifyAbsorbed));
+            case StatsMetric::RefreshIntervalMs: return m_cadence.Read().intervalMs;
+            case StatsMetric::RefreshLatencyMs: return m_cadence.Read().latencyMs;
+            case StatsMetric::ExcelThrottleMs: return m_cadence.Read().throttleMs;
+            }
+            return 0.0;
+        }
+
+        // Caller holds m_topicMutex.
+        void DropStatsTopic(long topicId) {
+            for (size_t i = 0; i < m_statsTopics.size(); ++i) {
+                if (m_statsTopics[i].first == topicId) {
+                    m_statsTopics[i] = m_statsTopics.back();
+                    m_statsTopics.pop_back();
+                    return;
+                }
+            }
+        }
+
+        // Runs on the stats ticker's thread: refreshes every stats topic, then re-arms itself.
+        void PublishStats() {
+            auto now = std::chrono::steady_clock::now();
+            std::chrono::milliseconds interval;
+            {
+                std::lock_guard<std::mutex> lock(m_topicMutex);
+                if (m_statsTopics.empty()) return;
+
+                unsigned long long ingested = m_counters.Sum(Counter::UpdatesIngested);
+                if (m_rateSampledAt != std::chrono::steady_clock::time_point()) {
+                    double seconds = std::chrono::duration<double>(now - m_rateSampledAt).count();
+                    if (seconds > 0.0) m_updatesPerSec = static_cast<double>(ingested - m_rateBaseline) / seconds;
+                }
+                m_rateBaseline = ingested;
+                m_rateSampledAt = now;
+
+                for (auto const& entry : m_statsTopics) {
+                    double value = StatsValue(entry.second);
+                    std::lock_guard<std::mutex> shardLock(m_shards.ShardOf(entry.first).mutex);
+                    TopicStore::Slot* slot = FindSlot(entry.first);
+                    if (!slot) continue;
+                    slot->value.Assign(value);
+                    MarkDirty(entry.first);
+                }
+                interval = m_statsInterval;
+            }
+            NotifyUpdate();
+            StatsTicker().ScheduleAt(now + interval);
+        }
+
+        // Caller holds m_topicMutex. Pops every shard's dirty list into its dueIds, leaving
+        // topics that their delivery policy holds back dirty and scheduling a notify for them.
+        // With a batch cap, only the top m_maxRefreshBatch by priority stay due.
+        // Returns the number of due topics.
+        size_t CollectDueTopics() {
+            auto now = PolicyState::Clock::now();
+            auto nextDue = PolicyState::Clock::time_point::max();
+            size_t total = 0;
+            std::vector<long> heldTopics;
+            // Throttle state is only charged once the batch is final
+            const bool capped = m_maxRefreshBatch != 0;
+
+            for (size_t s = 0; s < m_shards.Count(); ++s) {
+                TopicShards::Shard& shard = m_shards[s];
+                std::lock_guard<std::mutex> shardLock(shard.mutex);
+                TopicStore& store = shard.store;
+                std::vector<long>& due = shard.dueIds;
+                due.clear();
+                if (store.DirtyCount() == 0) continue;
+                due.reserve(store.DirtyCount());
+
+                // Disconnected topics are unlinked from the dirty list, so every slot here is live
+                for (long localId = store.PopDirty(); localId != TopicStore::kNil; localId = store.PopDirty()) {
+                    PolicyState& policy = store.At(localId).policy;
+                    if (policy.policy.IsThrottled()) {
+                        PolicyState::Clock::time_point dueAt;
+                        if (!policy.IsDue(now, dueAt)) {
+                            heldTopics.push_back(localId);
+                            if (dueAt < nextDue) nextDue = dueAt;
+                            continue;
+                        }
+                        if (!capped) policy.OnDelivered(now);
+                    }
+                    due.push_back(localId);
+                }
+
+                // Held-back topics keep their (conflated) pending value for a later refresh
+                for (long localId : heldTopics) store.MarkDirty(localId);
+                heldTopics.clear();
+                total += due.size();
+            }
+            if (capped && total > 0) {
+                if (total > m_maxRefreshBatch) {
+                    total = TrimDueTopics();
+                    nextDue = now; // Follow-up notify for the topics left out
+                }
+                for (size_t s = 0; s < m_shards.Count(); ++s) {
+                    TopicShards::Shard& shard = m_shards[s];
+                    if (shard.dueIds.empty()) continue;
+                    std::lock_guard<std::mutex> shardLock(shard.mutex);
+                    for (long localId : shard.dueIds) {
+                        PolicyState& policy = shard.store.At(localId).policy;
+                        if (policy.policy.IsThrottled()) policy.OnDelivered(now);
+                        policy.passedOver = 0;
+                    }
+                }
+            }
+            if (nextDue != PolicyState::Clock::time_point::max()) Notifier().ScheduleAt(nextDue);
+            return total;
+        }
+
+        // Caller holds m_topicMutex. Keeps the m_maxRefreshBatch due topics with the highest
+        // effective priority (oldest first among equals) and puts the rest back on their
+        // dirty lists, one level more urgent. Returns the number kept.
+        size_t TrimDueTopics() {
+            TopicShards::AllLock lock(m_shards);
+            std::vector<DueCandidate>& candidates = m_dueCandidates;
+            candidates.clear();
+            for (size_t s = 0; s < m_shards.Count(); ++s) {
+                TopicShards::Shard& shard = m_shards[s];
+                for (size_t i = 0; i < shard.dueIds.size(); ++i) {
+                    long localId = shard.dueIds[i];
+                    candidates.push_back({ shard.store.At(localId).policy.EffectivePriority(), i, s, localId });
+                }
+                shard.dueIds.clear();
+            }
+
+            size_t keep = m_maxRefreshBatch;
+            auto first = [](const DueCandidate& a, const DueCandidate& b) {
+                return a.priority != b.priority ? a.priority > b.priority : a.order < b.order;
+            };
+            std::nth_element(candidates.begin(), candidates.begin() + (keep - 1), candidates.end(), first);
+            // Re-queue in dirty-list order so the left-out topics keep their relative age
+            std::sort(candidates.begin() + keep, candidates.end(), [](const DueCandidate& a, const DueCandidate& b) {
+                return a.order < b.order;
+            });
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                const DueCandidate& candidate = candidates[i];
+                TopicShards::Shard& shard = m_shards[candidate.shard];
+                if (i < keep) {
+                    shard.dueIds.push_back(candidate.localId);
+                } else {
+                    ++shard.store.At(candidate.localId).policy.passedOver;
+                    shard.store.MarkDirty(candidate.localId);
+                }
+            }
+            m_counters.Add(Counter::TopicsDeferred, static_cast<unsigned long long>(candidates.size() - keep));
+            return keep;
+        }
+
+        // Pre-builds a BSTR for string values on the producer thread, before any topic lock.
+        void PrepareString(std::wstring_view value) {
+            if (m_stringPool) m_stringPool->Prepare(value);
+        }
+        void PrepareString(const VARIANT& value) {
+            if (m_stringPool && value.vt == VT_BSTR && value.bstrVal) {
+                m_stringPool->Prepare(std::wstring_view(value.bstrVal, SysStringLen(value.bstrVal)));
+            }
+        }
+        void PrepareString(const TopicValue& value) {
+            if (m_stringPool && value.GetType() == TopicValue::Type::String) m_stringPool->Prepare(value.AsString());
+        }
+        template <typename T>
+        void PrepareString(const T&) {}
+
+        template <typename T>
+        HRESULT Publish(long topicId, T&& value) {
+            m_counters.Add(Counter::UpdatesIngested);
+            PrepareString(value);
+            if (m_ingestMode.load(std::memory_order_relaxed) == IngestMode::LockFree) {
+                if (!TopicStore::IsValidId(topicId)) return E_INVALIDARG;
+                return EnqueueUpdate(topicId, 0, false, std::forward<T>(value));
+            }
+
+            std::lock_guard<std::mutex> lock(m_shards.ShardOf(topicId).mutex);
+            // Updates ahead of ConnectData are allowed below the update limit; the slot is created on demand.
+            TopicStore::Slot* slot = AcquireUpdateSlot(topicId);
+            if (!slot) return E_INVALIDARG;
+            return StoreValue(topicId, *slot, std::forward<T>(value));
+        }
+
+        template <typename T>
+        HRESULT Publish(const TopicHandle& handle, T&& value) {
+            m_counters.Add(Counter::UpdatesIngested);
+            PrepareString(value);
+            if (m_ingestMode.load(std::memory_order_relaxed) == IngestMode::LockFree) {
+                return EnqueueUpdate(handle.topicId, handle.generation, true, std::forward<T>(value));
+            }
+
+            std::lock_guard<std::mutex> lock(m_shards.ShardOf(handle.topicId).mutex);
+            TopicStore::Slot* slot = FindSlot(handle.topicId);
+            if (!slot || slot->generation != handle.generation) return E_HANDLE;
+            return StoreValue(handle.topicId, *slot, std::forward<T>(value));
+        }
+
+        template <typename T>
+        HRESULT PublishBatch(std::span<const long> ids, std::span<const T> values) {
+            if (ids.size() != values.size()) return E_INVALIDARG;
+            if (ids.empty()) return S_OK;
+            m_counters.Add(Counter::UpdatesIngested, ids.size());
+            if (m_stringPool) {
+                for (const T& value : values) PrepareString(value);
+            }
+
+            HRESULT result = S_OK;
+            size_t applied = 0;
+            {
+                std::unique_lock<std::mutex> drainLock;
+                if (m_ingestor.RingCount() != 0) {
+                    drainLock = std::unique_lock<std::mutex>(m_topicMutex);
+                    DrainPendingUpdates();
+                }
+                const long* id = ids.data();
+                const T* value = values.data();
+                size_t n = ids.size();
+                auto apply = [&](size_t i) {
+                    TopicStore::Slot* slot = AcquireUpdateSlot(id[i]);
+                    HRESULT hr = slot ? StoreValue(id[i], *slot, value[i]) : E_INVALIDARG;
+                    if (hr == S_OK) ++applied;
+                    else if (SUCCEEDED(result)) result = hr;
+                };
+                size_t shards = m_shards.Count();
+                if (shards == 1) {
+                    std::lock_guard<std::mutex> lock(m_shards[0].mutex);
+                    for (size_t i = 0; i < n; ++i) apply(i);
+                } else {
+                    // Counting sort by shard, keeping each shard's entries in batch order
+                    size_t start[TopicShards::kMaxShards + 1] = {};
+                    for (size_t i = 0; i < n; ++i) ++start[m_shards.IndexOf(id[i]) + 1];
+                    for (size_t s = 0; s < shards; ++s) start[s + 1] += start[s];
+                    size_t next[TopicShards::kMaxShards];
+                    std::copy(start, start + shards, next);
+                    std::vector<size_t>& order = BatchOrder();
+                    order.resize(n);
+                    for (size_t i = 0; i < n; ++i) order[next[m_shards.IndexOf(id[i])]++] = i;
+                    for (size_t s = 0; s < shards; ++s) {
+                        if (start[s] == start[s + 1]) continue;
+                        std::lock_guard<std::mutex> lock(m_shards[s].mutex);
+                        for (size_t k = start[s]; k < start[s + 1]; ++k) apply(order[k]);
+                    }
+                }
+            }
+            if (applied) NotifyUpdate();
+            return result;
+        }
+
+        // Scratch for bucketing a batch by shard; per thread, since producers publish concurrently
+        static std::vector<size_t>& BatchOrder() {
+            static thread_local std::vector<size_t> order;
+            return order;
+        }
+
+        template <typename T>
+        HRESULT FanOut(const SubscriptionHandle& subscription, T&& value) {
+            m_counters.Add(Counter::UpdatesIngested);
+            PrepareString(value);
             std::lock_guard<std::mutex> lock(m_topicMutex);
+            size_t applied = 0;
+            return FanOutLocked(subscription, std::forward<T>(value), applied);
+        }
 
-            // Store the new value
-            auto it = m_topicData.find(topicId);
-            if (it == m_topicData.end()) {
-                // This can happen if Update is called before ConnectData completes.
-                // For simplicity, we'll allow it.
-                m_topicData[topicId];
-                it = m_topicData.find(topicId);
-                VariantInit(&it->second);
+        // Caller holds m_topicMutex. Adds the number of TopicIDs updated to applied.
+        template <typename T>
+        HRESULT FanOutLocked(const SubscriptionHandle& subscription, T&& value, size_t& applied) {
+            SubscriptionTable::Subscription* sub = m_subscriptions.Find(subscription);
+            if (!sub) return E_HANDLE;
+            HRESULT hr = sub->value.Assign(std::forward<T>(value));
+            if (FAILED(hr)) return hr;
+            sub->hasValue = true;
+            for (long topicId : sub->topicIds) {
+                std::lock_guard<std::mutex> shardLock(m_shards.ShardOf(topicId).mutex);
+                TopicStore::Slot* slot = FindSlot(topicId);
+                if (slot && StoreValue(topicId, *slot, static_cast<const TopicValue&>(sub->value)) == S_OK) ++applied;
             }
-             VariantCopy(&it->second, const_cast<VARIANT*>(&value));
+            return S_OK;
+        }
 
-            // Mark as dirty (if not already)
-            if (std::find(m_dirtyTopics.begin(), m_dirtyTopics.end(), topicId) == m_dirtyTopics.end()) {
-                m_dirtyTopics.push_back(topicId);
+        // Caller holds the topic's shard lock. Returns false (and counts it) if the topic's
+        // policy filters drop the update.
+        template <typename T>
+        bool PassesFilter(const TopicStore::Slot& slot, const T& value) {
+            switch (slot.policy.policy.Filter(slot.value, value)) {
+            case UpdateFilter::Accept: return true;
+            case UpdateFilter::Unchanged: m_counters.Add(Counter::DroppedUnchanged); return false;
+            case UpdateFilter::Deadband: m_counters.Add(Counter::DroppedDeadband); return false;
             }
+            return true;
+        }
+
+        // Caller holds the topic's shard lock.
+        void MarkDirty(long topicId) {
+            m_shards.ShardOf(topicId).store.MarkDirty(m_shards.LocalId(topicId));
+        }
+
+        // Caller holds the topic's shard lock. Assigning in place reuses the slot's string
+        // buffer. Returns S_FALSE if a policy filter dropped the update.
+        template <typename T>
+        HRESULT StoreValue(long topicId, TopicStore::Slot& slot, T&& value) {
+            if (!PassesFilter(slot, value)) return S_FALSE;
+            HRESULT hr = slot.value.Assign(std::forward<T>(value));
+            if (FAILED(hr)) return hr;
+            if (slot.dirty) m_counters.Add(Counter::UpdatesConflated);
+            else MarkDirty(topicId);
             return S_OK;
         }
 
-        // User must implement:
-        // ConnectData
-        virtual HRESULT __stdcall ConnectData(long TopicID, SAFEARRAY** Strings, VARIANT_BOOL* GetNewValues, VARIANT* pvarOut) override = 0;
+        template <typename T>
+        HRESULT EnqueueUpdate(long topicId, unsigned long generation, bool byHandle, T&& value) {
+            PendingUpdate update;
+            update.topicId = topicId;
+            update.generation = generation;
+            update.byHandle = byHandle;
+            // Any copy (long strings, non-scalar VARIANTs) happens here, outside every lock
+            HRESULT hr = update.value.Assign(std::forward<T>(value));
+            if (FAILED(hr)) return hr;
+
+            UpdateIngestor::Ring* ring = m_ingestor.LocalRing();
+            if (ring && ring->TryPush(std::move(update))) return S_OK;
+
+            // Ring full (or no ring available): flush everything queued so far, then apply
+            // this update directly, so it cannot be overwritten by an older queued value.
+            std::lock_guard<std::mutex> lock(m_topicMutex);
+            TopicShards::AllLock shards(m_shards);
+            m_ingestor.Drain([this](PendingUpdate& pending) { ApplyPendingUpdate(pending); });
+            return ApplyPendingUpdate(update);
+        }
+
+        // Caller holds m_topicMutex and every shard lock. Takes ownership of update.value.
+        HRESULT ApplyPendingUpdate(PendingUpdate& update) {
+            TopicStore::Slot* slot = update.byHandle ? FindSlot(update.topicId) : AcquireUpdateSlot(update.topicId);
+            if (!slot || (update.byHandle && slot->generation != update.generation)) {
+                update.value.Clear();
+                return update.byHandle ? E_HANDLE : E_INVALIDARG;
+            }
+            if (!PassesFilter(*slot, update.value)) {
+                update.value.Clear();
+                return S_FALSE;
+            }
+            slot->value = std::move(update.value);
+            if (slot->dirty) m_counters.Add(Counter::UpdatesConflated);
+            else MarkDirty(update.topicId);
+            return S_OK;
+        }
+
+        // Caller holds m_topicMutex. Shard locks are only taken once a producer ring exists.
+        void DrainPendingUpdates() {
+            if (m_ingestor.RingCount() == 0) return;
+            TopicShards::AllLock shards(m_shards);
+            m_ingestor.Drain([this](PendingUpdate& update) { ApplyPendingUpdate(update); });
+        }
+
     };
 
 } // namespace rtd
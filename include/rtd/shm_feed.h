@@ -0,0 +1,474 @@
+#ifndef RTD_SHM_FEED_H
+#define RTD_SHM_FEED_H
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "feed_protocol.h"
+#include "server.h"
+#include "value.h"
+
+namespace rtd {
+
+    /**
+     * @brief One update in a shared-memory feed ring: 128 bytes, little-endian, no pointers,
+     * so producers in other languages can write it directly.
+     *
+     *   offset  0  uint64      sequence   ring protocol (see ShmFeedHeader)
+     *   offset  8  uint64      key        topic key: the TopicID unless the reader maps keys
+     *   offset 16  int64       timestamp  producer steady clock in ns (QueryPerformanceCounter); 0 = none
+     *   offset 24  uint32      type       FeedValueType
+     *   offset 28  uint32      length     String length in UTF-16 units (at most kMaxText)
+     *   offset 32  float64     number     Double
+     *   offset 40  int64       integer    Int64; Bool as 0/1; Error as the Excel code (2042 = #N/A)
+     *   offset 48  uint16[40]  text       String, not terminated
+     */
+    struct FeedRecord {
+        static constexpr size_t kMaxText = 40;
+
+        std::atomic<uint64_t> sequence;
+        uint64_t key;
+        int64_t timestamp;
+        uint32_t type;
+        uint32_t length;
+        double number;
+        int64_t integer;
+        uint16_t text[kMaxText];
+    };
+    static_assert(sizeof(FeedRecord) == 128, "FeedRecord is a fixed wire layout");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "The ring needs lock-free 64-bit atomics");
+
+    /**
+     * @brief Start of a shared-memory feed mapping; the records begin at kRecordsOffset.
+     *
+     * The ring is a bounded multi-producer, single-consumer queue (Vyukov's): record i
+     * starts with sequence i. A producer claims position p by moving tail from p to p+1
+     * with a compare-and-swap when record p % capacity has sequence p, writes the record
+     * and stores sequence p+1. The consumer reads record head % capacity once its sequence
+     * is head+1, then stores head+capacity to hand it back. When the ring is full the
+     * producer counts the update in dropped and gets it back (it may retry). After a push,
+     * a producer that sees consumerSleeping set signals the "<name>_wake" event.
+     *
+     * The reader creates and initialises the mapping and stores magic last; producers open
+     * it and check magic, version and recordSize. A stopping reader sets closed: producers
+     * then stop pushing and should close their handles, since the name stays taken (and a
+     * new reader cannot create it) while any process has the mapping open.
+     */
+    struct ShmFeedHeader {
+        static constexpr uint32_t kMagic = 0x46445452; // "RTDF"
+        static constexpr uint32_t kVersion = 1;
+        static constexpr size_t kRecordsOffset = 256;
+
+        std::atomic<uint32_t> magic;
+        uint32_t version;
+        uint32_t capacity;   // Records; a power of two
+        uint32_t recordSize;
+        std::atomic<uint32_t> consumerSleeping;
+        std::atomic<uint32_t> closed;
+        std::atomic<uint64_t> dropped; // Pushes refused because the ring was full
+        alignas(64) std::atomic<uint64_t> tail; // Next position producers claim
+        alignas(64) std::atomic<uint64_t> head; // Next position the consumer reads
+    };
+    static_assert(sizeof(ShmFeedHeader) <= ShmFeedHeader::kRecordsOffset, "Header overlaps the records");
+
+    /**
+     * @brief Owns one view of a named feed mapping and its wake event.
+     */
+    class ShmFeedMapping {
+    public:
+        ShmFeedMapping() = default;
+        ShmFeedMapping(const ShmFeedMapping&) = delete;
+        ShmFeedMapping& operator=(const ShmFeedMapping&) = delete;
+        ~ShmFeedMapping() { Close(); }
+
+        static size_t BytesFor(uint32_t capacity) {
+            return ShmFeedHeader::kRecordsOffset + static_cast<size_t>(capacity) * sizeof(FeedRecord);
+        }
+
+        /**
+         * @brief Creates and initialises the mapping (reader side).
+         * @return HRESULT S_OK on success, E_INVALIDARG if capacity is not a power of two,
+         * HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS) if another reader owns the name.
+         */
+        HRESULT Create(const std::wstring& name, uint32_t capacity) {
+            Close();
+            if (capacity < 2 || (capacity & (capacity - 1)) != 0) return E_INVALIDARG;
+            size_t bytes = BytesFor(capacity);
+            m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                           static_cast<DWORD>(static_cast<uint64_t>(bytes) >> 32),
+                                           static_cast<DWORD>(bytes & 0xFFFFFFFFU), name.c_str());
+            if (!m_mapping) return LastError();
+            if (GetLastError() == ERROR_ALREADY_EXISTS) {
+                Close();
+                return HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+            }
+            HRESULT hr = MapAndOpenEvent(name, true);
+            if (FAILED(hr)) return hr;
+
+            ShmFeedHeader* header = Header();
+            header->version = ShmFeedHeader::kVersion;
+            header->capacity = capacity;
+            header->recordSize = sizeof(FeedRecord);
+            header->consumerSleeping.store(0, std::memory_order_relaxed);
+            header->closed.store(0, std::memory_order_relaxed);
+            header->dropped.store(0, std::memory_order_relaxed);
+            header->tail.store(0, std::memory_order_relaxed);
+            header->head.store(0, std::memory_order_relaxed);
+            FeedRecord* records = Records();
+            for (uint32_t i = 0; i < capacity; ++i) records[i].sequence.store(i, std::memory_order_relaxed);
+            header->magic.store(ShmFeedHeader::kMagic, std::memory_order_release);
+            m_mask = capacity - 1;
+            return S_OK;
+        }
+
+        /**
+         * @brief Opens a mapping created by a reader (producer side).
+         * @return HRESULT S_OK on success, HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if no
+         * reader has created it yet, E_FAIL if the layout does not match.
+         */
+        HRESULT Open(const std::wstring& name) {
+            Close();
+            m_mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+            if (!m_mapping) return LastError();
+            HRESULT hr = MapAndOpenEvent(name, false);
+            if (FAILED(hr)) return hr;
+            const ShmFeedHeader* header = Header();
+            if (header->magic.load(std::memory_order_acquire) != ShmFeedHeader::kMagic ||
+                header->version != ShmFeedHeader::kVersion || header->recordSize != sizeof(FeedRecord)) {
+                Close();
+                return E_FAIL;
+            }
+            m_mask = header->capacity - 1;
+            return S_OK;
+        }
+
+        void Close() {
+            if (m_view) UnmapViewOfFile(m_view);
+            if (m_mapping) CloseHandle(m_mapping);
+            if (m_wake) CloseHandle(m_wake);
+            m_view = nullptr;
+            m_mapping = nullptr;
+            m_wake = nullptr;
+            m_mask = 0;
+        }
+
+        bool IsOpen() const { return m_view != nullptr; }
+        ShmFeedHeader* Header() const { return static_cast<ShmFeedHeader*>(m_view); }
+        FeedRecord* Records() const {
+            return reinterpret_cast<FeedRecord*>(static_cast<char*>(m_view) + ShmFeedHeader::kRecordsOffset);
+        }
+        uint64_t Mask() const { return m_mask; }
+        HANDLE WakeEvent() const { return m_wake; }
+
+    private:
+        static HRESULT LastError() {
+            DWORD error = GetLastError();
+            return error ? HRESULT_FROM_WIN32(error) : E_FAIL;
+        }
+
+        HRESULT MapAndOpenEvent(const std::wstring& name, bool create) {
+            m_view = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+            std::wstring wakeName = name + L"_wake";
+            if (m_view) {
+                m_wake = create ? CreateEventW(nullptr, FALSE, FALSE, wakeName.c_str())
+                                : OpenEventW(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, wakeName.c_str());
+            }
+            if (!m_view || !m_wake) {
+                HRESULT hr = LastError();
+                Close();
+                return hr;
+            }
+            return S_OK;
+        }
+
+        HANDLE m_mapping = nullptr;
+        HANDLE m_wake = nullptr;
+        void* m_view = nullptr;
+        uint64_t m_mask = 0;
+    };
+
+    /**
+     * @brief Producer side of a shared-memory feed. Several writers (threads or processes)
+     * may push into one ring; a single writer must not be used from two threads at once.
+     * Push returns false when the ring is full (the update is counted in dropped), a
+     * string is longer than FeedRecord::kMaxText, or the reader has stopped (IsClosed;
+     * Close and Open again once a new reader is up).
+     */
+    class ShmFeedWriter {
+    public:
+        HRESULT Open(const std::wstring& name) { return m_mapping.Open(name); }
+        void Close() { m_mapping.Close(); }
+        bool IsOpen() const { return m_mapping.IsOpen(); }
+        bool IsClosed() const {
+            return !m_mapping.IsOpen() || m_mapping.Header()->closed.load(std::memory_order_acquire) != 0;
+        }
+
+        bool Push(uint64_t key, double value) {
+            return Write(key, FeedValueType::Double, [value](FeedRecord& record) { record.number = value; });
+        }
+        bool Push(uint64_t key, int value) { return Push(key, static_cast<long long>(value)); }
+        bool Push(uint64_t key, long value) { return Push(key, static_cast<long long>(value)); }
+        bool Push(uint64_t key, long long value) {
+            return Write(key, FeedValueType::Int64, [value](FeedRecord& record) { record.integer = value; });
+        }
+        bool Push(uint64_t key, bool value) {
+            return Write(key, FeedValueType::Bool, [value](FeedRecord& record) { record.integer = value ? 1 : 0; });
+        }
+        bool PushError(uint64_t key, SCODE code) {
+            return Write(key, FeedValueType::Error, [code](FeedRecord& record) { record.integer = code; });
+        }
+        bool Push(uint64_t key, std::wstring_view value) {
+            if (value.size() > FeedRecord::kMaxText) return false;
+            return Write(key, FeedValueType::String, [value](FeedRecord& record) {
+                record.length = static_cast<uint32_t>(value.size());
+                for (size_t i = 0; i < value.size(); ++i) record.text[i] = static_cast<uint16_t>(value[i]);
+            });
+        }
+        bool Push(uint64_t key, const wchar_t* value) { return Push(key, std::wstring_view(value ? value : L"")); }
+
+        uint64_t Dropped() const {
+            return m_mapping.IsOpen() ? m_mapping.Header()->dropped.load(std::memory_order_relaxed) : 0;
+        }
+
+    private:
+        template <typename Fill>
+        bool Write(uint64_t key, FeedValueType type, Fill&& fill) {
+            if (IsClosed()) return false;
+            ShmFeedHeader* header = m_mapping.Header();
+            FeedRecord* records = m_mapping.Records();
+            uint64_t position = header->tail.load(std::memory_order_relaxed);
+            FeedRecord* record;
+            while (true) {
+                record = &records[position & m_mapping.Mask()];
+                uint64_t sequence = record->sequence.load(std::memory_order_acquire);
+                int64_t diff = static_cast<int64_t>(sequence - position);
+                if (diff == 0) {
+                    if (header->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+                } else if (diff < 0) {
+                    header->dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                } else {
+                    position = header->tail.load(std::memory_order_relaxed);
+                }
+            }
+
+            record->key = key;
+            record->timestamp = FeedClockNs();
+            record->type = static_cast<uint32_t>(type);
+            record->length = 0;
+            fill(*record);
+            // seq_cst pairs with the reader's consumerSleeping store: one of us sees the other
+            record->sequence.store(position + 1, std::memory_order_seq_cst);
+            if (header->consumerSleeping.load(std::memory_order_seq_cst)) SetEvent(m_mapping.WakeEvent());
+            return true;
+        }
+
+        ShmFeedMapping m_mapping;
+    };
+
+    /**
+     * @brief Consumer side of a shared-memory feed: creates the named ring and runs a
+     * thread that drains it into a server in batches of up to kBatch records, applied with
+     * one UpdateTopics call (which also notifies Excel). Records are decoded into reused
+     * TopicValues, so the steady state neither copies through a queue nor allocates.
+     *
+     * Keys are TopicIDs unless SetKeyMapper installs a translation (return -1 to skip a
+     * record). The reader holds a reference on the server between Start and Stop. When
+     * the ring is empty the thread sleeps on the wake event for up to kIdleWaitMs.
+     */
+    class ShmFeedReader {
+    public:
+        static constexpr uint32_t kDefaultCapacity = 65536;
+        static constexpr size_t kBatch = 1024;
+        static constexpr DWORD kIdleWaitMs = 20;
+        static constexpr size_t kLatencyBuckets = LatencyHistogram::kBuckets;
+
+        using KeyMapper = std::function<long(uint64_t key)>;
+
+        struct Stats {
+            unsigned long long records = 0;
+            unsigned long long batches = 0;
+            unsigned long long unmapped = 0; // Records whose key did not map to a TopicID
+            unsigned long long dropped = 0;  // Producer pushes refused because the ring was full
+            // Producer timestamp to applied, in log2 buckets: bucket b counts latencies below 2^b ns
+            unsigned long long latency[kLatencyBuckets] = {};
+
+            /**
+             * @brief Upper bound of the q-quantile (0..1) of the recorded latencies, in ns.
+             */
+            double LatencyPercentileNs(double q) const { return LatencyHistogram::PercentileNs(latency, q); }
+        };
+
+        explicit ShmFeedReader(RtdServerBase& server) : m_server(server) {}
+        ShmFeedReader(const ShmFeedReader&) = delete;
+        ShmFeedReader& operator=(const ShmFeedReader&) = delete;
+        ~ShmFeedReader() { Stop(); }
+
+        /**
+         * @brief Sets the key translation. Call before Start.
+         */
+        void SetKeyMapper(KeyMapper mapper) { m_mapper = std::move(mapper); }
+
+        /**
+         * @brief Creates the ring under the given name and starts draining it.
+         * @return HRESULT S_OK on success, E_UNEXPECTED if already started, or the error
+         * from ShmFeedMapping::Create.
+         */
+        HRESULT Start(const std::wstring& name, uint32_t capacity = kDefaultCapacity) {
+            if (m_thread.joinable()) return E_UNEXPECTED;
+            HRESULT hr = m_mapping.Create(name, capacity);
+            if (FAILED(hr)) return hr;
+            m_ids.resize(kBatch);
+            m_values.resize(kBatch);
+            m_stamps.resize(kBatch);
+            m_stopping.store(false, std::memory_order_relaxed);
+            m_server.AddRef();
+            m_thread = std::thread(&ShmFeedReader::Run, this);
+            return S_OK;
+        }
+
+        /**
+         * @brief Drains what is already in the ring, stops the thread and closes the mapping.
+         */
+        void Stop() {
+            if (!m_thread.joinable()) return;
+            m_stopping.store(true, std::memory_order_release);
+            SetEvent(m_mapping.WakeEvent());
+            m_thread.join();
+            m_mapping.Close();
+            m_server.Release();
+        }
+
+        Stats GetStats() const {
+            Stats stats;
+            stats.records = m_records.load(std::memory_order_relaxed);
+            stats.batches = m_batches.load(std::memory_order_relaxed);
+            stats.unmapped = m_unmapped.load(std::memory_order_relaxed);
+            stats.dropped = m_dropped.load(std::memory_order_relaxed);
+            m_latency.CopyTo(stats.latency);
+            return stats;
+        }
+
+    private:
+        void Run() {
+            ShmFeedHeader* header = m_mapping.Header();
+            while (true) {
+                if (DrainBatch() != 0) continue;
+                if (m_stopping.load(std::memory_order_acquire)) break;
+
+                header->consumerSleeping.store(1, std::memory_order_seq_cst);
+                if (!HasRecord()) WaitForSingleObject(m_mapping.WakeEvent(), kIdleWaitMs);
+                header->consumerSleeping.store(0, std::memory_order_relaxed);
+            }
+            header->closed.store(1, std::memory_order_release);
+            m_dropped.store(header->dropped.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        bool HasRecord() const {
+            uint64_t head = m_mapping.Header()->head.load(std::memory_order_relaxed);
+            const FeedRecord& record = m_mapping.Records()[head & m_mapping.Mask()];
+            return record.sequence.load(std::memory_order_seq_cst) == head + 1;
+        }
+
+        size_t DrainBatch() {
+            ShmFeedHeader* header = m_mapping.Header();
+            FeedRecord* records = m_mapping.Records();
+            uint64_t head = header->head.load(std::memory_order_relaxed);
+            uint64_t capacity = m_mapping.Mask() + 1;
+            size_t taken = 0, count = 0;
+            unsigned long long unmapped = 0;
+            for (; taken < kBatch; ++taken, ++head) {
+                FeedRecord& record = records[head & m_mapping.Mask()];
+                if (record.sequence.load(std::memory_order_acquire) != head + 1) break;
+                long topicId = MapKey(record.key);
+                if (topicId >= 0) {
+                    m_ids[count] = topicId;
+                    m_stamps[count] = record.timestamp;
+                    Decode(record, m_values[count]);
+                    ++count;
+                } else {
+                    ++unmapped;
+                }
+                record.sequence.store(head + capacity, std::memory_order_release);
+            }
+            if (taken == 0) return 0;
+            header->head.store(head, std::memory_order_relaxed);
+
+            if (count != 0) {
+                m_server.UpdateTopics(std::span<const long>(m_ids.data(), count),
+                                      std::span<const TopicValue>(m_values.data(), count));
+                RecordLatency(count);
+            }
+            m_records.fetch_add(taken, std::memory_order_relaxed);
+            m_batches.fetch_add(1, std::memory_order_relaxed);
+            if (unmapped) m_unmapped.fetch_add(unmapped, std::memory_order_relaxed);
+            m_dropped.store(header->dropped.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return taken;
+        }
+
+        long MapKey(uint64_t key) const {
+            if (m_mapper) return m_mapper(key);
+            // TopicIDs are 32-bit in IRtdServer
+            return key <= 0x7FFFFFFFU ? static_cast<long>(key) : -1;
+        }
+
+        static void Decode(const FeedRecord& record, TopicValue& value) {
+            switch (static_cast<FeedValueType>(record.type)) {
+            case FeedValueType::Double: value.Assign(record.number); break;
+            case FeedValueType::Int64: value.Assign(static_cast<long long>(record.integer)); break;
+            case FeedValueType::Bool: value.Assign(record.integer != 0); break;
+            case FeedValueType::Error: value.SetError(static_cast<SCODE>(record.integer)); break;
+            case FeedValueType::String: {
+                size_t length = record.length < FeedRecord::kMaxText ? record.length : FeedRecord::kMaxText;
+                if constexpr (sizeof(wchar_t) == sizeof(uint16_t)) {
+                    value.Assign(std::wstring_view(reinterpret_cast<const wchar_t*>(record.text), length));
+                } else {
+                    wchar_t text[FeedRecord::kMaxText];
+                    for (size_t i = 0; i < length; ++i) text[i] = static_cast<wchar_t>(record.text[i]);
+                    value.Assign(std::wstring_view(text, length));
+                }
+                break;
+            }
+            default: value.Clear(); break;
+            }
+        }
+
+        void RecordLatency(size_t count) {
+            int64_t now = FeedClockNs();
+            unsigned long long buckets[kLatencyBuckets] = {};
+            for (size_t i = 0; i < count; ++i) {
+                if (m_stamps[i] == 0) continue;
+                ++buckets[LatencyHistogram::Bucket(now > m_stamps[i] ? static_cast<uint64_t>(now - m_stamps[i]) : 0)];
+            }
+            for (size_t b = 0; b < kLatencyBuckets; ++b) {
+                if (buckets[b]) m_latency.Add(b, buckets[b]);
+            }
+        }
+
+        RtdServerBase& m_server;
+        KeyMapper m_mapper;
+        ShmFeedMapping m_mapping;
+        std::thread m_thread;
+        std::atomic<bool> m_stopping{false};
+
+        // Batch scratch, owned by the drain thread
+        std::vector<long> m_ids;
+        std::vector<TopicValue> m_values;
+        std::vector<int64_t> m_stamps;
+
+        std::atomic<unsigned long long> m_records{0};
+        std::atomic<unsigned long long> m_batches{0};
+        std::atomic<unsigned long long> m_unmapped{0};
+        std::atomic<unsigned long long> m_dropped{0};
+        LatencyHistogram m_latency;
+    };
+
+} // namespace rtd
+
+#endif // RTD_SHM_FEED_H
@@ -0,0 +1,392 @@
+#ifndef RTD_SNAPSHOT_H
+#define RTD_SNAPSHOT_H
+
+#include <windows.h>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "feed_protocol.h"
+#include "value.h"
+
+namespace rtd {
+
+    /**
+     * @brief One topic in a snapshot file: 256 bytes, little-endian.
+     *
+     *   offset  0  uint32      check       FNV-1a of bytes 4..255, never 0; 0 = free record
+     *   offset  4  uint32      keyLength   Canonical subscription key, in UTF-16 units
+     *   offset  8  uint32      type        FeedValueType, or kNoValue
+     *   offset 12  uint32      textLength  String value, in UTF-16 units
+     *   offset 16  float64     number      Double
+     *   offset 24  int64       integer     Int64; Bool as 0/1; Error as the Excel code
+     *   offset 32  uint16[112] text        Key, then the string value
+     *
+     * A record whose check does not match (torn by a crash mid-write) is dropped on load.
+     */
+    struct SnapshotRecord {
+        static constexpr size_t kMaxText = 112;
+        static constexpr uint32_t kNoValue = 0xFFFFFFFFU;
+
+        uint32_t check;
+        uint32_t keyLength;
+        uint32_t type;
+        uint32_t textLength;
+        double number;
+        int64_t integer;
+        uint16_t text[kMaxText];
+    };
+    static_assert(sizeof(SnapshotRecord) == 256, "SnapshotRecord is a fixed file layout");
+
+    /**
+     * @brief Start of a snapshot file; records follow at kRecordsOffset. A file whose magic,
+     * version or record size differ is reinitialised.
+     */
+    struct SnapshotHeader {
+        static constexpr uint32_t kMagic = 0x53445452; // "RTDS"
+        static constexpr uint32_t kVersion = 2; // 2: keys terminate every argument
+        static constexpr size_t kRecordsOffset = 64;
+
+        uint32_t magic;
+        uint32_t version;
+        uint32_t recordSize;
+        uint32_t capacity;
+    };
+
+    /**
+     * @brief Last-value store in a memory-mapped file, keyed by canonical subscription key
+     * (TopicArgs::Key), so values survive Excel restarts while TopicIDs do not.
+     *
+     * Each Write updates one record in place; the OS writes dirty pages back, also if the
+     * process dies, and Flush forces them out. Keys and string values must fit in
+     * SnapshotRecord::kMaxText units together, and VARIANT values are not kept; such topics
+     * simply have no snapshot value. Records stay when their subscription closes (Excel
+     * disconnects everything before it exits); when the file is full, the record of a
+     * closed subscription is reused.
+     *
+     * Not thread-safe: RtdServerBase guards it with m_topicMutex.
+     */
+    class TopicSnapshot {
+    public:
+        static constexpr uint32_t kDefaultCapacity = 65536;
+        static constexpr long kNil = -1;
+
+        struct Stats {
+            size_t restored = 0;    // Records with a value found by Open
+            size_t records = 0;     // Records in use
+            unsigned long long writes = 0;
+            unsigned long long skipped = 0; // Writes of values that do not fit a record
+            unsigned long long full = 0;    // Keys refused because every record was live
+        };
+
+        TopicSnapshot() = default;
+        TopicSnapshot(const TopicSnapshot&) = delete;
+        TopicSnapshot& operator=(const TopicSnapshot&) = delete;
+        ~TopicSnapshot() { Close(); }
+
+        /**
+         * @brief Opens (or creates) the snapshot file and indexes its records.
+         * An existing valid file keeps its own capacity.
+         * @return HRESULT S_OK on success, E_INVALIDARG for a zero capacity, or the file error.
+         */
+        HRESULT Open(const std::wstring& path, uint32_t capacity = kDefaultCapacity) {
+            Close();
+            if (capacity == 0) return E_INVALIDARG;
+            m_file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE) {
+                m_file = nullptr;
+                return LastError();
+            }
+
+            SnapshotHeader existing = {};
+            LARGE_INTEGER size = {};
+            GetFileSizeEx(m_file, &size);
+            bool valid = false;
+            if (static_cast<unsigned long long>(size.QuadPart) >= SnapshotHeader::kRecordsOffset) {
+                DWORD read = 0;
+                valid = ReadFile(m_file, &existing, sizeof(existing), &read, nullptr) && read == sizeof(existing) &&
+                        existing.magic == SnapshotHeader::kMagic && existing.version == SnapshotHeader::kVersion &&
+                        existing.recordSize == sizeof(SnapshotRecord) && existing.capacity != 0 &&
+                        static_cast<unsigned long long>(size.QuadPart) >= BytesFor(existing.capacity);
+            }
+            if (valid) capacity = existing.capacity;
+
+            unsigned long long bytes = BytesFor(capacity);
+            m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE, static_cast<DWORD>(bytes >> 32),
+                                           static_cast<DWORD>(bytes & 0xFFFFFFFFU), nullptr);
+            if (m_mapping) m_view = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(bytes));
+            if (!m_view) {
+                HRESULT hr = LastError();
+                Close();
+                return hr;
+            }
+
+            m_capacity = capacity;
+            m_live.assign(capacity, false);
+            if (!valid) {
+                std::memset(m_view, 0, static_cast<size_t>(bytes));
+                SnapshotHeader* header = static_cast<SnapshotHeader*>(m_view);
+                header->version = SnapshotHeader::kVersion;
+                header->recordSize = sizeof(SnapshotRecord);
+                header->capacity = capacity;
+                header->magic = SnapshotHeader::kMagic;
+            }
+            for (uint32_t i = capacity; i-- > 0;) {
+                SnapshotRecord& record = Records()[i];
+                if (record.check != 0 && (record.check != Checksum(record) || record.keyLength > SnapshotRecord::kMaxText ||
+                                          record.textLength > SnapshotRecord::kMaxText - record.keyLength)) {
+                    record.check = 0; // Torn write, or lengths that overrun the text
+                }
+                if (record.check == 0) {
+                    m_free.push_back(i);
+                    continue;
+                }
+                m_index.emplace(HashKey(KeyView(record)), i);
+                if (record.type != SnapshotRecord::kNoValue) m_restored.push_back(static_cast<long>(i));
+            }
+            m_stats.restored = m_restored.size();
+            return S_OK;
+        }
+
+        /**
+         * @brief Flushes and unmaps the file.
+         */
+        void Close() {
+            if (m_view) {
+                FlushViewOfFile(m_view, 0);
+                UnmapViewOfFile(m_view);
+            }
+            if (m_mapping) CloseHandle(m_mapping);
+            if (m_file) CloseHandle(m_file);
+            m_view = nullptr;
+            m_mapping = nullptr;
+            m_file = nullptr;
+            m_capacity = 0;
+            m_index.clear();
+            m_free.clear();
+            m_live.clear();
+            m_restored.clear();
+            m_stats = Stats();
+        }
+
+        bool IsOpen() const { return m_view != nullptr; }
+
+        /**
+         * @brief Records that held a value when the file was opened (the previous session's topics).
+         */
+        const std::vector<long>& Restored() const { return m_restored; }
+
+        std::wstring Key(long record) const {
+            const SnapshotRecord& r = Records()[record];
+            return std::wstring(r.text, r.text + r.keyLength);
+        }
+
+        long Find(std::wstring_view key) const {
+            auto range = m_index.equal_range(HashKey(key));
+            for (auto it = range.first; it != range.second; ++it) {
+                if (KeyEquals(Records()[it->second], key)) return static_cast<long>(it->second);
+            }
+            return kNil;
+        }
+
+        /**
+         * @brief Returns the record for key, creating an empty one if needed, and marks it
+         * live (its record is not reused while live).
+         * @return kNil if the key is too long or every record is live.
+         */
+        long Claim(std::wstring_view key) {
+            long found = Find(key);
+            if (found != kNil) {
+                m_live[found] = true;
+                return found;
+            }
+            if (key.size() > SnapshotRecord::kMaxText) return kNil;
+            uint32_t index;
+            if (!m_free.empty()) {
+                index = m_free.back();
+                m_free.pop_back();
+            } else if (!Evict(index)) {
+                ++m_stats.full;
+                return kNil;
+            }
+            SnapshotRecord& record = Records()[index];
+            record.keyLength = static_cast<uint32_t>(key.size());
+            for (size_t i = 0; i < key.size(); ++i) record.text[i] = static_cast<uint16_t>(key[i]);
+            record.type = SnapshotRecord::kNoValue;
+            record.textLength = 0;
+            record.number = 0.0;
+            record.integer = 0;
+            record.check = Checksum(record);
+            m_index.emplace(HashKey(key), index);
+            m_live[index] = true;
+            return static_cast<long>(index);
+        }
+
+        /**
+         * @brief Marks a record as belonging to a closed subscription. It keeps its value.
+         */
+        void Release(long record) {
+            if (record >= 0 && static_cast<uint32_t>(record) < m_capacity) m_live[record] = false;
+        }
+
+        /**
+         * @brief Deletes a record, e.g. for a key the workbook no longer uses.
+         */
+        void Erase(long record) {
+            if (record < 0 || static_cast<uint32_t>(record) >= m_capacity) return;
+            SnapshotRecord& r = Records()[record];
+            if (r.check == 0) return;
+            Unindex(static_cast<uint32_t>(record));
+            r.check = 0;
+            m_live[record] = false;
+            m_free.push_back(static_cast<uint32_t>(record));
+        }
+
+        /**
+         * @brief Stores a value. Values that do not fit (VARIANTs, strings longer than the
+         * room the key leaves) clear the record's value instead, so a stale one is never restored.
+         */
+        void Write(long record, const TopicValue& value) {
+            SnapshotRecord& r = Records()[record];
+            r.textLength = 0;
+            switch (value.GetType()) {
+            case TopicValue::Type::Empty: r.type = static_cast<uint32_t>(FeedValueType::Empty); break;
+            case TopicValue::Type::Double: r.type = static_cast<uint32_t>(FeedValueType::Double); r.number = value.AsDouble(); break;
+            case TopicValue::Type::Int64: r.type = static_cast<uint32_t>(FeedValueType::Int64); r.integer = value.AsInt64(); break;
+            case TopicValue::Type::Bool: r.type = static_cast<uint32_t>(FeedValueType::Bool); r.integer = value.AsBool() ? 1 : 0; break;
+            case TopicValue::Type::Error: r.type = static_cast<uint32_t>(FeedValueType::Error); r.integer = value.AsError(); break;
+            case TopicValue::Type::String: {
+                std::wstring_view text = value.AsString();
+                if (text.size() > SnapshotRecord::kMaxText - r.keyLength) {
+                    r.type = SnapshotRecord::kNoValue;
+                    ++m_stats.skipped;
+                    break;
+                }
+                r.type = static_cast<uint32_t>(FeedValueType::String);
+                r.textLength = static_cast<uint32_t>(text.size());
+                for (size_t i = 0; i < text.size(); ++i) r.text[r.keyLength + i] = static_cast<uint16_t>(text[i]);
+                break;
+            }
+            default:
+                r.type = SnapshotRecord::kNoValue;
+                ++m_stats.skipped;
+                break;
+            }
+            r.check = Checksum(r);
+            ++m_stats.writes;
+        }
+
+        /**
+         * @brief Reads a record's value.
+         * @return false if the record has none.
+         */
+        bool Read(long record, TopicValue& value) const {
+            const SnapshotRecord& r = Records()[record];
+            switch (static_cast<FeedValueType>(r.type)) {
+            case FeedValueType::Empty: value.Clear(); return true;
+            case FeedValueType::Double: value.Assign(r.number); return true;
+            case FeedValueType::Int64: value.Assign(static_cast<long long>(r.integer)); return true;
+            case FeedValueType::Bool: value.Assign(r.integer != 0); return true;
+            case FeedValueType::Error: value.SetError(static_cast<SCODE>(r.integer)); return true;
+            case FeedValueType::String: {
+                std::wstring text(r.text + r.keyLength, r.text + r.keyLength + r.textLength);
+                return SUCCEEDED(value.Assign(std::wstring_view(text)));
+            }
+            }
+            return false;
+        }
+
+        void Flush() {
+            if (m_view) FlushViewOfFile(m_view, 0);
+        }
+
+        Stats GetStats() const {
+            Stats stats = m_stats;
+            stats.records = m_capacity - m_free.size();
+            return stats;
+        }
+
+    private:
+        static unsigned long long BytesFor(uint32_t capacity) {
+            return SnapshotHeader::kRecordsOffset + static_cast<unsigned long long>(capacity) * sizeof(SnapshotRecord);
+        }
+
+        static HRESULT LastError() {
+            DWORD error = GetLastError();
+            return error ? HRESULT_FROM_WIN32(error) : E_FAIL;
+        }
+
+        static uint32_t Checksum(const SnapshotRecord& record) {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&record);
+            uint32_t hash = 2166136261U;
+            for (size_t i = sizeof(record.check); i < sizeof(SnapshotRecord); ++i) hash = (hash ^ bytes[i]) * 16777619U;
+            return hash ? hash : 1;
+        }
+
+        static std::u16string_view KeyView(const SnapshotRecord& record) {
+            return std::u16string_view(reinterpret_cast<const char16_t*>(record.text), record.keyLength);
+        }
+
+        // FNV-1a over UTF-16 units, so stored (char16_t) and incoming (wchar_t) keys hash alike
+        template <typename Char>
+        static size_t HashKey(std::basic_string_view<Char> key) {
+            size_t hash = static_cast<size_t>(14695981039346656037ULL);
+            for (Char c : key) hash = (hash ^ static_cast<uint16_t>(c)) * static_cast<size_t>(1099511628211ULL);
+            return hash;
+        }
+
+        static bool KeyEquals(const SnapshotRecord& record, std::wstring_view key) {
+            if (record.keyLength != key.size()) return false;
+            for (size_t i = 0; i < key.size(); ++i) {
+                if (record.text[i] != static_cast<uint16_t>(key[i])) return false;
+            }
+            return true;
+        }
+
+        // Reuses the record of a closed subscription.
+        bool Evict(uint32_t& index) {
+            for (uint32_t i = 0; i < m_capacity; ++i) {
+                uint32_t candidate = (m_evictCursor + i) % m_capacity;
+                if (!m_live[candidate]) {
+                    m_evictCursor = candidate + 1;
+                    Unindex(candidate);
+                    index = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Unindex(uint32_t index) {
+            auto range = m_index.equal_range(HashKey(KeyView(Records()[index])));
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == index) {
+                    m_index.erase(it);
+                    return;
+                }
+            }
+        }
+
+        SnapshotRecord* Records() const {
+            return reinterpret_cast<SnapshotRecord*>(static_cast<char*>(m_view) + SnapshotHeader::kRecordsOffset);
+        }
+
+        HANDLE m_file = nullptr;
+        HANDLE m_mapping = nullptr;
+        void* m_view = nullptr;
+        uint32_t m_capacity = 0;
+        uint32_t m_evictCursor = 0;
+        std::unordered_multimap<size_t, uint32_t> m_index; // Key hash -> record
+        std::vector<uint32_t> m_free;
+        std::vector<bool> m_live;
+        std::vector<long> m_restored;
+        Stats m_stats;
+    };
+
+} // namespace rtd
+
+#endif // RTD_SNAPSHOT_H
@@ -0,0 +1,96 @@
+#ifndef RTD_SPSC_RING_H
+#define RTD_SPSC_RING_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+namespace rtd {
+
+    // Destructive interference size; hard-coded because MinGW does not ship
+    // std::hardware_destructive_interference_size.
+    constexpr size_t kCacheLineSize = 64;
+
+    /**
+     * @brief Bounded single-producer/single-consumer lock-free ring.
+     * T must be default-constructible and movable; elements are moved in and out, so
+     * a push/pop pair transfers ownership of any resources they hold.
+     *
+     * The producer and consumer indices live on separate cache lines, and each side
+     * caches the other's index so the shared line is only re-read when the ring looks
+     * full (producer) or empty (consumer).
+     */
+    template <typename T>
+    class SpscRing {
+    public:
+        /**
+         * @param capacity Rounded up to a power of two.
+         */
+        explicit SpscRing(size_t capacity) {
+            size_t size = 2;
+            while (size < capacity) size *= 2;
+            m_buffer.resize(size);
+            m_mask = size - 1;
+        }
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        size_t Capacity() const { return m_mask + 1; }
+
+        // --- Producer side ---
+        // On failure (ring full) item is left untouched.
+        bool TryPush(T&& item) {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_cachedHead > m_mask) {
+                m_cachedHead = m_head.load(std::memory_order_acquire);
+                if (tail - m_cachedHead > m_mask) return false;
+            }
+            m_buffer[tail & m_mask] = std::move(item);
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // --- Consumer side ---
+        bool TryPop(T& item) {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_cachedTail) {
+                m_cachedTail = m_tail.load(std::memory_order_acquire);
+                if (head == m_cachedTail) return false;
+            }
+            item = std::move(m_buffer[head & m_mask]);
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Pops every element currently visible and passes it to fn (which may move from it).
+         * @return Number of elements consumed.
+         */
+        template <typename Fn>
+        size_t Drain(Fn&& fn) {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            size_t tail = m_tail.load(std::memory_order_acquire);
+            m_cachedTail = tail;
+            for (size_t i = head; i != tail; ++i) {
+                fn(m_buffer[i & m_mask]);
+            }
+            m_head.store(tail, std::memory_order_release);
+            return tail - head;
+        }
+
+    private:
+        std::vector<T> m_buffer;
+        size_t m_mask = 0;
+
+        alignas(kCacheLineSize) std::atomic<size_t> m_tail{0}; // Written by producer
+        size_t m_cachedHead = 0;                               // Producer's view of m_head
+
+        alignas(kCacheLineSize) std::atomic<size_t> m_head{0}; // Written by consumer
+        size_t m_cachedTail = 0;                               // Consumer's view of m_tail
+    };
+
+} // namespace rtd
+
+#endif // RTD_SPSC_RING_H
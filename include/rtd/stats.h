@@ -0,0 +1,164 @@
+#ifndef RTD_STATS_H
+#define RTD_STATS_H
+
+#include <atomic>
+#include <new>
+#include <string_view>
+#include "spsc_ring.h"
+#include "thread_slots.h"
+
+namespace rtd {
+
+    /**
+     * @brief Event counters kept by RtdServerBase.
+     */
+    enum class Counter : unsigned {
+        UpdatesIngested,  // UpdateTopic / UpdateTopics / UpdateSubscription values received
+        UpdatesConflated, // Values that replaced an undelivered value of the same topic
+        RefreshCalls,     // RefreshData calls that delivered at least one topic
+        TopicsDelivered,  // Sum of RefreshData batch sizes
+        NotifyCalls,      // UpdateNotify calls made to Excel
+        DroppedUnchanged, // Updates dropped by @onchange
+        DroppedDeadband,  // Updates dropped by @deadband / @decimals
+        NotifyAbsorbed,   // NotifyUpdate calls made while a notify was already outstanding
+        TopicsDeferred,   // Due topics left for a later RefreshData by the batch cap
+        Count
+    };
+
+    /**
+     * @brief Event counters in per-thread, cache-line-sized slots.
+     * Each thread writes only its own slot (a plain load/store, no locked instruction),
+     * so counting never bounces cache lines between producer threads. Readers sum all
+     * slots. A slot is leased per thread (see ThreadSlots) and passed on, counts included,
+     * once its thread exits; threads beyond kMaxSlots - 1 alive at once share the last
+     * slot, updated with fetch_add. Slots are allocated when first counted into, so a
+     * server with one producer holds one slot, not kMaxSlots.
+     */
+    class ThreadCounters {
+    public:
+        static constexpr size_t kMaxSlots = 64;
+
+        ThreadCounters() : m_threads(kMaxSlots - 1) {
+            for (auto& slot : m_slots) slot.store(nullptr, std::memory_order_relaxed);
+        }
+
+        ThreadCounters(const ThreadCounters&) = delete;
+        ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+        ~ThreadCounters() {
+            for (auto& slot : m_slots) delete slot.load(std::memory_order_relaxed);
+        }
+
+        void Add(Counter counter, unsigned long long amount = 1) {
+            size_t index = m_threads.Acquire();
+            bool shared = index == ThreadSlots::kNone;
+            Slot* slot = SlotAt(shared ? kMaxSlots - 1 : index);
+            if (!slot) return;
+            std::atomic<unsigned long long>& value = slot->values[static_cast<unsigned>(counter)];
+            if (shared) {
+                value.fetch_add(amount, std::memory_order_relaxed);
+            } else {
+                value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @brief Sums a counter over all slots; concurrent increments may or may not be included.
+         */
+        unsigned long long Sum(Counter counter) const {
+            unsigned long long total = 0;
+            for (const auto& entry : m_slots) {
+                const Slot* slot = entry.load(std::memory_order_acquire);
+                if (slot) total += slot->values[static_cast<unsigned>(counter)].load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+    private:
+        struct alignas(kCacheLineSize) Slot {
+            std::atomic<unsigned long long> values[static_cast<unsigned>(Counter::Count)];
+
+            Slot() {
+                for (auto& value : values) value.store(0, std::memory_order_relaxed);
+            }
+        };
+
+        // Allocates the slot on first use; only the overflow slot can see two threads race here
+        Slot* SlotAt(size_t index) {
+            Slot* slot = m_slots[index].load(std::memory_order_acquire);
+            if (slot) return slot;
+            Slot* fresh = new (std::nothrow) Slot();
+            if (!fresh) return nullptr; // The count is dropped
+            if (m_slots[index].compare_exchange_strong(slot, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) return fresh;
+            delete fresh;
+            return slot;
+        }
+
+        std::atomic<Slot*> m_slots[kMaxSlots]; // The last one is the shared overflow slot
+        ThreadSlots m_threads;                 // Slot index leased by each counting thread
+    };
+
+    /**
+     * @brief Metrics served under the reserved "__stats" topic namespace:
+     *   =RTD("My.Hybrid.Server",, "__stats", "updates_per_sec")
+     */
+    enum class StatsMetric {
+        UpdatesIngested,   // "updates_ingested"
+        UpdatesPerSec,     // "updates_per_sec", over the last publishing interval
+        UpdatesConflated,  // "updates_conflated"
+        UpdatesSuppressed, // "updates_suppressed", by @onchange / @deadband / @decimals
+        RefreshCalls,      // "refresh_calls"
+        LastBatch,         // "last_batch", topics in the latest RefreshData
+        MaxBatch,          // "max_batch"
+        AvgBatch,          // "avg_batch"
+        NotifyCalls,       // "notify_calls"
+        LiveTopics,        // "live_topics"
+        StoreBytes,        // "store_bytes", topic table plus heap-held string buffers
+        NotifyAbsorbed,    // "notify_absorbed", NotifyUpdate calls that did not reach Excel
+        RefreshIntervalMs, // "refresh_interval_ms", average time between RefreshData calls
+        RefreshLatencyMs,  // "refresh_latency_ms", average time from UpdateNotify to RefreshData
+        ExcelThrottleMs,   // "excel_throttle_ms", Excel's measured throttle interval
+        RefreshDeferred    // "refresh_deferred", due topics left for a later batch by the cap
+    };
+
+    constexpr std::wstring_view kStatsNamespace = L"__stats";
+
+    /**
+     * @brief Maps a metric name to its StatsMetric.
+     * @return false for unknown names.
+     */
+    inline bool ParseStatsMetric(std::wstring_view name, StatsMetric& metric) {
+        struct Entry {
+            std::wstring_view name;
+            StatsMetric metric;
+        };
+        static constexpr Entry kMetrics[] = {
+            { L"updates_ingested", StatsMetric::UpdatesIngested },
+            { L"updates_per_sec", StatsMetric::UpdatesPerSec },
+            { L"updates_conflated", StatsMetric::UpdatesConflated },
+            { L"updates_suppressed", StatsMetric::UpdatesSuppressed },
+            { L"refresh_calls", StatsMetric::RefreshCalls },
+            { L"last_batch", StatsMetric::LastBatch },
+            { L"max_batch", StatsMetric::MaxBatch },
+            { L"avg_batch", StatsMetric::AvgBatch },
+            { L"notify_calls", StatsMetric::NotifyCalls },
+            { L"live_topics", StatsMetric::LiveTopics },
+            { L"store_bytes", StatsMetric::StoreBytes },
+            { L"notify_absorbed", StatsMetric::NotifyAbsorbed },
+            { L"refresh_interval_ms", StatsMetric::RefreshIntervalMs },
+            { L"refresh_latency_ms", StatsMetric::RefreshLatencyMs },
+            { L"excel_throttle_ms", StatsMetric::ExcelThrottleMs },
+            { L"refresh_deferred", StatsMetric::RefreshDeferred },
+        };
+        for (const Entry& entry : kMetrics) {
+            if (entry.name == name) {
+                metric = entry.metric;
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // namespace rtd
+
+#endif // RTD_STATS_H
@@ -0,0 +1,318 @@
+#ifndef RTD_SUBSCRIPTION_H
+#define RTD_SUBSCRIPTION_H
+
+#include <windows.h>
+#include <ole2.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "policy.h"
+#include "value.h"
+
+namespace rtd {
+
+    /**
+     * @brief Zero-copy view of ConnectData's topic strings.
+     * The views point into the BSTRs of the Strings SAFEARRAY and are only valid for the
+     * duration of ConnectData. Strings starting with '@' are delivery options (see
+     * DeliveryPolicy) and are kept apart from the arguments; the remaining arguments, in
+     * order and compared exactly, form the canonical subscription key. Each argument is
+     * terminated in the key, so no arguments and one empty argument are different keys.
+     *
+     *   =RTD("My.Hybrid.Server",, "AAPL", "Last", "@rate=2")  ->  args {"AAPL", "Last"}, options {"@rate=2"}
+     */
+    class TopicArgs {
+    public:
+        /**
+         * @brief Parses a one-dimensional array of BSTRs or VARIANT(BSTR)s.
+         * Non-string elements are kept as empty arguments so positions stay stable.
+         * @return E_INVALIDARG if the array has the wrong shape or element type.
+         */
+        HRESULT Parse(SAFEARRAY* strings) {
+            m_args.clear();
+            m_options.clear();
+            m_hash = kHashSeed;
+            if (!strings) return S_OK;
+            if (SafeArrayGetDim(strings) != 1) return E_INVALIDARG;
+
+            VARTYPE vt = VT_EMPTY;
+            HRESULT hr = SafeArrayGetVartype(strings, &vt);
+            if (FAILED(hr)) return hr;
+            if (vt != VT_VARIANT && vt != VT_BSTR) return E_INVALIDARG;
+
+            long lower = 0, upper = -1;
+            SafeArrayGetLBound(strings, 1, &lower);
+            SafeArrayGetUBound(strings, 1, &upper);
+
+            void* data = nullptr;
+            hr = SafeArrayAccessData(strings, &data);
+            if (FAILED(hr)) return hr;
+            for (long i = 0; i <= upper - lower; ++i) {
+                BSTR text = nullptr;
+                if (vt == VT_VARIANT) {
+                    VARIANT& item = static_cast<VARIANT*>(data)[i];
+                    if (item.vt == VT_BSTR) text = item.bstrVal;
+                } else {
+                    text = static_cast<BSTR*>(data)[i];
+                }
+                std::wstring_view view = text ? std::wstring_view(text, SysStringLen(text)) : std::wstring_view();
+                if (DeliveryPolicy::IsOption(view)) {
+                    m_options.push_back(view);
+                } else {
+                    m_args.push_back(view);
+                    HashArg(view);
+                }
+            }
+            // The BSTRs stay owned by the array; unaccessing only drops the lock count
+            SafeArrayUnaccessData(strings);
+            return S_OK;
+        }
+
+        /**
+         * @brief Splits a canonical key (see Key) back into arguments, e.g. one restored from
+         * a snapshot. The views point into key, which must outlive this object.
+         */
+        static TopicArgs FromKey(std::wstring_view key) {
+            TopicArgs args;
+            while (!key.empty()) {
+                size_t end = key.find(kSeparator);
+                args.m_args.push_back(key.substr(0, end));
+                args.HashArg(args.m_args.back());
+                key.remove_prefix(end == std::wstring_view::npos ? key.size() : end + 1);
+            }
+            return args;
+        }
+
+        size_t Count() const { return m_args.size(); }
+        bool Empty() const { return m_args.empty(); }
+        std::wstring_view operator[](size_t index) const { return m_args[index]; }
+        const std::vector<std::wstring_view>& Args() const { return m_args; }
+        const std::vector<std::wstring_view>& Options() const { return m_options; }
+
+        /**
+         * @brief Hash of the canonical key (FNV-1a over the arguments and their terminators).
+         */
+        size_t Hash() const { return m_hash; }
+
+        /**
+         * @brief Builds the canonical key: each argument followed by kSeparator.
+         */
+        std::wstring Key() const {
+            std::wstring key;
+            for (std::wstring_view arg : m_args) {
+                key.append(arg.data(), arg.size());
+                key.push_back(kSeparator);
+            }
+            return key;
+        }
+
+        /**
+         * @brief Compares against a canonical key without building one.
+         */
+        bool Matches(std::wstring_view key) const {
+            for (std::wstring_view arg : m_args) {
+                if (key.size() <= arg.size() || key.substr(0, arg.size()) != arg || key[arg.size()] != kSeparator) return false;
+                key.remove_prefix(arg.size() + 1);
+            }
+            return key.empty();
+        }
+
+        /**
+         * @brief Applies the '@' options to a policy; unrecognized options are ignored.
+         */
+        DeliveryPolicy Policy(const DeliveryPolicy& fallback) const {
+            DeliveryPolicy policy = fallback;
+            for (std::wstring_view option : m_options) policy.ApplyOption(option);
+            return policy;
+        }
+
+    private:
+        static constexpr wchar_t kSeparator = L'\x1F'; // ASCII unit separator
+        static constexpr size_t kHashSeed = static_cast<size_t>(14695981039346656037ULL);
+        static constexpr size_t kHashPrime = static_cast<size_t>(1099511628211ULL);
+
+        void HashArg(std::wstring_view arg) {
+            for (wchar_t c : arg) Mix(c);
+            Mix(kSeparator);
+        }
+
+        void Mix(wchar_t c) {
+            m_hash = (m_hash ^ static_cast<size_t>(c)) * kHashPrime;
+        }
+
+        std::vector<std::wstring_view> m_args;
+        std::vector<std::wstring_view> m_options;
+        size_t m_hash = kHashSeed;
+    };
+
+    /**
+     * @brief Generation-checked reference to a logical subscription.
+     * Handed to RtdServerBase::OnSubscribe; stale once OnUnsubscribe ran for it.
+     */
+    struct SubscriptionHandle {
+        long id = -1;
+        unsigned long generation = 0;
+
+        bool IsValid() const { return id >= 0; }
+    };
+
+    /**
+     * @brief Maps canonical topic keys to reference-counted logical subscriptions.
+     * Every TopicID connected with the same key attaches to one subscription, which keeps
+     * the latest upstream value so a TopicID joining later can be answered at once.
+     * Subscriptions live in a dense table with a free list, like TopicStore slots.
+     *
+     * Not thread-safe: RtdServerBase guards it with m_topicMutex.
+     */
+    class SubscriptionTable {
+    public:
+        static constexpr long kNil = -1;
+
+        struct Subscription {
+            std::wstring key;
+            size_t hash = 0;
+            std::vector<long> topicIds; // Attached TopicIDs (the reference count)
+            TopicValue value;           // Latest upstream value
+            bool hasValue = false;
+            unsigned long generation = 0;
+            bool live = false;
+            long snapshotRecord = -1;   // TopicSnapshot record, if the server keeps one
+        };
+
+        SubscriptionTable() = default;
+        SubscriptionTable(const SubscriptionTable&) = delete;
+        SubscriptionTable& operator=(const SubscriptionTable&) = delete;
+
+        /**
+         * @brief Attaches a TopicID to the subscription for args, creating it if needed.
+         * @param created Set when this TopicID is the key's first subscriber.
+         * @return The subscription id.
+         */
+        long Attach(const TopicArgs& args, long topicId, bool& created) {
+            long id = Open(args, created);
+            m_subs[id].topicIds.push_back(topicId);
+            return id;
+        }
+
+        /**
+         * @brief Finds or creates the subscription for args without attaching a TopicID,
+         * e.g. to subscribe upstream before Excel connects. Close it with CloseIfUnused
+         * if no TopicID ever attaches.
+         * @return The subscription id.
+         */
+        long Open(const TopicArgs& args, bool& created) {
+            created = false;
+            long id = FindByArgs(args);
+            if (id == kNil) {
+                id = Allocate();
+                Subscription& sub = m_subs[id];
+                sub.key = args.Key();
+                sub.hash = args.Hash();
+                sub.live = true;
+                m_byHash.emplace(sub.hash, id);
+                created = true;
+            }
+            return id;
+        }
+
+        /**
+         * @brief Detaches a TopicID. When it was the last one the subscription is closed,
+         * its value released and its generation bumped.
+         * @return true if the subscription was closed.
+         */
+        bool Detach(long id, long topicId) {
+            Subscription* sub = Find(id);
+            if (!sub) return false;
+            std::vector<long>& ids = sub->topicIds;
+            for (size_t i = 0; i < ids.size(); ++i) {
+                if (ids[i] == topicId) {
+                    ids[i] = ids.back();
+                    ids.pop_back();
+                    break;
+                }
+            }
+            if (!ids.empty()) return false;
+            Close(id);
+            return true;
+        }
+
+        /**
+         * @brief Closes a subscription that has no TopicIDs attached.
+         * @return true if the subscription was closed.
+         */
+        bool CloseIfUnused(const SubscriptionHandle& handle) {
+            Subscription* sub = Find(handle);
+            if (!sub || !sub->topicIds.empty()) return false;
+            Close(handle.id);
+            return true;
+        }
+
+        /**
+         * @brief Returns the live subscription with the given id, or nullptr.
+         */
+        Subscription* Find(long id) {
+            if (id < 0 || static_cast<size_t>(id) >= m_subs.size()) return nullptr;
+            Subscription& sub = m_subs[id];
+            return sub.live ? &sub : nullptr;
+        }
+
+        Subscription* Find(const SubscriptionHandle& handle) {
+            Subscription* sub = Find(handle.id);
+            return sub && sub->generation == handle.generation ? sub : nullptr;
+        }
+
+        SubscriptionHandle HandleOf(long id) const {
+            SubscriptionHandle handle;
+            handle.id = id;
+            handle.generation = m_subs[id].generation;
+            return handle;
+        }
+
+        size_t LiveCount() const { return m_subs.size() - m_free.size(); }
+
+    private:
+        void Close(long id) {
+            Subscription& sub = m_subs[id];
+            auto range = m_byHash.equal_range(sub.hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == id) {
+                    m_byHash.erase(it);
+                    break;
+                }
+            }
+            sub.key.clear();
+            sub.value.Clear();
+            sub.hasValue = false;
+            sub.live = false;
+            sub.snapshotRecord = -1;
+            ++sub.generation;
+            m_free.push_back(id);
+        }
+
+        long FindByArgs(const TopicArgs& args) const {
+            auto range = m_byHash.equal_range(args.Hash());
+            for (auto it = range.first; it != range.second; ++it) {
+                if (args.Matches(m_subs[it->second].key)) return it->second;
+            }
+            return kNil;
+        }
+
+        long Allocate() {
+            if (!m_free.empty()) {
+                long id = m_free.back();
+                m_free.pop_back();
+                return id;
+            }
+            m_subs.emplace_back();
+            return static_cast<long>(m_subs.size() - 1);
+        }
+
+        std::vector<Subscription> m_subs;
+        std::vector<long> m_free;
+        std::unordered_multimap<size_t, long> m_byHash;
+    };
+
+} // namespace rtd
+
+#endif // RTD_SUBSCRIPTION_H
@@ -0,0 +1,116 @@
+#ifndef RTD_THREAD_SLOTS_H
+#define RTD_THREAD_SLOTS_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rtd {
+
+    /**
+     * @brief Leases each thread one of a fixed number of slot indices, for per-thread state
+     * such as producer rings and counter slots.
+     * A thread keeps its index until it exits; a thread_local destructor then hands it back,
+     * so thread pools and short-lived workers cycle through the same few indices instead of
+     * using them up. Leases are cached per thread and per ThreadSlots, so a thread feeding
+     * several servers keeps one lease with each. The next holder of an index inherits
+     * whatever state it indexes; the pool's mutex orders the two threads' accesses.
+     */
+    class ThreadSlots {
+    public:
+        static constexpr size_t kNone = static_cast<size_t>(-1);
+
+        explicit ThreadSlots(size_t count) : m_pool(std::make_shared<Pool>()), m_ownerId(NextOwnerId()) {
+            // Handed out lowest index first
+            m_pool->free.reserve(count);
+            for (size_t i = count; i > 0; --i) m_pool->free.push_back(i - 1);
+        }
+
+        ThreadSlots(const ThreadSlots&) = delete;
+        ThreadSlots& operator=(const ThreadSlots&) = delete;
+
+        /**
+         * @brief Returns the calling thread's index, leasing one on first use.
+         * @return kNone while every index is leased by a live thread; retried once another
+         * thread has given its index back.
+         */
+        size_t Acquire() {
+            Leases& leases = LocalLeases();
+            for (Lease& lease : leases.entries) {
+                if (lease.owner != m_ownerId) continue;
+                if (lease.index != kNone || lease.epoch == m_pool->returned.load(std::memory_order_relaxed)) return lease.index;
+                return Take(leases, &lease);
+            }
+            return Take(leases, nullptr);
+        }
+
+    private:
+        struct Pool {
+            std::mutex mutex;
+            std::vector<size_t> free;                 // Guarded by mutex
+            std::atomic<unsigned long> returned{0};   // Indices given back so far; written under mutex
+        };
+
+        struct Lease {
+            unsigned long long owner;
+            size_t index;
+            unsigned long epoch; // Pool's returned count when a miss was cached
+            std::weak_ptr<Pool> pool;
+        };
+
+        // Gives every index back when the thread exits; pools of destroyed owners are skipped
+        struct Leases {
+            std::vector<Lease> entries;
+
+            ~Leases() {
+                for (Lease& lease : entries) {
+                    if (lease.index == kNone) continue;
+                    std::shared_ptr<Pool> pool = lease.pool.lock();
+                    if (!pool) continue;
+                    std::lock_guard<std::mutex> lock(pool->mutex);
+                    pool->free.push_back(lease.index);
+                    pool->returned.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        // Leases an index, into missed if the thread already holds a cached miss
+        size_t Take(Leases& leases, Lease* missed) {
+            std::lock_guard<std::mutex> lock(m_pool->mutex);
+            size_t index = kNone;
+            if (!m_pool->free.empty()) {
+                index = m_pool->free.back();
+                m_pool->free.pop_back();
+            }
+            unsigned long epoch = m_pool->returned.load(std::memory_order_relaxed);
+            if (missed) {
+                missed->index = index;
+                missed->epoch = epoch;
+                return index;
+            }
+            // Leases with servers destroyed since are never looked up again
+            std::erase_if(leases.entries, [](const Lease& lease) { return lease.pool.expired(); });
+            leases.entries.push_back({ m_ownerId, index, epoch, m_pool });
+            return index;
+        }
+
+        static Leases& LocalLeases() {
+            static thread_local Leases leases;
+            return leases;
+        }
+
+        // Unique per instance; unlike an address it is never reused by a later server.
+        static unsigned long long NextOwnerId() {
+            static std::atomic<unsigned long long> next{1};
+            return next.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::shared_ptr<Pool> m_pool;
+        const unsigned long long m_ownerId;
+    };
+
+} // namespace rtd
+
+#endif // RTD_THREAD_SLOTS_H
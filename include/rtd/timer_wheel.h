@@ -0,0 +1,416 @@
+#ifndef RTD_TIMER_WHEEL_H
+#define RTD_TIMER_WHEEL_H
+
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rtd {
+
+    /**
+     * @brief Generation-checked reference to a timer scheduled on a TimerWheel.
+     */
+    struct TimerHandle {
+        long id = -1;
+        unsigned long generation = 0;
+
+        bool IsValid() const { return id >= 0; }
+    };
+
+    /**
+     * @brief Hierarchical timing wheel driven by one worker thread.
+     * Schedules one-shot and periodic callbacks (per-topic deadlines, republishes,
+     * expirations) with O(1) insert and cancel. Time is counted in ticks of a fixed
+     * resolution (100 us by default); each of the kLevels wheels has 64 slots, so
+     * level L holds timers due within 64^(L+1) ticks and cascades them down as its slots
+     * come up. Per-level occupancy masks let the worker sleep straight until the next
+     * occupied slot instead of polling.
+     *
+     * A callback never fires before its deadline and usually within one tick (plus OS
+     * wake-up latency) after it. Callbacks run on the worker thread without the wheel's
+     * lock held, so they may schedule or cancel timers. The worker thread is started on
+     * first use.
+     */
+    class TimerWheel {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Callback = std::function<void()>;
+
+        static constexpr std::chrono::microseconds kDefaultTick{100};
+        static constexpr unsigned kLevels = 6;
+        static constexpr unsigned kSlotBits = 6;
+        static constexpr unsigned kSlots = 1u << kSlotBits;
+
+        /**
+         * @param origin Time of tick 0; ticks before it count as 0. Defaults to now.
+         */
+        explicit TimerWheel(Clock::duration tick = kDefaultTick, Clock::time_point origin = Clock::now())
+            : m_tick(tick.count() > 0 ? tick : Clock::duration(1)), m_origin(origin) {
+            for (auto& level : m_heads) {
+                for (auto& head : level) head = kNil;
+            }
+            for (auto& mask : m_occupied) mask = 0;
+        }
+
+        TimerWheel(const TimerWheel&) = delete;
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+        ~TimerWheel() {
+            Stop();
+        }
+
+        /**
+         * @brief Runs fn once at 'due' (at once if 'due' has passed).
+         * @return A handle for Cancel; invalid if the wheel is stopping.
+         */
+        TimerHandle ScheduleAt(Clock::time_point due, Callback fn) {
+            return Schedule(due, Clock::duration::zero(), std::move(fn));
+        }
+
+        TimerHandle ScheduleAfter(Clock::duration delay, Callback fn) {
+            return Schedule(Clock::now() + delay, Clock::duration::zero(), std::move(fn));
+        }
+
+        /**
+         * @brief Runs fn every 'period', first after one period, until cancelled.
+         * Runs that fall behind are skipped rather than replayed in a burst.
+         */
+        TimerHandle ScheduleEvery(Clock::duration period, Callback fn) {
+            if (period < m_tick) period = m_tick;
+            return Schedule(Clock::now() + period, period, std::move(fn));
+        }
+
+        /**
+         * @brief Cancels a timer in O(1).
+         * @return true if this prevented a future run; false if the timer already ran (or is
+         * running its final, one-shot run) or was cancelled before. Cancelling a periodic
+         * timer from inside its own callback stops further runs.
+         */
+        bool Cancel(const TimerHandle& handle) {
+            Callback dead;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Node* node = Find(handle);
+            if (!node) return false;
+            if (node->level < kLevels) Unlink(handle.id);
+            dead = std::move(node->fn);
+            Free(handle.id);
+            return true;
+        }
+
+        /**
+         * @brief Number of scheduled timers (periodic timers count until cancelled).
+         */
+        size_t Pending() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_live;
+        }
+
+        /**
+         * @brief Drops every timer and joins the worker thread.
+         * Must not be called from inside a callback. Scheduling is allowed again afterwards.
+         */
+        void Stop() {
+            std::vector<Callback> dead;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_cv.notify_one();
+            if (m_thread.joinable()) m_thread.join();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t id = 0; id < m_nodes.size(); ++id) {
+                Node& node = m_nodes[id];
+                if (!node.live) continue;
+                if (node.level < kLevels) Unlink(static_cast<long>(id));
+                dead.push_back(std::move(node.fn));
+                Free(static_cast<long>(id));
+            }
+            m_expired.clear();
+            m_stopping = false;
+        }
+
+    private:
+        static constexpr long kNil = -1;
+        static constexpr unsigned kRunning = kLevels;  // Node is out of the wheel, its callback executing
+        static constexpr unsigned kExpired = kLevels + 1; // Node is queued in m_expired
+
+        struct Node {
+            Callback fn;
+            uint64_t dueTick = 0;
+            uint64_t periodTicks = 0;   // 0 for one-shot timers
+            unsigned long generation = 0;
+            long prev = kNil;
+            long next = kNil;
+            unsigned level = 0;
+            unsigned slot = 0;
+            bool live = false;
+        };
+
+        TimerHandle Schedule(Clock::time_point due, Clock::duration period, Callback fn) {
+            TimerHandle handle;
+            if (!fn) return handle;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping) return handle;
+
+            long id = Allocate();
+            Node& node = m_nodes[id];
+            node.fn = std::move(fn);
+            node.dueTick = TickAtOrAfter(due);
+            node.periodTicks = period.count() > 0 ? static_cast<uint64_t>((period + m_tick - Clock::duration(1)) / m_tick) : 0;
+            Insert(id);
+            handle.id = id;
+            handle.generation = node.generation;
+
+            if (!m_thread.joinable()) {
+                m_thread = std::thread(&TimerWheel::Run, this);
+            } else if (node.dueTick < m_wakeTick) {
+                m_cv.notify_one();
+            }
+            return handle;
+        }
+
+        void Run() {
+            std::vector<TimerHandle> expired;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_stopping) {
+                Advance(TickOf(Clock::now()));
+                if (m_expired.empty()) {
+                    uint64_t next = 0;
+                    if (NextEventTick(next)) {
+                        m_wakeTick = next;
+                        m_cv.wait_until(lock, TimeOf(next));
+                    } else {
+                        m_wakeTick = UINT64_MAX;
+                        m_cv.wait(lock);
+                    }
+                    m_wakeTick = 0;
+                    continue;
+                }
+
+                expired.swap(m_expired);
+                for (const TimerHandle& entry : expired) {
+                    if (m_stopping) break;
+                    Node* node = Find(entry);
+                    if (!node || node->level != kExpired) continue; // Cancelled while queued
+                    uint64_t period = node->periodTicks;
+                    Callback fn = std::move(node->fn);
+                    if (period) node->level = kRunning;
+                    else Free(entry.id);
+
+                    lock.unlock();
+                    fn();
+                    if (period) {
+                        // Re-arm unless cancelled meanwhile (the slot may even have been reused)
+                        lock.lock();
+                        node = Find(entry);
+                        if (node && !m_stopping) {
+                            node->fn = std::move(fn);
+                            uint64_t now = TickOf(Clock::now());
+                            node->dueTick += period;
+                            if (node->dueTick <= now) node->dueTick += ((now - node->dueTick) / period + 1) * period;
+                            Insert(entry.id);
+                        }
+                        lock.unlock();
+                    }
+                    fn = nullptr; // Finished or cancelled: drop its captures without the lock
+                    lock.lock();
+                }
+                expired.clear();
+            }
+        }
+
+        // --- Tick arithmetic ---
+
+        uint64_t TickOf(Clock::time_point t) const {
+            if (t <= m_origin) return 0;
+            return static_cast<uint64_t>((t - m_origin) / m_tick);
+        }
+
+        // First tick that starts at or after t, so callbacks never fire early
+        uint64_t TickAtOrAfter(Clock::time_point t) const {
+            if (t <= m_origin) return 0;
+            return static_cast<uint64_t>((t - m_origin + m_tick - Clock::duration(1)) / m_tick);
+        }
+
+        Clock::time_point TimeOf(uint64_t tick) const {
+            return m_origin + m_tick * static_cast<Clock::rep>(tick);
+        }
+
+        static unsigned SlotOf(uint64_t tick, unsigned level) {
+            return static_cast<unsigned>((tick >> (level * kSlotBits)) & (kSlots - 1));
+        }
+
+        // --- Wheel maintenance; caller holds m_mutex ---
+
+        // Places a node on the lowest level whose current rotation contains its deadline.
+        void Insert(long id) {
+            Node& node = m_nodes[id];
+            if (node.dueTick < m_now || (node.dueTick == m_now && m_nowProcessed)) {
+                Expire(id);
+                return;
+            }
+            unsigned level = 0;
+            while (level + 1 < kLevels && (node.dueTick >> ((level + 1) * kSlotBits)) != (m_now >> ((level + 1) * kSlotBits))) {
+                ++level;
+            }
+            // Top-level slots behind the current one belong to the next rotation (see
+            // NextEventTick). Deadlines at or beyond the current slot's position in it are
+            // parked in the slot before the current one and re-inserted from there.
+            unsigned slot = SlotOf(node.dueTick, level);
+            uint64_t rotation = node.dueTick >> (kLevels * kSlotBits);
+            uint64_t nowRotation = m_now >> (kLevels * kSlotBits);
+            if (level + 1 == kLevels && rotation != nowRotation) {
+                unsigned current = SlotOf(m_now, level);
+                if (rotation != nowRotation + 1 || slot >= current) slot = (current + kSlots - 1) & (kSlots - 1);
+            }
+            node.level = level;
+            node.slot = slot;
+            node.prev = kNil;
+            node.next = m_heads[level][slot];
+            if (node.next != kNil) m_nodes[node.next].prev = id;
+            m_heads[level][slot] = id;
+            m_occupied[level] |= uint64_t(1) << slot;
+        }
+
+        void Expire(long id) {
+            Node& node = m_nodes[id];
+            node.level = kExpired;
+            TimerHandle entry;
+            entry.id = id;
+            entry.generation = node.generation;
+            m_expired.push_back(entry);
+        }
+
+        // Removes a node from its wheel slot (node.level < kLevels).
+        void Unlink(long id) {
+            Node& node = m_nodes[id];
+            if (node.prev != kNil) m_nodes[node.prev].next = node.next;
+            else m_heads[node.level][node.slot] = node.next;
+            if (node.next != kNil) m_nodes[node.next].prev = node.prev;
+            if (m_heads[node.level][node.slot] == kNil) m_occupied[node.level] &= ~(uint64_t(1) << node.slot);
+            node.prev = node.next = kNil;
+        }
+
+        // Finds the first tick at which a slot needs processing: m_now itself while its
+        // slots are unprocessed, later ticks otherwise.
+        bool NextEventTick(uint64_t& tick) const {
+            for (unsigned level = 0; level < kLevels; ++level) {
+                unsigned shift = level * kSlotBits;
+                uint64_t rotation = (m_now >> (shift + kSlotBits)) << (shift + kSlotBits);
+                unsigned current = SlotOf(m_now, level);
+                // The current slot is still due if it starts exactly now and has not been processed
+                bool startsNow = (m_now & ((uint64_t(1) << shift) - 1)) == 0;
+                unsigned first = (startsNow && !m_nowProcessed) ? current : current + 1;
+                uint64_t ahead = first < kSlots ? m_occupied[level] & (~uint64_t(0) << first) : 0;
+                if (ahead) {
+                    tick = rotation | (static_cast<uint64_t>(std::countr_zero(ahead)) << shift);
+                    return true;
+                }
+                // Only the top level holds slots behind the current one (timers parked
+                // beyond its rotation); those start in the next rotation
+                if (level + 1 == kLevels && m_occupied[level]) {
+                    uint64_t span = uint64_t(1) << (shift + kSlotBits);
+                    tick = rotation + span + (static_cast<uint64_t>(std::countr_zero(m_occupied[level])) << shift);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Processes every slot up to and including 'target', queueing due timers in m_expired.
+        void Advance(uint64_t target) {
+            while (true) {
+                uint64_t next = 0;
+                if (!NextEventTick(next) || next > target) {
+                    if (target > m_now || (target == m_now && !m_nowProcessed)) {
+                        m_now = target;
+                        m_nowProcessed = true;
+                    }
+                    return;
+                }
+                m_now = next;
+                m_nowProcessed = false;
+                // Cascade the higher levels whose slots start at this tick, top-down, then
+                // expire the level-0 slot
+                for (unsigned level = kLevels - 1; level > 0; --level) {
+                    if (m_now & ((uint64_t(1) << (level * kSlotBits)) - 1)) continue;
+                    Cascade(level, SlotOf(m_now, level));
+                }
+                Cascade(0, SlotOf(m_now, 0));
+                m_nowProcessed = true;
+            }
+        }
+
+        // Empties a slot, re-inserting its timers relative to m_now. Due ones are expired.
+        void Cascade(unsigned level, unsigned slot) {
+            long id = m_heads[level][slot];
+            m_heads[level][slot] = kNil;
+            m_occupied[level] &= ~(uint64_t(1) << slot);
+            while (id != kNil) {
+                long next = m_nodes[id].next;
+                m_nodes[id].prev = m_nodes[id].next = kNil;
+                if (m_nodes[id].dueTick <= m_now) Expire(id);
+                else Insert(id);
+                id = next;
+            }
+        }
+
+        // --- Node slab ---
+
+        Node* Find(const TimerHandle& handle) {
+            if (handle.id < 0 || static_cast<size_t>(handle.id) >= m_nodes.size()) return nullptr;
+            Node& node = m_nodes[handle.id];
+            return node.live && node.generation == handle.generation ? &node : nullptr;
+        }
+
+        long Allocate() {
+            long id;
+            if (!m_free.empty()) {
+                id = m_free.back();
+                m_free.pop_back();
+            } else {
+                m_nodes.emplace_back();
+                id = static_cast<long>(m_nodes.size() - 1);
+            }
+            m_nodes[id].live = true;
+            ++m_live;
+            return id;
+        }
+
+        void Free(long id) {
+            Node& node = m_nodes[id];
+            node.live = false;
+            node.fn = nullptr;
+            ++node.generation;
+            m_free.push_back(id);
+            --m_live;
+        }
+
+        const Clock::duration m_tick;
+        const Clock::time_point m_origin;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::thread m_thread;
+        bool m_stopping = false;
+
+        std::vector<Node> m_nodes;
+        std::vector<long> m_free;
+        size_t m_live = 0;
+        long m_heads[kLevels][kSlots];
+        uint64_t m_occupied[kLevels];
+        std::vector<TimerHandle> m_expired; // Due timers waiting for the worker
+        uint64_t m_now = 0;             // Current tick
+        bool m_nowProcessed = false;    // Whether m_now's level-0 slot has been emptied
+        uint64_t m_wakeTick = 0;        // Tick the worker sleeps until (0 while awake)
+    };
+
+} // namespace rtd
+
+#endif // RTD_TIMER_WHEEL_H
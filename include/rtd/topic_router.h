@@ -0,0 +1,261 @@
+#ifndef RTD_TOPIC_ROUTER_H
+#define RTD_TOPIC_ROUTER_H
+
+#include <windows.h>
+#include <oleauto.h>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include "subscription.h"
+
+namespace rtd {
+
+    /**
+     * @brief A wide string literal usable as a template argument: Route<L"quote", ...>.
+     */
+    template <size_t N>
+    struct TopicName {
+        wchar_t text[N] = {};
+
+        constexpr TopicName(const wchar_t (&literal)[N]) {
+            for (size_t i = 0; i < N; ++i) text[i] = literal[i];
+        }
+
+        constexpr std::wstring_view View() const { return std::wstring_view(text, N - 1); }
+    };
+
+    // --- Argument types ---
+    // A topic argument type is a struct with a static bool Parse(std::wstring_view, T&);
+    // failing to parse makes the topic malformed. The parsed views point into the topic
+    // strings and are only valid during ConnectData.
+
+    /**
+     * @brief A non-empty string argument.
+     */
+    struct TextArg {
+        std::wstring_view value;
+
+        static bool Parse(std::wstring_view text, TextArg& out) {
+            out.value = text;
+            return !text.empty();
+        }
+    };
+
+    namespace detail {
+
+        // std::from_chars only reads char, so the ASCII text is copied to the stack first
+        template <size_t N, typename T>
+        bool ParseDecimal(std::wstring_view text, T& value) {
+            char buffer[N];
+            if (text.empty() || text.size() > N) return false;
+            for (size_t i = 0; i < text.size(); ++i) {
+                if (text[i] > 0x7F) return false;
+                buffer[i] = static_cast<char>(text[i]);
+            }
+            const char* begin = buffer;
+            const char* end = buffer + text.size();
+            if (*begin == '+' && end - begin > 1) ++begin; // from_chars takes '-' only
+            std::from_chars_result result = std::from_chars(begin, end, value);
+            return result.ec == std::errc() && result.ptr == end;
+        }
+
+        constexpr uint32_t RouteHash(std::wstring_view name, uint32_t seed) {
+            uint32_t hash = 2166136261U ^ seed;
+            for (wchar_t c : name) hash = (hash ^ static_cast<uint32_t>(c)) * 16777619U;
+            return hash ^ (hash >> 15);
+        }
+
+    } // namespace detail
+
+    /**
+     * @brief A decimal integer argument, with optional sign.
+     */
+    struct IntegerArg {
+        long long value = 0;
+
+        static bool Parse(std::wstring_view text, IntegerArg& out) { return detail::ParseDecimal<32>(text, out.value); }
+    };
+
+    /**
+     * @brief A decimal floating-point argument ("1.5", "-2e-3").
+     */
+    struct NumberArg {
+        double value = 0.0;
+
+        static bool Parse(std::wstring_view text, NumberArg& out) { return detail::ParseDecimal<64>(text, out.value); }
+    };
+
+    /**
+     * @brief One of a fixed set of words; value is the index of the one given.
+     *
+     *   using Field = rtd::KeywordArg<L"bid", L"ask", L"last">;   // "ask" -> value 1
+     */
+    template <TopicName... Words>
+    struct KeywordArg {
+        size_t value = 0;
+
+        static bool Parse(std::wstring_view text, KeywordArg& out) {
+            constexpr std::wstring_view kWords[] = { Words.View()... };
+            for (size_t i = 0; i < sizeof...(Words); ++i) {
+                if (kWords[i] == text) {
+                    out.value = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    /**
+     * @brief What a route handler gets besides its parsed arguments: the ConnectData call.
+     */
+    struct TopicRequest {
+        long topicId;
+        const TopicArgs& args;
+        VARIANT_BOOL* getNewValues;
+        VARIANT* pvarOut;
+    };
+
+    /**
+     * @brief One topic kind in a TopicRouter: the leading topic string, the handler and the
+     * types of the arguments that follow it, in order. The handler provides
+     *
+     *   static HRESULT Connect(Context& context, const TopicRequest& request, const Args&... args);
+     */
+    template <TopicName Name, typename Handler, typename... Args>
+    struct Route {
+        static constexpr std::wstring_view kName = Name.View();
+        static constexpr size_t kArity = sizeof...(Args);
+
+        template <typename Context>
+        static HRESULT Invoke(Context& context, const TopicRequest& request) {
+            if (request.args.Count() != kArity + 1) return Malformed(request);
+            std::tuple<Args...> parsed;
+            if (!ParseAll(request.args, parsed, std::index_sequence_for<Args...>())) return Malformed(request);
+            return std::apply([&](const Args&... args) { return Handler::Connect(context, request, args...); }, parsed);
+        }
+
+    private:
+        template <size_t... I>
+        static bool ParseAll(const TopicArgs& args, std::tuple<Args...>& parsed, std::index_sequence<I...>) {
+            return (Args::Parse(args[I + 1], std::get<I>(parsed)) && ...);
+        }
+
+        static HRESULT Malformed(const TopicRequest& request) {
+            VariantInit(request.pvarOut);
+            request.pvarOut->vt = VT_ERROR;
+            request.pvarOut->scode = 2015; // xlErrValue
+            return S_OK;
+        }
+    };
+
+    /**
+     * @brief Dispatches ConnectData to a handler chosen by the first topic string, from a
+     * table fixed at compile time:
+     *
+     *   using Router = rtd::TopicRouter<
+     *       rtd::Route<L"quote", QuoteTopic, rtd::TextArg, rtd::KeywordArg<L"bid", L"ask">>,
+     *       rtd::Route<L"stats", StatsTopic, rtd::TextArg>>;
+     *
+     *   HRESULT ConnectData(long TopicID, SAFEARRAY** Strings, VARIANT_BOOL* GetNewValues, VARIANT* pvarOut) override {
+     *       rtd::TopicArgs args;
+     *       HRESULT hr = args.Parse(Strings ? *Strings : nullptr);
+     *       if (FAILED(hr)) return hr;
+     *       return Router::Dispatch(*this, { TopicID, args, GetNewValues, pvarOut });
+     *   }
+     *
+     * Route names are found through a perfect hash computed at compile time, then compared
+     * once; the arguments are parsed into the route's types and passed to its handler.
+     * Nothing is allocated. An unknown topic gets #NAME? and a topic with the wrong number of
+     * arguments, or one that fails to parse, gets #VALUE! (both with S_OK, so Excel shows
+     * the error in the cell). Names are compared exactly, like TopicArgs keys.
+     */
+    template <typename... Routes>
+    class TopicRouter {
+    public:
+        static_assert(sizeof...(Routes) > 0, "A TopicRouter needs at least one route");
+
+        static constexpr size_t kRoutes = sizeof...(Routes);
+
+        template <typename Context>
+        static HRESULT Dispatch(Context& context, const TopicRequest& request) {
+            if (!request.pvarOut) return E_POINTER;
+            using Invoker = HRESULT (*)(Context&, const TopicRequest&);
+            static constexpr Invoker kInvokers[] = { &Routes::template Invoke<Context>... };
+
+            size_t route = Find(request.args.Empty() ? std::wstring_view() : request.args[0]);
+            if (route == kNone) {
+                VariantInit(request.pvarOut);
+                request.pvarOut->vt = VT_ERROR;
+                request.pvarOut->scode = 2029; // xlErrName
+                return S_OK;
+            }
+            return kInvokers[route](context, request);
+        }
+
+        /**
+         * @brief Index of the route named name, or kNone.
+         */
+        static constexpr size_t Find(std::wstring_view name) {
+            size_t route = kSlots[detail::RouteHash(name, kSeed) & (kTableSize - 1)];
+            return route != kNone && kNames[route] == name ? route : kNone;
+        }
+
+        static constexpr size_t kNone = static_cast<size_t>(-1);
+
+    private:
+        static constexpr std::wstring_view kNames[] = { Routes::kName... };
+
+        static constexpr size_t TableSize() {
+            size_t size = 1;
+            while (size < 2 * kRoutes) size <<= 1;
+            return size;
+        }
+        static constexpr size_t kTableSize = TableSize();
+
+        static constexpr bool Distinct() {
+            for (size_t i = 0; i < kRoutes; ++i) {
+                for (size_t j = i + 1; j < kRoutes; ++j) {
+                    if (kNames[i] == kNames[j]) return false;
+                }
+            }
+            return true;
+        }
+        static_assert(Distinct(), "TopicRouter route names must be distinct");
+
+        // First seed that sends every name to its own slot
+        static constexpr uint32_t FindSeed() {
+            for (uint32_t seed = 0; seed < 100000; ++seed) {
+                bool used[kTableSize] = {};
+                bool collision = false;
+                for (size_t i = 0; i < kRoutes && !collision; ++i) {
+                    size_t slot = detail::RouteHash(kNames[i], seed) & (kTableSize - 1);
+                    collision = used[slot];
+                    used[slot] = true;
+                }
+                if (!collision) return seed;
+            }
+            return 0xFFFFFFFFU;
+        }
+        static constexpr uint32_t kSeed = FindSeed();
+        static_assert(kSeed != 0xFFFFFFFFU, "No perfect hash found for the TopicRouter route names");
+
+        struct Slots {
+            size_t route[kTableSize];
+            constexpr size_t operator[](size_t i) const { return route[i]; }
+        };
+        static constexpr Slots BuildSlots() {
+            Slots slots{};
+            for (size_t i = 0; i < kTableSize; ++i) slots.route[i] = kNone;
+            for (size_t i = 0; i < kRoutes; ++i) slots.route[detail::RouteHash(kNames[i], kSeed) & (kTableSize - 1)] = i;
+            return slots;
+        }
+        static constexpr Slots kSlots = BuildSlots();
+    };
+
+} // namespace rtd
+
+#endif // RTD_TOPIC_ROUTER_H
@@ -0,0 +1,94 @@
+#ifndef RTD_TOPIC_SHARDS_H
+#define RTD_TOPIC_SHARDS_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "spsc_ring.h"
+#include "topic_store.h"
+
+namespace rtd {
+
+    /**
+     * @brief TopicStore partitioned across independently locked shards.
+     * TopicID t lives in shard (t % Count()) at local index (t / Count()); Excel's
+     * TopicIDs are dense and sequential, so consecutive topics land on different shards
+     * and each shard's table stays dense. Every shard has its own mutex and dirty list,
+     * so producers updating topics on different shards never contend.
+     *
+     * The shard count is a power of two and is fixed by Reset, which must not race with
+     * any other use. Lock order: a thread holding several shard locks takes them in
+     * index order (see LockAll).
+     */
+    class TopicShards {
+    public:
+        static constexpr size_t kMaxShards = 64;
+
+        struct alignas(kCacheLineSize) Shard {
+            std::mutex mutex;
+            TopicStore store;           // Indexed by local id; guarded by mutex
+            std::vector<long> dueIds;   // Local ids collected by the single refreshing thread
+        };
+
+        TopicShards() { Reset(1); }
+
+        TopicShards(const TopicShards&) = delete;
+        TopicShards& operator=(const TopicShards&) = delete;
+
+        /**
+         * @brief Replaces all shards with 'count' empty ones (rounded up to a power of two,
+         * at most kMaxShards). Drops every stored value.
+         */
+        void Reset(size_t count) {
+            size_t shards = 1;
+            unsigned shift = 0;
+            while (shards < count && shards < kMaxShards) {
+                shards *= 2;
+                ++shift;
+            }
+            m_shards = std::make_unique<Shard[]>(shards);
+            m_count = shards;
+            m_shift = shift;
+        }
+
+        size_t Count() const { return m_count; }
+
+        Shard& operator[](size_t index) { return m_shards[index]; }
+
+        Shard& ShardOf(long topicId) { return m_shards[IndexOf(topicId)]; }
+        size_t IndexOf(long topicId) const { return static_cast<size_t>(topicId) & (m_count - 1); }
+        long LocalId(long topicId) const { return topicId >> m_shift; }
+        long GlobalId(size_t shard, long localId) const { return (localId << m_shift) | static_cast<long>(shard); }
+
+        void LockAll() {
+            for (size_t i = 0; i < m_count; ++i) m_shards[i].mutex.lock();
+        }
+        void UnlockAll() {
+            for (size_t i = m_count; i > 0; --i) m_shards[i - 1].mutex.unlock();
+        }
+
+        /**
+         * @brief RAII guard over every shard lock.
+         */
+        class AllLock {
+        public:
+            explicit AllLock(TopicShards& shards) : m_shards(shards) { m_shards.LockAll(); }
+            ~AllLock() { m_shards.UnlockAll(); }
+
+            AllLock(const AllLock&) = delete;
+            AllLock& operator=(const AllLock&) = delete;
+
+        private:
+            TopicShards& m_shards;
+        };
+
+    private:
+        std::unique_ptr<Shard[]> m_shards;
+        size_t m_count = 0;
+        unsigned m_shift = 0;
+    };
+
+} // namespace rtd
+
+#endif // RTD_TOPIC_SHARDS_H
@@ -0,0 +1,178 @@
+#ifndef RTD_TOPIC_STORE_H
+#define RTD_TOPIC_STORE_H
+
+#include <windows.h>
+#include <ole2.h>
+#include <vector>
+#include <cstddef>
+#include "cancellation.h"
+#include "policy.h"
+#include "value.h"
+
+namespace rtd {
+
+    /**
+     * @brief Generation-checked reference to a topic slot.
+     * Obtained from RtdServerBase::GetTopicHandle. Publishing through a handle skips
+     * the TopicID lookup, and a handle taken before DisconnectData is rejected
+     * (E_HANDLE) even if Excel later reuses the same TopicID.
+     */
+    struct TopicHandle {
+        long topicId = -1;
+        unsigned long generation = 0;
+
+        bool IsValid() const { return topicId >= 0; }
+    };
+
+    /**
+     * @brief Dense topic table indexed directly by Excel TopicID.
+     * Excel hands out small, dense TopicIDs, so a flat slot array gives O(1) lookup.
+     * Dirty topics are chained through the slots themselves (intrusive doubly-linked
+     * list), so marking, unmarking and draining are all O(1) per topic.
+     *
+     * Not thread-safe: RtdServerBase keeps one per shard (see TopicShards), guarded by the shard lock.
+     */
+    class TopicStore {
+    public:
+        // Upper bound on accepted TopicIDs; protects against runaway growth on bogus IDs.
+        static constexpr long kMaxTopicId = 1L << 24;
+        // Default bound below which updates may create slots ahead of ConnectData
+        static constexpr long kDefaultUpdateLimit = 1L << 16;
+        static constexpr long kNil = -1;
+
+        struct Slot {
+            TopicValue value;
+            unsigned long generation = 0; // Bumped on Release; invalidates outstanding handles
+            long prevDirty = kNil;
+            long nextDirty = kNil;
+            bool live = false;            // Connected (or updated ahead of ConnectData)
+            bool dirty = false;           // Linked into the dirty list
+            PolicyState policy;           // Delivery throttling for RefreshData
+            long subscription = kNil;     // Logical subscription the topic is attached to
+            CancellationSource tasks;     // Scope of executor tasks computing this topic
+        };
+
+        TopicStore() : m_dirtyHead(kNil), m_dirtyTail(kNil), m_dirtyCount(0), m_liveCount(0) {}
+        TopicStore(const TopicStore&) = delete;
+        TopicStore& operator=(const TopicStore&) = delete;
+
+        static bool IsValidId(long topicId) {
+            return topicId >= 0 && topicId < kMaxTopicId;
+        }
+
+        /**
+         * @brief Returns the live slot for a TopicID, or nullptr.
+         */
+        Slot* Find(long topicId) {
+            if (topicId < 0 || static_cast<size_t>(topicId) >= m_slots.size()) return nullptr;
+            Slot& slot = m_slots[topicId];
+            return slot.live ? &slot : nullptr;
+        }
+
+        /**
+         * @brief Returns the slot for a TopicID, growing the table and marking it live as needed.
+         * @return nullptr if the TopicID is out of range.
+         */
+        Slot* Acquire(long topicId) {
+            if (!IsValidId(topicId)) return nullptr;
+            if (static_cast<size_t>(topicId) >= m_slots.size()) Grow(topicId);
+            Slot& slot = m_slots[topicId];
+            if (!slot.live) {
+                slot.live = true;
+                slot.policy.Reset(m_defaultPolicy);
+                ++m_liveCount;
+            }
+            return &slot;
+        }
+
+        /**
+         * @brief Policy given to slots when they become live.
+         */
+        void SetDefaultPolicy(const DeliveryPolicy& policy) { m_defaultPolicy = policy; }
+        const DeliveryPolicy& DefaultPolicy() const { return m_defaultPolicy; }
+
+        /**
+         * @brief Releases a slot: clears the value, drops it from the dirty list, cancels
+         * its tasks and bumps the generation so outstanding handles become stale.
+         */
+        void Release(long topicId) {
+            Slot* slot = Find(topicId);
+            if (!slot) return;
+            Unlink(topicId);
+            slot->value.Clear();
+            slot->subscription = kNil;
+            slot->tasks.Cancel();
+            slot->live = false;
+            ++slot->generation;
+            --m_liveCount;
+        }
+
+        void MarkDirty(long topicId) {
+            Slot& slot = m_slots[topicId];
+            if (slot.dirty) return;
+            slot.dirty = true;
+            slot.prevDirty = m_dirtyTail;
+            slot.nextDirty = kNil;
+            if (m_dirtyTail != kNil) m_slots[m_dirtyTail].nextDirty = topicId;
+            else m_dirtyHead = topicId;
+            m_dirtyTail = topicId;
+            ++m_dirtyCount;
+        }
+
+        void Unlink(long topicId) {
+            Slot& slot = m_slots[topicId];
+            if (!slot.dirty) return;
+            if (slot.prevDirty != kNil) m_slots[slot.prevDirty].nextDirty = slot.nextDirty;
+            else m_dirtyHead = slot.nextDirty;
+            if (slot.nextDirty != kNil) m_slots[slot.nextDirty].prevDirty = slot.prevDirty;
+            else m_dirtyTail = slot.prevDirty;
+            slot.dirty = false;
+            slot.prevDirty = slot.nextDirty = kNil;
+            --m_dirtyCount;
+        }
+
+        /**
+         * @brief Removes and returns the oldest dirty TopicID, or kNil if none.
+         */
+        long PopDirty() {
+            long topicId = m_dirtyHead;
+            if (topicId != kNil) Unlink(topicId);
+            return topicId;
+        }
+
+        Slot& At(long topicId) { return m_slots[topicId]; }
+
+        size_t DirtyCount() const { return m_dirtyCount; }
+        size_t LiveCount() const { return m_liveCount; }
+
+        /**
+         * @brief Approximate memory held by the table: slots plus heap string buffers. O(slots).
+         */
+        size_t MemoryBytes() const {
+            size_t bytes = m_slots.capacity() * sizeof(Slot);
+            for (const Slot& slot : m_slots) bytes += slot.value.HeapBytes();
+            return bytes;
+        }
+
+    private:
+        void Grow(long topicId) {
+            size_t needed = static_cast<size_t>(topicId) + 1;
+            size_t newSize = m_slots.size() < 64 ? 64 : m_slots.size();
+            while (newSize < needed) newSize *= 2;
+            if (newSize > static_cast<size_t>(kMaxTopicId)) newSize = kMaxTopicId;
+
+            // TopicValue moves are noexcept, so reallocation moves slots without copying strings
+            m_slots.resize(newSize);
+        }
+
+        std::vector<Slot> m_slots;
+        long m_dirtyHead;
+        long m_dirtyTail;
+        size_t m_dirtyCount;
+        size_t m_liveCount;
+        DeliveryPolicy m_defaultPolicy;
+    };
+
+} // namespace rtd
+
+#endif // RTD_TOPIC_STORE_H
@@ -0,0 +1,553 @@
+#ifndef RTD_TOPIC_STREAM_H
+#define RTD_TOPIC_STREAM_H
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "executor.h"
+#include "spsc_ring.h"
+#include "timer_wheel.h"
+#include "topic_store.h"
+#include "value.h"
+
+namespace rtd {
+
+    /**
+     * @brief Size-class pool for coroutine frames.
+     * Frames are rounded up to 64-byte classes and carved out of chunks of kBlocksPerChunk
+     * blocks, so starting a stream for each of 100k topics costs a few thousand chunk
+     * allocations instead of 100k heap allocations, and a disconnected topic's frame is
+     * reused by the next one of similar size. Frames above kMaxBlock bytes go to the heap.
+     * Chunks are kept for the life of the process.
+     */
+    class FramePool {
+    public:
+        static constexpr size_t kGranularity = 64;
+        static constexpr size_t kMaxBlock = 4096;
+        static constexpr size_t kBlocksPerChunk = 64;
+
+        struct Stats {
+            size_t liveBlocks = 0; // Pooled blocks handed out
+            size_t chunks = 0;     // Chunks allocated so far
+            size_t oversized = 0;  // Live heap allocations above kMaxBlock
+        };
+
+        /**
+         * @brief The process-wide pool. Never destroyed, so frames may outlive static destructors.
+         */
+        static FramePool& Instance() {
+            static FramePool* pool = new FramePool();
+            return *pool;
+        }
+
+        /**
+         * @return nullptr if out of memory.
+         */
+        void* Allocate(size_t size) noexcept {
+            if (size == 0) size = 1;
+            if (size > kMaxBlock) {
+                void* block = ::operator new(size, std::nothrow);
+                if (block) m_oversized.fetch_add(1, std::memory_order_relaxed);
+                return block;
+            }
+            SizeClass& sizeClass = m_classes[ClassOf(size)];
+            std::lock_guard<std::mutex> lock(sizeClass.mutex);
+            if (!sizeClass.free && !Refill(sizeClass, BlockSize(size))) return nullptr;
+            FreeBlock* block = sizeClass.free;
+            sizeClass.free = block->next;
+            ++sizeClass.live;
+            return block;
+        }
+
+        void Deallocate(void* block, size_t size) noexcept {
+            if (!block) return;
+            if (size == 0) size = 1;
+            if (size > kMaxBlock) {
+                m_oversized.fetch_sub(1, std::memory_order_relaxed);
+                ::operator delete(block);
+                return;
+            }
+            SizeClass& sizeClass = m_classes[ClassOf(size)];
+            std::lock_guard<std::mutex> lock(sizeClass.mutex);
+            FreeBlock* freed = static_cast<FreeBlock*>(block);
+            freed->next = sizeClass.free;
+            sizeClass.free = freed;
+            --sizeClass.live;
+        }
+
+        Stats GetStats() {
+            Stats stats;
+            for (SizeClass& sizeClass : m_classes) {
+                std::lock_guard<std::mutex> lock(sizeClass.mutex);
+                stats.liveBlocks += sizeClass.live;
+                stats.chunks += sizeClass.chunks;
+            }
+            stats.oversized = m_oversized.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+        /**
+         * @brief Standard allocator over the pool (used for the stream control blocks).
+         */
+        template <typename T>
+        struct Allocator {
+            using value_type = T;
+
+            Allocator() = default;
+            template <typename U>
+            Allocator(const Allocator<U>&) noexcept {}
+
+            T* allocate(size_t n) {
+                void* block = Instance().Allocate(n * sizeof(T));
+                if (!block) throw std::bad_alloc();
+                return static_cast<T*>(block);
+            }
+            void deallocate(T* block, size_t n) noexcept { Instance().Deallocate(block, n * sizeof(T)); }
+
+            template <typename U>
+            bool operator==(const Allocator<U>&) const noexcept { return true; }
+        };
+
+    private:
+        static constexpr size_t kClasses = kMaxBlock / kGranularity;
+
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        struct alignas(kCacheLineSize) SizeClass {
+            std::mutex mutex;
+            FreeBlock* free = nullptr;
+            size_t live = 0;
+            size_t chunks = 0;
+        };
+
+        FramePool() = default;
+
+        static size_t ClassOf(size_t size) { return (size - 1) / kGranularity; }
+        static size_t BlockSize(size_t size) { return (ClassOf(size) + 1) * kGranularity; }
+
+        // Caller holds sizeClass.mutex.
+        static bool Refill(SizeClass& sizeClass, size_t blockSize) {
+            char* chunk = static_cast<char*>(::operator new(blockSize * kBlocksPerChunk, std::nothrow));
+            if (!chunk) return false;
+            for (size_t i = kBlocksPerChunk; i-- > 0;) {
+                FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + i * blockSize);
+                block->next = sizeClass.free;
+                sizeClass.free = block;
+            }
+            ++sizeClass.chunks;
+            return true;
+        }
+
+        SizeClass m_classes[kClasses];
+        std::atomic<size_t> m_oversized{0};
+    };
+
+    /**
+     * @brief What a running TopicStream needs from its server (implemented by RtdServerBase).
+     */
+    class StreamHost {
+    public:
+        /**
+         * @brief Publishes a yielded value and arranges for Excel to be notified.
+         * @return E_HANDLE once the topic has been disconnected.
+         */
+        virtual HRESULT PublishStreamValue(const TopicHandle& topic, TopicValue&& value) = 0;
+        virtual Executor& StreamExecutor() = 0;
+        virtual TimerWheel& StreamTimers() = 0;
+
+    protected:
+        ~StreamHost() = default;
+    };
+
+    /**
+     * @brief Coroutine producing one topic's values.
+     * Write a topic as a coroutine returning TopicStream: it may co_await rtd::Delay or a
+     * ValueChannel, and each co_yield publishes a value to the topic and carries on. Hand
+     * the coroutine to RtdServerBase::StartTopicStream; it is resumed on the server's
+     * executor (never on two threads at once) and its frame is destroyed at the next
+     * suspension point after DisconnectData or ServerTerminate, or straight away if it is
+     * already suspended. Frames come from FramePool.
+     *
+     * Take parameters by value: references (e.g. into ConnectData's TopicArgs) dangle once
+     * the caller returns. An exception escaping the body publishes #VALUE! and ends the stream.
+     *
+     *     rtd::TopicStream Clock(std::chrono::milliseconds period) {
+     *         for (long long tick = 0;; ++tick) {
+     *             co_yield tick;
+     *             co_await rtd::Delay(period);
+     *         }
+     *     }
+     */
+    class TopicStream {
+    public:
+        class Control;
+        struct promise_type;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        TopicStream() = default;
+        TopicStream(TopicStream&& other) noexcept : m_frame(std::exchange(other.m_frame, nullptr)) {}
+        TopicStream& operator=(TopicStream&& other) noexcept {
+            if (this != &other) {
+                if (m_frame) m_frame.destroy();
+                m_frame = std::exchange(other.m_frame, nullptr);
+            }
+            return *this;
+        }
+        TopicStream(const TopicStream&) = delete;
+        TopicStream& operator=(const TopicStream&) = delete;
+
+        // A stream that was never started still sits at its initial suspend point
+        ~TopicStream() {
+            if (m_frame) m_frame.destroy();
+        }
+
+        /**
+         * @brief False if the frame could not be allocated.
+         */
+        explicit operator bool() const { return static_cast<bool>(m_frame); }
+
+        /**
+         * @brief Hands the frame to a new control block bound to 'topic'. Call Start on the
+         * result to run it. Used by RtdServerBase::StartTopicStream.
+         * @return nullptr (and the stream left as it was) if out of memory.
+         */
+        std::shared_ptr<Control> Attach(StreamHost& host, const TopicHandle& topic);
+
+    private:
+        explicit TopicStream(Handle frame) : m_frame(frame) {}
+
+        Handle m_frame;
+    };
+
+    /**
+     * @brief Scheduling state of one started TopicStream, shared by the frame, the
+     * server and whatever will wake it (a timer or a ValueChannel). Outlives the frame.
+     */
+    class TopicStream::Control : public std::enable_shared_from_this<Control> {
+    public:
+        Control(StreamHost& host, const TopicHandle& topic, Handle frame)
+            : m_host(host), m_topic(topic), m_frame(frame) {}
+
+        Control(const Control&) = delete;
+        Control& operator=(const Control&) = delete;
+
+        const TopicHandle& Topic() const { return m_topic; }
+        StreamHost& Host() { return m_host; }
+
+        bool IsCancelled() const { return m_cancelled.load(std::memory_order_acquire); }
+
+        /**
+         * @brief True once the frame has been destroyed (finished, failed or cancelled).
+         */
+        bool IsDone() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_state == State::Done;
+        }
+
+        /**
+         * @brief Queues the first resumption on the executor.
+         * @return false if the executor is shutting down (the frame is destroyed).
+         */
+        bool Start() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_state != State::Created) return false;
+            return Schedule(lock);
+        }
+
+        /**
+         * @brief Stops the stream. A suspended frame is destroyed on the calling thread; a
+         * queued or running one is destroyed at its next suspension point. Callers must not
+         * hold locks the coroutine's destructors might take.
+         */
+        void Cancel() {
+            m_cancelled.store(true, std::memory_order_release);
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_state == State::Suspended || m_state == State::Created) Destroy(lock);
+        }
+
+        // --- Awaitable plumbing; called from the frame while it runs ---
+
+        /**
+         * @brief Suspends the running frame. 'arm' registers the wake-up with the current
+         * epoch (passed to Wake) and returns false if the awaited thing is already
+         * available, in which case the frame keeps running.
+         * @return true if the frame is suspended (or destroyed, when cancelled).
+         */
+        template <typename Arm>
+        bool Suspend(Arm&& arm) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (IsCancelled()) {
+                Destroy(lock);
+                return true;
+            }
+            if (!arm(++m_epoch)) return false;
+            m_state = State::Suspended;
+            return true;
+        }
+
+        /**
+         * @brief Requeues the frame if it is still suspended on the wait for 'epoch'.
+         */
+        void Wake(unsigned long epoch) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_state != State::Suspended || m_epoch != epoch) return;
+            Resume(lock);
+        }
+
+        /**
+         * @brief Arms a one-shot wake-up for the current suspension. Call from inside
+         * Suspend's 'arm'.
+         */
+        void ArmTimer(TimerWheel::Clock::time_point due) {
+            // Capturing just the control keeps the callback within std::function's inline buffer
+            m_timer = m_host.StreamTimers().ScheduleAt(due, [self = shared_from_this()]() { self->OnTimer(); });
+        }
+
+        /**
+         * @brief Final suspend: destroys the finished frame.
+         */
+        void Finish() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            Destroy(lock);
+        }
+
+    private:
+        enum class State : unsigned char { Created, Scheduled, Running, Suspended, Done };
+
+        // Runs on the executor.
+        void Run() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_state != State::Scheduled) return;
+            if (IsCancelled()) {
+                Destroy(lock);
+                return;
+            }
+            m_state = State::Running;
+            Handle frame = m_frame;
+            lock.unlock();
+            // May destroy the frame (and the promise's reference to us); our task holds another
+            frame.resume();
+        }
+
+        // Runs on the timer thread. A suspension arms at most one timer, and Destroy cancels it.
+        void OnTimer() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_state != State::Suspended || !m_timer.IsValid()) return;
+            Resume(lock);
+        }
+
+        void Resume(std::unique_lock<std::mutex>& lock) {
+            m_timer = TimerHandle();
+            if (IsCancelled()) {
+                Destroy(lock);
+                return;
+            }
+            Schedule(lock);
+        }
+
+        bool Schedule(std::unique_lock<std::mutex>& lock) {
+            m_state = State::Scheduled;
+            if (m_host.StreamExecutor().Submit([self = shared_from_this()]() { self->Run(); })) return true;
+            Destroy(lock);
+            return false;
+        }
+
+        // Caller holds m_mutex via 'lock', and a reference to this control besides the frame's.
+        void Destroy(std::unique_lock<std::mutex>& lock) {
+            if (m_state == State::Done) return;
+            m_state = State::Done;
+            Handle frame = std::exchange(m_frame, nullptr);
+            TimerHandle timer = std::exchange(m_timer, TimerHandle());
+            lock.unlock();
+            if (timer.IsValid()) m_host.StreamTimers().Cancel(timer);
+            // Locals' destructors run here, without our lock
+            if (frame) frame.destroy();
+        }
+
+        StreamHost& m_host;
+        const TopicHandle m_topic;
+        std::atomic<bool> m_cancelled{false};
+        std::mutex m_mutex;              // Guards everything below
+        State m_state = State::Created;
+        unsigned long m_epoch = 0;       // Bumped on every suspension; stale wake-ups are ignored
+        Handle m_frame;
+        TimerHandle m_timer;
+    };
+
+    struct TopicStream::promise_type {
+        std::shared_ptr<Control> control; // Set by Attach
+
+        static void* operator new(size_t size) noexcept { return FramePool::Instance().Allocate(size); }
+        static void operator delete(void* frame, size_t size) noexcept { FramePool::Instance().Deallocate(frame, size); }
+
+        static TopicStream get_return_object_on_allocation_failure() noexcept { return TopicStream(); }
+
+        TopicStream get_return_object() noexcept { return TopicStream(Handle::from_promise(*this)); }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            void await_suspend(Handle frame) noexcept {
+                // Keep the control alive past the frame, which owns a reference to it
+                std::shared_ptr<Control> control = frame.promise().control;
+                control->Finish();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        // Publishes and keeps running, unless the topic is gone or the stream was cancelled
+        struct YieldAwaiter {
+            bool stop;
+
+            bool await_ready() noexcept { return !stop; }
+            bool await_suspend(Handle frame) noexcept {
+                std::shared_ptr<Control> control = frame.promise().control;
+                return control->Suspend([](unsigned long) { return true; });
+            }
+            void await_resume() noexcept {}
+        };
+
+        YieldAwaiter yield_value(TopicValue value) {
+            HRESULT hr = control->Host().PublishStreamValue(control->Topic(), std::move(value));
+            if (hr == E_HANDLE) control->Cancel();
+            return YieldAwaiter{ control->IsCancelled() };
+        }
+        // A template so string literals still pick the TopicValue overload
+        template <typename String>
+            requires std::is_same_v<String, std::wstring>
+        YieldAwaiter yield_value(const String& value) { return yield_value(TopicValue(std::wstring_view(value))); }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {
+            control->Host().PublishStreamValue(control->Topic(), TopicValue::FromError(2015)); // xlErrValue
+        }
+    };
+
+    inline std::shared_ptr<TopicStream::Control> TopicStream::Attach(StreamHost& host, const TopicHandle& topic) {
+        if (!m_frame) return nullptr;
+        std::shared_ptr<Control> control;
+        try {
+            control = std::allocate_shared<Control>(FramePool::Allocator<Control>(), host, topic, m_frame);
+        } catch (const std::bad_alloc&) {
+            return nullptr;
+        }
+        m_frame.promise().control = control;
+        m_frame = nullptr;
+        return control;
+    }
+
+    /**
+     * @brief Awaitable that resumes a TopicStream after 'delay', on the server's timer wheel.
+     */
+    class Delay {
+    public:
+        explicit Delay(TimerWheel::Clock::duration delay) : m_due(TimerWheel::Clock::now() + delay) {}
+
+        bool await_ready() const noexcept { return m_due <= TimerWheel::Clock::now(); }
+        bool await_suspend(TopicStream::Handle frame) {
+            std::shared_ptr<TopicStream::Control> control = frame.promise().control;
+            TimerWheel::Clock::time_point due = m_due;
+            return control->Suspend([&](unsigned long) {
+                control->ArmTimer(due);
+                return true;
+            });
+        }
+        void await_resume() const noexcept {}
+
+    private:
+        TimerWheel::Clock::time_point m_due;
+    };
+
+    /**
+     * @brief Conflating single-consumer mailbox feeding a TopicStream.
+     * Producers on any thread Push values; the stream's 'co_await channel.Next()' returns
+     * the latest one, suspending until there is one. Values pushed while the stream is busy
+     * overwrite each other, so a slow topic always sees the newest value. Share it between
+     * the feed and the coroutine through a shared_ptr passed by value.
+     */
+    template <typename T>
+    class ValueChannel {
+    public:
+        ValueChannel() = default;
+        ValueChannel(const ValueChannel&) = delete;
+        ValueChannel& operator=(const ValueChannel&) = delete;
+
+        void Push(T value) {
+            std::shared_ptr<TopicStream::Control> waiter;
+            unsigned long epoch = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_value = std::move(value);
+                waiter = std::move(m_waiter);
+                epoch = m_epoch;
+            }
+            if (waiter) waiter->Wake(epoch);
+        }
+
+        class NextAwaiter {
+        public:
+            explicit NextAwaiter(ValueChannel& channel) : m_channel(channel) {}
+
+            bool await_ready() { return m_channel.TryTake(m_value); }
+            bool await_suspend(TopicStream::Handle frame) {
+                std::shared_ptr<TopicStream::Control> control = frame.promise().control;
+                // Lock order: control, then channel (Push wakes after releasing the channel)
+                return control->Suspend([&](unsigned long epoch) {
+                    std::lock_guard<std::mutex> lock(m_channel.m_mutex);
+                    if (m_channel.m_value) {
+                        m_value = std::move(m_channel.m_value);
+                        m_channel.m_value.reset();
+                        return false;
+                    }
+                    m_channel.m_waiter = control;
+                    m_channel.m_epoch = epoch;
+                    return true;
+                });
+            }
+            T await_resume() {
+                if (!m_value) m_channel.TryTake(m_value);
+                return std::move(*m_value);
+            }
+
+        private:
+            ValueChannel& m_channel;
+            std::optional<T> m_value;
+        };
+
+        /**
+         * @brief Awaitable returning the next value. Only one stream may wait at a time.
+         */
+        NextAwaiter Next() { return NextAwaiter(*this); }
+
+    private:
+        bool TryTake(std::optional<T>& out) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_value) return false;
+            out = std::move(m_value);
+            m_value.reset();
+            return true;
+        }
+
+        std::mutex m_mutex;
+        std::optional<T> m_value;
+        std::shared_ptr<TopicStream::Control> m_waiter;
+        unsigned long m_epoch = 0;
+    };
+
+} // namespace rtd
+
+#endif // RTD_TOPIC_STREAM_H
@@ -0,0 +1,351 @@
+#ifndef RTD_VALUE_H
+#define RTD_VALUE_H
+
+#include <windows.h>
+#include <ole2.h>
+#include <string_view>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace rtd {
+
+    /**
+     * @brief Compact tagged topic value.
+     * Stores numbers, booleans, Excel errors and strings without building a VARIANT;
+     * strings up to kInlineChars are kept inline, longer ones in a heap buffer that is
+     * reused when a later value fits. The VARIANT (and BSTR) is only created by CopyTo /
+     * MoveTo when RefreshData actually delivers the value. Anything else (dates,
+     * currency, arrays, ...) is kept as a VARIANT.
+     */
+    class TopicValue {
+    public:
+        enum class Type : unsigned char { Empty, Double, Int64, Bool, Error, String, Variant };
+
+        // Inline string capacity: the bytes a VARIANT would have used.
+        static constexpr size_t kInlineChars = sizeof(VARIANT) / sizeof(wchar_t);
+
+        TopicValue() : m_type(Type::Empty), m_heapString(false), m_inlineLength(0) {
+            m_data.int64 = 0;
+        }
+
+        TopicValue(double value) : TopicValue() { Assign(value); }
+        TopicValue(int value) : TopicValue() { Assign(static_cast<long long>(value)); }
+        TopicValue(long value) : TopicValue() { Assign(static_cast<long long>(value)); }
+        TopicValue(long long value) : TopicValue() { Assign(value); }
+        TopicValue(bool value) : TopicValue() { Assign(value); }
+        TopicValue(std::wstring_view value) : TopicValue() { Assign(value); }
+        TopicValue(const wchar_t* value) : TopicValue() { Assign(std::wstring_view(value ? value : L"")); }
+
+        static TopicValue FromError(SCODE code) {
+            TopicValue value;
+            value.SetError(code);
+            return value;
+        }
+
+        TopicValue(const TopicValue& other) : TopicValue() { Assign(other); }
+
+        TopicValue(TopicValue&& other) noexcept : TopicValue() { Steal(other); }
+
+        TopicValue& operator=(const TopicValue& other) {
+            if (this != &other) Assign(other);
+            return *this;
+        }
+
+        TopicValue& operator=(TopicValue&& other) noexcept {
+            if (this != &other) {
+                Clear();
+                Steal(other);
+            }
+            return *this;
+        }
+
+        ~TopicValue() { Clear(); }
+
+        Type GetType() const { return m_type; }
+        bool IsEmpty() const { return m_type == Type::Empty; }
+
+        double AsDouble() const { return m_data.dbl; }
+        long long AsInt64() const { return m_data.int64; }
+        bool AsBool() const { return m_data.boolean; }
+        SCODE AsError() const { return m_data.error; }
+        std::wstring_view AsString() const {
+            return m_heapString ? std::wstring_view(m_data.heap.chars, m_data.heap.length)
+                                : std::wstring_view(m_data.inlineChars, m_inlineLength);
+        }
+        const VARIANT& AsVariant() const { return m_data.variant; }
+
+        /**
+         * @brief Reads Double and Int64 values as a double.
+         * @return false for every other type.
+         */
+        bool AsNumber(double& number) const {
+            if (m_type == Type::Double) number = m_data.dbl;
+            else if (m_type == Type::Int64) number = static_cast<double>(m_data.int64);
+            else return false;
+            return true;
+        }
+
+        /**
+         * @brief Bytes held outside the object (heap string buffer); VARIANT payloads are not counted.
+         */
+        size_t HeapBytes() const {
+            return m_heapString ? static_cast<size_t>(m_data.heap.capacity) * sizeof(wchar_t) : 0;
+        }
+
+        // --- Comparison (used for change detection; a held VARIANT never compares equal) ---
+
+        bool Equals(double value) const { return m_type == Type::Double && m_data.dbl == value; }
+        bool Equals(long long value) const { return m_type == Type::Int64 && m_data.int64 == value; }
+        bool Equals(bool value) const { return m_type == Type::Bool && m_data.boolean == value; }
+        bool Equals(std::wstring_view value) const { return m_type == Type::String && AsString() == value; }
+
+        bool Equals(const VARIANT& value) const {
+            switch (value.vt) {
+            case VT_EMPTY: return m_type == Type::Empty;
+            case VT_R8: return Equals(value.dblVal);
+            case VT_R4: return Equals(static_cast<double>(value.fltVal));
+            case VT_I4: return Equals(static_cast<long long>(value.lVal));
+            case VT_I2: return Equals(static_cast<long long>(value.iVal));
+            case VT_I8: return Equals(static_cast<long long>(value.llVal));
+            case VT_INT: return Equals(static_cast<long long>(value.intVal));
+            case VT_BOOL: return Equals(value.boolVal != VARIANT_FALSE);
+            case VT_ERROR: return m_type == Type::Error && m_data.error == value.scode;
+            case VT_BSTR: return Equals(std::wstring_view(value.bstrVal ? value.bstrVal : L"", SysStringLen(value.bstrVal)));
+            default: return false;
+            }
+        }
+
+        bool Equals(const TopicValue& other) const {
+            switch (other.m_type) {
+            case Type::Empty: return m_type == Type::Empty;
+            case Type::Double: return Equals(other.m_data.dbl);
+            case Type::Int64: return Equals(other.m_data.int64);
+            case Type::Bool: return Equals(other.m_data.boolean);
+            case Type::Error: return m_type == Type::Error && m_data.error == other.m_data.error;
+            case Type::String: return Equals(other.AsString());
+            case Type::Variant: return false;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Releases held resources. A heap string buffer is freed as well.
+         */
+        void Clear() {
+            if (m_type == Type::Variant) VariantClear(&m_data.variant);
+            if (m_heapString) delete[] m_data.heap.chars;
+            m_heapString = false;
+            m_inlineLength = 0;
+            m_type = Type::Empty;
+            m_data.int64 = 0;
+        }
+
+        // --- Assignment (returns E_OUTOFMEMORY if a buffer or VARIANT copy fails) ---
+
+        HRESULT Assign(double value) {
+            Reset(Type::Double);
+            m_data.dbl = value;
+            return S_OK;
+        }
+
+        HRESULT Assign(long long value) {
+            Reset(Type::Int64);
+            m_data.int64 = value;
+            return S_OK;
+        }
+
+        HRESULT Assign(bool value) {
+            Reset(Type::Bool);
+            m_data.boolean = value;
+            return S_OK;
+        }
+
+        HRESULT SetError(SCODE code) {
+            Reset(Type::Error);
+            m_data.error = code;
+            return S_OK;
+        }
+
+        HRESULT Assign(std::wstring_view value) {
+            if (m_type == Type::Variant) VariantClear(&m_data.variant);
+
+            // Reuse an existing heap buffer if it is large enough
+            if (m_heapString && value.size() <= m_data.heap.capacity) {
+                std::memmove(m_data.heap.chars, value.data(), value.size() * sizeof(wchar_t));
+                m_data.heap.length = static_cast<unsigned int>(value.size());
+                m_type = Type::String;
+                return S_OK;
+            }
+
+            if (value.size() <= kInlineChars) {
+                if (m_heapString) delete[] m_data.heap.chars;
+                m_heapString = false;
+                std::memmove(m_data.inlineChars, value.data(), value.size() * sizeof(wchar_t));
+                m_inlineLength = static_cast<unsigned char>(value.size());
+                m_type = Type::String;
+                return S_OK;
+            }
+
+            wchar_t* chars = new (std::nothrow) wchar_t[value.size()];
+            if (!chars) return E_OUTOFMEMORY;
+            std::memcpy(chars, value.data(), value.size() * sizeof(wchar_t));
+            if (m_heapString) delete[] m_data.heap.chars;
+            m_heapString = true;
+            m_data.heap.chars = chars;
+            m_data.heap.length = static_cast<unsigned int>(value.size());
+            m_data.heap.capacity = static_cast<unsigned int>(value.size());
+            m_type = Type::String;
+            return S_OK;
+        }
+
+        /**
+         * @brief Stores a VARIANT, unpacking the common scalar types into the compact form.
+         */
+        HRESULT Assign(const VARIANT& value) {
+            switch (value.vt) {
+            case VT_EMPTY: Reset(Type::Empty); return S_OK;
+            case VT_R8: return Assign(value.dblVal);
+            case VT_R4: return Assign(static_cast<double>(value.fltVal));
+            case VT_I4: return Assign(static_cast<long long>(value.lVal));
+            case VT_I2: return Assign(static_cast<long long>(value.iVal));
+            case VT_I8: return Assign(static_cast<long long>(value.llVal));
+            case VT_INT: return Assign(static_cast<long long>(value.intVal));
+            case VT_BOOL: return Assign(value.boolVal != VARIANT_FALSE);
+            case VT_ERROR: return SetError(value.scode);
+            case VT_BSTR: return Assign(std::wstring_view(value.bstrVal ? value.bstrVal : L"", SysStringLen(value.bstrVal)));
+            default: break;
+            }
+            VARIANT copy;
+            VariantInit(&copy);
+            HRESULT hr = VariantCopy(&copy, const_cast<VARIANT*>(&value));
+            if (FAILED(hr)) return hr;
+            Reset(Type::Variant);
+            m_data.variant = copy;
+            return S_OK;
+        }
+
+        HRESULT Assign(const TopicValue& other) {
+            switch (other.m_type) {
+            case Type::Empty: Reset(Type::Empty); return S_OK;
+            case Type::Double: return Assign(other.m_data.dbl);
+            case Type::Int64: return Assign(other.m_data.int64);
+            case Type::Bool: return Assign(other.m_data.boolean);
+            case Type::Error: return SetError(other.m_data.error);
+            case Type::String: return Assign(other.AsString());
+            case Type::Variant: return Assign(other.m_data.variant);
+            }
+            return E_UNEXPECTED;
+        }
+
+        HRESULT Assign(TopicValue&& other) {
+            *this = std::move(other);
+            return S_OK;
+        }
+
+        // --- Materialization ---
+
+        /**
+         * @brief Writes the value into an empty VARIANT, allocating a BSTR for strings.
+         * Int64 values are delivered as VT_I4 when they fit and as VT_R8 otherwise,
+         * since Excel does not accept VT_I8 from RTD servers.
+         */
+        HRESULT CopyTo(VARIANT* out) const {
+            switch (m_type) {
+            case Type::Empty:
+                out->vt = VT_EMPTY;
+                return S_OK;
+            case Type::Double:
+                out->vt = VT_R8;
+                out->dblVal = m_data.dbl;
+                return S_OK;
+            case Type::Int64:
+                if (m_data.int64 >= -2147483647LL - 1 && m_data.int64 <= 2147483647LL) {
+                    out->vt = VT_I4;
+                    out->lVal = static_cast<long>(m_data.int64);
+                } else {
+                    out->vt = VT_R8;
+                    out->dblVal = static_cast<double>(m_data.int64);
+                }
+                return S_OK;
+            case Type::Bool:
+                out->vt = VT_BOOL;
+                out->boolVal = m_data.boolean ? VARIANT_TRUE : VARIANT_FALSE;
+                return S_OK;
+            case Type::Error:
+                out->vt = VT_ERROR;
+                out->scode = m_data.error;
+                return S_OK;
+            case Type::String: {
+                std::wstring_view text = AsString();
+                BSTR bstr = SysAllocStringLen(text.data(), static_cast<UINT>(text.size()));
+                if (!bstr) return E_OUTOFMEMORY;
+                out->vt = VT_BSTR;
+                out->bstrVal = bstr;
+                return S_OK;
+            }
+            case Type::Variant:
+                return VariantCopy(out, const_cast<VARIANT*>(&m_data.variant));
+            }
+            return E_UNEXPECTED;
+        }
+
+        /**
+         * @brief Like CopyTo, but leaves this value empty, transferring a held VARIANT without copying.
+         */
+        HRESULT MoveTo(VARIANT* out) {
+            if (m_type == Type::Variant) {
+                *out = m_data.variant;
+                m_type = Type::Empty;
+                m_data.int64 = 0;
+                return S_OK;
+            }
+            HRESULT hr = CopyTo(out);
+            Clear();
+            return hr;
+        }
+
+    private:
+        // Switches to a non-string type, releasing a held VARIANT or heap buffer.
+        void Reset(Type type) {
+            if (m_type == Type::Variant) VariantClear(&m_data.variant);
+            if (m_heapString) {
+                delete[] m_data.heap.chars;
+                m_heapString = false;
+            }
+            m_inlineLength = 0;
+            m_type = type;
+        }
+
+        void Steal(TopicValue& other) {
+            m_type = other.m_type;
+            m_heapString = other.m_heapString;
+            m_inlineLength = other.m_inlineLength;
+            std::memcpy(&m_data, &other.m_data, sizeof(m_data));
+            other.m_type = Type::Empty;
+            other.m_heapString = false;
+            other.m_inlineLength = 0;
+            other.m_data.int64 = 0;
+        }
+
+        union Data {
+            double dbl;
+            long long int64;
+            bool boolean;
+            SCODE error;
+            wchar_t inlineChars[kInlineChars];
+            struct {
+                wchar_t* chars;
+                unsigned int length;
+                unsigned int capacity;
+            } heap;
+            VARIANT variant;
+        } m_data;
+        Type m_type;
+        bool m_heapString;            // m_data.heap owns the string buffer
+        unsigned char m_inlineLength;
+    };
+
+} // namespace rtd
+
+#endif // RTD_VALUE_H
@@ -0,0 +1,128 @@
+#ifndef RTD_XLCALL_H
+#define RTD_XLCALL_H
+
+#include <windows.h>
+
+// Excel 12 (2007+) C API definitions, laid out as in the Microsoft Excel XLL SDK's xlcall.h.
+// The full union matters: Excel hands out xltypeMulti arrays of these, so the element size
+// must match Excel's. If the SDK header was included first, its definitions are used.
+
+#ifndef xltypeNum
+
+typedef wchar_t XCHAR;
+typedef INT32 RW;
+typedef INT32 COL;
+typedef DWORD_PTR IDSHEET;
+
+typedef struct xlref12 {
+    RW rwFirst;
+    RW rwLast;
+    COL colFirst;
+    COL colLast;
+} XLREF12, *LPXLREF12;
+
+typedef struct xlmref12 {
+    WORD count;
+    XLREF12 reftbl[1]; // Actually reftbl[count]
+} XLMREF12, *LPXLMREF12;
+
+typedef struct xloper12 {
+    union {
+        double num;
+        XCHAR *str;       // Length-prefixed: str[0] is the length
+        BOOL xbool;
+        int err;
+        int w;
+        struct {
+            WORD count;   // Always 1
+            XLREF12 ref;
+        } sref;
+        struct {
+            XLMREF12 *lpmref;
+            IDSHEET idSheet;
+        } mref;
+        struct {
+            struct xloper12 *lparray;
+            RW rows;
+            COL columns;
+        } array;
+        struct {
+            union {
+                int level;
+                int tbctrl;
+                IDSHEET idSheet;
+            } valflow;
+            RW rw;
+            COL col;
+            BYTE xlflow;
+        } flow;
+        struct {
+            union {
+                BYTE *lpbData;
+                HANDLE hdata;
+            } h;
+            long cbData;
+        } bigdata;
+    } val;
+    DWORD xltype;
+} XLOPER12, *LPXLOPER12;
+
+// XLOPER12 types
+#define xltypeNum      0x0001
+#define xltypeStr      0x0002
+#define xltypeBool     0x0004
+#define xltypeRef      0x0008
+#define xltypeErr      0x0010
+#define xltypeFlow     0x0020
+#define xltypeMulti    0x0040
+#define xltypeMissing  0x0080
+#define xltypeNil      0x0100
+#define xltypeSRef     0x0400
+#define xltypeInt      0x0800
+#define xlbitXLFree    0x1000
+#define xlbitDLLFree   0x4000
+#define xltypeBigData  (xltypeStr | xltypeInt)
+
+// Error codes (val.err)
+#define xlerrNull        0
+#define xlerrDiv0        7
+#define xlerrValue       15
+#define xlerrRef         23
+#define xlerrName        29
+#define xlerrNum         36
+#define xlerrNA          42
+#define xlerrGettingData 43
+
+// Excel12 return codes
+#define xlretSuccess       0
+#define xlretAbort         1
+#define xlretInvXlfn       2
+#define xlretInvCount      4
+#define xlretInvXloper     8
+#define xlretStackOvfl     16
+#define xlretFailed        32
+#define xlretUncalced      64
+#define xlretNotThreadSafe 128
+#define xlretInvAsynchronousContext 256
+#define xlretNotClusterSafe 512
+
+// Function numbers used by the library and examples
+#define xlCommand      0x8000
+#define xlSpecial      0x4000
+#define xlIntl         0x2000
+#define xlPrompt       0x1000
+
+#define xlFree         (0 | xlSpecial)
+#define xlCoerce       (2 | xlSpecial)
+#define xlGetName      (9 | xlSpecial)
+
+#define xlfCaller      89
+#define xlfRegister    149
+#define xlfRtd         379
+
+// Excel's callback, exported by the host process as MdCallBack12 (EXCEL12PROC in the SDK)
+typedef int (__stdcall *PEXCEL12)(int xlfn, int count, LPXLOPER12 opers[], LPXLOPER12 operRes);
+
+#endif // xltypeNum
+
+#endif // RTD_XLCALL_H
@@ -0,0 +1,505 @@
+#ifndef RTD_XLL_H
+#define RTD_XLL_H
+
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "result_cache.h"
+#include "xlcall.h"
+
+namespace rtd {
+
+    // --- Calling Excel ---
+
+    /**
+     * @brief Replaces the Excel12 entry point, e.g. with a stub in tests. nullptr restores
+     * the lookup of MdCallBack12 in the host process, as the SDK's xlcall.cpp does.
+     */
+    inline std::atomic<PEXCEL12>& Excel12Entry() {
+        static std::atomic<PEXCEL12> entry{ nullptr };
+        return entry;
+    }
+
+    inline int Excel12v(int xlfn, LPXLOPER12 result, int count, LPXLOPER12 opers[]) {
+        PEXCEL12 entry = Excel12Entry().load(std::memory_order_acquire);
+        if (!entry) {
+            static const PEXCEL12 loaded = []() -> PEXCEL12 {
+                HMODULE host = GetModuleHandleW(nullptr);
+                return host ? reinterpret_cast<PEXCEL12>(GetProcAddress(host, "MdCallBack12")) : nullptr;
+            }();
+            entry = loaded;
+        }
+        if (!entry) return xlretFailed;
+        return entry(xlfn, count, opers, result);
+    }
+
+    /**
+     * @brief Calls Excel with the arguments in a stack array (no allocation).
+     */
+    template <typename... Opers>
+    int Excel12(int xlfn, LPXLOPER12 result, Opers... opers) {
+        LPXLOPER12 list[sizeof...(Opers) + 1] = { opers... };
+        return Excel12v(xlfn, result, static_cast<int>(sizeof...(Opers)), list);
+    }
+
+    // --- Arena for XLOPER12 temporaries and results ---
+
+    /**
+     * @brief Per-thread bump allocator for the XLOPER12s and strings a worksheet function
+     * builds. Memory is handed back in stack order, never freed to the heap, so once a
+     * thread's arena has grown to its working size, functions returning strings and arrays
+     * run without heap allocation. Use it through XlFrame.
+     */
+    class XlArena {
+    public:
+        static constexpr size_t kBlockSize = 64 * 1024;
+        static constexpr size_t kAlignment = 16;
+
+        struct Mark {
+            size_t block = 0;
+            size_t used = 0;
+        };
+
+        XlArena() = default;
+        XlArena(const XlArena&) = delete;
+        XlArena& operator=(const XlArena&) = delete;
+
+        /**
+         * @brief The calling thread's arena. Each Excel calculation thread gets its own.
+         */
+        static XlArena& Current() {
+            thread_local XlArena arena;
+            return arena;
+        }
+
+        /**
+         * @return Zeroed memory aligned to kAlignment, or nullptr if the heap is exhausted.
+         */
+        void* Allocate(size_t bytes) {
+            bytes = (bytes + kAlignment - 1) & ~(kAlignment - 1);
+            while (m_block < m_blocks.size()) {
+                Block& block = m_blocks[m_block];
+                if (block.size - m_used >= bytes) {
+                    void* memory = block.data.get() + m_used;
+                    m_used += bytes;
+                    std::memset(memory, 0, bytes);
+                    return memory;
+                }
+                ++m_block; // Blocks past the current one are free; try the next
+                m_used = 0;
+            }
+            size_t size = bytes > kBlockSize ? bytes : kBlockSize;
+            Block block;
+            block.data.reset(new (std::nothrow) unsigned char[size]);
+            if (!block.data) return nullptr;
+            block.size = size;
+            m_blocks.push_back(std::move(block));
+            m_block = m_blocks.size() - 1;
+            m_used = bytes;
+            std::memset(m_blocks.back().data.get(), 0, bytes);
+            return m_blocks.back().data.get();
+        }
+
+        Mark Position() const { return { m_block, m_used }; }
+
+        /**
+         * @brief Frees everything allocated since mark.
+         */
+        void Rewind(const Mark& mark) {
+            m_block = mark.block;
+            m_used = mark.used;
+        }
+
+        void Reset() { Rewind(Mark()); }
+
+        /**
+         * @brief True if p lies in this arena's memory.
+         */
+        bool Owns(const void* p) const {
+            const unsigned char* bytes = static_cast<const unsigned char*>(p);
+            for (const Block& block : m_blocks) {
+                if (bytes >= block.data.get() && bytes < block.data.get() + block.size) return true;
+            }
+            return false;
+        }
+
+        size_t Capacity() const {
+            size_t capacity = 0;
+            for (const Block& block : m_blocks) capacity += block.size;
+            return capacity;
+        }
+
+    private:
+        friend class XlFrame;
+
+        struct Block {
+            std::unique_ptr<unsigned char[]> data;
+            size_t size = 0;
+        };
+
+        std::vector<Block> m_blocks;
+        size_t m_block = 0; // Block being filled
+        size_t m_used = 0;  // Bytes used in it
+        int m_depth = 0;    // Open XlFrames on this thread
+    };
+
+    /**
+     * @brief Scope of one worksheet-function call in the thread's XlArena.
+     *
+     *   extern "C" LPXLOPER12 WINAPI MyName(LPXLOPER12 first) {
+     *       rtd::XlFrame frame;
+     *       return frame.Return(frame.String(L"..."));
+     *   }
+     *
+     * Everything the frame allocates is released when it ends, except a result passed to
+     * Return: that is flagged xlbitDLLFree and stays until Excel has copied it and calls
+     * xlAutoFree12 (forward it to XlAutoFree12). Frames nest, so a function can be
+     * re-entered through Excel12. When the outermost frame of a thread opens, any result
+     * Excel never freed is reclaimed.
+     *
+     * The returned XLOPER12s point into the arena, so a frame's results must not be kept
+     * past the call.
+     */
+    class XlFrame {
+    public:
+        XlFrame() : m_arena(XlArena::Current()) {
+            if (m_arena.m_depth++ == 0) m_arena.Reset();
+            m_mark = m_arena.Position();
+        }
+
+        ~XlFrame() {
+            --m_arena.m_depth;
+            if (!m_returned) m_arena.Rewind(m_mark);
+        }
+
+        XlFrame(const XlFrame&) = delete;
+        XlFrame& operator=(const XlFrame&) = delete;
+
+        /**
+         * @brief A temporary XLOPER12 (xltypeNil), e.g. an argument for Excel12.
+         * @return nullptr if memory runs out.
+         */
+        LPXLOPER12 Oper() {
+            Result* result = Allocate<Result>();
+            if (!result) return nullptr;
+            result->oper.xltype = xltypeNil;
+            return &result->oper;
+        }
+
+        /**
+         * @brief A string XLOPER12; text beyond 32767 characters is cut off.
+         */
+        LPXLOPER12 String(std::wstring_view text) {
+            Result* result = Allocate<Result>();
+            if (!result) return nullptr;
+            if (!SetString(result->oper, text)) return nullptr;
+            return &result->oper;
+        }
+
+        LPXLOPER12 Number(double value) {
+            LPXLOPER12 oper = Oper();
+            if (!oper) return nullptr;
+            oper->xltype = xltypeNum;
+            oper->val.num = value;
+            return oper;
+        }
+
+        LPXLOPER12 Error(int error) {
+            LPXLOPER12 oper = Oper();
+            if (!oper) return nullptr;
+            oper->xltype = xltypeErr;
+            oper->val.err = error;
+            return oper;
+        }
+
+        /**
+         * @brief An xltypeMulti with rows x columns xltypeNil cells, filled by the caller
+         * (SetString puts string cells' text in the arena too).
+         */
+        LPXLOPER12 Multi(RW rows, COL columns) {
+            if (rows <= 0 || columns <= 0 || rows > ResultMatrix::kMaxRows || columns > ResultMatrix::kMaxColumns) return nullptr;
+            Result* result = Allocate<Result>();
+            size_t count = static_cast<size_t>(rows) * static_cast<size_t>(columns);
+            LPXLOPER12 cells = result ? static_cast<LPXLOPER12>(m_arena.Allocate(count * sizeof(XLOPER12))) : nullptr;
+            if (!cells) return nullptr;
+            for (size_t i = 0; i < count; ++i) cells[i].xltype = xltypeNil;
+            result->oper.xltype = xltypeMulti;
+            result->oper.val.array.lparray = cells;
+            result->oper.val.array.rows = rows;
+            result->oper.val.array.columns = columns;
+            return &result->oper;
+        }
+
+        /**
+         * @brief Makes oper a string held in the arena.
+         * @return false if memory runs out (oper is left unchanged).
+         */
+        bool SetString(XLOPER12& oper, std::wstring_view text) {
+            if (text.size() > ResultMatrix::kMaxText) text = text.substr(0, ResultMatrix::kMaxText);
+            XCHAR* buffer = static_cast<XCHAR*>(m_arena.Allocate((text.size() + 1) * sizeof(XCHAR)));
+            if (!buffer) return false;
+            buffer[0] = static_cast<XCHAR>(text.size());
+            std::copy(text.begin(), text.end(), buffer + 1);
+            oper.xltype = xltypeStr;
+            oper.val.str = buffer;
+            return true;
+        }
+
+        /**
+         * @brief Hands result (from this frame) to Excel: flags it xlbitDLLFree and keeps the
+         * frame's memory until XlAutoFree12. A null result (out of memory) becomes #NUM!.
+         */
+        LPXLOPER12 Return(LPXLOPER12 result) {
+            if (!result) {
+                thread_local XLOPER12 failed;
+                failed.xltype = xltypeErr;
+                failed.val.err = xlerrNum;
+                return &failed;
+            }
+            Result* owner = reinterpret_cast<Result*>(reinterpret_cast<unsigned char*>(result) - offsetof(Result, oper));
+            owner->magic = Result::kMagic;
+            owner->mark = m_mark;
+            result->xltype |= xlbitDLLFree;
+            m_returned = true;
+            return result;
+        }
+
+    private:
+        friend bool XlAutoFree12(LPXLOPER12 result);
+
+        // Every XLOPER12 a frame hands out is preceded by the mark Return rewinds to
+        struct Result {
+            static constexpr uint32_t kMagic = 0x584C4652; // "XLFR"
+            uint32_t magic;
+            XlArena::Mark mark;
+            XLOPER12 oper;
+        };
+
+        template <typename T>
+        T* Allocate() { return static_cast<T*>(m_arena.Allocate(sizeof(T))); }
+
+        XlArena& m_arena;
+        XlArena::Mark m_mark;
+        bool m_returned = false;
+    };
+
+    /**
+     * @brief The XLL's xlAutoFree12: releases results from XlFrame::Return and
+     * XlResultSlot::Resolve on the calling thread.
+     *
+     *   extern "C" void WINAPI xlAutoFree12(LPXLOPER12 p) { rtd::XlAutoFree12(p); }
+     *
+     * @return false if result came from neither (the caller frees it itself).
+     */
+    inline bool XlAutoFree12(LPXLOPER12 result) {
+        if (!result) return false;
+        if (XlResultSlot::Release(result)) return true;
+        XlArena& arena = XlArena::Current();
+        if (!arena.Owns(result)) return false;
+        XlFrame::Result* owner =
+            reinterpret_cast<XlFrame::Result*>(reinterpret_cast<unsigned char*>(result) - offsetof(XlFrame::Result, oper));
+        if (owner->magic != XlFrame::Result::kMagic) return false;
+        owner->magic = 0;
+        arena.Rewind(owner->mark);
+        return true;
+    }
+
+    // --- Registration ---
+
+    /**
+     * @brief One worksheet function for RegisterFunctions. Usually a constexpr table:
+     *
+     *   constexpr rtd::XlFunction kFunctions[] = {
+     *       { L"MyHello", L"Q$" },
+     *       { L"MyMatrix", L"QQ$", L"handle", L"My Add-in", L"Returns the array behind a handle" },
+     *   };
+     */
+    struct XlFunction {
+        std::wstring_view name;       // Exported procedure, also the worksheet name unless sheetName is set
+        std::wstring_view type;       // Type text, e.g. L"QQ$"
+        std::wstring_view arguments;  // Argument names shown by the function wizard, comma-separated
+        std::wstring_view category;
+        std::wstring_view help;
+        std::wstring_view sheetName;
+    };
+
+    /**
+     * @brief Registers a table of functions with xlfRegister in one pass, typically from
+     * xlAutoOpen. The strings are built in the thread's XlArena, not on the heap.
+     * @return The number of functions Excel accepted.
+     */
+    inline size_t RegisterFunctions(std::span<const XlFunction> functions) {
+        XlFrame frame;
+        LPXLOPER12 dll = frame.Oper();
+        if (!dll || Excel12(xlGetName, dll) != xlretSuccess) return 0;
+
+        XLOPER12 macroType = {};
+        macroType.xltype = xltypeNum;
+        macroType.val.num = 1; // Worksheet function
+        XLOPER12 missing = {};
+        missing.xltype = xltypeMissing;
+
+        size_t registered = 0;
+        for (const XlFunction& function : functions) {
+            XlArena::Mark mark = XlArena::Current().Position();
+            LPXLOPER12 procedure = frame.String(function.name);
+            LPXLOPER12 type = frame.String(function.type);
+            LPXLOPER12 sheetName = frame.String(function.sheetName.empty() ? function.name : function.sheetName);
+            LPXLOPER12 arguments = frame.String(function.arguments);
+            LPXLOPER12 category = frame.String(function.category);
+            LPXLOPER12 help = frame.String(function.help);
+            if (!procedure || !type || !sheetName || !arguments || !category || !help) break;
+
+            XLOPER12 id = {};
+            int rc = Excel12(xlfRegister, &id, dll, procedure, type, sheetName, arguments, &macroType, category,
+                             &missing, &missing, help);
+            if (rc == xlretSuccess && (id.xltype & ~static_cast<DWORD>(xlbitXLFree | xlbitDLLFree)) == xltypeNum) ++registered;
+            XlArena::Current().Rewind(mark);
+        }
+
+        Excel12(xlFree, nullptr, dll);
+        return registered;
+    }
+
+    // --- RTD wrapper functions ---
+
+    /**
+     * @brief Calls RTD for a fixed ProgID from a worksheet function, so a workbook can use
+     * =MyQuote("AAPL", "Last") instead of =RTD("My.Progid",, "quote", "AAPL", "Last"):
+     *
+     *   static const rtd::XlRtdFunction g_quote(L"My.Progid");
+     *   extern "C" LPXLOPER12 WINAPI MyQuote(LPXLOPER12 symbol, LPXLOPER12 field) {   // registered "QQQ$"
+     *       return g_quote(L"quote", *symbol, *field);
+     *   }
+     *
+     * The ProgID and server XLOPER12s are built once and only read afterwards. Topic
+     * arguments that are strings are passed to Excel as they are; numbers, booleans and
+     * empty arguments are converted to text (numbers in their shortest round-trip form) in
+     * the calling thread's XlArena, as are wide-string topics. Calls therefore take no lock
+     * and allocate nothing once the thread's arena has warmed up, and the function can be
+     * registered thread-safe ('$') for multithreaded recalculation.
+     *
+     * An error argument is returned as is, any other argument (an array, a reference not
+     * dereferenced by 'Q') gives #VALUE!, and a failed xlfRtd call gives #N/A. The result
+     * Excel returns is handed back flagged xlbitXLFree, so Excel frees it itself.
+     */
+    class XlRtdFunction {
+    public:
+        static constexpr size_t kMaxTopics = 253; // Excel12 takes 255 arguments
+
+        /**
+         * @param server Computer running the server; empty for this one (the usual case).
+         */
+        explicit XlRtdFunction(std::wstring_view progId, std::wstring_view server = std::wstring_view())
+            : m_progIdText(Prefixed(progId)), m_serverText(Prefixed(server)) {
+            m_progId.xltype = xltypeStr;
+            m_progId.val.str = m_progIdText.data();
+            m_server.xltype = xltypeStr;
+            m_server.val.str = m_serverText.data();
+        }
+
+        XlRtdFunction(const XlRtdFunction&) = delete;
+        XlRtdFunction& operator=(const XlRtdFunction&) = delete;
+
+        /**
+         * @brief Calls RTD with the topics (XLOPER12s, std::wstring_view or wide-string literals).
+         * @return The RTD value for Excel, in the calling thread's result slot.
+         */
+        template <typename... Topics>
+        LPXLOPER12 operator()(const Topics&... topics) const {
+            static_assert(sizeof...(Topics) >= 1 && sizeof...(Topics) <= kMaxTopics, "RTD takes 1 to 253 topics");
+            XlFrame frame;
+            int error = -1;
+            LPXLOPER12 opers[sizeof...(Topics) + 2] = { const_cast<LPXLOPER12>(&m_progId), const_cast<LPXLOPER12>(&m_server),
+                                                         TopicOper(frame, topics, error)... };
+            XLOPER12& result = ResultSlot();
+            if (error >= 0) return ErrorResult(result, error);
+            if (Excel12v(xlfRtd, &result, static_cast<int>(sizeof...(Topics) + 2), opers) != xlretSuccess) {
+                return ErrorResult(result, xlerrNA);
+            }
+            result.xltype |= xlbitXLFree;
+            return &result;
+        }
+
+    private:
+        static std::vector<XCHAR> Prefixed(std::wstring_view text) {
+            if (text.size() > ResultMatrix::kMaxText) text = text.substr(0, ResultMatrix::kMaxText);
+            std::vector<XCHAR> buffer(text.size() + 1);
+            buffer[0] = static_cast<XCHAR>(text.size());
+            std::copy(text.begin(), text.end(), buffer.begin() + 1);
+            return buffer;
+        }
+
+        static XLOPER12& ResultSlot() {
+            thread_local XLOPER12 result;
+            return result;
+        }
+
+        static LPXLOPER12 ErrorResult(XLOPER12& result, int error) {
+            result.xltype = xltypeErr;
+            result.val.err = error;
+            return &result;
+        }
+
+        // Sets error (the first one wins) and returns nullptr if the argument cannot be a topic
+        static LPXLOPER12 TopicOper(XlFrame& frame, const XLOPER12& topic, int& error) {
+            switch (topic.xltype & ~static_cast<DWORD>(xlbitXLFree | xlbitDLLFree)) {
+            case xltypeStr:
+                return const_cast<LPXLOPER12>(&topic); // Excel only reads it
+            case xltypeNum: {
+                char digits[32];
+                std::to_chars_result converted = std::to_chars(digits, digits + sizeof(digits), topic.val.num);
+                wchar_t text[32];
+                size_t length = static_cast<size_t>(converted.ptr - digits);
+                std::copy(digits, converted.ptr, text);
+                return Converted(frame, std::wstring_view(text, length), error);
+            }
+            case xltypeInt: return TopicOper(frame, static_cast<double>(topic.val.w), error);
+            case xltypeBool: return Converted(frame, topic.val.xbool ? L"TRUE" : L"FALSE", error);
+            case xltypeMissing:
+            case xltypeNil: return Converted(frame, std::wstring_view(), error);
+            case xltypeErr:
+                if (error < 0) error = topic.val.err;
+                return nullptr;
+            default:
+                if (error < 0) error = xlerrValue;
+                return nullptr;
+            }
+        }
+
+        static LPXLOPER12 TopicOper(XlFrame& frame, double number, int& error) {
+            XLOPER12 oper = {};
+            oper.xltype = xltypeNum;
+            oper.val.num = number;
+            return TopicOper(frame, oper, error);
+        }
+
+        static LPXLOPER12 TopicOper(XlFrame& frame, std::wstring_view text, int& error) { return Converted(frame, text, error); }
+        static LPXLOPER12 TopicOper(XlFrame& frame, const wchar_t* text, int& error) {
+            return Converted(frame, std::wstring_view(text ? text : L""), error);
+        }
+
+        static LPXLOPER12 Converted(XlFrame& frame, std::wstring_view text, int& error) {
+            LPXLOPER12 oper = frame.String(text);
+            if (!oper && error < 0) error = xlerrNum;
+            return oper;
+        }
+
+        std::vector<XCHAR> m_progIdText;
+        std::vector<XCHAR> m_serverText;
+        XLOPER12 m_progId = {};
+        XLOPER12 m_server = {};
+    };
+
+} // namespace rtd
+
+#endif // RTD_XLL_H
@@ -0,0 +1,262 @@
+#ifndef RTD_XLOPER_HASH_H
+#define RTD_XLOPER_HASH_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "content_hash.h"
+#include "xlcall.h"
+
+namespace rtd {
+
+    /**
+     * @brief Content hash of an XLL argument: a scalar XLOPER12 or an xltypeMulti array.
+     * Used as the RTD topic for large inputs (see docs/LARGE_DATA_RTD_PATTERN.md): equal
+     * content gives the same topic, any change gives a new one.
+     *
+     * Numbers are gathered into a contiguous stream and hashed by the vectorised stripe
+     * loop; strings, booleans, errors and empty cells go into a second stream together
+     * with their position. The shape, both streams and their lengths make up the result,
+     * so 1x4 and 4x1, TRUE and 1, "1" and 1 all differ. -0 hashes like 0, since Excel
+     * shows them the same. Reference types hash by type only (coerce them first).
+     */
+    class XloperHasher {
+    public:
+        explicit XloperHasher(HashIsa isa = HashIsa::Native) : m_numbers(isa), m_cells(isa) {}
+
+        uint64_t Hash(const XLOPER12& value) {
+            m_numbers.Reset();
+            m_cells.Reset();
+
+            const XLOPER12* items = &value;
+            uint64_t shape[3] = { 0, 1, 1 };
+            if (TypeOf(value) == xltypeMulti) {
+                items = value.val.array.lparray;
+                bool valid = items && value.val.array.rows > 0 && value.val.array.columns > 0;
+                shape[0] = xltypeMulti;
+                shape[1] = valid ? static_cast<uint64_t>(value.val.array.rows) : 0;
+                shape[2] = valid ? static_cast<uint64_t>(value.val.array.columns) : 0;
+            }
+            m_cells.Update(shape, sizeof(shape));
+
+            size_t count = static_cast<size_t>(shape[1] * shape[2]);
+            size_t staged = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const XLOPER12& item = items[i];
+                if (TypeOf(item) == xltypeNum) {
+                    double number = item.val.num;
+                    if (number == 0.0) number = 0.0;
+                    m_staged[staged++] = number;
+                    if (staged == kStaged) {
+                        m_numbers.Update(m_staged, sizeof(m_staged));
+                        staged = 0;
+                    }
+                } else {
+                    HashCell(i, item);
+                }
+            }
+            if (staged != 0) m_numbers.Update(m_staged, staged * sizeof(double));
+
+            uint64_t parts[2] = { m_numbers.Digest(), m_cells.Digest() };
+            return ContentHasher::Hash(parts, sizeof(parts));
+        }
+
+    private:
+        static constexpr size_t kStaged = ContentHasher::kBlock / sizeof(double);
+
+        static DWORD TypeOf(const XLOPER12& value) {
+            return value.xltype & ~static_cast<DWORD>(xlbitXLFree | xlbitDLLFree);
+        }
+
+        void HashCell(size_t index, const XLOPER12& item) {
+            struct {
+                uint64_t index;
+                uint32_t type;
+                uint32_t value;
+            } header = { index, static_cast<uint32_t>(TypeOf(item)), 0 };
+
+            const XCHAR* text = nullptr;
+            switch (header.type) {
+            case xltypeStr:
+                if (item.val.str) {
+                    header.value = static_cast<uint32_t>(item.val.str[0]);
+                    text = item.val.str + 1;
+                }
+                break;
+            case xltypeBool: header.value = item.val.xbool ? 1 : 0; break;
+            case xltypeErr: header.value = static_cast<uint32_t>(item.val.err); break;
+            case xltypeInt: header.value = static_cast<uint32_t>(item.val.w); break;
+            default: break;
+            }
+            m_cells.Update(&header, sizeof(header));
+            if (text && header.value != 0) m_cells.Update(text, header.value * sizeof(XCHAR));
+        }
+
+        ContentHasher m_numbers;
+        ContentHasher m_cells;
+        double m_staged[kStaged];
+    };
+
+    inline uint64_t HashXloper(const XLOPER12& value, HashIsa isa = HashIsa::Native) {
+        XloperHasher hasher(isa);
+        return hasher.Hash(value);
+    }
+
+    /**
+     * @brief Formats a content hash as a fixed-width 16-digit hex topic string.
+     */
+    inline std::wstring FormatContentHash(uint64_t hash) {
+        static const wchar_t kDigits[] = L"0123456789abcdef";
+        std::wstring text(16, L'0');
+        for (size_t i = 0; i < 16; ++i) text[15 - i] = kDigits[(hash >> (4 * i)) & 0xF];
+        return text;
+    }
+
+    /**
+     * @brief Bounded, thread-safe record of input hashes already sent to the calculation server.
+     *
+     * MarkSent returns true the first time a hash is seen, so an XLL function sends each
+     * distinct input once however many cells or recalculations use it. Entries beyond
+     * maxEntries, or beyond maxBytes of sent payload, are evicted least recently used
+     * first; the next MarkSent for an evicted hash asks for it to be sent again. Call
+     * Forget when a send fails or the server drops the data, and Clear on reconnect.
+     *
+     * Hashing itself can be skipped for inputs the caller knows are immutable under a key
+     * of its own (e.g. an object handle): Remember stores the hash under that key and
+     * Recall returns it. Such keys share the entry bound.
+     */
+    class ContentHashCache {
+    public:
+        static constexpr size_t kDefaultMaxEntries = 4096;
+
+        struct Stats {
+            unsigned long long hits = 0;      // MarkSent found the hash already sent
+            unsigned long long misses = 0;    // MarkSent asked for a send
+            unsigned long long recalls = 0;   // Recall found a remembered hash
+            unsigned long long evictions = 0;
+            size_t entries = 0;
+            unsigned long long bytes = 0;     // Payload of the hashes currently recorded as sent
+        };
+
+        /**
+         * @param maxEntries Bound on sent hashes (and, separately, on remembered keys).
+         * @param maxBytes Bound on the summed payload of sent hashes; 0 for none.
+         */
+        explicit ContentHashCache(size_t maxEntries = kDefaultMaxEntries, unsigned long long maxBytes = 0)
+            : m_maxEntries(maxEntries ? maxEntries : 1), m_maxBytes(maxBytes) {}
+
+        ContentHashCache(const ContentHashCache&) = delete;
+        ContentHashCache& operator=(const ContentHashCache&) = delete;
+
+        /**
+         * @brief Records the hash as sent.
+         * @return true if the caller must send the payload (the hash was not recorded).
+         */
+        bool MarkSent(uint64_t hash, size_t bytes) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_sent.find(hash);
+            if (it != m_sent.end()) {
+                m_sentLru.splice(m_sentLru.begin(), m_sentLru, it->second);
+                ++m_stats.hits;
+                return false;
+            }
+            ++m_stats.misses;
+            m_sentLru.push_front({ hash, bytes });
+            m_sent.emplace(hash, m_sentLru.begin());
+            m_bytes += bytes;
+            // The newest entry stays even if it alone exceeds maxBytes
+            while (m_sentLru.size() > 1 &&
+                   (m_sentLru.size() > m_maxEntries || (m_maxBytes != 0 && m_bytes > m_maxBytes))) {
+                const SentEntry& oldest = m_sentLru.back();
+                m_bytes -= oldest.bytes;
+                m_sent.erase(oldest.hash);
+                m_sentLru.pop_back();
+                ++m_stats.evictions;
+            }
+            return true;
+        }
+
+        bool IsSent(uint64_t hash) const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_sent.count(hash) != 0;
+        }
+
+        void Forget(uint64_t hash) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_sent.find(hash);
+            if (it == m_sent.end()) return;
+            m_bytes -= it->second->bytes;
+            m_sentLru.erase(it->second);
+            m_sent.erase(it);
+        }
+
+        void Remember(uint64_t key, uint64_t hash) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_keys.find(key);
+            if (it != m_keys.end()) {
+                it->second->hash = hash;
+                m_keyLru.splice(m_keyLru.begin(), m_keyLru, it->second);
+                return;
+            }
+            m_keyLru.push_front({ key, hash });
+            m_keys.emplace(key, m_keyLru.begin());
+            if (m_keyLru.size() > m_maxEntries) {
+                m_keys.erase(m_keyLru.back().key);
+                m_keyLru.pop_back();
+                ++m_stats.evictions;
+            }
+        }
+
+        bool Recall(uint64_t key, uint64_t& hash) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_keys.find(key);
+            if (it == m_keys.end()) return false;
+            m_keyLru.splice(m_keyLru.begin(), m_keyLru, it->second);
+            hash = it->second->hash;
+            ++m_stats.recalls;
+            return true;
+        }
+
+        void Clear() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_sent.clear();
+            m_sentLru.clear();
+            m_keys.clear();
+            m_keyLru.clear();
+            m_bytes = 0;
+        }
+
+        Stats GetStats() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Stats stats = m_stats;
+            stats.entries = m_sentLru.size();
+            stats.bytes = m_bytes;
+            return stats;
+        }
+
+    private:
+        struct SentEntry {
+            uint64_t hash;
+            size_t bytes;
+        };
+        struct KeyEntry {
+            uint64_t key;
+            uint64_t hash;
+        };
+
+        mutable std::mutex m_mutex;
+        std::list<SentEntry> m_sentLru; // Front is most recently used
+        std::unordered_map<uint64_t, std::list<SentEntry>::iterator> m_sent;
+        std::list<KeyEntry> m_keyLru;
+        std::unordered_map<uint64_t, std::list<KeyEntry>::iterator> m_keys;
+        size_t m_maxEntries;
+        unsigned long long m_maxBytes;
+        unsigned long long m_bytes = 0;
+        Stats m_stats;
+    };
+
+} // namespace rtd
+
+#endif // RTD_XLOPER_HASH_H
@@ -3,18 +3,34 @@
 #include <string>
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <initializer_list>
+#include <span>
+#include <memory>
+#include <map>
+#include <stdexcept>
+#include <algorithm>
+
+// Winsock 2 has to precede <windows.h>
+#include <rtd/feed_adapter.h>
 
 // Include the implementation directly to test logic without COM overhead
 #include "../examples/simple/server_impl.h"
 #include <rtd/module.h> // Ensure we can access GlobalModule
+#include <rtd/xloper_hash.h>
+#include <rtd/shm_feed.h>
+#include <rtd/topic_router.h>
+#include <rtd/xll.h>
 
 // Mock IRTDUpdateEvent for ServerStart
 struct MockUpdateEvent : public rtd::IRTDUpdateEvent {
-    long m_refCount = 1;
-    HRESULT __stdcall UpdateNotify() override { return S_OK; }
+    std::atomic<long> m_refCount{1};
+    std::atomic<long> m_notifyCount{0};
+    long m_heartbeatInterval = 1000;
+    HRESULT __stdcall UpdateNotify() override { ++m_notifyCount; return S_OK; }
     HRESULT __stdcall get_HeartbeatInterval(long* value) override {
         if (!value) return E_POINTER;
-        *value = 1000;
+        *value = m_heartbeatInterval;
         return S_OK;
     }
     HRESULT __stdcall put_HeartbeatInterval(long value) override { return S_OK; }
@@ -43,6 +59,94 @@ void Assert(bool condition, const std::string& message) {
     }
 }
 
+// Builds a 1D SAFEARRAY of BSTR VARIANTs, as Excel passes to ConnectData
+SAFEARRAY* MakeTopicStrings(std::initializer_list<const wchar_t*> strings) {
+    SAFEARRAY* sa = SafeArrayCreateVector(VT_VARIANT, 0, static_cast<ULONG>(strings.size()));
+    long index = 0;
+    for (const wchar_t* text : strings) {
+        VARIANT v;
+        VariantInit(&v);
+        v.vt = VT_BSTR;
+        v.bstrVal = SysAllocString(text);
+        SafeArrayPutElement(sa, &index, &v);
+        VariantClear(&v);
+        ++index;
+    }
+    return sa;
+}
+
+// Coroutine topics for Test 19. Parameters are taken by value, as TopicStream requires.
+struct FrameProbe {
+    std::shared_ptr<std::atomic<int>> destroyed;
+    ~FrameProbe() { ++*destroyed; }
+};
+
+rtd::TopicStream CountTo(int count, std::shared_ptr<std::atomic<int>> destroyed) {
+    FrameProbe probe{ destroyed };
+    for (int i = 1; i <= count; ++i) {
+        co_await rtd::Delay(std::chrono::milliseconds(1));
+        co_yield i;
+    }
+}
+
+rtd::TopicStream Doubler(std::shared_ptr<rtd::ValueChannel<double>> input, std::shared_ptr<std::atomic<int>> destroyed) {
+    FrameProbe probe{ destroyed };
+    while (true) {
+        double value = co_await input->Next();
+        co_yield value * 2;
+    }
+}
+
+rtd::TopicStream Throws() {
+    co_yield 1.0;
+    throw std::runtime_error("feed lost");
+}
+
+// Stand-in for Excel's MdCallBack12: records xlfRegister calls
+struct MockExcel {
+    static inline std::vector<std::vector<std::wstring>> registered;
+    static inline int frees = 0;
+    static inline std::atomic<int> rtdCalls{ 0 };
+    static inline XCHAR dllName[] = L"\x000CMyHybrid.xll";
+
+    static int __stdcall Call(int xlfn, int count, LPXLOPER12 opers[], LPXLOPER12 result) {
+        if (xlfn == xlGetName) {
+            result->xltype = xltypeStr | xlbitXLFree;
+            result->val.str = dllName;
+        } else if (xlfn == xlFree) {
+            ++frees;
+        } else if (xlfn == xlfRegister) {
+            registered.push_back(Texts(count, opers));
+            result->xltype = xltypeNum;
+            result->val.num = static_cast<double>(registered.size());
+        } else if (xlfn == xlfRtd) {
+            // Answers with the topic strings joined by '|', so each thread can check its own call
+            std::vector<std::wstring> args = Texts(count, opers);
+            static thread_local XCHAR answer[256];
+            std::wstring joined;
+            for (size_t i = 0; i < args.size(); ++i) joined += (i ? L"|" : L"") + args[i];
+            answer[0] = static_cast<XCHAR>(joined.size());
+            std::copy(joined.begin(), joined.end(), answer + 1);
+            result->xltype = xltypeStr;
+            result->val.str = answer;
+            ++rtdCalls;
+        }
+        return xlretSuccess;
+    }
+
+    static std::vector<std::wstring> Texts(int count, LPXLOPER12 opers[]) {
+        std::vector<std::wstring> args;
+        for (int i = 0; i < count; ++i) {
+            const XLOPER12& oper = *opers[i];
+            DWORD type = oper.xltype & ~static_cast<DWORD>(xlbitXLFree | xlbitDLLFree);
+            args.push_back(type == xltypeStr ? std::wstring(oper.val.str + 1, oper.val.str[0])
+                                             : type == xltypeNum ? L"#" + std::to_wstring(static_cast<int>(oper.val.num))
+                                                                 : L"-");
+        }
+        return args;
+    }
+};
+
 int main() {
     std::cout << "Running Unit Tests..." << std::endl;
 
@@ -275,6 +379,2152 @@ int main() {
     }
 
 
+    // Test 6: Dense Topic Store and Handles
+    std::cout << "Test 6: Dense Topic Store and Handles..." << std::endl;
+    {
+        class StoreServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        StoreServer* server = new StoreServer();
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+
+        VARIANT v;
+        VariantInit(&v);
+        v.vt = VT_R8;
+
+        // Repeated updates to the same topic collapse into one dirty entry
+        for (int i = 0; i < 1000; ++i) {
+            v.dblVal = i;
+            server->UpdateTopic(7, v);
+        }
+        v.dblVal = 1.5;
+        server->UpdateTopic(3, v);
+
+        hr = server->RefreshData(&topicCount, &sa);
+        Assert(hr == S_OK && topicCount == 2, "Repeated updates should be conflated into 2 topics");
+        if (sa) {
+            long indices[2] = { 0, 1 };
+            VARIANT val;
+            SafeArrayGetElement(sa, indices, &val);
+            Assert(val.vt == VT_R8 && val.dblVal == 999, "Conflated topic should carry the last value");
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+
+        Assert(server->UpdateTopic(-1, v) == E_INVALIDARG, "Negative TopicID should be rejected");
+
+        // A bogus TopicID from a feed must not grow the table; once connected it is accepted
+        double storeBytes = server->GetStatsValue(rtd::StatsMetric::StoreBytes);
+        Assert(server->UpdateTopic(rtd::TopicStore::kMaxTopicId - 1, v) == E_INVALIDARG, "Unconnected TopicID beyond the update limit should be rejected");
+        std::vector<long> bogusIds = { 1L << 20 };
+        std::vector<double> bogusValues = { 1.0 };
+        Assert(server->UpdateTopics(std::span<const long>(bogusIds), std::span<const double>(bogusValues)) == E_INVALIDARG, "Batch updates should respect the update limit");
+        Assert(server->GetStatsValue(rtd::StatsMetric::StoreBytes) == storeBytes, "Rejected updates should not grow the topic table");
+        server->SetUpdateTopicLimit(16);
+        Assert(server->UpdateTopic(16, v) == E_INVALIDARG && server->UpdateTopic(15, v) == S_OK, "The update limit should be configurable");
+        server->SetUpdateTopicLimit(rtd::TopicStore::kDefaultUpdateLimit);
+        hr = server->RefreshData(&topicCount, &sa);
+        if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+
+        // Handles publish without lookup and go stale after DisconnectData
+        rtd::TopicHandle handle = server->GetTopicHandle(5);
+        Assert(handle.IsValid(), "GetTopicHandle should return a valid handle");
+        Assert(server->UpdateTopic(handle, v) == S_OK, "Update through a fresh handle should succeed");
+
+        server->DisconnectData(5);
+        Assert(!server->IsTopicHandleValid(handle), "Handle should be stale after DisconnectData");
+        Assert(server->UpdateTopic(handle, v) == E_HANDLE, "Update through a stale handle should return E_HANDLE");
+
+        hr = server->RefreshData(&topicCount, &sa);
+        Assert(hr == S_OK && topicCount == 0, "Disconnected topic should not be delivered");
+
+        // TopicID reused by Excel: a new handle is required
+        rtd::TopicHandle reused = server->GetTopicHandle(5);
+        Assert(reused.generation != handle.generation, "Reused TopicID should get a new generation");
+        Assert(server->UpdateTopic(reused, v) == S_OK, "Update through the new handle should succeed");
+        Assert(server->UpdateTopic(handle, v) == E_HANDLE, "Old handle should stay stale after reuse");
+
+        hr = server->RefreshData(&topicCount, &sa);
+        Assert(hr == S_OK && topicCount == 1, "Reused topic should be delivered once");
+        if (sa) SafeArrayDestroy(sa);
+
+        server->Release();
+    }
+
+    // Test 7: Lock-Free Ingestion Mode
+    std::cout << "Test 7: Lock-Free Ingestion Mode..." << std::endl;
+    {
+        class IngestServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        IngestServer* server = new IngestServer();
+        // Tiny rings so the overflow path is exercised as well
+        server->SetIngestMode(rtd::IngestMode::LockFree, 8);
+        Assert(server->GetIngestMode() == rtd::IngestMode::LockFree, "Ingest mode should be LockFree");
+
+        const int producers = 4;
+        const int topicsPerProducer = 50;
+        const int rounds = 200;
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([server, p, topicsPerProducer, rounds]() {
+                VARIANT v;
+                VariantInit(&v);
+                v.vt = VT_I4;
+                for (int r = 0; r < rounds; ++r) {
+                    for (int t = 0; t < topicsPerProducer; ++t) {
+                        v.lVal = r;
+                        server->UpdateTopic(p * topicsPerProducer + t, v);
+                    }
+                }
+            });
+        }
+
+        // Drain concurrently with the producers
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+        for (int i = 0; i < 20; ++i) {
+            server->RefreshData(&topicCount, &sa);
+            if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+        }
+        for (auto& t : threads) t.join();
+
+        // Force every topic dirty once more with its final value
+        VARIANT last;
+        VariantInit(&last);
+        last.vt = VT_I4;
+        last.lVal = rounds;
+        for (int id = 0; id < producers * topicsPerProducer; ++id) server->UpdateTopic(id, last);
+
+        hr = server->RefreshData(&topicCount, &sa);
+        Assert(hr == S_OK && topicCount == producers * topicsPerProducer, "Every topic should be delivered once after draining");
+        bool allLast = true;
+        if (sa) {
+            for (long i = 0; i < topicCount; ++i) {
+                long indices[2] = { i, 1 };
+                VARIANT val;
+                SafeArrayGetElement(sa, indices, &val);
+                if (val.vt != VT_I4 || val.lVal != rounds) allLast = false;
+            }
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+        Assert(allLast, "Drained values should be conflated to the last update");
+
+        // Stale handles are dropped at drain time
+        rtd::TopicHandle handle = server->GetTopicHandle(1000);
+        server->DisconnectData(1000);
+        server->UpdateTopic(handle, last);
+        hr = server->RefreshData(&topicCount, &sa);
+        Assert(hr == S_OK && topicCount == 0, "Update through a stale handle should be dropped in LockFree mode");
+
+        // String values survive the trip through the ring
+        VARIANT str;
+        VariantInit(&str);
+        str.vt = VT_BSTR;
+        str.bstrVal = SysAllocString(L"Queued");
+        server->UpdateTopic(1, str);
+        VariantClear(&str);
+        hr = server->RefreshData(&topicCount, &sa);
+        if (sa) {
+            long indices[2] = { 0, 1 };
+            VARIANT val;
+            SafeArrayGetElement(sa, indices, &val);
+            Assert(val.vt == VT_BSTR && wcscmp(val.bstrVal, L"Queued") == 0, "Queued string should be delivered intact");
+            VariantClear(&val);
+            SafeArrayDestroy(sa);
+        }
+
+        // Leave something in the rings; the destructor must release it
+        server->UpdateTopic(2, last);
+        server->Release();
+
+        // Rings of exited producers are reused, pending updates included
+        rtd::UpdateIngestor ingestor;
+        rtd::UpdateIngestor other;
+        bool leased = true;
+        for (long t = 0; t < 2 * static_cast<long>(rtd::UpdateIngestor::kMaxRings); ++t) {
+            std::thread([&ingestor, &leased, t]() {
+                rtd::UpdateIngestor::Ring* ring = ingestor.LocalRing();
+                rtd::PendingUpdate update;
+                update.topicId = t;
+                leased = leased && ring && ring->TryPush(std::move(update));
+            }).join();
+        }
+        Assert(leased && ingestor.RingCount() == 1, "Short-lived producers should reuse one ring");
+        Assert(ingestor.Drain([](rtd::PendingUpdate&) {}) == 2 * rtd::UpdateIngestor::kMaxRings, "Updates left by exited producers should still be drained");
+
+        // One thread feeding two ingestors keeps a ring with each
+        rtd::UpdateIngestor::Ring* mine = ingestor.LocalRing();
+        rtd::UpdateIngestor::Ring* theirs = other.LocalRing();
+        Assert(mine && theirs && mine != theirs && ingestor.LocalRing() == mine && other.LocalRing() == theirs, "Ring leases should be kept per ingestor");
+    }
+
+    // Test 8: Delivery Policies
+    std::cout << "Test 8: Delivery Policies..." << std::endl;
+    {
+        rtd::DeliveryPolicy parsed;
+        Assert(parsed.ApplyOption(L"@interval=250") && parsed.minIntervalMs == 250, "@interval option should parse");
+        Assert(parsed.ApplyOption(L"@rate=4") && parsed.maxPerSecond == 4, "@rate option should parse");
+        Assert(!parsed.ApplyOption(L"@rate=abc"), "Malformed option should be rejected");
+        Assert(!parsed.ApplyOption(L"AAPL"), "Plain topic string is not an option");
+        Assert(parsed.ApplyOption(L"@lvw") && !parsed.IsThrottled(), "@lvw should reset to unthrottled");
+
+        class PolicyServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long TopicID, SAFEARRAY** Strings, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                ApplyTopicPolicy(TopicID, Strings);
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        PolicyServer* server = new PolicyServer();
+        MockUpdateEvent* callback = new MockUpdateEvent();
+        long res = 0;
+        server->ServerStart(callback, &res);
+
+        VARIANT_BOOL getNewValues = VARIANT_FALSE;
+        VARIANT out;
+        VariantInit(&out);
+        SAFEARRAY* hotStrings = MakeTopicStrings({ L"HOT", L"@interval=200" });
+        SAFEARRAY* quietStrings = MakeTopicStrings({ L"QUIET" });
+        server->ConnectData(1, &hotStrings, &getNewValues, &out);
+        server->ConnectData(2, &quietStrings, &getNewValues, &out);
+        SafeArrayDestroy(hotStrings);
+        SafeArrayDestroy(quietStrings);
+
+        VARIANT v;
+        VariantInit(&v);
+        v.vt = VT_I4;
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+
+        // First delivery of the hot topic goes out immediately
+        v.lVal = 1;
+        server->UpdateTopic(1, v);
+        server->RefreshData(&topicCount, &sa);
+        Assert(topicCount == 1, "First update of a throttled topic should be delivered");
+        if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+
+        // Within the interval: the hot topic is held, the quiet topic is not crowded out
+        v.lVal = 2;
+        server->UpdateTopic(1, v);
+        v.lVal = 3;
+        server->UpdateTopic(1, v);
+        server->UpdateTopic(2, v);
+        long notifiesBefore = callback->m_notifyCount;
+        server->RefreshData(&topicCount, &sa);
+        Assert(topicCount == 1, "Only the quiet topic should be delivered within the interval");
+        if (sa) {
+            long indices[2] = { 0, 0 };
+            VARIANT id;
+            SafeArrayGetElement(sa, indices, &id);
+            Assert(id.lVal == 2, "Delivered topic should be the quiet one");
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+
+        // The held update stays pending and a follow-up notify is scheduled
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        Assert(callback->m_notifyCount > notifiesBefore, "A deferred notify should fire when the interval expires");
+        server->RefreshData(&topicCount, &sa);
+        Assert(topicCount == 1, "Held topic should be delivered after the interval");
+        if (sa) {
+            long indices[2] = { 0, 1 };
+            VARIANT val;
+            SafeArrayGetElement(sa, indices, &val);
+            Assert(val.vt == VT_I4 && val.lVal == 3, "Held topic should deliver the last value");
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+
+        // Rate limit: burst of 2, then held
+        server->SetTopicPolicy(3, rtd::DeliveryPolicy::MaxPerSecond(2));
+        int delivered = 0;
+        for (int i = 0; i < 5; ++i) {
+            v.lVal = i;
+            server->UpdateTopic(3, v);
+            server->RefreshData(&topicCount, &sa);
+            delivered += topicCount;
+            if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+        }
+        Assert(delivered == 2, "Rate-limited topic should deliver at most its burst");
+
+        // Server-wide default applies to newly connected topics
+        server->SetDefaultDeliveryPolicy(rtd::DeliveryPolicy::MinInterval(10000));
+        server->UpdateTopic(4, v);
+        server->RefreshData(&topicCount, &sa);
+        if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+        server->UpdateTopic(4, v);
+        server->RefreshData(&topicCount, &sa);
+        Assert(topicCount == 0, "Default policy should hold back the second update");
+
+        server->ServerTerminate();
+        server->Release();
+        delete callback;
+    }
+
+    // Test 9: In-Place RefreshData (Move vs Retain)
+    std::cout << "Test 9: In-Place RefreshData..." << std::endl;
+    {
+        class FillServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+            rtd::TopicValue::Type StoredType(long topicId) {
+                std::lock_guard<std::mutex> lock(m_shards.ShardOf(topicId).mutex);
+                return FindSlot(topicId)->value.GetType();
+            }
+        };
+
+        FillServer* server = new FillServer();
+        const long topics = 300;
+        VARIANT v;
+        VariantInit(&v);
+        v.vt = VT_BSTR;
+        v.bstrVal = SysAllocString(L"Moved");
+        for (long id = 0; id < topics; ++id) server->UpdateTopic(id, v);
+
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+        hr = server->RefreshData(&topicCount, &sa);
+        Assert(hr == S_OK && topicCount == topics, "All topics should be delivered in one array");
+        bool allOk = true;
+        if (sa) {
+            for (long i = 0; i < topicCount; ++i) {
+                long indices[2] = { i, 0 };
+                VARIANT id, val;
+                SafeArrayGetElement(sa, indices, &id);
+                indices[1] = 1;
+                SafeArrayGetElement(sa, indices, &val);
+                if (id.vt != VT_I4 || id.lVal != i || val.vt != VT_BSTR || wcscmp(val.bstrVal, L"Moved") != 0) allOk = false;
+                VariantClear(&val);
+            }
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+        Assert(allOk, "Both rows should be filled in place");
+        Assert(server->StoredType(0) == rtd::TopicValue::Type::Empty, "Delivered value should be moved out of the store by default");
+
+        server->SetRetainValues(true);
+        server->UpdateTopic(0, v);
+        server->RefreshData(&topicCount, &sa);
+        if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+        Assert(server->StoredType(0) == rtd::TopicValue::Type::String, "Delivered value should stay in the store when retained");
+
+        VariantClear(&v);
+        server->Release();
+    }
+
+    // Test 10: Typed Updates and Lazy Materialization
+    std::cout << "Test 10: Typed Updates..." << std::endl;
+    {
+        rtd::TopicValue shortText(L"Open");
+        Assert(shortText.GetType() == rtd::TopicValue::Type::String && shortText.AsString() == L"Open", "Short string should be stored inline");
+        std::wstring longText(200, L'x');
+        rtd::TopicValue text(std::wstring_view(longText.c_str(), longText.size()));
+        Assert(text.AsString().size() == 200, "Long string should be stored on the heap");
+        const wchar_t* before = text.AsString().data();
+        text.Assign(std::wstring_view(longText.c_str(), 150));
+        Assert(text.AsString().data() == before && text.AsString().size() == 150, "Heap buffer should be reused for a shorter string");
+
+        class TypedServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        TypedServer* server = new TypedServer();
+        server->UpdateTopic(0, 1.25);
+        server->UpdateTopic(1, 42);
+        server->UpdateTopic(2, 5000000000LL);
+        server->UpdateTopic(3, true);
+        server->UpdateTopic(4, L"Halted");
+        server->UpdateTopic(5, std::wstring_view(longText.c_str(), longText.size()));
+        server->UpdateTopic(6, rtd::TopicValue::FromError(2042));
+        // Overwritten before delivery: never materialized
+        server->UpdateTopic(4, L"Open");
+
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+        hr = server->RefreshData(&topicCount, &sa);
+        Assert(hr == S_OK && topicCount == 7, "All typed topics should be delivered");
+        if (sa) {
+            VARIANT vals[7];
+            for (long i = 0; i < 7; ++i) {
+                long indices[2] = { i, 1 };
+                SafeArrayGetElement(sa, indices, &vals[i]);
+            }
+            Assert(vals[0].vt == VT_R8 && vals[0].dblVal == 1.25, "double should materialize as VT_R8");
+            Assert(vals[1].vt == VT_I4 && vals[1].lVal == 42, "int should materialize as VT_I4");
+            Assert(vals[2].vt == VT_R8 && vals[2].dblVal == 5000000000.0, "Out-of-range int64 should materialize as VT_R8");
+            Assert(vals[3].vt == VT_BOOL && vals[3].boolVal == VARIANT_TRUE, "bool should materialize as VT_BOOL");
+            Assert(vals[4].vt == VT_BSTR && wcscmp(vals[4].bstrVal, L"Open") == 0, "String should materialize as the last BSTR");
+            Assert(vals[5].vt == VT_BSTR && SysStringLen(vals[5].bstrVal) == 200, "Long string should materialize intact");
+            Assert(vals[6].vt == VT_ERROR && vals[6].scode == 2042, "Error should materialize as VT_ERROR");
+            for (auto& v : vals) VariantClear(&v);
+            SafeArrayDestroy(sa);
+        }
+
+        // Typed updates through handles and the lock-free path
+        server->SetIngestMode(rtd::IngestMode::LockFree);
+        rtd::TopicHandle handle = server->GetTopicHandle(8);
+        server->UpdateTopic(handle, L"Queued");
+        server->UpdateTopic(9, 7.5);
+        hr = server->RefreshData(&topicCount, &sa);
+        Assert(hr == S_OK && topicCount == 2, "Typed updates should flow through the lock-free path");
+        if (sa) SafeArrayDestroy(sa);
+
+        server->Release();
+    }
+
+    // Test 11: String Interning
+    std::cout << "Test 11: String Interning..." << std::endl;
+    {
+        class InternServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        InternServer* server = new InternServer();
+        server->EnableStringInterning(2, 8);
+        const long topics = 4;
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+        bool allOk = true;
+
+        // Every delivered BSTR must be a distinct allocation, since Excel frees each one
+        for (int cycle = 0; cycle < 3; ++cycle) {
+            for (long id = 0; id < topics; ++id) server->UpdateTopic(id, L"Halted");
+            hr = server->RefreshData(&topicCount, &sa);
+            if (hr != S_OK || topicCount != topics || !sa) {
+                allOk = false;
+                continue;
+            }
+            std::vector<BSTR> seen;
+            for (long i = 0; i < topicCount; ++i) {
+                long indices[2] = { i, 1 };
+                VARIANT val;
+                SafeArrayGetElement(sa, indices, &val);
+                if (val.vt != VT_BSTR || wcscmp(val.bstrVal, L"Halted") != 0) allOk = false;
+                VariantClear(&val);
+            }
+            void* data = nullptr;
+            SafeArrayAccessData(sa, &data);
+            VARIANT* valueRow = static_cast<VARIANT*>(data) + topicCount;
+            for (long i = 0; i < topicCount; ++i) {
+                for (BSTR other : seen) if (other == valueRow[i].bstrVal) allOk = false;
+                seen.push_back(valueRow[i].bstrVal);
+            }
+            SafeArrayUnaccessData(sa);
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+        Assert(allOk, "Interned values should be delivered as distinct BSTRs");
+
+        rtd::BstrPool::Stats stats = server->GetStringPoolStats();
+        Assert(stats.misses == 0 && stats.hits == 3 * topics, "Values prepared by producers should hit the pool");
+        Assert(stats.spareHits > 0, "Later cycles should be served from pre-built BSTRs");
+        Assert(stats.spareHits + stats.allocations == 3 * topics, "Every delivery is either a spare or an allocation");
+
+        // Bounded: a third distinct value evicts the least recently used one
+        server->UpdateTopic(0, L"Open");
+        server->UpdateTopic(1, L"Closed");
+        hr = server->RefreshData(&topicCount, &sa);
+        if (sa) SafeArrayDestroy(sa);
+        stats = server->GetStringPoolStats();
+        Assert(stats.entries == 2 && stats.evictions == 1, "Pool should stay within its entry limit");
+
+        // One refresh delivering more distinct values than the pool holds
+        const wchar_t* distinct[] = { L"Auction", L"Pre-Open", L"Suspended", L"Closing", L"After-Hours", L"Halted" };
+        for (long id = 0; id < 6; ++id) server->UpdateTopic(id, distinct[id]);
+        hr = server->RefreshData(&topicCount, &sa);
+        bool intact = hr == S_OK && topicCount == 6;
+        if (sa) {
+            for (long i = 0; i < topicCount; ++i) {
+                long indices[2] = { i, 0 };
+                VARIANT id, val;
+                SafeArrayGetElement(sa, indices, &id);
+                indices[1] = 1;
+                SafeArrayGetElement(sa, indices, &val);
+                intact = intact && val.vt == VT_BSTR && wcscmp(val.bstrVal, distinct[id.lVal]) == 0;
+                VariantClear(&val);
+            }
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+        stats = server->GetStringPoolStats();
+        Assert(intact && stats.entries == 2, "A refresh with more distinct values than the pool bound should be delivered intact and trimmed afterwards");
+
+        server->Release();
+    }
+
+    // Test 12: Subscription Deduplication and Fan-Out
+    std::cout << "Test 12: Subscription Fan-Out..." << std::endl;
+    {
+        rtd::TopicArgs args;
+        SAFEARRAY* parsed = MakeTopicStrings({ L"AAPL", L"@rate=2", L"Last" });
+        hr = args.Parse(parsed);
+        Assert(hr == S_OK && args.Count() == 2 && args[0] == L"AAPL" && args[1] == L"Last", "TopicArgs should expose the arguments");
+        Assert(args.Options().size() == 1 && args.Policy(rtd::DeliveryPolicy()).maxPerSecond == 2, "TopicArgs should keep '@' options apart");
+        Assert(args.Matches(args.Key()), "TopicArgs should match its own canonical key");
+        std::wstring key = args.Key();
+        rtd::TopicArgs restored = rtd::TopicArgs::FromKey(key);
+        Assert(restored.Count() == 2 && restored[1] == L"Last" && restored.Hash() == args.Hash(), "A canonical key should split back into its arguments");
+        SafeArrayDestroy(parsed);
+
+        rtd::TopicArgs none;
+        rtd::TopicArgs blank;
+        SAFEARRAY* blankStrings = MakeTopicStrings({ L"" });
+        none.Parse(nullptr);
+        blank.Parse(blankStrings);
+        Assert(blank.Count() == 1 && none.Key() != blank.Key() && none.Hash() != blank.Hash() &&
+               !none.Matches(blank.Key()) && !blank.Matches(none.Key()), "No arguments and one empty argument should be different keys");
+        std::wstring blankKey = blank.Key();
+        std::wstring noneKey = none.Key();
+        Assert(rtd::TopicArgs::FromKey(blankKey).Count() == 1 && rtd::TopicArgs::FromKey(noneKey).Empty(), "Empty arguments should survive the key round trip");
+        SafeArrayDestroy(blankStrings);
+
+        class FanOutServer : public rtd::RtdServerBase {
+        public:
+            int subscribes = 0;
+            int unsubscribes = 0;
+            rtd::SubscriptionHandle last;
+            SAFEARRAY* flaky = nullptr;
+        protected:
+            HRESULT OnSubscribe(const rtd::SubscriptionHandle& subscription, const rtd::TopicArgs& args) override {
+                ++subscribes;
+                last = subscription;
+                if (args.Count() == 1 && args[0] == L"BAD") return E_FAIL;
+                if (args.Count() == 1 && args[0] == L"FLAKY") {
+                    // Another TopicID for the key connects while this one is still subscribing
+                    VARIANT value;
+                    VariantInit(&value);
+                    ConnectData(8, &flaky, nullptr, &value);
+                    return E_FAIL;
+                }
+                return S_OK;
+            }
+            void OnUnsubscribe(const rtd::SubscriptionHandle&) override { ++unsubscribes; }
+        };
+
+        FanOutServer* server = new FanOutServer();
+        VARIANT_BOOL getNewValues = VARIANT_FALSE;
+        VARIANT out;
+        VariantInit(&out);
+
+        SAFEARRAY* aapl = MakeTopicStrings({ L"AAPL", L"Last" });
+        SAFEARRAY* aaplThrottled = MakeTopicStrings({ L"AAPL", L"Last", L"@interval=100" });
+        SAFEARRAY* msft = MakeTopicStrings({ L"MSFT", L"Last" });
+        server->ConnectData(1, &aapl, &getNewValues, &out);
+        Assert(out.vt == VT_ERROR && out.scode == 2043, "First subscriber should get #GETTING_DATA");
+        rtd::SubscriptionHandle aaplSub = server->last;
+        server->ConnectData(2, &aaplThrottled, &getNewValues, &out);
+        server->ConnectData(3, &msft, &getNewValues, &out);
+        Assert(server->subscribes == 2 && server->GetSubscriptionCount() == 2, "Same strings should share one subscription");
+
+        server->UpdateSubscription(aaplSub, 101.5);
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+        hr = server->RefreshData(&topicCount, &sa);
+        Assert(hr == S_OK && topicCount == 2, "One upstream update should reach every attached TopicID");
+        if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+
+        getNewValues = VARIANT_FALSE;
+        server->ConnectData(4, &aapl, &getNewValues, &out);
+        Assert(out.vt == VT_R8 && out.dblVal == 101.5 && getNewValues == VARIANT_TRUE, "Joining TopicID should get the current value at once");
+        Assert(server->subscribes == 2, "Joining TopicID should not subscribe upstream again");
+
+        SAFEARRAY* bad = MakeTopicStrings({ L"BAD" });
+        hr = server->ConnectData(5, &bad, &getNewValues, &out);
+        Assert(FAILED(hr) && server->GetSubscriptionCount() == 2, "Failed OnSubscribe should reject the connection");
+
+        server->DisconnectData(1);
+        server->DisconnectData(2);
+        Assert(server->unsubscribes == 0, "Subscription should stay open while TopicIDs remain");
+        server->DisconnectData(4);
+        Assert(server->unsubscribes == 1, "Last TopicID should close the subscription");
+        Assert(server->UpdateSubscription(aaplSub, 1.0) == E_HANDLE, "Closed subscription handle should be stale");
+
+        // Excel reusing a TopicID without DisconnectData ends its old subscription
+        SAFEARRAY* ibm = MakeTopicStrings({ L"IBM", L"Last" });
+        server->ConnectData(6, &ibm, &getNewValues, &out);
+        int subscribed = server->subscribes;
+        server->ConnectData(6, &msft, &getNewValues, &out);
+        Assert(server->unsubscribes == 2 && server->subscribes == subscribed, "A reused TopicID should unsubscribe its previous key");
+        Assert(server->GetSubscriptionCount() == 1, "Only the reused TopicID's new key should stay open");
+
+        // A TopicID joining while OnSubscribe fails is failed with it
+        hr = server->RefreshData(&topicCount, &sa);
+        if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+        server->flaky = MakeTopicStrings({ L"FLAKY" });
+        hr = server->ConnectData(7, &server->flaky, &getNewValues, &out);
+        Assert(FAILED(hr) && server->GetSubscriptionCount() == 1, "Failed OnSubscribe should close the subscription its joiners attached to");
+        hr = server->RefreshData(&topicCount, &sa);
+        bool joinerFailed = false;
+        if (sa) {
+            long indices[2] = { 0, 0 };
+            VARIANT id, val;
+            SafeArrayGetElement(sa, indices, &id);
+            indices[1] = 1;
+            SafeArrayGetElement(sa, indices, &val);
+            joinerFailed = topicCount == 1 && id.lVal == 8 && val.vt == VT_ERROR && val.scode == 2042;
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+        Assert(joinerFailed, "A TopicID that joined a failed subscription should get #N/A");
+        server->DisconnectData(8);
+        Assert(server->unsubscribes == 2, "A failed subscription should never be unsubscribed");
+
+        SafeArrayDestroy(server->flaky);
+        SafeArrayDestroy(ibm);
+        SafeArrayDestroy(aapl);
+        SafeArrayDestroy(aaplThrottled);
+        SafeArrayDestroy(msft);
+        SafeArrayDestroy(bad);
+        server->Release();
+    }
+
+    // Test 13: Batch Publish over Spans
+    std::cout << "Test 13: Batch Publish..." << std::endl;
+    {
+        class BatchServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        BatchServer* server = new BatchServer();
+        MockUpdateEvent* callback = new MockUpdateEvent();
+        long res = 0;
+        server->ServerStart(callback, &res);
+
+        std::vector<long> ids = { 3, 1, 2, 1 };
+        std::vector<double> prices = { 30.0, 10.0, 20.0, 11.0 };
+        hr = server->UpdateTopics(std::span<const long>(ids), std::span<const double>(prices));
+        Assert(hr == S_OK && callback->m_notifyCount == 1, "Batch should notify once");
+
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+        server->RefreshData(&topicCount, &sa);
+        Assert(topicCount == 3, "Repeated TopicID in a batch should conflate");
+        bool lastWins = false;
+        if (sa) {
+            for (long i = 0; i < topicCount; ++i) {
+                long indices[2] = { i, 0 };
+                VARIANT id, val;
+                SafeArrayGetElement(sa, indices, &id);
+                indices[1] = 1;
+                SafeArrayGetElement(sa, indices, &val);
+                if (id.lVal == 1) lastWins = val.vt == VT_R8 && val.dblVal == 11.0;
+            }
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+        Assert(lastWins, "Later entry in a batch should win");
+
+        std::vector<VARIANT> variants(2);
+        for (auto& v : variants) VariantInit(&v);
+        variants[0].vt = VT_I4;
+        variants[0].lVal = 5;
+        variants[1].vt = VT_BSTR;
+        variants[1].bstrVal = SysAllocString(L"Open");
+        std::vector<long> badIds = { 4, -1 };
+        hr = server->UpdateTopics(std::span<const long>(badIds), std::span<const VARIANT>(variants));
+        Assert(hr == E_INVALIDARG, "Out-of-range TopicID should be reported");
+        server->RefreshData(&topicCount, &sa);
+        Assert(topicCount == 1, "Valid entries of a batch should still be applied");
+        if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+
+        hr = server->UpdateTopics(std::span<const long>(ids), std::span<const VARIANT>(variants));
+        Assert(hr == E_INVALIDARG && callback->m_notifyCount == 2, "Mismatched spans should be rejected without notifying");
+        for (auto& v : variants) VariantClear(&v);
+
+        server->ServerTerminate();
+        server->Release();
+        delete callback;
+    }
+
+    // Test 14: Change Detection and Deadbands
+    std::cout << "Test 14: Change Detection and Deadbands..." << std::endl;
+    {
+        rtd::DeliveryPolicy parsed;
+        Assert(parsed.ApplyOption(L"@deadband=0.5%") && parsed.deadbandPct == 0.5, "@deadband=x% should set a relative deadband");
+        Assert(parsed.ApplyOption(L"@deadband=0.25") && parsed.deadband == 0.25, "@deadband=x should set an absolute deadband");
+        Assert(parsed.ApplyOption(L"@decimals=2") && parsed.decimals == 2, "@decimals should set the display precision");
+        rtd::DeliveryPolicy fine;
+        rtd::TopicValue shown;
+        shown.Assign(1.0);
+        Assert(fine.ApplyOption(L"@decimals=400") && fine.decimals == rtd::DeliveryPolicy::kMaxDecimals &&
+               fine.Filter(shown, 2.0) == rtd::UpdateFilter::Accept, "Huge @decimals should be clamped, not hide every move");
+        Assert(!parsed.ApplyOption(L"@deadband=abc"), "Malformed deadband should be rejected");
+
+        class FilterServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+            long Pending() {
+                long topicCount = 0;
+                SAFEARRAY* sa = nullptr;
+                RefreshData(&topicCount, &sa);
+                if (sa) SafeArrayDestroy(sa);
+                return topicCount;
+            }
+        };
+
+        FilterServer* server = new FilterServer();
+        server->SetTopicPolicy(1, rtd::DeliveryPolicy::OnChange());
+        server->SetTopicPolicy(2, rtd::DeliveryPolicy::Deadband(0.05));
+        server->SetTopicPolicy(3, rtd::DeliveryPolicy::RelativeDeadband(1.0));
+        server->SetTopicPolicy(4, rtd::DeliveryPolicy::Decimals(2));
+
+        server->UpdateTopic(1, L"Open");
+        server->UpdateTopic(2, 100.0);
+        server->UpdateTopic(3, 200.0);
+        server->UpdateTopic(4, 1.234);
+        server->UpdateTopic(5, 7.0);
+        Assert(server->Pending() == 5, "First values should always be delivered");
+
+        // Delivered values stay in the store as the comparison reference
+        Assert(server->UpdateTopic(1, L"Open") == S_FALSE, "Unchanged string should be suppressed after delivery");
+        VARIANT same;
+        VariantInit(&same);
+        same.vt = VT_BSTR;
+        same.bstrVal = SysAllocString(L"Open");
+        Assert(server->UpdateTopic(1, same) == S_FALSE, "Unchanged VARIANT should be suppressed");
+        VariantClear(&same);
+        Assert(server->UpdateTopic(2, 100.04) == S_FALSE, "Move inside the absolute deadband should be suppressed");
+        Assert(server->UpdateTopic(3, 201.5) == S_FALSE, "Move inside the relative deadband should be suppressed");
+        Assert(server->UpdateTopic(4, 1.2341) == S_FALSE, "Move hidden by the display precision should be suppressed");
+        Assert(server->UpdateTopic(5, 7.0) == S_OK, "Topics without filters should accept repeated values");
+        Assert(server->Pending() == 1, "Suppressed updates should not mark topics dirty");
+
+        Assert(server->UpdateTopic(2, 100.06) == S_OK, "Move beyond the deadband should be accepted");
+        Assert(server->UpdateTopic(4, 1.24) == S_OK, "Move visible at the display precision should be accepted");
+        Assert(server->Pending() == 2, "Accepted updates should be delivered");
+
+        rtd::SuppressionStats stats = server->GetSuppressionStats();
+        Assert(stats.unchanged == 2 && stats.deadband == 3, "Suppression counters should count each reason");
+
+        // Filters also apply to updates drained from the lock-free rings
+        server->SetIngestMode(rtd::IngestMode::LockFree);
+        server->UpdateTopic(1, L"Open");
+        Assert(server->Pending() == 0 && server->GetSuppressionStats().unchanged == 3, "Drained updates should be filtered");
+
+        server->Release();
+    }
+
+    // Test 15: Self-Monitoring Statistics Topics
+    std::cout << "Test 15: Statistics Topics..." << std::endl;
+    {
+        class StatsServer : public rtd::RtdServerBase {};
+
+        StatsServer* server = new StatsServer();
+        MockUpdateEvent* callback = new MockUpdateEvent();
+        long res = 0;
+        server->ServerStart(callback, &res);
+        server->SetStatsInterval(std::chrono::milliseconds(20));
+
+        // Producers on several threads land in separate counter slots
+        std::vector<std::thread> producers;
+        for (int t = 0; t < 4; ++t) {
+            producers.emplace_back([server, t]() {
+                for (int i = 0; i < 1000; ++i) server->UpdateTopic(100 + t, static_cast<double>(i));
+            });
+        }
+        for (auto& producer : producers) producer.join();
+        Assert(server->GetStatsValue(rtd::StatsMetric::UpdatesIngested) == 4000.0, "Ingested updates should be counted across threads");
+        Assert(server->GetStatsValue(rtd::StatsMetric::UpdatesConflated) == 3996.0, "Overwrites of undelivered values should count as conflated");
+
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+        server->RefreshData(&topicCount, &sa);
+        if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+        Assert(server->GetStatsValue(rtd::StatsMetric::LastBatch) == 4.0 && server->GetStatsValue(rtd::StatsMetric::RefreshCalls) == 1.0, "RefreshData batches should be recorded");
+
+        VARIANT_BOOL getNewValues = VARIANT_FALSE;
+        VARIANT out;
+        VariantInit(&out);
+        SAFEARRAY* ingested = MakeTopicStrings({ L"__stats", L"updates_ingested" });
+        SAFEARRAY* live = MakeTopicStrings({ L"__stats", L"live_topics" });
+        SAFEARRAY* unknown = MakeTopicStrings({ L"__stats", L"no_such_metric" });
+        server->ConnectData(1, &ingested, &getNewValues, &out);
+        Assert(out.vt == VT_R8 && out.dblVal == 4000.0 && getNewValues == VARIANT_TRUE, "Stats topic should answer at once");
+        server->ConnectData(2, &live, &getNewValues, &out);
+        Assert(out.vt == VT_R8 && out.dblVal == 6.0, "live_topics should include the stats topics");
+        server->ConnectData(3, &unknown, &getNewValues, &out);
+        Assert(out.vt == VT_ERROR && out.scode == 2042, "Unknown metric should be #N/A");
+        Assert(server->GetSubscriptionCount() == 0, "Stats topics should not open subscriptions");
+
+        long notifiesBefore = callback->m_notifyCount;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        server->RefreshData(&topicCount, &sa);
+        if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+        Assert(callback->m_notifyCount > notifiesBefore && topicCount == 2, "Stats topics should be republished periodically");
+
+        server->DisconnectData(1);
+        server->DisconnectData(2);
+        server->DisconnectData(3);
+        SafeArrayDestroy(ingested);
+        SafeArrayDestroy(live);
+        SafeArrayDestroy(unknown);
+        server->ServerTerminate();
+        server->Release();
+        delete callback;
+
+        // Counter slots of exited threads are reused, with their counts
+        rtd::ThreadCounters counters;
+        rtd::ThreadCounters others;
+        const unsigned long long workers = 4 * rtd::ThreadCounters::kMaxSlots;
+        for (unsigned long long t = 0; t < workers; ++t) {
+            std::thread([&counters]() { counters.Add(rtd::Counter::UpdatesIngested); }).join();
+        }
+        counters.Add(rtd::Counter::UpdatesIngested, 2);
+        others.Add(rtd::Counter::UpdatesIngested);
+        counters.Add(rtd::Counter::UpdatesIngested);
+        Assert(counters.Sum(rtd::Counter::UpdatesIngested) == workers + 3 && others.Sum(rtd::Counter::UpdatesIngested) == 1,
+               "Counters should keep every thread's counts across slot reuse and per instance");
+    }
+
+    // Test 16: Sharded Topic Store
+    std::cout << "Test 16: Sharded Topic Store..." << std::endl;
+    {
+        class ShardServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        ShardServer* server = new ShardServer();
+        Assert(server->GetShardCount() == 1, "Store should default to one shard");
+        hr = server->SetShardCount(3);
+        Assert(hr == S_OK && server->GetShardCount() == 4, "Shard count should round up to a power of two");
+
+        const int producers = 4;
+        const long topicsPerProducer = 50;
+        const int rounds = 200;
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([server, p, topicsPerProducer, rounds]() {
+                for (int r = 0; r < rounds; ++r) {
+                    for (long t = 0; t < topicsPerProducer; ++t) {
+                        server->UpdateTopic(p * topicsPerProducer + t, static_cast<double>(r));
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+        server->RefreshData(&topicCount, &sa);
+        Assert(topicCount == producers * topicsPerProducer, "RefreshData should merge every shard's dirty topics");
+        std::vector<int> seen(producers * topicsPerProducer, 0);
+        bool latest = true;
+        if (sa) {
+            for (long i = 0; i < topicCount; ++i) {
+                long indices[2] = { i, 0 };
+                VARIANT id, val;
+                SafeArrayGetElement(sa, indices, &id);
+                indices[1] = 1;
+                SafeArrayGetElement(sa, indices, &val);
+                if (id.lVal >= 0 && id.lVal < static_cast<long>(seen.size())) ++seen[id.lVal];
+                latest = latest && val.vt == VT_R8 && val.dblVal == rounds - 1;
+            }
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+        bool once = true;
+        for (int count : seen) once = once && count == 1;
+        Assert(once && latest, "Each topic should be delivered once with its latest value");
+
+        hr = server->SetShardCount(8);
+        Assert(hr == E_UNEXPECTED && server->GetShardCount() == 4, "Shard count should be fixed once topics exist");
+
+        rtd::TopicHandle handle = server->GetTopicHandle(6);
+        Assert(server->UpdateTopic(handle, 1.5) == S_OK, "Handles should publish into their shard");
+        std::vector<long> ids = { 5, 6, 7, 8 };
+        std::vector<double> values = { 5.0, 6.0, 7.0, 8.0 };
+        server->UpdateTopics(std::span<const long>(ids), std::span<const double>(values));
+        // Interleaved entries land in their shards in batch order: the last value per topic wins
+        std::vector<long> mixed = { 9, 10, 9, 11, 10, 9 };
+        std::vector<double> mixedValues = { 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 };
+        server->UpdateTopics(std::span<const long>(mixed), std::span<const double>(mixedValues));
+        server->RefreshData(&topicCount, &sa);
+        double lastOf[12] = {};
+        if (sa) {
+            for (long i = 0; i < topicCount; ++i) {
+                long indices[2] = { i, 0 };
+                VARIANT id, val;
+                SafeArrayGetElement(sa, indices, &id);
+                indices[1] = 1;
+                SafeArrayGetElement(sa, indices, &val);
+                if (id.lVal >= 0 && id.lVal < 12 && val.vt == VT_R8) lastOf[id.lVal] = val.dblVal;
+            }
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+        Assert(lastOf[9] == 6.0 && lastOf[10] == 5.0 && lastOf[11] == 4.0, "A sharded batch should apply each topic's entries in order");
+
+        server->UpdateTopics(std::span<const long>(ids), std::span<const double>(values));
+        rtd::TopicHandle stale = server->GetTopicHandle(7);
+        server->DisconnectData(7);
+        Assert(server->IsTopicHandleValid(handle) && !server->IsTopicHandleValid(stale), "Disconnect should only invalidate its own topic's handle");
+        server->RefreshData(&topicCount, &sa);
+        Assert(topicCount == 3, "Disconnected topic should be dropped from its shard's dirty list");
+        if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+
+        server->Release();
+    }
+
+    // Test 17: Timer Wheel
+    std::cout << "Test 17: Timer Wheel..." << std::endl;
+    {
+        using Clock = rtd::TimerWheel::Clock;
+        rtd::TimerWheel wheel(std::chrono::microseconds(50));
+        std::mutex mutex;
+        std::vector<int> order;
+        std::atomic<int> early{0};
+        auto start = Clock::now();
+        // 2 ms sits on level 0 of a 50 us wheel, 20 ms and 120 ms have to cascade down
+        const int delaysMs[] = { 120, 2, 20, 60 };
+        for (int delay : delaysMs) {
+            Clock::time_point due = start + std::chrono::milliseconds(delay);
+            wheel.ScheduleAt(due, [&, due, delay]() {
+                if (Clock::now() < due) ++early;
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(delay);
+            });
+        }
+        rtd::TimerHandle cancelled = wheel.ScheduleAfter(std::chrono::milliseconds(40), [&]() { ++early; });
+        Assert(wheel.Cancel(cancelled) && !wheel.Cancel(cancelled), "Cancel should succeed exactly once");
+
+        std::atomic<int> runs{0};
+        rtd::TimerHandle periodic = wheel.ScheduleEvery(std::chrono::milliseconds(10), [&]() { ++runs; });
+        std::atomic<bool> chained{false};
+        wheel.ScheduleAfter(std::chrono::milliseconds(5), [&]() {
+            wheel.ScheduleAfter(std::chrono::milliseconds(5), [&]() { chained = true; });
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Assert(order == std::vector<int>({ 2, 20, 60, 120 }), "Timers should fire in deadline order");
+        }
+        Assert(early == 0, "Timers should never fire early, and cancelled ones never");
+        Assert(chained, "Callbacks should be able to schedule timers");
+        Assert(runs >= 5, "Periodic timer should keep firing");
+        Assert(wheel.Cancel(periodic) && wheel.Pending() == 0, "Cancelling the periodic timer should leave nothing pending");
+        int runsAfterCancel = runs;
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        Assert(runs == runsAfterCancel, "Cancelled periodic timer should stop");
+
+        wheel.ScheduleAfter(std::chrono::seconds(60), [&]() { ++early; });
+        wheel.Stop();
+        Assert(wheel.Pending() == 0 && early == 0, "Stop should drop pending timers");
+
+        // A 1 ns wheel whose top level rotates every 2^36 ticks (~68.7 s), started 200 ms
+        // before a rotation boundary: a 400 ms timer crossing it should fire on time
+        const std::chrono::nanoseconds rotation(uint64_t(1) << (rtd::TimerWheel::kLevels * rtd::TimerWheel::kSlotBits));
+        rtd::TimerWheel fine(std::chrono::nanoseconds(1), Clock::now() - rotation + std::chrono::milliseconds(200));
+        std::atomic<bool> crossed{false};
+        Clock::time_point due = Clock::now() + std::chrono::milliseconds(400);
+        fine.ScheduleAt(due, [&]() { crossed = true; });
+        for (int i = 0; i < 2000 && !crossed; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        Assert(crossed && Clock::now() >= due, "A timer crossing a top-level rotation should fire on time");
+    }
+
+    // Test 18: Executor Tasks and Cancellation
+    std::cout << "Test 18: Executor Tasks..." << std::endl;
+    {
+        class TaskServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        TaskServer* server = new TaskServer();
+        server->SetExecutorThreads(4);
+        const long topics = 200;
+        for (long id = 0; id < topics; ++id) {
+            server->SubmitTopicTask(id, [server, id](const rtd::TopicHandle& topic, const rtd::CancellationToken&) {
+                double sum = 0;
+                for (long i = 1; i <= 1000; ++i) sum += id * i;
+                server->UpdateTopic(topic, sum);
+            });
+        }
+        server->WaitForTasks();
+
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+        server->RefreshData(&topicCount, &sa);
+        bool computed = topicCount == topics;
+        if (sa) {
+            for (long i = 0; i < topicCount; ++i) {
+                long indices[2] = { i, 0 };
+                VARIANT id, val;
+                SafeArrayGetElement(sa, indices, &id);
+                indices[1] = 1;
+                SafeArrayGetElement(sa, indices, &val);
+                computed = computed && val.vt == VT_R8 && val.dblVal == id.lVal * 500500.0;
+            }
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+        }
+        Assert(computed && server->GetExecutorStats().executed == topics, "Every topic task should publish its result");
+
+        std::atomic<bool> started{false};
+        std::atomic<HRESULT> lateUpdate{S_OK};
+        server->SubmitTopicTask(500, [&, server](const rtd::TopicHandle& topic, const rtd::CancellationToken& cancel) {
+            started = true;
+            while (!cancel.IsCancelled()) std::this_thread::yield();
+            lateUpdate = server->UpdateTopic(topic, 1.0);
+        });
+        while (!started) std::this_thread::yield();
+        server->DisconnectData(500);
+        server->WaitForTasks();
+        Assert(lateUpdate == E_HANDLE, "DisconnectData should cancel the topic's task and reject its late result");
+
+        std::atomic<bool> serverTaskStopped{false};
+        started = false;
+        server->SubmitTask([&](const rtd::CancellationToken& cancel) {
+            started = true;
+            while (!cancel.IsCancelled()) std::this_thread::yield();
+            serverTaskStopped = true;
+        });
+        while (!started) std::this_thread::yield();
+        server->ServerTerminate();
+        Assert(serverTaskStopped, "ServerTerminate should cancel and join running tasks");
+
+        // Topic 0's scope was opened under the terminated session's; a new task must not inherit it
+        std::atomic<bool> freshToken{false};
+        server->SubmitTopicTask(0, [&](const rtd::TopicHandle&, const rtd::CancellationToken& cancel) {
+            freshToken = !cancel.IsCancelled();
+        });
+        server->WaitForTasks();
+        Assert(freshToken, "A topic task submitted after ServerTerminate should get a live token");
+
+        server->Release();
+    }
+
+    // Test 19: Coroutine Topic Streams
+    std::cout << "Test 19: Coroutine Topic Streams..." << std::endl;
+    {
+        class StreamServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        StreamServer* server = new StreamServer();
+        server->SetExecutorThreads(2);
+        MockUpdateEvent* callback = new MockUpdateEvent();
+        long res = 0;
+        server->ServerStart(callback, &res);
+
+        // Delivered values by TopicID, accumulated over RefreshData calls
+        std::map<long, VARIANT> latest;
+        auto refresh = [&]() {
+            long topicCount = 0;
+            SAFEARRAY* sa = nullptr;
+            server->RefreshData(&topicCount, &sa);
+            for (long i = 0; i < topicCount; ++i) {
+                long indices[2] = { i, 0 };
+                VARIANT id, val;
+                SafeArrayGetElement(sa, indices, &id);
+                indices[1] = 1;
+                SafeArrayGetElement(sa, indices, &val);
+                latest[id.lVal] = val;
+            }
+            if (sa) SafeArrayDestroy(sa);
+        };
+        auto waitFor = [&](long topicId, auto&& done) {
+            for (int i = 0; i < 2000; ++i) {
+                refresh();
+                auto it = latest.find(topicId);
+                if (it != latest.end() && done(it->second)) return true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return false;
+        };
+
+        rtd::FramePool::Stats before = rtd::FramePool::Instance().GetStats();
+        auto destroyed = std::make_shared<std::atomic<int>>(0);
+
+        Assert(server->StartTopicStream(1, CountTo(3, destroyed)) == S_OK, "StartTopicStream should accept a coroutine");
+        bool counted = waitFor(1, [](const VARIANT& v) { return v.vt == VT_I4 && v.lVal == 3; });
+        Assert(counted, "Each co_yield after co_await Delay should reach RefreshData");
+        server->WaitForTasks();
+        Assert(*destroyed == 1, "A finished coroutine should destroy its frame");
+        Assert(callback->m_notifyCount > 0, "Yielded values should notify Excel");
+
+        auto input = std::make_shared<rtd::ValueChannel<double>>();
+        server->StartTopicStream(2, Doubler(input, destroyed));
+        input->Push(1.0);
+        input->Push(21.0); // Conflates with 1.0 if the stream has not taken it yet
+        Assert(waitFor(2, [](const VARIANT& v) { return v.vt == VT_R8 && v.dblVal == 42.0; }),
+               "A coroutine awaiting a ValueChannel should publish what is pushed");
+
+        server->WaitForTasks(); // Back to waiting on the channel
+        server->DisconnectData(2);
+        Assert(*destroyed == 2, "DisconnectData should destroy a suspended coroutine's frame");
+        input->Push(5.0);
+        server->WaitForTasks();
+        Assert(*destroyed == 2, "A push after DisconnectData should not resume the stream");
+
+        server->StartTopicStream(3, Throws());
+        Assert(waitFor(3, [](const VARIANT& v) { return v.vt == VT_ERROR && v.scode == 2015; }),
+               "An escaping exception should publish #VALUE!");
+
+        // Many live topics share pooled frames; replacing and disconnecting returns them
+        const long streams = 1000;
+        auto idle = std::make_shared<rtd::ValueChannel<double>>();
+        for (long id = 100; id < 100 + streams; ++id) server->StartTopicStream(id, Doubler(idle, destroyed));
+        server->WaitForTasks();
+        rtd::FramePool::Stats live = rtd::FramePool::Instance().GetStats();
+        Assert(live.chunks - before.chunks < streams / 10, "Coroutine frames should be carved from pooled chunks");
+        server->StartTopicStream(100, CountTo(1000000, destroyed));
+        for (long id = 101; id < 100 + streams; ++id) server->DisconnectData(id);
+        Assert(*destroyed == 2 + streams, "Replacing or disconnecting a topic should destroy its coroutine");
+
+        server->StartTopicStream(4, CountTo(1000000, destroyed));
+        server->WaitForTasks(); // Past its first suspension, so the probe exists
+        server->ServerTerminate();
+        Assert(*destroyed == 2 + streams + 2, "ServerTerminate should destroy running coroutines");
+        idle.reset(); // Drops the last waiter it was holding
+        Assert(rtd::FramePool::Instance().GetStats().liveBlocks == before.liveBlocks,
+               "Destroyed frames should go back to the pool");
+
+        server->Release();
+        delete callback;
+    }
+
+    // Test 20: Edge-Triggered Notify and Refresh Cadence
+    std::cout << "Test 20: Notify Pacing..." << std::endl;
+    {
+        class PacedServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        PacedServer* server = new PacedServer();
+        MockUpdateEvent* callback = new MockUpdateEvent();
+        callback->m_heartbeatInterval = 50;
+        long res = 0;
+        server->ServerStart(callback, &res);
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+        auto refresh = [&]() {
+            server->RefreshData(&topicCount, &sa);
+            if (sa) { SafeArrayDestroy(sa); sa = nullptr; }
+        };
+
+        for (int i = 0; i < 100; ++i) {
+            server->UpdateTopic(1, static_cast<double>(i));
+            server->NotifyUpdate();
+        }
+        Assert(callback->m_notifyCount == 1, "Only the first notify before RefreshData should reach Excel");
+        Assert(server->GetStatsValue(rtd::StatsMetric::NotifyAbsorbed) == 99.0, "Absorbed notifies should be counted");
+        refresh();
+        Assert(topicCount == 1, "RefreshData should collect everything published meanwhile");
+        server->NotifyUpdate();
+        Assert(callback->m_notifyCount == 2, "RefreshData should re-open the notify gate");
+
+        // Excel sits on each notify for ~30 ms (its throttle interval)
+        for (int cycle = 0; cycle < 4; ++cycle) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            refresh();
+            server->NotifyUpdate();
+        }
+        rtd::RefreshCadence::Snapshot cadence = server->GetRefreshCadence();
+        Assert(cadence.throttleMs >= 25.0 && cadence.throttleMs < 250.0, "The throttle interval should be measured from held notifies");
+        Assert(cadence.intervalMs >= 25.0 && server->GetStatsValue(rtd::StatsMetric::RefreshIntervalMs) == cadence.intervalMs,
+               "The refresh interval should be served as a metric");
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        refresh();
+        server->SetNotifyPacing(rtd::NotifyPacing::Adaptive);
+        long before = callback->m_notifyCount;
+        server->NotifyUpdate();
+        Assert(callback->m_notifyCount == before, "Adaptive pacing should hold a notify while Excel is throttling");
+        bool delivered = false;
+        for (int i = 0; i < 500 && !delivered; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            delivered = callback->m_notifyCount == before + 1;
+        }
+        Assert(delivered, "The held notify should be sent when the throttle interval is nearly over");
+
+        // A notify Excel never answers is re-sent on a heartbeat once the interval has passed
+        long hbRes = 0;
+        server->Heartbeat(&hbRes);
+        Assert(callback->m_notifyCount == before + 1, "Heartbeat should not re-send a fresh notify");
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        server->Heartbeat(&hbRes);
+        Assert(callback->m_notifyCount == before + 2, "Heartbeat should re-send a notify outstanding for a whole interval");
+
+        server->ServerTerminate();
+        server->Release();
+        delete callback;
+    }
+
+    // Test 21: Capped RefreshData with Prioritised Delivery
+    std::cout << "Test 21: Capped RefreshData..." << std::endl;
+    {
+        class CappedServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long TopicID, SAFEARRAY** Strings, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                ApplyTopicPolicy(TopicID, Strings);
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        CappedServer* server = new CappedServer();
+        MockUpdateEvent* callback = new MockUpdateEvent();
+        long res = 0;
+        server->ServerStart(callback, &res);
+        server->SetMaxRefreshBatch(3);
+
+        VARIANT_BOOL getNewValues = VARIANT_FALSE;
+        VARIANT out;
+        VariantInit(&out);
+        SAFEARRAY* urgentStrings = MakeTopicStrings({ L"URGENT", L"@priority=5" });
+        server->ConnectData(7, &urgentStrings, &getNewValues, &out);
+        SafeArrayDestroy(urgentStrings);
+        server->SetTopicPriority(9, 2);
+
+        long topicCount = 0;
+        SAFEARRAY* sa = nullptr;
+        auto refresh = [&]() {
+            std::vector<long> ids;
+            server->RefreshData(&topicCount, &sa);
+            if (!sa) return ids;
+            for (long i = 0; i < topicCount; ++i) {
+                long indices[2] = { i, 0 };
+                VARIANT id;
+                SafeArrayGetElement(sa, indices, &id);
+                ids.push_back(id.lVal);
+            }
+            SafeArrayDestroy(sa);
+            sa = nullptr;
+            return ids;
+        };
+        auto contains = [](const std::vector<long>& ids, long id) {
+            return std::find(ids.begin(), ids.end(), id) != ids.end();
+        };
+
+        for (long id = 1; id <= 10; ++id) server->UpdateTopic(id, static_cast<double>(id));
+        long notifiesBefore = callback->m_notifyCount;
+        std::vector<long> batch = refresh();
+        Assert(topicCount == 3, "RefreshData should deliver at most the cap");
+        Assert(contains(batch, 7) && contains(batch, 9), "Highest priority topics should go first");
+        Assert(server->GetStatsValue(rtd::StatsMetric::RefreshDeferred) == 7.0, "Topics left out should be counted");
+        bool notified = false;
+        for (int i = 0; i < 500 && !notified; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            notified = callback->m_notifyCount > notifiesBefore;
+        }
+        Assert(notified, "A follow-up notify should be scheduled for the leftovers");
+
+        std::vector<long> rest;
+        for (int i = 0; i < 3; ++i) {
+            batch = refresh();
+            Assert(topicCount <= 3, "Follow-up batches should stay within the cap");
+            rest.insert(rest.end(), batch.begin(), batch.end());
+        }
+        Assert(rest.size() == 7 && refresh().empty(), "Leftovers should be delivered by later refreshes");
+
+        // A steady stream of urgent updates must not starve the default-priority topic
+        server->SetMaxRefreshBatch(1);
+        server->UpdateTopic(1, 100.0);
+        bool aged = false;
+        for (int i = 0; i < 20 && !aged; ++i) {
+            server->UpdateTopic(7, static_cast<double>(i));
+            aged = contains(refresh(), 1);
+        }
+        Assert(aged, "Aging should eventually deliver a passed-over topic");
+
+        server->SetMaxRefreshBatch(0);
+        for (long id = 1; id <= 10; ++id) server->UpdateTopic(id, 0.0);
+        refresh();
+        Assert(topicCount == 10, "Removing the cap should deliver everything at once");
+
+        server->ServerTerminate();
+        server->Release();
+        delete callback;
+    }
+
+    // Test 22: XLOPER12 Content Hashing and Dedupe Cache
+    std::cout << "Test 22: Content Hashing..." << std::endl;
+    {
+        // Chunking and the SIMD path must not change the hash
+        std::vector<unsigned char> bytes(5000);
+        for (size_t i = 0; i < bytes.size(); ++i) bytes[i] = static_cast<unsigned char>(i * 131 + 7);
+        uint64_t whole = rtd::ContentHasher::Hash(bytes.data(), bytes.size());
+        rtd::ContentHasher chunked;
+        for (size_t offset = 0, step = 1; offset < bytes.size(); offset += step, step = step * 3 + 1) {
+            chunked.Update(bytes.data() + offset, std::min(step, bytes.size() - offset));
+        }
+        Assert(chunked.Digest() == whole, "Chunked input should hash like one update");
+        Assert(rtd::ContentHasher::Hash(bytes.data(), bytes.size(), rtd::HashIsa::Scalar) == whole,
+               "The scalar and vector stripe loops should agree");
+        bytes[4321] ^= 1;
+        Assert(rtd::ContentHasher::Hash(bytes.data(), bytes.size()) != whole, "A flipped bit should change the hash");
+        Assert(rtd::ContentHasher::Hash(bytes.data(), 10) != rtd::ContentHasher::Hash(bytes.data(), 11),
+               "Length should be part of the hash");
+
+        std::vector<XLOPER12> cells(2000);
+        for (size_t i = 0; i < cells.size(); ++i) {
+            cells[i].xltype = xltypeNum;
+            cells[i].val.num = static_cast<double>(i) * 0.5;
+        }
+        static XCHAR text[] = L"\x0005Hello";
+        cells[7].xltype = xltypeStr;
+        cells[7].val.str = text;
+        cells[9].xltype = xltypeErr;
+        cells[9].val.err = xlerrNA;
+        cells[11].xltype = xltypeNil;
+
+        XLOPER12 matrix;
+        matrix.xltype = xltypeMulti;
+        matrix.val.array.lparray = cells.data();
+        matrix.val.array.rows = 1000;
+        matrix.val.array.columns = 2;
+        uint64_t base = rtd::HashXloper(matrix);
+        Assert(rtd::HashXloper(matrix, rtd::HashIsa::Scalar) == base, "Matrix hash should not depend on the stripe loop");
+
+        matrix.val.array.rows = 2;
+        matrix.val.array.columns = 1000;
+        Assert(rtd::HashXloper(matrix) != base, "Shape should be part of the hash");
+        matrix.val.array.rows = 1000;
+        matrix.val.array.columns = 2;
+
+        auto changed = [&](auto edit) {
+            XLOPER12 saved = cells[1500];
+            edit(cells[1500]);
+            uint64_t hash = rtd::HashXloper(matrix);
+            cells[1500] = saved;
+            return hash != base;
+        };
+        Assert(changed([](XLOPER12& x) { x.val.num += 1e-12; }), "A numeric change should change the hash");
+        Assert(changed([](XLOPER12& x) { x.xltype = xltypeBool; x.val.xbool = 1; }), "Type should be part of the hash");
+        Assert(!changed([](XLOPER12& x) { x.xltype |= xlbitXLFree; }), "Memory ownership bits should not affect the hash");
+        cells[0].val.num = -0.0;
+        Assert(rtd::HashXloper(matrix) == base, "-0 should hash like 0");
+        static XCHAR other[] = L"\x0005Hellp";
+        cells[7].val.str = other;
+        Assert(rtd::HashXloper(matrix) != base, "String content should be part of the hash");
+        cells[7].val.str = text;
+        Assert(rtd::FormatContentHash(0x1234abcdULL) == L"000000001234abcd", "Hash topics should be fixed-width hex");
+
+        rtd::ContentHashCache cache(2, 100);
+        Assert(cache.MarkSent(1, 10) && !cache.MarkSent(1, 10), "A hash should be sent once");
+        Assert(cache.MarkSent(2, 10) && cache.MarkSent(3, 10), "New hashes should be sent");
+        Assert(!cache.IsSent(1) && cache.IsSent(3), "The least recently used hash should be evicted");
+        Assert(cache.MarkSent(4, 95) && !cache.IsSent(3) && cache.IsSent(4), "The byte bound should evict too");
+        cache.Forget(4);
+        Assert(cache.MarkSent(4, 95), "A forgotten hash should be sent again");
+        uint64_t recalled = 0;
+        cache.Remember(42, base);
+        Assert(cache.Recall(42, recalled) && recalled == base && !cache.Recall(43, recalled),
+               "Remembered hashes should be recalled by key");
+        rtd::ContentHashCache::Stats cacheStats = cache.GetStats();
+        Assert(cacheStats.hits == 1 && cacheStats.recalls == 1 && cacheStats.entries == 1 && cacheStats.bytes == 95,
+               "Cache stats should track hits, recalls and payload");
+    }
+
+    // Test 23: Shared-Memory Feed
+    std::cout << "Test 23: Shared-Memory Feed..." << std::endl;
+    {
+        class FeedServer : public rtd::RtdServerBase {
+        public:
+            HRESULT __stdcall ConnectData(long, SAFEARRAY**, VARIANT_BOOL*, VARIANT* pvarOut) override {
+                if (!pvarOut) return E_POINTER;
+                pvarOut->vt = VT_ERROR;
+                pvarOut->scode = 2043;
+                return S_OK;
+            }
+        };
+
+        FeedServer* server = new FeedServer();
+        MockUpdateEvent* callback = new MockUpdateEvent();
+        long res = 0;
+        server->ServerStart(callback, &res);
+
+        const std::wstring name = L"Local\\RtdUnitTestFeed";
+        rtd::ShmFeedWriter early;
+        Assert(FAILED(early.Open(name)), "A writer should not open a feed before the reader creates it");
+
+        rtd::ShmFeedReader reader(*server);
+        Assert(reader.Start(name, 1000) == E_INVALIDARG, "Ring capacity should be a power of two");
+        Assert(SUCCEEDED(reader.Start(name, 1024)), "The reader should create the feed");
+        rtd::ShmFeedReader rival(*server);
+        Assert(rival.Start(name, 1024) == HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS), "A second reader should be refused");
+
+        rtd::ShmFeedWriter writer;
+        Assert(SUCCEEDED(writer.Open(name)), "A writer should open the feed");
+        Assert(writer.Push(1, 1.5) && writer.Push(2, L"Bid") && writer.PushError(3, 2042) && writer.Push(4, 42) &&
+               writer.Push(uint64_t(1) << 40, 0.0), "Pushes should fit in the ring");
+        Assert(!writer.Push(5, std::wstring(rtd::FeedRecord::kMaxText + 1, L'x')), "Over-long strings should be refused");
+
+        auto waitFor = [&](unsigned long long records) {
+            for (int i = 0; i < 2000 && reader.GetStats().records < records; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return reader.GetStats().records >= records;
+        };
+        Assert(waitFor(5), "The reader thread should drain the ring");
+        rtd::ShmFeedReader::Stats feedStats = reader.GetStats();
+        Assert(feedStats.unmapped == 1, "Keys that are not TopicIDs should be skipped");
+        Assert(feedStats.LatencyPercentileNs(0.5) > 0.0, "Producer timestamps should give a latency");
+
+        std::map<long, VARIANT> delivered;
+        auto refresh = [&]() {
+            for (auto& entry : delivered) VariantClear(&entry.second);
+            delivered.clear();
+            long topicCount = 0;
+            SAFEARRAY* sa = nullptr;
+            server->RefreshData(&topicCount, &sa);
+            if (!sa) return;
+            for (long i = 0; i < topicCount; ++i) {
+                long idIndex[2] = { i, 0 };
+                long valueIndex[2] = { i, 1 };
+                VARIANT id, value;
+                VariantInit(&value);
+                SafeArrayGetElement(sa, idIndex, &id);
+                SafeArrayGetElement(sa, valueIndex, &value);
+                delivered[id.lVal] = value;
+            }
+            SafeArrayDestroy(sa);
+        };
+        refresh();
+        Assert(delivered.size() == 4, "Every mapped record should reach RefreshData");
+        Assert(delivered[1].vt == VT_R8 && delivered[1].dblVal == 1.5, "Doubles should arrive intact");
+        Assert(delivered[2].vt == VT_BSTR && std::wstring(delivered[2].bstrVal) == L"Bid", "Strings should arrive intact");
+        Assert(delivered[3].vt == VT_ERROR && delivered[3].scode == 2042, "Errors should arrive intact");
+
+        // Several producers into one ring; a full ring is retried, so nothing is lost
+        const int producers = 4;
+        const long perProducer = 20000;
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p]() {
+                rtd::ShmFeedWriter local;
+                if (FAILED(local.Open(name))) return;
+                for (long i = 1; i <= perProducer; ++i) {
+                    while (!local.Push(static_cast<uint64_t>(10 + p), static_cast<double>(i))) std::this_thread::yield();
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        Assert(waitFor(5 + producers * perProducer), "Every pushed record should be drained");
+        refresh();
+        bool lastWins = delivered.size() == static_cast<size_t>(producers);
+        for (int p = 0; p < producers; ++p) lastWins = lastWins && delivered[10 + p].dblVal == perProducer;
+        Assert(lastWins, "Each producer's last value should win");
+
+        // A stopped reader closes the ring; writers let go so the name can be reused
+        reader.Stop();
+        Assert(writer.IsClosed() && !writer.Push(1, 2.0), "Writers should see the reader stop");
+        writer.Close();
+
+        // The key mapper translates producer keys
+        rtd::ShmFeedReader mapped(*server);
+        mapped.SetKeyMapper([](uint64_t key) { return key == 777 ? 20L : -1L; });
+        Assert(SUCCEEDED(mapped.Start(name, 64)), "A stopped reader should release the name");
+        Assert(SUCCEEDED(writer.Open(name)) && writer.Push(777, true), "The writer should reopen the new ring");
+        for (int i = 0; i < 2000 && mapped.GetStats().records < 1; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        mapped.Stop();
+        refresh();
+        Assert(delivered.size() == 1 && delivered[20].vt == VT_BOOL, "Mapped keys should update their topic");
+        for (auto& entry : delivered) VariantClear(&entry.second);
+
+        writer.Close();
+        early.Close();
+        server->ServerTerminate();
+        server->Release();
+        delete callback;
+    }
+
+    // Test 24: Stream Feed Adapter over Pipe and TCP
+    std::cout << "Test 24: Stream Feed Adapter..." << std::endl;
+    {
+        class StreamServer : public rtd::RtdServerBase {
+        public:
+            rtd::FeedAdapter feed{ *this };
+        protected:
+            HRESULT OnSubscribe(const rtd::SubscriptionHandle& subscription, const rtd::TopicArgs& args) override {
+                feed.Subscribe(subscription, args);
+                return S_OK;
+            }
+            void OnUnsubscribe(const rtd::SubscriptionHandle& subscription) override { feed.Unsubscribe(subscription); }
+        };
+
+        // Reads back-channel frames at the publisher: returns the key, and the args of a Subscribe
+        auto receive = [](rtd::FeedPublisher& publisher, rtd::FeedFrameKind& kind, std::vector<std::wstring>& args) {
+            std::vector<uint8_t> payload;
+            uint64_t key = 0;
+            args.clear();
+            if (FAILED(publisher.Receive(kind, payload))) return key;
+            rtd::FeedPayloadReader reader(payload.data(), payload.size());
+            reader.Read(key);
+            uint16_t argc = 0;
+            if (kind == rtd::FeedFrameKind::Subscribe && reader.Read(argc)) {
+                args.resize(argc);
+                for (std::wstring& arg : args) reader.ReadText(arg);
+            }
+            return key;
+        };
+
+        for (int transport = 0; transport < 2; ++transport) {
+            const bool tcp = transport == 1;
+            const std::wstring pipeName = L"\\\\.\\pipe\\RtdUnitTestFeed";
+            const unsigned short port = 47391;
+
+            StreamServer* server = new StreamServer();
+            MockUpdateEvent* callback = new MockUpdateEvent();
+            long res = 0;
+            server->ServerStart(callback, &res);
+
+            VARIANT_BOOL getNewValues = VARIANT_FALSE;
+            VARIANT out;
+            VariantInit(&out);
+            SAFEARRAY* aapl = MakeTopicStrings({ L"AAPL", L"Last" });
+            SAFEARRAY* halt = MakeTopicStrings({ L"MSFT", L"Status" });
+            server->ConnectData(1, &aapl, &getNewValues, &out);
+
+            rtd::FeedPublisher publisher;
+            Assert(SUCCEEDED(tcp ? publisher.ListenTcp(port) : publisher.ListenPipe(pipeName)), "The publisher should listen");
+            Assert(SUCCEEDED(tcp ? server->feed.ConnectTcp(port) : server->feed.ConnectPipe(pipeName)), "The adapter should start");
+            Assert(server->feed.ConnectTcp(port) == E_UNEXPECTED, "A running adapter should refuse a second connect");
+            Assert(SUCCEEDED(publisher.Accept()), "The adapter should connect");
+
+            // Subscriptions made before the connection are sent once it is up
+            rtd::FeedFrameKind kind{};
+            std::vector<std::wstring> args;
+            uint64_t aaplKey = receive(publisher, kind, args);
+            Assert(kind == rtd::FeedFrameKind::Subscribe && args.size() == 2 && args[0] == L"AAPL" && args[1] == L"Last",
+                   "ConnectData should send a Subscribe frame with the topic arguments");
+            server->ConnectData(2, &halt, &getNewValues, &out);
+            uint64_t haltKey = receive(publisher, kind, args);
+            Assert(kind == rtd::FeedFrameKind::Subscribe && haltKey != aaplKey && args[0] == L"MSFT",
+                   "A live connection should send new subscriptions at once");
+
+            // One frame, one bulk update and one notification; unknown keys are skipped
+            long notifies = callback->m_notifyCount.load();
+            rtd::FeedFrameWriter frames;
+            frames.BeginUpdates();
+            frames.Add(aaplKey, 101.5);
+            frames.Add(haltKey, L"Halted");
+            frames.Add(aaplKey + (uint64_t(1) << 32), 0.0);
+            frames.EndUpdates();
+            Assert(SUCCEEDED(publisher.Send(frames)), "The publisher should send");
+
+            auto waitFrames = [&](unsigned long long count) {
+                for (int i = 0; i < 2000 && server->feed.GetStats().frames < count; ++i) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                return server->feed.GetStats().frames >= count;
+            };
+            Assert(waitFrames(1), "The adapter should apply the frame");
+            Assert(callback->m_notifyCount.load() == notifies + 1, "A frame should notify Excel once");
+            rtd::FeedAdapter::Stats stats = server->feed.GetStats();
+            Assert(stats.updates == 3 && stats.LatencyPercentileNs(0.5) > 0.0, "Updates and their latency should be counted");
+
+            std::map<long, VARIANT> delivered;
+            auto refresh = [&]() {
+                for (auto& entry : delivered) VariantClear(&entry.second);
+                delivered.clear();
+                long topicCount = 0;
+                SAFEARRAY* sa = nullptr;
+                server->RefreshData(&topicCount, &sa);
+                if (!sa) return;
+                for (long i = 0; i < topicCount; ++i) {
+                    long idIndex[2] = { i, 0 };
+                    long valueIndex[2] = { i, 1 };
+                    VARIANT id, value;
+                    VariantInit(&value);
+                    SafeArrayGetElement(sa, idIndex, &id);
+                    SafeArrayGetElement(sa, valueIndex, &value);
+                    delivered[id.lVal] = value;
+                }
+                SafeArrayDestroy(sa);
+            };
+            refresh();
+            Assert(delivered.size() == 2 && delivered[1].vt == VT_R8 && delivered[1].dblVal == 101.5,
+                   "Numbers should reach their topic");
+            Assert(delivered[2].vt == VT_BSTR && std::wstring(delivered[2].bstrVal) == L"Halted", "Strings should reach their topic");
+
+            // A frame larger than the read buffer grows it
+            std::wstring longText(40000, L'x');
+            frames.BeginUpdates();
+            frames.Add(haltKey, longText);
+            frames.EndUpdates();
+            publisher.Send(frames);
+            Assert(waitFrames(2), "Frames larger than the read buffer should be applied");
+            refresh();
+            Assert(delivered[2].vt == VT_BSTR && SysStringLen(delivered[2].bstrVal) == longText.size(),
+                   "Large values should arrive intact");
+
+            // DisconnectData sends Unsubscribe
+            server->DisconnectData(2);
+            uint64_t closedKey = receive(publisher, kind, args);
+            Assert(kind == rtd::FeedFrameKind::Unsubscribe && closedKey == haltKey, "The last DisconnectData should unsubscribe");
+
+            // A malformed frame drops the connection; the adapter reconnects and resubscribes
+            const uint8_t zeroLength[5] = { 0, 0, 0, 0, 1 };
+            publisher.Send(zeroLength, sizeof(zeroLength));
+            for (int i = 0; i < 2000 && server->feed.GetStats().protocolErrors < 1; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            Assert(server->feed.GetStats().protocolErrors == 1, "A zero-length frame should be a protocol error");
+            publisher.Disconnect();
+            Assert(SUCCEEDED(publisher.Accept()), "The adapter should reconnect");
+            uint64_t resubscribed = receive(publisher, kind, args);
+            Assert(kind == rtd::FeedFrameKind::Subscribe && resubscribed == aaplKey && args[0] == L"AAPL",
+                   "Live subscriptions should be sent again after a reconnect");
+            Assert(server->feed.GetStats().connects == 2, "Both connections should be counted");
+
+            // A count the payload cannot hold is rejected before any buffer is sized for it
+            const uint8_t oversized[17] = { 13, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF };
+            publisher.Send(oversized, sizeof(oversized));
+            for (int i = 0; i < 2000 && server->feed.GetStats().protocolErrors < 2; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            Assert(server->feed.GetStats().protocolErrors == 2, "An update count beyond the payload should be a protocol error");
+            publisher.Disconnect();
+            Assert(SUCCEEDED(publisher.Accept()), "The adapter should reconnect after a bad count");
+            receive(publisher, kind, args);
+
+            server->feed.Stop();
+            Assert(!server->feed.IsConnected(), "Stop should close the connection");
+            for (auto& entry : delivered) VariantClear(&entry.second);
+            publisher.Close();
+            SafeArrayDestroy(aapl);
+            SafeArrayDestroy(halt);
+            server->ServerTerminate();
+            server->Release();
+            delete callback;
+        }
+    }
+
+    // Test 25: Last-Value Snapshot
+    std::cout << "Test 25: Last-Value Snapshot..." << std::endl;
+    {
+        class SnapshotServer : public rtd::RtdServerBase {
+        public:
+            std::atomic<int> subscribes{ 0 };
+            std::atomic<int> unsubscribes{ 0 };
+            std::map<std::wstring, rtd::SubscriptionHandle> handles;
+        protected:
+            HRESULT OnSubscribe(const rtd::SubscriptionHandle& subscription, const rtd::TopicArgs& args) override {
+                handles[args.Key()] = subscription;
+                ++subscribes;
+                return S_OK;
+            }
+            void OnUnsubscribe(const rtd::SubscriptionHandle&) override { ++unsubscribes; }
+        };
+
+        const std::wstring path = L"rtd_unit_test.snapshot";
+        DeleteFileW(path.c_str());
+        SAFEARRAY* aapl = MakeTopicStrings({ L"AAPL", L"Last" });
+        SAFEARRAY* msft = MakeTopicStrings({ L"MSFT", L"Status" });
+        SAFEARRAY* goog = MakeTopicStrings({ L"GOOG", L"Volume" });
+        SAFEARRAY* ibm = MakeTopicStrings({ L"IBM", L"Last" });
+        VARIANT_BOOL getNewValues = VARIANT_FALSE;
+        VARIANT out;
+        VariantInit(&out);
+        long res = 0;
+        auto refresh = [](SnapshotServer* server) {
+            long topicCount = 0;
+            SAFEARRAY* sa = nullptr;
+            server->RefreshData(&topicCount, &sa);
+            if (sa) SafeArrayDestroy(sa);
+            return topicCount;
+        };
+
+        // Session 1: three keys get values, one never does
+        SnapshotServer* server = new SnapshotServer();
+        MockUpdateEvent* callback = new MockUpdateEvent();
+        Assert(SUCCEEDED(server->EnableSnapshot(path, 16)), "The snapshot file should open");
+        server->ServerStart(callback, &res);
+        server->ConnectData(1, &aapl, &getNewValues, &out);
+        server->ConnectData(2, &msft, &getNewValues, &out);
+        server->ConnectData(3, &goog, &getNewValues, &out);
+        server->ConnectData(4, &ibm, &getNewValues, &out);
+        Assert(out.vt == VT_ERROR && out.scode == 2043, "An empty snapshot should leave #GETTING_DATA");
+        server->UpdateSubscription(server->handles[L"AAPL\x1FLast\x1F"], 101.5);
+        server->UpdateSubscription(server->handles[L"MSFT\x1FStatus\x1F"], L"Halted");
+        server->UpdateSubscription(server->handles[L"GOOG\x1FVolume\x1F"], 7LL);
+        Assert(refresh(server) == 3, "Three topics should be delivered");
+        rtd::TopicSnapshot::Stats snapshotStats = server->GetSnapshotStats();
+        Assert(snapshotStats.writes == 3 && snapshotStats.records == 4, "Delivered values should be written to their records");
+        for (long id = 1; id <= 4; ++id) server->DisconnectData(id);
+        server->ServerTerminate();
+        server->Release();
+        delete callback;
+
+        // Session 2: values come back through ConnectData and the keys are subscribed at ServerStart
+        server = new SnapshotServer();
+        callback = new MockUpdateEvent();
+        Assert(SUCCEEDED(server->EnableSnapshot(path)), "The snapshot file should reopen");
+        Assert(server->GetSnapshotStats().restored == 3, "Keys with values should be restored");
+        server->SetSnapshotPrewarm(std::chrono::milliseconds(100));
+        server->ServerStart(callback, &res);
+        Assert(server->subscribes == 3 && server->GetSubscriptionCount() == 3, "ServerStart should subscribe to restored keys");
+        getNewValues = VARIANT_FALSE;
+        server->ConnectData(11, &aapl, &getNewValues, &out);
+        Assert(out.vt == VT_R8 && out.dblVal == 101.5 && getNewValues == VARIANT_TRUE, "ConnectData should return the last known value");
+        Assert(server->subscribes == 3, "A prewarmed key should not be subscribed again");
+        server->ConnectData(12, &msft, &getNewValues, &out);
+        Assert(out.vt == VT_BSTR && std::wstring(out.bstrVal) == L"Halted", "Strings should be restored");
+        VariantClear(&out);
+        server->ConnectData(14, &ibm, &getNewValues, &out);
+        Assert(out.vt == VT_ERROR && out.scode == 2043, "A key that never had a value should still be pending");
+
+        // GOOG is not reconnected within the grace period: unsubscribed and forgotten
+        for (int i = 0; i < 2000 && server->unsubscribes < 1; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        Assert(server->unsubscribes == 1 && server->GetSubscriptionCount() == 3, "Unclaimed prewarmed keys should be unsubscribed");
+        server->ConnectData(13, &goog, &getNewValues, &out);
+        Assert(out.vt == VT_ERROR && out.scode == 2043 && server->subscribes == 5, "A swept key should start from scratch");
+
+        // A fresh value replaces the restored one
+        server->UpdateSubscription(server->handles[L"AAPL\x1FLast\x1F"], 102.25);
+        refresh(server);
+        for (long id = 11; id <= 14; ++id) server->DisconnectData(id);
+        server->ServerTerminate();
+        server->Release();
+        delete callback;
+
+        // Session 3: without pre-warming, ConnectData still answers from the snapshot
+        server = new SnapshotServer();
+        callback = new MockUpdateEvent();
+        server->EnableSnapshot(path);
+        server->SetSnapshotPrewarm(std::chrono::milliseconds(0));
+        Assert(server->GetSnapshotStats().restored == 2, "Swept keys should not be restored");
+        server->ServerStart(callback, &res);
+        Assert(server->subscribes == 0, "Pre-warming should be off");
+        server->ConnectData(21, &aapl, &getNewValues, &out);
+        Assert(out.vt == VT_R8 && out.dblVal == 102.25 && server->subscribes == 1, "The newest delivered value should be restored");
+        server->DisconnectData(21);
+        server->ServerTerminate();
+        server->Release();
+        delete callback;
+
+        // Records of closed subscriptions are reused when the file is full
+        {
+            const std::wstring smallPath = L"rtd_unit_test_small.snapshot";
+            DeleteFileW(smallPath.c_str());
+            rtd::TopicSnapshot snapshot;
+            Assert(SUCCEEDED(snapshot.Open(smallPath, 2)), "A small snapshot should open");
+            long a = snapshot.Claim(L"A");
+            long b = snapshot.Claim(L"B");
+            Assert(a != b && snapshot.Claim(L"C") == rtd::TopicSnapshot::kNil && snapshot.GetStats().full == 1,
+                   "A full snapshot should refuse new keys while every record is live");
+            Assert(snapshot.Claim(std::wstring(200, L'k')) == rtd::TopicSnapshot::kNil, "Keys longer than a record should be refused");
+            snapshot.Release(a);
+            Assert(snapshot.Claim(L"C") == a && snapshot.Find(L"A") == rtd::TopicSnapshot::kNil,
+                   "A released record should be reused");
+            rtd::TopicValue value;
+            value.Assign(std::wstring_view(std::wstring(150, L'v')));
+            snapshot.Write(b, value);
+            Assert(!snapshot.Read(b, value) && snapshot.GetStats().skipped == 1, "Values that do not fit should not be kept");
+            snapshot.Close();
+            DeleteFileW(smallPath.c_str());
+        }
+
+        SafeArrayDestroy(aapl);
+        SafeArrayDestroy(msft);
+        SafeArrayDestroy(goog);
+        SafeArrayDestroy(ibm);
+        DeleteFileW(path.c_str());
+    }
+
+    // Test 26: Result Cache for Matrix Handles
+    std::cout << "Test 26: Result Cache..." << std::endl;
+    {
+        rtd::ResultCache cache;
+        rtd::ResultMatrix matrix;
+        Assert(matrix.Resize(0, 3) == E_INVALIDARG && matrix.Resize(2, 20000) == E_INVALIDARG, "Shapes beyond a worksheet should be refused");
+        matrix.Resize(2, 3);
+        const double numbers[6] = { 1, 2, 3, 4, 5, 6 };
+        matrix.SetNumbers(numbers);
+        matrix.SetString(0, 1, L"bid");
+        matrix.SetString(1, 2, L"ask");
+        matrix.SetBool(1, 0, true);
+        std::wstring first = cache.Publish(L"curve", std::move(matrix));
+        Assert(first == L"curve@1", "Publish should return a versioned handle");
+
+        // Resolve hands out the cached cells themselves
+        XCHAR handleText[16] = {};
+        auto toXloper = [&](const std::wstring& text) {
+            XLOPER12 oper = {};
+            oper.xltype = xltypeStr;
+            handleText[0] = static_cast<XCHAR>(text.size());
+            std::copy(text.begin(), text.end(), handleText + 1);
+            oper.val.str = handleText;
+            return oper;
+        };
+        XLOPER12 handle = toXloper(first);
+        LPXLOPER12 result = rtd::XlResultSlot::Resolve(handle, cache);
+        Assert(result->xltype == (xltypeMulti | xlbitDLLFree) && result->val.array.rows == 2 && result->val.array.columns == 3,
+               "Resolve should return an xltypeMulti for Excel to free");
+        const XLOPER12* cells = result->val.array.lparray;
+        Assert(cells == cache.Find(first)->Cells(), "The array should point at the cached cells");
+        Assert(cells[0].xltype == xltypeNum && cells[0].val.num == 1 && cells[3].xltype == xltypeBool && cells[3].val.xbool,
+               "Numbers and booleans should be in row-major order");
+        Assert(cells[1].xltype == xltypeStr && cells[1].val.str[0] == 3 && std::wstring(cells[5].val.str + 1, 3) == L"ask",
+               "Strings should be length-prefixed");
+
+        // A newer version replaces the cache entry; the pinned one lives until xlAutoFree12
+        std::weak_ptr<const rtd::ResultMatrix> pinned = cache.Find(first);
+        rtd::ResultMatrix next;
+        next.Resize(1, 1);
+        next.SetNumber(0, 0, 42.0);
+        std::wstring second = cache.Publish(L"curve", std::move(next));
+        Assert(second == L"curve@2" && cache.GetStats().entries == 1, "Republishing should bump the version");
+        Assert(!pinned.expired(), "A matrix handed to Excel should stay alive until it is freed");
+        Assert(rtd::XlResultSlot::Release(result) && pinned.expired(), "xlAutoFree12 should release the replaced matrix");
+        XLOPER12 other = {};
+        Assert(!rtd::XlResultSlot::Release(&other), "Results from elsewhere should be left to the caller");
+        result = rtd::XlResultSlot::Resolve(handle, cache);
+        Assert(result->xltype == (xltypeMulti | xlbitDLLFree) && result->val.array.lparray[0].val.num == 42.0,
+               "An older handle should resolve to the latest version");
+        rtd::XlResultSlot::Release(result);
+
+        XLOPER12 pending = {};
+        pending.xltype = xltypeErr;
+        pending.val.err = xlerrNA;
+        Assert(rtd::XlResultSlot::Resolve(pending, cache)->val.err == xlerrGettingData, "An RTD error should read as #GETTING_DATA");
+        XLOPER12 unknown = toXloper(L"other@7");
+        result = rtd::XlResultSlot::Resolve(unknown, cache);
+        Assert(result->xltype == xltypeErr && result->val.err == xlerrNA, "Unknown handles should give #N/A");
+
+        // Memory bound: least recently used names go first
+        rtd::ResultCache small(3 * sizeof(rtd::ResultMatrix) + 3 * 1000 * sizeof(XLOPER12));
+        for (int i = 0; i < 4; ++i) {
+            rtd::ResultMatrix block;
+            block.Resize(1000, 1);
+            if (i == 3) small.Find(L"m0@1");
+            small.Publish(L"m" + std::to_wstring(i), std::move(block));
+        }
+        rtd::ResultCache::Stats stats = small.GetStats();
+        Assert(stats.entries == 3 && stats.evictions == 1 && !small.Find(L"m1") && small.Find(L"m0"),
+               "The least recently used matrix should be evicted");
+
+        // The example server's "matrix" topic delivers a handle MyMatrix can resolve
+        MyRtdServer* server = new MyRtdServer();
+        MockUpdateEvent* callback = new MockUpdateEvent();
+        long res = 0;
+        server->ServerStart(callback, &res);
+        SAFEARRAY* strings = MakeTopicStrings({ L"matrix", L"4", L"2" });
+        VARIANT_BOOL getNewValues = VARIANT_FALSE;
+        VARIANT out;
+        VariantInit(&out);
+        server->ConnectData(5, &strings, &getNewValues, &out);
+        std::wstring delivered;
+        for (int i = 0; i < 2000 && delivered.empty(); ++i) {
+            long topicCount = 0;
+            SAFEARRAY* sa = nullptr;
+            server->RefreshData(&topicCount, &sa);
+            if (sa) {
+                long valueIndex[2] = { 0, 1 };
+                VARIANT value;
+                VariantInit(&value);
+                SafeArrayGetElement(sa, valueIndex, &value);
+                if (value.vt == VT_BSTR) delivered = value.bstrVal;
+                VariantClear(&value);
+                SafeArrayDestroy(sa);
+            }
+            if (delivered.empty()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        Assert(delivered.rfind(L"matrix.5.", 0) == 0, "The matrix topic should deliver a handle");
+        handle = toXloper(delivered);
+        result = rtd::XlResultSlot::Resolve(handle);
+        Assert(result->xltype == (xltypeMulti | xlbitDLLFree) && result->val.array.rows == 4 && result->val.array.columns == 2,
+               "MyMatrix should resolve the handle from the shared cache");
+        rtd::XlResultSlot::Release(result);
+        server->DisconnectData(5);
+        // The stream erases its matrix when its frame is destroyed, at the latest after a running step
+        for (int i = 0; i < 2000 && rtd::ResultCache::Shared().Find(delivered); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        Assert(!rtd::ResultCache::Shared().Find(delivered), "DisconnectData should drop the matrix");
+        SafeArrayDestroy(strings);
+        server->ServerTerminate();
+        server->Release();
+        delete callback;
+    }
+
+    // Test 27: Compile-Time Topic Router
+    std::cout << "Test 27: Topic Router..." << std::endl;
+    {
+        struct RouteLog {
+            int route = 0;
+            long topicId = 0;
+            std::wstring symbol;
+            size_t field = 0;
+            long long count = 0;
+            double scale = 0.0;
+        };
+        struct QuoteTopic {
+            static HRESULT Connect(RouteLog& log, const rtd::TopicRequest& request, const rtd::TextArg& symbol,
+                                   const rtd::KeywordArg<L"bid", L"ask", L"last">& field) {
+                log.route = 1;
+                log.topicId = request.topicId;
+                log.symbol = std::wstring(symbol.value);
+                log.field = field.value;
+                VariantInit(request.pvarOut);
+                request.pvarOut->vt = VT_R8;
+                request.pvarOut->dblVal = 1.0;
+                return S_OK;
+            }
+        };
+        struct StatsTopic {
+            static HRESULT Connect(RouteLog& log, const rtd::TopicRequest&, const rtd::TextArg&) {
+                log.route = 2;
+                return S_OK;
+            }
+        };
+        struct TicksTopic {
+            static HRESULT Connect(RouteLog& log, const rtd::TopicRequest&, const rtd::IntegerArg& count, const rtd::NumberArg& scale) {
+                log.route = 3;
+                log.count = count.value;
+                log.scale = scale.value;
+                return S_OK;
+            }
+        };
+        using Router = rtd::TopicRouter<
+            rtd::Route<L"quote", QuoteTopic, rtd::TextArg, rtd::KeywordArg<L"bid", L"ask", L"last">>,
+            rtd::Route<L"stats", StatsTopic, rtd::TextArg>,
+            rtd::Route<L"ticks", TicksTopic, rtd::IntegerArg, rtd::NumberArg>>;
+        static_assert(Router::Find(L"quote") == 0 && Router::Find(L"stats") == 1 && Router::Find(L"ticks") == 2,
+                      "Route lookup should resolve at compile time");
+        static_assert(Router::Find(L"quotes") == Router::kNone && Router::Find(L"") == Router::kNone,
+                      "Unknown names should not resolve");
+
+        auto dispatch = [](RouteLog& log, std::initializer_list<const wchar_t*> strings, VARIANT& out) {
+            SAFEARRAY* sa = MakeTopicStrings(strings);
+            rtd::TopicArgs args;
+            args.Parse(sa);
+            HRESULT hr = Router::Dispatch(log, { 9, args, nullptr, &out });
+            SafeArrayDestroy(sa);
+            return hr;
+        };
+        RouteLog log;
+        VARIANT out;
+        VariantInit(&out);
+        Assert(dispatch(log, { L"quote", L"AAPL", L"ask", L"@rate=2" }, out) == S_OK && log.route == 1 && log.topicId == 9,
+               "A known topic should reach its handler");
+        Assert(log.symbol == L"AAPL" && log.field == 1 && out.vt == VT_R8, "Arguments should be parsed into their types");
+        dispatch(log, { L"stats", L"cpu" }, out);
+        Assert(log.route == 2, "Each topic kind should have its own handler");
+        dispatch(log, { L"ticks", L"-12", L"+2.5e1" }, out);
+        Assert(log.route == 3 && log.count == -12 && log.scale == 25.0, "Numbers should parse without allocating");
+
+        log = RouteLog();
+        dispatch(log, { L"news", L"AAPL" }, out);
+        Assert(log.route == 0 && out.vt == VT_ERROR && out.scode == 2029, "Unknown topics should get #NAME?");
+        dispatch(log, { L"quote", L"AAPL" }, out);
+        Assert(log.route == 0 && out.vt == VT_ERROR && out.scode == 2015, "A missing argument should get #VALUE!");
+        dispatch(log, { L"quote", L"AAPL", L"volume" }, out);
+        Assert(log.route == 0 && out.scode == 2015, "An unknown keyword should get #VALUE!");
+        dispatch(log, { L"ticks", L"12x", L"1" }, out);
+        Assert(log.route == 0 && out.scode == 2015, "A malformed number should get #VALUE!");
+        dispatch(log, {}, out);
+        Assert(out.vt == VT_ERROR && out.scode == 2029, "An empty topic should get #NAME?");
+    }
+
+    // Test 28: XLL Arena, xlAutoFree12 and Table Registration
+    std::cout << "Test 28: XLL Arena and Registration..." << std::endl;
+    {
+        rtd::XlArena& arena = rtd::XlArena::Current();
+        LPXLOPER12 first = nullptr;
+        {
+            rtd::XlFrame frame;
+            first = frame.Return(frame.String(L"Hello from XLL"));
+        }
+        Assert(first->xltype == (xltypeStr | xlbitDLLFree) && first->val.str[0] == 14 &&
+               std::wstring(first->val.str + 1, 14) == L"Hello from XLL", "A returned string should stay until Excel frees it");
+        size_t capacity = arena.Capacity();
+        Assert(rtd::XlAutoFree12(first), "xlAutoFree12 should release an arena result");
+        Assert(!rtd::XlAutoFree12(first), "A result should be released only once");
+        LPXLOPER12 second = nullptr;
+        {
+            rtd::XlFrame frame;
+            second = frame.Return(frame.String(L"Again"));
+        }
+        Assert(second == first && arena.Capacity() == capacity, "Released memory should be reused without allocating");
+        rtd::XlAutoFree12(second);
+
+        // Arrays with string cells, and a frame nested inside another (re-entry through Excel12)
+        {
+            rtd::XlFrame outer;
+            LPXLOPER12 temporary = outer.Number(7.0);
+            LPXLOPER12 inner = nullptr;
+            {
+                rtd::XlFrame frame;
+                LPXLOPER12 multi = frame.Multi(2, 2);
+                frame.SetString(multi->val.array.lparray[1], L"ask");
+                multi->val.array.lparray[2].xltype = xltypeNum;
+                multi->val.array.lparray[2].val.num = 3.5;
+                inner = frame.Return(multi);
+            }
+            Assert(inner->xltype == (xltypeMulti | xlbitDLLFree) && inner->val.array.lparray[0].xltype == xltypeNil &&
+                   inner->val.array.lparray[1].val.str[0] == 3 && inner->val.array.lparray[2].val.num == 3.5,
+                   "Arrays should be built in the arena");
+            rtd::XlAutoFree12(inner);
+            Assert(temporary->xltype == xltypeNum && temporary->val.num == 7.0, "Freeing an inner result should keep the outer frame's data");
+            Assert(outer.Multi(0, 3) == nullptr && outer.Return(nullptr)->val.err == xlerrNum, "Failures should surface as #NUM!");
+        }
+        XLOPER12 foreign = {};
+        Assert(!rtd::XlAutoFree12(&foreign), "Foreign results should be left to the caller");
+
+        // Excel12 without Excel, and one registration pass through a stand-in callback
+        XLOPER12 unused = {};
+        Assert(rtd::Excel12(xlfCaller, &unused) == xlretFailed, "Excel12 should fail outside Excel");
+        rtd::Excel12Entry().store(&MockExcel::Call);
+        static constexpr rtd::XlFunction kFunctions[] = {
+            { L"MyHello", L"Q$", L"", L"Tests", L"Greets" },
+            { L"MyMatrix", L"QQ$", L"handle", L"Tests", L"Resolves a handle", L"Matrix.Of" },
+        };
+        Assert(rtd::RegisterFunctions(kFunctions) == 2, "Every function in the table should be registered");
+        Assert(MockExcel::registered.size() == 2 && MockExcel::registered[0].size() == 10, "xlfRegister should get the full argument list");
+        const std::vector<std::wstring>& hello = MockExcel::registered[0];
+        const std::vector<std::wstring>& matrix = MockExcel::registered[1];
+        Assert(hello[0] == L"MyHybrid.xll" && hello[1] == L"MyHello" && hello[2] == L"Q$" && hello[3] == L"MyHello" && hello[5] == L"#1",
+               "The DLL, export, type and worksheet name should be passed");
+        Assert(matrix[3] == L"Matrix.Of" && matrix[4] == L"handle" && matrix[6] == L"Tests" && matrix[9] == L"Resolves a handle",
+               "Argument names, category and help should be passed");
+        Assert(MockExcel::frees == 1, "The DLL name should be freed");
+        rtd::Excel12Entry().store(nullptr);
+    }
+
+    // Test 29: Thread-Safe RTD Wrapper Functions
+    std::cout << "Test 29: RTD Wrapper Functions..." << std::endl;
+    {
+        static const rtd::XlRtdFunction quote(L"My.Hybrid.Server");
+        rtd::Excel12Entry().store(&MockExcel::Call);
+        auto text = [](LPXLOPER12 result) {
+            return (result->xltype & ~static_cast<DWORD>(xlbitXLFree)) == xltypeStr ? std::wstring(result->val.str + 1, result->val.str[0])
+                                                                                    : std::wstring();
+        };
+
+        XLOPER12 symbol = {};
+        XCHAR symbolText[] = L"\x0004" L"AAPL";
+        symbol.xltype = xltypeStr;
+        symbol.val.str = symbolText;
+        XLOPER12 number = {};
+        number.xltype = xltypeNum;
+        number.val.num = 2.5;
+        XLOPER12 flag = {};
+        flag.xltype = xltypeBool;
+        flag.val.xbool = TRUE;
+        XLOPER12 missing = {};
+        missing.xltype = xltypeMissing;
+
+        LPXLOPER12 result = quote(L"quote", symbol, number, flag, missing);
+        Assert(result->xltype == (xltypeStr | xlbitXLFree), "The RTD value should be returned for Excel to free");
+        Assert(text(result) == L"My.Hybrid.Server||quote|AAPL|2.5|TRUE|", "Topics should be passed as strings after the ProgID and server");
+
+        XLOPER12 error = {};
+        error.xltype = xltypeErr;
+        error.val.err = xlerrDiv0;
+        int calls = MockExcel::rtdCalls;
+        result = quote(L"quote", symbol, error);
+        Assert(result->xltype == xltypeErr && result->val.err == xlerrDiv0 && MockExcel::rtdCalls == calls,
+               "An error argument should be returned without calling RTD");
+        XLOPER12 array = {};
+        array.xltype = xltypeMulti;
+        result = quote(L"quote", array);
+        Assert(result->xltype == xltypeErr && result->val.err == xlerrValue, "Arrays should give #VALUE!");
+
+        // Recalculation threads: each has its own arena and result slot, and warm calls do not grow the arena
+        std::atomic<int> mismatches{ 0 };
+        std::atomic<int> grew{ 0 };
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t]() {
+                XLOPER12 field = {};
+                field.xltype = xltypeNum;
+                field.val.num = t;
+                quote(L"quote", symbol, field);
+                size_t capacity = rtd::XlArena::Current().Capacity();
+                std::wstring expected = L"My.Hybrid.Server||quote|AAPL|" + std::to_wstring(t);
+                for (int i = 0; i < 1000; ++i) {
+                    LPXLOPER12 value = quote(L"quote", symbol, field);
+                    if (value->val.str[0] != expected.size() || std::wstring(value->val.str + 1, value->val.str[0]) != expected) ++mismatches;
+                }
+                if (rtd::XlArena::Current().Capacity() != capacity) ++grew;
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+        Assert(mismatches == 0, "Concurrent calls should each see their own topics");
+        Assert(grew == 0, "Warm calls should not allocate arena memory");
+
+        rtd::Excel12Entry().store(nullptr);
+        result = quote(L"quote", symbol);
+        Assert(result->xltype == xltypeErr && result->val.err == xlerrNA, "A failed RTD call should give #N/A");
+    }
+
     std::cout << "All Unit Tests Passed." << std::endl;
     return 0;
 }